@@ -0,0 +1,108 @@
+// Copyright 2019 Intel Corporation.
+
+#include "base/util/executor.h"
+
+#include <boost/thread/executors/basic_thread_pool.hpp>
+#include <boost/thread/executors/inline_executor.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "base/util/env.h"
+#include "base/util/logging.h"
+
+namespace vertexai {
+namespace {
+
+namespace ex = boost::executors;
+
+std::atomic<ex::executor*> current_{nullptr};
+
+// Every executor which has ever been the runtime executor. This is leaked
+// deliberately: continuations may still be pending on any of them at exit.
+std::mutex& RetainedMutex() {
+  static std::mutex* mu = new std::mutex;
+  return *mu;
+}
+
+std::vector<std::shared_ptr<ex::executor>>& Retained() {
+  static auto* retained = new std::vector<std::shared_ptr<ex::executor>>;
+  return *retained;
+}
+
+// The default executor is built by whichever continuation first touches the
+// runtime, so a bad setting is ignored with a warning rather than thrown.
+std::size_t ExecutorThreads() {
+  auto threads = env::Get("PLAIDML_EXECUTOR_THREADS");
+  if (threads.empty()) {
+    return 0;
+  }
+  if (4 < threads.size() || !std::all_of(threads.begin(), threads.end(), [](char c) { return std::isdigit(c); })) {
+    LOG(WARNING) << "Ignoring malformed PLAIDML_EXECUTOR_THREADS: " << threads;
+    return 0;
+  }
+  return std::stoul(threads);
+}
+
+std::shared_ptr<ex::executor> MakeDefaultExecutor() {
+  auto kind = env::Get("PLAIDML_EXECUTOR");
+  if (kind == "inline") {
+    return MakeInlineExecutor();
+  }
+  if (!kind.empty() && kind != "pool") {
+    LOG(WARNING) << "Ignoring unknown PLAIDML_EXECUTOR: " << kind;
+  }
+  return MakeThreadPoolExecutor(ExecutorThreads());
+}
+
+}  // namespace
+
+ex::executor& RuntimeExecutor() {
+  auto* executor = current_.load(std::memory_order_acquire);
+  if (executor) {
+    return *executor;
+  }
+  static std::once_flag init_once;
+  std::call_once(init_once, []() {
+    auto executor = MakeDefaultExecutor();
+    std::lock_guard<std::mutex> lock{RetainedMutex()};
+    Retained().push_back(executor);
+    // An executor installed concurrently takes precedence.
+    ex::executor* expected = nullptr;
+    current_.compare_exchange_strong(expected, executor.get(), std::memory_order_acq_rel);
+  });
+  return *current_.load(std::memory_order_acquire);
+}
+
+void SetRuntimeExecutor(std::shared_ptr<ex::executor> executor) {
+  std::lock_guard<std::mutex> lock{RetainedMutex()};
+  Retained().push_back(executor);
+  current_.store(executor.get(), std::memory_order_release);
+}
+
+std::shared_ptr<ex::executor> MakeInlineExecutor() {
+  return std::make_shared<ex::executor_adaptor<ex::inline_executor>>();
+}
+
+std::shared_ptr<ex::executor> MakeThreadPoolExecutor(std::size_t threads) {
+  if (!threads) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return std::make_shared<ex::executor_adaptor<ex::basic_thread_pool>>(threads);
+}
+
+std::size_t CallerExecutor::RunQueued() {
+  std::size_t count = 0;
+  while (underlying_executor().try_executing_one()) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace vertexai
@@ -0,0 +1,46 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <boost/thread/executors/executor.hpp>
+#include <boost/thread/executors/executor_adaptor.hpp>
+#include <boost/thread/executors/loop_executor.hpp>
+
+#include <cstddef>
+#include <memory>
+
+namespace vertexai {
+
+// The runtime binds the continuation of every future it chains to the runtime
+// executor, e.g. fut.then(RuntimeExecutor(), ...), rather than using the
+// default launch policy, which may start a thread per continuation.
+//
+// By default, the runtime executor is a thread pool with one thread per
+// hardware thread (or PLAIDML_EXECUTOR_THREADS threads); setting
+// PLAIDML_EXECUTOR=inline selects an inline executor instead, which runs each
+// continuation on whichever thread completes its antecedent (or on the
+// chaining thread, if the antecedent is already complete). Malformed settings
+// are logged and ignored.
+boost::executors::executor& RuntimeExecutor();
+
+// Replaces the runtime executor. Continuations already bound to the previous
+// executor still run there; executors are retained for the life of the
+// process, so that they never disappear from under such continuations.
+void SetRuntimeExecutor(std::shared_ptr<boost::executors::executor> executor);
+
+// Returns an executor which runs each closure as soon as it is submitted.
+std::shared_ptr<boost::executors::executor> MakeInlineExecutor();
+
+// Returns an executor which runs closures on a fixed set of threads; if
+// threads is zero, one per hardware thread.
+std::shared_ptr<boost::executors::executor> MakeThreadPoolExecutor(std::size_t threads = 0);
+
+// CallerExecutor queues closures until a thread drives it, which lets an
+// application run the runtime's continuations from its own event loop.
+class CallerExecutor final : public boost::executors::executor_adaptor<boost::executors::loop_executor> {
+ public:
+  // Runs closures until the queue is empty, returning the number run.
+  std::size_t RunQueued();
+};
+
+}  // namespace vertexai
@@ -0,0 +1,87 @@
+// Copyright 2019 Intel Corporation.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/thread/future.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "base/util/executor.h"
+
+using ::testing::Eq;
+
+namespace vertexai {
+namespace {
+
+TEST(ExecutorTest, InlineRunsOnSubmission) {
+  auto executor = MakeInlineExecutor();
+  auto caller = std::this_thread::get_id();
+  std::thread::id ran_on;
+  executor->submit([&ran_on]() { ran_on = std::this_thread::get_id(); });
+  EXPECT_THAT(ran_on, Eq(caller));
+}
+
+TEST(ExecutorTest, ThreadPoolRunsEverything) {
+  auto executor = MakeThreadPoolExecutor(3);
+  const int kClosures = 100;
+  std::atomic<int> ran{0};
+  std::vector<boost::future<void>> done;
+  for (int idx = 0; idx < kClosures; ++idx) {
+    auto promise = std::make_shared<boost::promise<void>>();
+    done.emplace_back(promise->get_future());
+    executor->submit([&ran, promise]() {
+      ++ran;
+      promise->set_value();
+    });
+  }
+  for (auto& fut : done) {
+    fut.get();
+  }
+  EXPECT_THAT(ran.load(), Eq(kClosures));
+}
+
+TEST(ExecutorTest, CallerExecutorRunsOnlyWhenDriven) {
+  CallerExecutor executor;
+  std::vector<int> order;
+  for (int idx = 0; idx < 3; ++idx) {
+    executor.submit([&order, idx]() { order.push_back(idx); });
+  }
+  EXPECT_TRUE(order.empty());
+  EXPECT_THAT(executor.RunQueued(), Eq(3));
+  EXPECT_THAT(order, Eq(std::vector<int>{0, 1, 2}));
+  EXPECT_THAT(executor.RunQueued(), Eq(0));
+
+  // Closures queued by running closures are run in the same pass.
+  executor.submit([&executor, &order]() { executor.submit([&order]() { order.push_back(4); }); });
+  EXPECT_THAT(executor.RunQueued(), Eq(2));
+  EXPECT_THAT(order.back(), Eq(4));
+}
+
+TEST(ExecutorTest, RuntimeContinuationsRunOnInstalledExecutor) {
+  auto executor = std::make_shared<CallerExecutor>();
+  SetRuntimeExecutor(executor);
+  EXPECT_THAT(&RuntimeExecutor(), Eq(executor.get()));
+
+  boost::promise<int> promise;
+  auto result = promise.get_future().then(RuntimeExecutor(), [](boost::future<int> fut) { return fut.get() + 1; });
+  promise.set_value(41);
+  // The continuation waits for the application to drive the executor.
+  EXPECT_FALSE(result.is_ready());
+  EXPECT_THAT(executor->RunQueued(), Eq(1));
+  ASSERT_TRUE(result.is_ready());
+  EXPECT_THAT(result.get(), Eq(42));
+
+  // Replacing the executor leaves the old one usable.
+  auto replacement = MakeInlineExecutor();
+  SetRuntimeExecutor(replacement);
+  EXPECT_THAT(&RuntimeExecutor(), Eq(replacement.get()));
+  executor->submit([]() {});
+  EXPECT_THAT(executor->RunQueued(), Eq(1));
+}
+
+}  // namespace
+}  // namespace vertexai
@@ -2,6 +2,8 @@
 
 #include "base/util/file.h"
 
+#include <algorithm>
+
 #include <boost/format.hpp>
 
 #include "base/util/throw.h"
@@ -46,4 +48,76 @@ void WriteFile(const boost::filesystem::path& path,  //
   WriteFile(path, binary, [contents](std::ofstream& fout) { fout << contents; });
 }
 
+bool ReplaceFile(const boost::filesystem::path& path,  //
+                 const std::function<bool(const boost::filesystem::path& tmp_path)>& write) {
+  boost::system::error_code ec;
+  if (path.has_parent_path()) {
+    boost::filesystem::create_directories(path.parent_path(), ec);
+  }
+  auto tmp_path = path.parent_path() / boost::filesystem::unique_path(path.filename().string() + ".%%%%-%%%%");
+  bool written = false;
+  try {
+    written = write(tmp_path);
+  } catch (...) {
+    boost::filesystem::remove(tmp_path, ec);
+    throw;
+  }
+  if (written) {
+    boost::filesystem::rename(tmp_path, path, ec);
+    if (!ec) {
+      return true;
+    }
+  }
+  boost::filesystem::remove(tmp_path, ec);
+  return false;
+}
+
+bool WriteFileAtomically(const boost::filesystem::path& path,  //
+                         bool binary,                          //
+                         const std::function<void(std::ofstream& fout)>& writer) {
+  return ReplaceFile(path, [&](const boost::filesystem::path& tmp_path) {
+    std::ios_base::openmode mode = std::ios_base::out;
+    if (binary) {
+      mode |= std::ios::binary;
+    }
+    std::ofstream fout(tmp_path.string(), mode);
+    writer(fout);
+    fout.close();
+    return !fout.fail();
+  });
+}
+
+void WriteString(std::ostream& out, const std::string& str) { out << str.size() << ':' << str << '\n'; }
+
+bool ReadString(std::istream& in, std::string* str) {
+  std::uint64_t size;
+  if (!(in >> size) || in.get() != ':') {
+    return false;
+  }
+  auto pos = in.tellg();
+  if (pos < 0 || !in.seekg(0, std::ios::end)) {
+    return false;
+  }
+  auto end = in.tellg();
+  if (!in.seekg(pos) || end < pos || static_cast<std::uint64_t>(end - pos) <= size) {
+    return false;
+  }
+  str->resize(size);
+  if (size && !in.read(&(*str)[0], size)) {
+    return false;
+  }
+  return in.get() == '\n';
+}
+
+bool ReadNumber(std::istream& in, std::uint64_t* value) {
+  std::string str;
+  // Nineteen decimal digits always fit in a uint64_t.
+  if (!ReadString(in, &str) || str.empty() || 19 < str.size() ||
+      !std::all_of(str.begin(), str.end(), [](char c) { return '0' <= c && c <= '9'; })) {
+    return false;
+  }
+  *value = std::stoull(str);
+  return true;
+}
+
 }  // namespace vertexai
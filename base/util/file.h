@@ -2,8 +2,11 @@
 
 #pragma once
 
+#include <cstdint>
 #include <fstream>
 #include <functional>
+#include <istream>
+#include <ostream>
 #include <string>
 
 #include <boost/filesystem.hpp>
@@ -20,4 +23,25 @@ void WriteFile(const boost::filesystem::path& path,  //
                bool binary,                          //
                const std::function<void(std::ofstream& fout)>& writer);
 
+// Replaces a file without readers ever seeing it incomplete: write is handed a private temporary path beside the
+// file, which is renamed over the file if write returns true, and removed otherwise.  The parent directories are
+// created if needed.  Returns whether the file was replaced.
+bool ReplaceFile(const boost::filesystem::path& path,  //
+                 const std::function<bool(const boost::filesystem::path& tmp_path)>& write);
+
+// Replaces a file with the output of writer, as ReplaceFile does.  Returns false if the stream fails.
+bool WriteFileAtomically(const boost::filesystem::path& path,  //
+                         bool binary,                          //
+                         const std::function<void(std::ofstream& fout)>& writer);
+
+// Writes a string as its length, a colon, its bytes, and a newline.
+void WriteString(std::ostream& out, const std::string& str);
+
+// Reads a string written by WriteString.  Returns false if the stream doesn't hold a well-formed string; a corrupt
+// length never allocates more than the stream holds.
+bool ReadString(std::istream& in, std::string* str);
+
+// Reads an unsigned integer written by WriteString.  Returns false if the string isn't one.
+bool ReadNumber(std::istream& in, std::uint64_t* value);
+
 }  // namespace vertexai
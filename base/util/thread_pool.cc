@@ -0,0 +1,193 @@
+// Copyright 2019 Intel Corporation.
+
+#include "base/util/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace vertexai {
+
+namespace {
+
+thread_local bool in_worker = false;
+
+}  // namespace
+
+struct ThreadPool::Job {
+  // A participant's share of the iteration space, [begin, end).
+  struct Range {
+    std::mutex mu;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+  };
+
+  Job(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body,
+      std::size_t participants)
+      : body{body}, grain{grain}, ranges(participants), pending{count} {
+    for (std::size_t idx = 0; idx < participants; ++idx) {
+      ranges[idx].begin = count * idx / participants;
+      ranges[idx].end = count * (idx + 1) / participants;
+    }
+  }
+
+  // Moves the back half of some other participant's range into the
+  // indicated slot.  Returns false if there was nothing left to steal.
+  bool Steal(std::size_t slot) {
+    for (std::size_t offset = 1; offset < ranges.size(); ++offset) {
+      auto& victim = ranges[(slot + offset) % ranges.size()];
+      std::size_t begin;
+      std::size_t end;
+      {
+        std::lock_guard<std::mutex> lock{victim.mu};
+        if (victim.end <= victim.begin) {
+          continue;
+        }
+        begin = victim.begin + (victim.end - victim.begin) / 2;
+        end = victim.end;
+        victim.end = begin;
+      }
+      auto& own = ranges[slot];
+      std::lock_guard<std::mutex> lock{own.mu};
+      own.begin = begin;
+      own.end = end;
+      return true;
+    }
+    return false;
+  }
+
+  const std::function<void(std::size_t, std::size_t)>& body;
+  const std::size_t grain;
+  std::vector<Range> ranges;
+  std::atomic<std::size_t> next_slot{1};  // Slot zero belongs to the issuing thread
+  std::atomic<std::size_t> pending;       // Iterations not yet completed
+
+  std::mutex mu;
+  std::condition_variable cv;
+  bool done = false;
+  std::exception_ptr error;
+};
+
+ThreadPool::ThreadPool(std::size_t threads) {
+  if (!threads) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads_.reserve(threads);
+  for (std::size_t idx = 0; idx < threads; ++idx) {
+    threads_.emplace_back([this]() { WorkerMain(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{mu_};
+    shutdown_ = true;
+  }
+  cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+ThreadPool& ThreadPool::Global() {
+  static ThreadPool pool;
+  return pool;
+}
+
+bool ThreadPool::InWorker() { return in_worker; }
+
+void ThreadPool::ParallelFor(std::size_t count, std::size_t grain,
+                             const std::function<void(std::size_t, std::size_t)>& body) {
+  grain = std::max<std::size_t>(grain, 1);
+  if (!count) {
+    return;
+  }
+  if (in_worker || threads_.empty() || count <= grain) {
+    for (std::size_t begin = 0; begin < count; begin += grain) {
+      body(begin, std::min(count, begin + grain));
+    }
+    return;
+  }
+
+  std::size_t participants = std::min(threads_.size() + 1, (count + grain - 1) / grain);
+  auto job = std::make_shared<Job>(count, grain, body, participants);
+  {
+    std::lock_guard<std::mutex> lock{mu_};
+    jobs_.push_back(job);
+  }
+  cv_.notify_all();
+
+  Participate(job.get(), 0);
+
+  {
+    std::unique_lock<std::mutex> lock{job->mu};
+    job->cv.wait(lock, [&job]() { return job->done; });
+  }
+  {
+    std::lock_guard<std::mutex> lock{mu_};
+    auto it = std::find(jobs_.begin(), jobs_.end(), job);
+    if (it != jobs_.end()) {
+      jobs_.erase(it);
+    }
+  }
+  if (job->error) {
+    std::rethrow_exception(job->error);
+  }
+}
+
+void ThreadPool::WorkerMain() {
+  in_worker = true;
+  std::unique_lock<std::mutex> lock{mu_};
+  for (;;) {
+    cv_.wait(lock, [this]() { return shutdown_ || !jobs_.empty(); });
+    if (shutdown_) {
+      return;
+    }
+    std::shared_ptr<Job> job = jobs_.front();
+    std::size_t slot = job->next_slot++;
+    if (job->ranges.size() <= slot) {
+      // Every slot of this job has been claimed; the participants will
+      // rebalance the remaining work amongst themselves.
+      jobs_.pop_front();
+      continue;
+    }
+    lock.unlock();
+    Participate(job.get(), slot);
+    lock.lock();
+  }
+}
+
+void ThreadPool::Participate(Job* job, std::size_t slot) {
+  auto& own = job->ranges[slot];
+  for (;;) {
+    std::size_t begin;
+    std::size_t end;
+    {
+      std::lock_guard<std::mutex> lock{own.mu};
+      begin = own.begin;
+      end = std::min(own.end, begin + job->grain);
+      own.begin = std::max(begin, end);
+    }
+    if (end <= begin) {
+      if (!job->Steal(slot)) {
+        return;
+      }
+      continue;
+    }
+    try {
+      job->body(begin, end);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock{job->mu};
+      if (!job->error) {
+        job->error = std::current_exception();
+      }
+    }
+    if (job->pending.fetch_sub(end - begin) == end - begin) {
+      std::lock_guard<std::mutex> lock{job->mu};
+      job->done = true;
+      job->cv.notify_all();
+    }
+  }
+}
+
+}  // namespace vertexai
@@ -0,0 +1,65 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vertexai {
+
+// ThreadPool runs data-parallel loops on a fixed set of worker threads.
+//
+// Each call to ParallelFor divides its iteration space into one range per
+// participant (every worker plus the calling thread).  A participant consumes
+// its own range from the front, one grain at a time; once it runs dry, it
+// steals the back half of another participant's remaining range.  This keeps
+// all cores busy even when the cost of individual iterations varies.
+//
+// Multiple threads may issue loops concurrently; workers service the loops in
+// the order in which they were issued.  A loop issued from within a pool
+// worker runs inline on that worker, so nested parallel loops cannot deadlock.
+class ThreadPool final {
+ public:
+  // Creates a pool with the indicated number of worker threads.  If threads
+  // is zero, the pool sizes itself to the hardware concurrency.
+  explicit ThreadPool(std::size_t threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Returns the process-wide pool.
+  static ThreadPool& Global();
+
+  // Returns true if the current thread is a worker belonging to any pool.
+  static bool InWorker();
+
+  // The number of worker threads in the pool.
+  std::size_t size() const { return threads_.size(); }
+
+  // Invokes body(begin, end) over disjoint subranges covering [0, count),
+  // each at most grain iterations long, and returns once all of them have
+  // completed.  If any invocation throws, the first exception is rethrown
+  // to the caller after the loop has drained.
+  void ParallelFor(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& body);
+
+ private:
+  struct Job;
+
+  void WorkerMain();
+  static void Participate(Job* job, std::size_t slot);
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::shared_ptr<Job>> jobs_;
+  bool shutdown_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace vertexai
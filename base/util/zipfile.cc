@@ -9,7 +9,7 @@ const size_t BLOCK_SIZE = 8 * 1024;
 
 namespace vertexai {
 
-UnZipArchive::UnZipArchive(const std::string& path) : zip_file_(unzOpen64(path.c_str())) {
+UnZipArchive::UnZipArchive(const std::string& path) : path_{path}, zip_file_(unzOpen64(path.c_str())) {
   if (!zip_file_) {
     throw std::runtime_error("Cannot open zip archive for extraction.");
   }
@@ -30,6 +30,8 @@ UnZipFile::UnZipFile(unzFile zip_file, const std::string& filename) : zip_file_(
   }
   unzOpenCurrentFile(zip_file_);
   unzGetCurrentFileInfo64(zip_file_, &fi_, nullptr, 0, nullptr, 0, nullptr, 0);
+  // Nothing has been read yet, so the stream is positioned at the start of the file's contents.
+  offset_ = unzGetCurrentFileZStreamPos64(zip_file_);
 }
 
 UnZipFile::~UnZipFile() { unzCloseCurrentFile(zip_file_); }
@@ -54,4 +56,39 @@ void UnZipFile::ReadInto(void* buf, std::size_t len) {
   }
 }
 
+ZipArchive::ZipArchive(const std::string& path) {
+  // The default file functions ignore their opaque pointer, so the archive uses it to find itself when the stream is
+  // opened, and keeps the stream so that it can ask for the stream's position.
+  fill_fopen64_filefunc(&base_);
+  funcs_ = base_;
+  funcs_.zopen64_file = &ZipArchive::Open;
+  funcs_.opaque = this;
+  zip_file_ = zipOpen2_64(path.c_str(), APPEND_STATUS_CREATE, nullptr, &funcs_);
+  if (!zip_file_) {
+    throw std::runtime_error("Cannot open zip archive for writing: " + path);
+  }
+}
+
+ZipArchive::~ZipArchive() {
+  if (zip_file_) {
+    zipClose(zip_file_, nullptr);
+  }
+}
+
+voidpf ZCALLBACK ZipArchive::Open(voidpf opaque, const void* filename, int mode) {
+  auto archive = static_cast<ZipArchive*>(opaque);
+  archive->stream_ = archive->base_.zopen64_file(archive->base_.opaque, filename, mode);
+  return archive->stream_;
+}
+
+std::uint64_t ZipArchive::Tell() const { return base_.ztell64_file(base_.opaque, stream_); }
+
+void ZipArchive::Close() {
+  zipFile zip_file = zip_file_;
+  zip_file_ = nullptr;
+  if (zipClose(zip_file, nullptr) != ZIP_OK) {
+    throw std::runtime_error("Failed to write zip archive.");
+  }
+}
+
 }  // namespace vertexai
@@ -3,7 +3,9 @@
 #pragma once
 
 #include <unzip.h>
+#include <zip.h>
 
+#include <cstdint>
 #include <string>
 
 namespace vertexai {
@@ -20,9 +22,20 @@ class UnZipFile {
   std::string ReadString();
   void ReadInto(void* buf, std::size_t len);
 
+  // The size of the file's contents.
+  std::uint64_t size() const { return fi_.uncompressed_size; }
+
+  // Whether the file's contents are stored as is: neither compressed nor encrypted.  The contents of a stored file may
+  // be read (or mapped) directly from the archive, starting at offset().
+  bool is_stored() const { return fi_.compression_method == 0 && !(fi_.flag & 1); }
+
+  // The offset of the file's contents within the archive.
+  std::uint64_t offset() const { return offset_; }
+
  private:
   unzFile zip_file_;
   unz_file_info64 fi_;
+  std::uint64_t offset_ = 0;
 };
 
 class UnZipArchive {
@@ -33,8 +46,39 @@ class UnZipArchive {
   bool Exist(const std::string& filename);
   UnZipFile OpenFile(const std::string& filename);
 
+  const std::string& path() const { return path_; }
+
  private:
+  std::string path_;
   unzFile zip_file_;
 };
 
+// ZipArchive writes a zip archive, keeping track of where in the archive its files' contents land, so that they can
+// be laid out for mapping.
+class ZipArchive {
+ public:
+  explicit ZipArchive(const std::string& path);
+  ~ZipArchive();
+
+  ZipArchive(const ZipArchive&) = delete;
+  ZipArchive& operator=(const ZipArchive&) = delete;
+
+  zipFile get() const { return zip_file_; }
+
+  // Returns the offset within the archive at which the next byte written will be placed.  Right after a file is
+  // opened, this is the offset of the file's contents.
+  std::uint64_t Tell() const;
+
+  // Closes the archive, writing its central directory.
+  void Close();
+
+ private:
+  static voidpf ZCALLBACK Open(voidpf opaque, const void* filename, int mode);
+
+  zlib_filefunc64_def base_;
+  zlib_filefunc64_def funcs_;
+  voidpf stream_ = nullptr;
+  zipFile zip_file_ = nullptr;
+};
+
 }  // namespace vertexai
@@ -690,6 +690,24 @@ class _Library(plaidml.library.Library):
         self.plaidml_set_invoker_const.restype = ctypes.c_bool
         self.plaidml_set_invoker_const.errcheck = self._check_err
 
+        # PLAIDML_API bool plaidml_set_invoker_max_batch(plaidml_invoker* invoker, uint64_t max_batch);
+        self.plaidml_set_invoker_max_batch = lib.plaidml_set_invoker_max_batch
+        self.plaidml_set_invoker_max_batch.argtypes = [
+            ctypes.POINTER(_C_Invoker),  # plaidml_invoker* invoker
+            ctypes.c_uint64,  # uint64_t max_batch
+        ]
+        self.plaidml_set_invoker_max_batch.restype = ctypes.c_bool
+        self.plaidml_set_invoker_max_batch.errcheck = self._check_err
+
+        # PLAIDML_API bool plaidml_set_invoker_batched(plaidml_invoker* invoker, const char* name);
+        self.plaidml_set_invoker_batched = lib.plaidml_set_invoker_batched
+        self.plaidml_set_invoker_batched.argtypes = [
+            ctypes.POINTER(_C_Invoker),  # plaidml_invoker* invoker
+            ctypes.c_char_p,  # const char* name
+        ]
+        self.plaidml_set_invoker_batched.restype = ctypes.c_bool
+        self.plaidml_set_invoker_batched.errcheck = self._check_err
+
         # bool plaidml_save_invoker(plaidml_invoker* invoker, const char* filename, plaidml_file_format format)
         self.plaidml_save_invoker = lib.plaidml_save_invoker
         self.plaidml_save_invoker.argtypes = [
@@ -1451,6 +1469,12 @@ class Invoker(object):
     def set_const(self):
         _lib().plaidml_set_invoker_const(self)
 
+    def set_max_batch(self, max_batch):
+        _lib().plaidml_set_invoker_max_batch(self, max_batch)
+
+    def set_batched(self, name):
+        _lib().plaidml_set_invoker_batched(self, name.encode())
+
     def invoke(self):
         return Invocation(self._ctx, self)
 
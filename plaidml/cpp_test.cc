@@ -3,6 +3,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+
 #include "base/util/logging.h"
 #include "plaidml/base/context.h"
 #include "plaidml/plaidml++.h"
@@ -184,4 +186,160 @@ TEST(PlaidML_CPP_API, MultiDep) {
   }
 }
 
+TEST(PlaidML_CPP_API, BatchSmallerThanBucket) {
+  const std::size_t K = 5;
+
+  vai_clear_status();
+  auto ctx = std::make_shared<vertexai::ctx>();
+
+  auto devices = enumerate_devices(ctx, vertexai::testing::PlaidMLConfig());
+  device dev = devices[0].open();
+  function scale(R"(
+    function (A[N, K], B[K]) -> (O) {
+      O = A * 2 + B;
+    }
+  )");
+
+  tensor<float> bias = dev.allocate(shape<float>(ctx, {K}));
+  {
+    mapping<float> view = bias.map(map_for_write);
+    for (size_t k = 0; k < K; k++) {
+      view(k) = 100 * k;
+    }
+  }
+
+  // Batches of 3 and 5 run padded to buckets of 4 and 8; the unbatched bias keeps its own outermost dimension.
+  for (size_t batch : {3, 4, 5}) {
+    tensor<float> in = dev.allocate(shape<float>(ctx, {batch, K}));
+    {
+      mapping<float> view = in.map(map_for_write);
+      for (size_t n = 0; n < batch; n++) {
+        for (size_t k = 0; k < K; k++) {
+          view(n, k) = K * n + k;
+        }
+      }
+    }
+    tensor<float> out = dev.allocate(shape<float>(ctx, {batch, K}));
+
+    invoker inv(ctx, scale);
+    inv.set_max_batch(8);
+    inv.set_input("A", in)
+        .set_input("B", bias)
+        .set_output("O", out)
+        .set_batched("A")
+        .set_batched("O")
+        .invoke();
+
+    mapping<float> view = out.map(map_for_read);
+    for (size_t n = 0; n < batch; n++) {
+      for (size_t k = 0; k < K; k++) {
+        EXPECT_THAT(view(n, k), Eq(2 * (K * n + k) + 100 * k)) << "batch " << batch << " at " << n << ", " << k;
+      }
+    }
+  }
+}
+
+// Counts the programs invokers resolve, rather than reusing the one they resolved for their previous invocation.
+class ResolutionCounter final : public vertexai::context::EventLog {
+ public:
+  void LogEvent(vertexai::context::proto::Event event) final {
+    if (event.verb() == "plaidml::invoker::ResolveProgram") {
+      ++count_;
+    }
+  }
+  void FlushAndClose() final {}
+
+  std::size_t count() const { return count_; }
+
+ private:
+  std::atomic_size_t count_{0};
+};
+
+TEST(PlaidML_CPP_API, InvokerResolvesProgramOnChange) {
+  vai_clear_status();
+  auto ctx = std::make_shared<vertexai::ctx>();
+  auto counter = std::make_shared<ResolutionCounter>();
+  ctx->get_ctx()->activity.mutable_ctx()->set_eventlog(counter).set_is_logging_events(true);
+
+  auto devices = enumerate_devices(ctx, vertexai::testing::PlaidMLConfig());
+  device dev = devices[0].open();
+  function add("function (A[N, K], B[K]) -> (O) { O = A + B; }");
+
+  auto fill = [&](std::size_t rows, std::size_t cols, float base) {
+    tensor<float> t = dev.allocate(shape<float>(ctx, {rows, cols}));
+    mapping<float> view = t.map(map_for_write);
+    for (size_t i = 0; i < rows; i++) {
+      for (size_t j = 0; j < cols; j++) {
+        view(i, j) = base + i * cols + j;
+      }
+    }
+    return t;
+  };
+  tensor<float> bias = dev.allocate(shape<float>(ctx, {4}));
+  {
+    mapping<float> view = bias.map(map_for_write);
+    for (size_t j = 0; j < 4; j++) {
+      view(j) = 100 * j;
+    }
+  }
+  auto check = [&](tensor<float>* out, std::size_t rows, float base) {
+    mapping<float> view = out->map(map_for_read);
+    for (size_t i = 0; i < rows; i++) {
+      for (size_t j = 0; j < 4; j++) {
+        EXPECT_THAT(view(i, j), Eq(base + i * 4 + j + 100 * j));
+      }
+    }
+  };
+
+  invoker inv(ctx, add);
+  tensor<float> in2 = fill(2, 4, 0);
+  tensor<float> out2 = dev.allocate(shape<float>(ctx, {2, 4}));
+  inv.set_input("A", in2).set_input("B", bias).set_output("O", out2).invoke();
+  check(&out2, 2, 0);
+  EXPECT_THAT(counter->count(), Eq(1u));
+
+  // Rebinding parameters to tensors of the same shapes reuses the program.
+  tensor<float> other2 = fill(2, 4, 10);
+  tensor<float> other_out2 = dev.allocate(shape<float>(ctx, {2, 4}));
+  inv.set_input("A", other2).set_output("O", other_out2).invoke();
+  check(&other_out2, 2, 10);
+  EXPECT_THAT(counter->count(), Eq(1u));
+
+  // An input with a new shape.
+  tensor<float> in3 = fill(3, 4, 20);
+  tensor<float> out3 = dev.allocate(shape<float>(ctx, {3, 4}));
+  inv.set_input("A", in3).set_output("O", out3).invoke();
+  check(&out3, 3, 20);
+  EXPECT_THAT(counter->count(), Eq(2u));
+
+  // An output which aliases an input, so that the program updates it in place.
+  inv.set_output("O", in3).invoke();
+  check(&in3, 3, 20);
+  EXPECT_THAT(counter->count(), Eq(3u));
+  tensor<float> fresh3 = fill(3, 4, 20);
+  inv.set_input("A", fresh3).set_output("O", out3).invoke();
+  check(&out3, 3, 20);
+  EXPECT_THAT(counter->count(), Eq(4u));
+
+  // A change to the maximum batch size; setting the same size again changes nothing.
+  inv.set_batched("A").set_batched("O");
+  EXPECT_THAT(counter->count(), Eq(4u));
+  inv.set_max_batch(4);
+  inv.invoke();
+  check(&out3, 3, 20);
+  EXPECT_THAT(counter->count(), Eq(5u));
+  inv.set_max_batch(4);
+  inv.invoke();
+  EXPECT_THAT(counter->count(), Eq(5u));
+  inv.set_max_batch(0);
+  inv.invoke();
+  EXPECT_THAT(counter->count(), Eq(6u));
+
+  // Marking the function's bound tensors constant lets the program fold them.
+  inv.set_const();
+  inv.invoke();
+  check(&out3, 3, 20);
+  EXPECT_THAT(counter->count(), Eq(7u));
+}
+
 }  // namespace
@@ -0,0 +1,76 @@
+// Copyright 2019 Intel Corporation.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "base/util/logging.h"
+#include "plaidml/plaidml++.h"
+#include "testing/plaidml_config.h"
+
+using ::testing::Eq;
+using ::testing::Ne;
+
+namespace {
+
+using namespace vertexai::plaidml;  // NOLINT
+
+// Measures the host-side cost of scheduling invocations of a trivial program: the time spent in
+// plaidml_schedule_invocation, not including the program's execution.  Invocations are made with a fresh invoker
+// each time (so each one resolves its program through the device's program cache), with one invoker reused as is,
+// and with one invoker whose inputs are rebound before each invocation, as a training loop would.
+
+const std::size_t invocations_ = 2000;
+
+template <typename F>
+void Measure(const std::string& kind, F invoke) {
+  std::vector<double> latencies;
+  for (std::size_t idx = 0; idx < invocations_; ++idx) {
+    auto start = std::chrono::steady_clock::now();
+    invoke();
+    latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  LOG(INFO) << kind << ": per-call overhead p50=" << latencies[latencies.size() / 2]
+            << "us p99=" << latencies[latencies.size() * 99 / 100] << "us max=" << latencies.back() << "us";
+}
+
+TEST(InvocationBench, Overhead) {
+  vai_clear_status();
+  auto ctx = std::make_shared<vertexai::ctx>();
+  auto devices = enumerate_devices(ctx, vertexai::testing::PlaidMLConfig());
+  ASSERT_THAT(devices.size(), Ne(0));
+  device dev = devices[0].open();
+
+  function add("function (A, B) -> (C) { C = A + B; }");
+  tensor<float> a = dev.allocate(shape<float>(ctx, {4, 4}));
+  tensor<float> b = dev.allocate(shape<float>(ctx, {4, 4}));
+  tensor<float> c = dev.allocate(shape<float>(ctx, {4, 4}));
+  for (auto* t : {&a, &b}) {
+    mapping<float> view = t->map(map_for_write);
+    for (std::size_t i = 0; i < 4; i++) {
+      for (std::size_t j = 0; j < 4; j++) {
+        view(i, j) = 1;
+      }
+    }
+  }
+
+  // Compile the program, so that it's in the program cache.
+  invoker(ctx, add).set_input("A", a).set_input("B", b).set_output("C", c).invoke();
+
+  Measure("fresh invoker", [&]() { invoker(ctx, add).set_input("A", a).set_input("B", b).set_output("C", c).invoke(); });
+
+  invoker reused{ctx, add};
+  reused.set_input("A", a).set_input("B", b).set_output("C", c);
+  Measure("reused invoker", [&]() { reused.invoke(); });
+  Measure("rebound invoker", [&]() { reused.set_input("A", a).set_input("B", b).invoke(); });
+
+  mapping<float> view = c.map(map_for_read);
+  EXPECT_THAT(view(3, 3), Eq(2));
+}
+
+}  // namespace
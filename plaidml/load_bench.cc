@@ -0,0 +1,105 @@
+// Copyright 2019 Intel Corporation.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "base/util/logging.h"
+#include "plaidml/plaidml++.h"
+#include "testing/plaidml_config.h"
+
+using ::testing::Ne;
+
+namespace {
+
+using namespace vertexai::plaidml;  // NOLINT
+
+// Measures loading a saved function whose constants are the size of ResNet-50's weights (about 25M parameters): the
+// time taken to load it and to run it for the first time, and the memory used after each step.  Saved tensors are
+// aligned within the file, so devices that can address host memory map them rather than reading them into freshly
+// allocated buffers; the mapped pages are shared with the page cache, and show up as shared rather than private
+// memory.
+
+const std::size_t layers_ = 25;
+const std::size_t width_ = 1000;
+
+// Logs the process's resident memory, as reported by /proc/self/statm.
+void LogMemory(const std::string& when) {
+  std::ifstream statm{"/proc/self/statm"};
+  std::size_t size, resident, shared;
+  if (!(statm >> size >> resident >> shared)) {
+    return;
+  }
+  std::size_t page_size = sysconf(_SC_PAGESIZE);
+  LOG(INFO) << when << ": resident=" << resident * page_size / (1 << 20) << "MB shared="
+            << shared * page_size / (1 << 20) << "MB private=" << (resident - shared) * page_size / (1 << 20) << "MB";
+}
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(LoadBench, ResNet50SizedConstants) {
+  vai_clear_status();
+  auto ctx = std::make_shared<vertexai::ctx>();
+  auto devices = enumerate_devices(ctx, vertexai::testing::PlaidMLConfig());
+  ASSERT_THAT(devices.size(), Ne(0));
+  device dev = devices[0].open();
+  function matmul("function (B[X,Z], C[Z,Y]) -> (A) { A[x,y : X,Y] = +(B[x,z] * C[z,y]); }");
+  auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("load_bench_%%%%%%.plaidml");
+
+  {
+    placeholder input(2);
+    variable output = input;
+    for (std::size_t layer = 0; layer < layers_; ++layer) {
+      tensor<float> weights = dev.allocate(shape<float>(ctx, {width_, width_}));
+      {
+        mapping<float> view = weights.map(map_for_write);
+        for (std::size_t i = 0; i < width_; i++) {
+          for (std::size_t j = 0; j < width_; j++) {
+            view(i, j) = 1.0 / width_;
+          }
+        }
+      }
+      output = matmul(output, weights);
+    }
+    function model = compose().input("X", input).output("Y", output);
+    model.save(path.string());
+  }
+  LOG(INFO) << "Saved " << boost::filesystem::file_size(path) / (1 << 20) << "MB of constants";
+  LogMemory("Before loading");
+
+  auto start = std::chrono::steady_clock::now();
+  function model;
+  model.load(ctx, dev, path.string());
+  LOG(INFO) << "Loaded in " << Seconds(start) << "s";
+  LogMemory("After loading");
+
+  tensor<float> x = dev.allocate(shape<float>(ctx, {1, width_}));
+  tensor<float> y = dev.allocate(shape<float>(ctx, {1, width_}));
+  {
+    mapping<float> view = x.map(map_for_write);
+    for (std::size_t j = 0; j < width_; j++) {
+      view(0, j) = 1;
+    }
+  }
+  start = std::chrono::steady_clock::now();
+  invoker(ctx, model).set_input("X", x).set_output("Y", y).invoke();
+  {
+    mapping<float> view = y.map(map_for_read);
+    EXPECT_NEAR(view(0, 0), 1, 1e-3);
+  }
+  LOG(INFO) << "First run (including compilation) in " << Seconds(start) << "s";
+  LogMemory("After the first run");
+
+  boost::filesystem::remove(path);
+}
+
+}  // namespace
@@ -673,6 +673,15 @@ class invoker {
 
   void set_const() { vai_exception::check_and_throw(plaidml_set_invoker_const(invoker_.get())); }
 
+  void set_max_batch(uint64_t max_batch) {
+    vai_exception::check_and_throw(plaidml_set_invoker_max_batch(invoker_.get(), max_batch));
+  }
+
+  invoker& set_batched(const std::string& name) {
+    vai_exception::check_and_throw(plaidml_set_invoker_batched(invoker_.get(), name.c_str()));
+    return *this;
+  }
+
   std::unique_ptr<plaidml_invocation> invoke() {
     std::unique_ptr<plaidml_invocation> invocation{plaidml_schedule_invocation(ctx_->get_ctx(), invoker_.get())};
     vai_exception::check_and_throw(invocation);
@@ -718,6 +727,9 @@ class executable {
 
  public:
   executable() = default;
+
+  // Runs the program on its bound buffers.  The first run prepares a plan which later runs replay, so an executable
+  // should be kept and rerun rather than recompiled for each invocation.
   void run() { plaidml_executable_run(ptr_.get()); }
 
  private:
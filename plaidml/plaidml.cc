@@ -13,10 +13,12 @@
 #include <atomic>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <exception>
 #include <fstream>
+#include <functional>
 #include <list>
 #include <map>
 #include <memory>
@@ -32,6 +34,8 @@
 #include "base/util/compat.h"
 #include "base/util/env.h"
 #include "base/util/error.h"
+#include "base/util/executor.h"
+#include "base/util/file.h"
 #include "base/util/logging.h"
 #include "base/util/sync.h"
 #include "base/util/type_url.h"
@@ -145,12 +149,23 @@ extern "C" bool plaidml_query_devconf(vai_ctx* ctx, plaidml_devconf* devconf, pl
 
 // plaidml_device
 
+// Returns the memory budget for each device's compiled program cache: PLAIDML_PROGRAM_CACHE_MB megabytes, or 1GB by
+// default.  A budget of zero disables the cache.
+std::size_t ProgramCacheBytes() {
+  std::size_t megabytes = 1024;
+  auto env_mb = vertexai::env::Get("PLAIDML_PROGRAM_CACHE_MB");
+  if (env_mb.length()) {
+    megabytes = std::strtoull(env_mb.c_str(), nullptr, 10);
+  }
+  return megabytes * 1024 * 1024;
+}
+
 class Evaluator final {
  public:
   explicit Evaluator(plaidml_devconf* devconf)
       : platform_{devconf->platform},
         id_{devconf->device.dev_id()},
-        program_cache_{std::make_shared<tile::ProgramCache>(platform_, 500 /* TODO: Make this configurable */)} {}
+        program_cache_{std::make_shared<tile::ProgramCache>(platform_, ProgramCacheBytes())} {}
 
   const std::shared_ptr<tile::Platform>& get_platform() const { return platform_; }
   const std::string& get_id() const { return id_; }
@@ -476,7 +491,7 @@ extern "C" plaidml_mapping* plaidml_map_buffer_current(plaidml_buffer* buffer,
     completion->rundown()->TryEnterGate(buffer->activity.ctx().gate());
     context::Activity activity{buffer->activity.ctx(), "tile::MapCurrent"};
     auto fut = buffer->state->buffer()->MapCurrent(activity.ctx());
-    fut.then([ completion, buffer_state = buffer->state,
+    fut.then(vertexai::RuntimeExecutor(), [ completion, buffer_state = buffer->state,
                activity = std::move(activity) ](boost::future<std::unique_ptr<tile::View>> f) noexcept {
       try {
         completion->OnComplete(activity.ctx(), std::move(f));
@@ -809,11 +824,36 @@ extern "C" void plaidml_free_function(plaidml_function* function) { delete funct
 
 namespace {
 
+// The alignment of tensor data within saved functions, which allows the data to be mapped directly from the file.
+const std::uint64_t tensor_alignment_ = 4096;
+
+// Serializes a shape that will be written at the supplied offset within a file, padding it so that the data following
+// it is aligned.
+std::string SerializeAlignedShape(const tile::TensorShape& shape, std::uint64_t offset) {
+  tile::proto::TensorShape pb_shape = tile::IntoProto(shape);
+  std::string unpadded = pb_shape.SerializeAsString();
+  std::uint64_t pad = (tensor_alignment_ - (offset + unpadded.size()) % tensor_alignment_) % tensor_alignment_;
+  for (; pad; pad += tensor_alignment_) {
+    // The padding field's tag and length take two or three bytes of the padding.
+    for (std::uint64_t overhead = 2; overhead <= 3 && overhead <= pad; ++overhead) {
+      pb_shape.set_padding(std::string(pad - overhead, '\0'));
+      if (pb_shape.ByteSizeLong() == unpadded.size() + pad) {
+        return pb_shape.SerializeAsString();
+      }
+    }
+  }
+  return unpadded;
+}
+
 //  V0 format:
 //  0..7  : shape size
 //  8..ss : shape
 //  ...   : tensor data
-void WriteTensor(zipFile f, const std::string& name, const TensorValue& tensor) {
+//
+// Tensors are stored uncompressed, with the shape padded so that the data is aligned to tensor_alignment_ within the
+// file.
+void WriteTensor(vertexai::ZipArchive* archive, const std::string& name, const TensorValue& tensor) {
+  zipFile f = archive->get();
   std::vector<size_t> rdims;
   const auto& tdims = tensor.shape().dims;
   for (size_t i = 0; i < tdims.size(); i++) {
@@ -835,8 +875,7 @@ void WriteTensor(zipFile f, const std::string& name, const TensorValue& tensor)
   if (zipOpenNewFileInZip64(f, name.c_str(), NULL, NULL, 0, NULL, 0, NULL, Z_NO_COMPRESSION, 0, 1) != ZIP_OK) {
     throw std::runtime_error("Could not write file into zip file");
   }
-  std::string shape_buf;
-  IntoProto(tensor.shape()).SerializeToString(&shape_buf);
+  std::string shape_buf = SerializeAlignedShape(tensor.shape(), archive->Tell() + sizeof(uint64_t));
   uint64_t shape_sz = shape_buf.size();
   zipWriteInFileInZip(f, &shape_sz, sizeof(shape_sz));
   zipWriteInFileInZip(f, &shape_buf[0], shape_sz);
@@ -860,7 +899,7 @@ void WriteString(zipFile f, const std::string& name, const std::string& value) {
 
 void WriteVersion(zipFile f) { WriteString(f, "version", "0"); }
 
-void WriteFunction(zipFile f, const BoundFunction& func) {
+void WriteFunction(vertexai::ZipArchive* archive, const BoundFunction& func) {
   if (func.out_bound().size() > 0) {
     throw std::runtime_error("Can't save a function that has bound outputs");
   }
@@ -868,12 +907,12 @@ void WriteFunction(zipFile f, const BoundFunction& func) {
     throw std::runtime_error("Can't save a function that has bound outputs");
   }
   std::string xo = to_string(Xify(func.prog()));
-  WriteString(f, "code", xo);
+  WriteString(archive->get(), "code", xo);
   for (const auto& kvp : func.in_bound()) {
-    WriteTensor(f, "data_" + kvp.first, *kvp.second);
+    WriteTensor(archive, "data_" + kvp.first, *kvp.second);
     auto qparams = kvp.second->qparams();
     if (qparams) {
-      WriteTensor(f, "qparams_" + kvp.first, *qparams);
+      WriteTensor(archive, "qparams_" + kvp.first, *qparams);
     }
   }
 }
@@ -902,6 +941,21 @@ void WriteMetadata(zipFile f, const BoundFunction& func, const std::map<std::str
   WriteString(f, "metadata", serialized);
 }
 
+// Saves an archive through a temporary file beside it, which is renamed over the file once complete.  The file being
+// replaced may hold tensors which loaded functions map straight from it; truncating it in place would pull the pages
+// out from under them, and its data might be the very data being saved.
+void SaveArchive(const std::string& filename, const std::function<void(vertexai::ZipArchive* archive)>& write) {
+  bool saved = vertexai::ReplaceFile(filename, [&](const boost::filesystem::path& tmp_path) {
+    vertexai::ZipArchive archive(tmp_path.string());
+    write(&archive);
+    archive.Close();
+    return true;
+  });
+  if (!saved) {
+    throw std::runtime_error{"Unable to save " + filename};
+  }
+}
+
 std::shared_ptr<TensorValue> ReadTensor(vai_ctx* ctx, vertexai::UnZipArchive* zip_file,
                                         const std::shared_ptr<Evaluator>& evaluator, const std::string& name) {
   auto tensor_file = zip_file->OpenFile(name);
@@ -916,6 +970,18 @@ std::shared_ptr<TensorValue> ReadTensor(vai_ctx* ctx, vertexai::UnZipArchive* zi
   tile::proto::TensorShape ts_proto;
   ts_proto.ParseFromString(proto_buf);
   auto ts = tile::FromProto(ts_proto);
+
+  // If the data is stored as is, the device may be able to map it straight from the file, leaving it to be paged in
+  // as it's used.
+  std::uint64_t data_offset = sizeof(shape_size) + shape_size;
+  if (tensor_file.is_stored() && data_offset + ts.byte_size() <= tensor_file.size()) {
+    auto buffer = evaluator->get_platform()->MapBuffer(ctx->activity.ctx(), evaluator->get_id(), zip_file->path(),
+                                                       tensor_file.offset() + data_offset, ts.byte_size());
+    if (buffer) {
+      return tile::lang::TensorValue::make(std::make_shared<BufferState>(buffer, evaluator), ts, true);
+    }
+  }
+
   std::shared_ptr<BufferState> bs = std::make_shared<BufferState>(
       evaluator->get_platform()->MakeBuffer(ctx->activity.ctx(), evaluator->get_id(), ts.byte_size()), evaluator);
   plaidml_buffer tb{std::move(activity), bs};
@@ -934,10 +1000,10 @@ std::shared_ptr<TensorValue> ReadTensor(vai_ctx* ctx, vertexai::UnZipArchive* zi
 extern "C" bool plaidml_save_function(plaidml_function* function, const char* filename) {
   std::unique_ptr<vai_ctx> ctx{vai_alloc_ctx()};
   try {
-    zipFile out_file = zipOpen64(filename, 0);
-    WriteVersion(out_file);
-    WriteFunction(out_file, *function->func);
-    zipClose(out_file, nullptr);
+    SaveArchive(filename, [&](vertexai::ZipArchive* archive) {
+      WriteVersion(archive->get());
+      WriteFunction(archive, *function->func);
+    });
     return true;
   } catch (...) {
     vertexai::SetLastException(std::current_exception());
@@ -1303,6 +1369,28 @@ struct ApplierParameterShape {
     }
   }
 
+  // Returns true if the value has this shape.  Unlike constructing the value's shape to compare it, this never
+  // allocates; it also distinguishes constant tensors from variable ones.
+  template <class V>
+  bool Matches(const std::shared_ptr<V>& value) const {
+    const Value& base = *value;
+    if (base.type() != type) {
+      return false;
+    }
+    switch (type) {
+      case Value::TENSOR: {
+        const auto& value_shape = static_cast<const TensorValue&>(base).shape();
+        return value_shape == shape && value_shape.is_const == shape.is_const;
+      }
+      case Value::FCONST:
+        return static_cast<const FConstValue&>(base).value() == fconst;
+      case Value::ICONST:
+        return static_cast<const IConstValue&>(base).value() == iconst;
+      default:
+        return false;
+    }
+  }
+
   Value::Type type;
   tile::TensorShape shape;
   std::int64_t iconst = 0;
@@ -1354,10 +1442,43 @@ struct plaidml_invoker {
       runinfo_cache{kRuninfoCacheSize};
 
   std::shared_ptr<RunInfo> runinfo;
+
+  std::uint64_t max_batch = 0;
+  std::set<std::string> batched;  // The inputs and outputs whose outermost dimension is the batch dimension
+
+  // The buffers bound to the run, dropped whenever an input or output is set.
+  struct Bindings {
+    std::shared_ptr<Evaluator> evaluator;
+    std::map<std::string, std::shared_ptr<tile::Buffer>> inputs;
+    std::map<std::string, std::shared_ptr<tile::Buffer>> outputs;
+    std::set<std::string> consumed;  // The inputs whose buffers are also bound as outputs
+  };
+  std::unique_ptr<Bindings> bindings;
+
+  // The program last compiled for the invoker, and what it was compiled for.  Invocations reuse it for as long as the
+  // invoker's parameters keep the same shapes, and are bound in the same way.
+  struct Resolved {
+    std::map<std::string, ApplierParameterShape> input_shapes;
+    std::map<std::string, ApplierParameterShape> output_shapes;
+    std::shared_ptr<RunInfo> runinfo;
+    std::shared_ptr<Evaluator> evaluator;
+    std::set<std::string> consumed;
+    std::shared_ptr<tile::Program> program;
+  };
+  std::unique_ptr<Resolved> resolved;
 };
 
 namespace {
 
+template <class V>
+bool ShapesMatch(const std::map<std::string, std::shared_ptr<V>>& bindings,
+                 const std::map<std::string, ApplierParameterShape>& shapes) {
+  return bindings.size() == shapes.size() &&
+         std::equal(bindings.begin(), bindings.end(), shapes.begin(), [](const auto& binding, const auto& shape) {
+           return binding.first == shape.first && shape.second.Matches(binding.second);
+         });
+}
+
 void BuildInvokerRunInfo(plaidml_invoker* invoker, const std::string& name) {
   if (invoker->runinfo) {
     return;
@@ -1430,6 +1551,7 @@ extern "C" bool plaidml_set_invoker_input(plaidml_invoker* invoker, const char*
     }
     invoker->applier_for_output_shape.reset();
     invoker->runinfo.reset();
+    invoker->bindings.reset();
     return true;
   } catch (...) {
     vertexai::SetLastException(std::current_exception());
@@ -1485,6 +1607,7 @@ extern "C" bool plaidml_set_invoker_output(plaidml_invoker* invoker, const char*
       invoker->outputs.erase(name);
     }
     invoker->runinfo.reset();
+    invoker->bindings.reset();
     return true;
   } catch (...) {
     vertexai::SetLastException(std::current_exception());
@@ -1494,9 +1617,38 @@ extern "C" bool plaidml_set_invoker_output(plaidml_invoker* invoker, const char*
 
 extern "C" bool plaidml_set_invoker_const(plaidml_invoker* invoker) {
   invoker->func->SetBoundConst();
+  invoker->resolved.reset();
   return true;
 }
 
+extern "C" bool plaidml_set_invoker_max_batch(plaidml_invoker* invoker, uint64_t max_batch) {
+  if (!invoker) {
+    vertexai::SetLastOOM();
+    return false;
+  }
+  if (invoker->max_batch != max_batch) {
+    invoker->max_batch = max_batch;
+    invoker->resolved.reset();
+  }
+  return true;
+}
+
+extern "C" bool plaidml_set_invoker_batched(plaidml_invoker* invoker, const char* name) {
+  if (!invoker || !name) {
+    vertexai::SetLastOOM();
+    return false;
+  }
+  try {
+    if (invoker->batched.insert(name).second) {
+      invoker->resolved.reset();
+    }
+    return true;
+  } catch (...) {
+    vertexai::SetLastException(std::current_exception());
+    return false;
+  }
+}
+
 extern "C" bool plaidml_save_invoker(plaidml_invoker* invoker, const char* filename, plaidml_file_format format) {
   if (!invoker || !filename || !format) {
     vertexai::SetLastOOM();
@@ -1511,11 +1663,11 @@ extern "C" bool plaidml_save_invoker(plaidml_invoker* invoker, const char* filen
 
     switch (format) {
       case PLAIDML_FILE_FORMAT_TILE: {
-        zipFile out_file = zipOpen64(filename, 0);
-        WriteVersion(out_file);
-        WriteFunction(out_file, *invoker->func);
-        WriteMetadata(out_file, *invoker->func, invoker->inputs);
-        zipClose(out_file, nullptr);
+        SaveArchive(filename, [&](vertexai::ZipArchive* archive) {
+          WriteVersion(archive->get());
+          WriteFunction(archive, *invoker->func);
+          WriteMetadata(archive->get(), *invoker->func, invoker->inputs);
+        });
         return true;
       }
 
@@ -1533,26 +1685,30 @@ extern "C" bool plaidml_save_invoker(plaidml_invoker* invoker, const char* filen
     BuildInvokerRunInfo(invoker, path.stem().string());
     auto stripe = GenerateStripe(*invoker->runinfo);
 
-    std::ofstream file{path.string()};
-
-    switch (format) {
-      case PLAIDML_FILE_FORMAT_STRIPE_HUMAN:
-        file << *stripe->entry;
-        break;
+    bool binary = format == PLAIDML_FILE_FORMAT_STRIPE_BINARY;
+    bool saved = vertexai::WriteFileAtomically(path, binary, [&](std::ofstream& file) {
+      switch (format) {
+        case PLAIDML_FILE_FORMAT_STRIPE_HUMAN:
+          file << *stripe->entry;
+          break;
 
-      case PLAIDML_FILE_FORMAT_STRIPE_PROTOTXT: {
-        auto pb_program = tile::stripe::IntoProto(*stripe);
-        gpi::OstreamOutputStream out{&file};
-        gp::TextFormat::Print(pb_program, &out);
-      } break;
+        case PLAIDML_FILE_FORMAT_STRIPE_PROTOTXT: {
+          auto pb_program = tile::stripe::IntoProto(*stripe);
+          gpi::OstreamOutputStream out{&file};
+          gp::TextFormat::Print(pb_program, &out);
+        } break;
 
-      case PLAIDML_FILE_FORMAT_STRIPE_BINARY: {
-        auto pb_program = tile::stripe::IntoProto(*stripe);
-        pb_program.SerializeToOstream(&file);
-      } break;
+        case PLAIDML_FILE_FORMAT_STRIPE_BINARY: {
+          auto pb_program = tile::stripe::IntoProto(*stripe);
+          pb_program.SerializeToOstream(&file);
+        } break;
 
-      default:
-        break;
+        default:
+          break;
+      }
+    });
+    if (!saved) {
+      throw std::runtime_error{"Unable to save " + path.string()};
     }
 
     return true;
@@ -1589,83 +1745,135 @@ class PlatformAllocator : public tile::Allocator {
   std::string id_;
 };
 
-};  // namespace
-
-extern "C" plaidml_invocation* plaidml_schedule_invocation(vai_ctx* ctx, plaidml_invoker* invoker) {
-  if (!ctx || !invoker) {
-    vertexai::SetLastOOM();
-    return nullptr;
+// Binds the invoker's parameters to their buffers, unless they're already bound.
+void BindInvokerBuffers(plaidml_invoker* invoker) {
+  if (invoker->bindings) {
+    return;
+  }
+  auto bindings = std::make_unique<plaidml_invoker::Bindings>();
+  bindings->inputs = BindBuffers(invoker->runinfo->input_buffers, invoker->inputs, &bindings->evaluator);
+  bindings->outputs = BindBuffers(invoker->runinfo->output_buffers, invoker->outputs, &bindings->evaluator);
+  if (!bindings->evaluator) {
+    throw vertexai::error::FailedPrecondition{"Function has neither inputs nor outputs"};
   }
-  context::Activity activity{ctx->activity.ctx(), "plaidml::invoker::ScheduleInvocation"};
-  try {
-    auto invocation = std::make_unique<plaidml_invocation>();
-    auto rundown = std::make_shared<context::Rundown>();
-    rundown->TryEnterGate(activity.ctx().gate());
-    BuildInvokerRunInfo(invoker, "invoker_program");
-
-    // Gather up the appropriate buffers
-    std::shared_ptr<Evaluator> evaluator;
-
-    auto in_buffers = BindBuffers(invoker->runinfo->input_buffers, invoker->inputs, &evaluator);
-    auto out_buffers = BindBuffers(invoker->runinfo->output_buffers, invoker->outputs, &evaluator);
-
-    std::unordered_set<const tile::Buffer*> output_set;
-    for (const auto& kv : out_buffers) {
-      output_set.insert(kv.second.get());
-    }
 
-    if (!evaluator) {
-      throw vertexai::error::FailedPrecondition{"Function has neither inputs nor outputs"};
+  std::unordered_set<const tile::Buffer*> output_set;
+  for (const auto& kv : bindings->outputs) {
+    output_set.insert(kv.second.get());
+  }
+  for (const auto& kv : bindings->inputs) {
+    if (output_set.count(kv.second.get())) {
+      bindings->consumed.insert(kv.first);
     }
-
-    tile::proto::Program prog;
-    prog.set_dev_id(evaluator->get_id());
-    prog.set_code(invoker->runinfo->code);
-    for (const auto& kv : invoker->runinfo->input_shapes) {
-      auto& input = (*prog.mutable_inputs())[kv.first];
-      *input.mutable_shape() = tile::IntoProto(kv.second);
-      if (output_set.count(in_buffers[kv.first].get())) {
-        input.set_consumed(true);
+  }
+  invoker->bindings = std::move(bindings);
+}
+
+// Returns the program for the invoker's bound run.  The program resolved by the previous invocation is reused if it
+// was resolved for the same run, device, and aliasing of inputs to outputs; otherwise the program is looked up in the
+// device's program cache, and compiled if necessary; each such resolution is logged as an activity.
+std::shared_ptr<tile::Program> ResolveInvokerProgram(const context::Context& ctx, plaidml_invoker* invoker) {
+  const auto& bindings = *invoker->bindings;
+  const auto* resolved = invoker->resolved.get();
+  if (resolved && resolved->runinfo == invoker->runinfo && resolved->evaluator == bindings.evaluator &&
+      resolved->consumed == bindings.consumed) {
+    return resolved->program;
+  }
+
+  context::Activity activity{ctx, "plaidml::invoker::ResolveProgram"};
+  const auto& evaluator = bindings.evaluator;
+  tile::proto::Program prog;
+  prog.set_dev_id(evaluator->get_id());
+  prog.set_code(invoker->runinfo->code);
+  prog.set_max_batch(invoker->max_batch);
+  if (invoker->max_batch) {
+    for (const auto& name : invoker->batched) {
+      if (!invoker->runinfo->input_shapes.count(name) && !invoker->runinfo->output_shapes.count(name)) {
+        throw vertexai::error::InvalidArgument{"Batched parameter " + name + " is not a function input or output"};
       }
     }
-    for (const auto& kv : invoker->runinfo->output_shapes) {
-      *(*prog.mutable_outputs())[kv.first].mutable_shape() = tile::IntoProto(kv.second);
+  }
+  for (const auto& kv : invoker->runinfo->input_shapes) {
+    auto& input = (*prog.mutable_inputs())[kv.first];
+    *input.mutable_shape() = tile::IntoProto(kv.second);
+    if (bindings.consumed.count(kv.first)) {
+      input.set_consumed(true);
+    }
+    if (invoker->max_batch && invoker->batched.count(kv.first)) {
+      input.set_batched(true);
+    }
+  }
+  for (const auto& kv : invoker->runinfo->output_shapes) {
+    auto& output = (*prog.mutable_outputs())[kv.first];
+    *output.mutable_shape() = tile::IntoProto(kv.second);
+    if (invoker->max_batch && invoker->batched.count(kv.first)) {
+      output.set_batched(true);
     }
+  }
 
-    size_t max_trials = 1;
-    auto env_trials = vertexai::env::Get("PLAIDML_KERNEL_TRIALS");
-    if (env_trials.length()) {
-      auto env_value = std::atoi(env_trials.c_str());
-      if (env_value) {
-        max_trials = env_value;
-      }
+  size_t max_trials = 1;
+  auto env_trials = vertexai::env::Get("PLAIDML_KERNEL_TRIALS");
+  if (env_trials.length()) {
+    auto env_value = std::atoi(env_trials.c_str());
+    if (env_value) {
+      max_trials = env_value;
     }
+  }
 
-    size_t max_trial_runs = 1;
-    auto env_runs = vertexai::env::Get("PLAIDML_KERNEL_TRIAL_RUNS");
-    if (env_runs.length()) {
-      auto env_value = std::atoi(env_runs.c_str());
-      if (env_value) {
-        max_trial_runs = env_value;
-      }
+  size_t max_trial_runs = 1;
+  auto env_runs = vertexai::env::Get("PLAIDML_KERNEL_TRIAL_RUNS");
+  if (env_runs.length()) {
+    auto env_value = std::atoi(env_runs.c_str());
+    if (env_value) {
+      max_trial_runs = env_value;
     }
+  }
 
-    auto* params = prog.mutable_tile_scanning_params();
-    params->set_max_trials(max_trials);
-    params->set_max_trial_runs(max_trial_runs);
+  auto* params = prog.mutable_tile_scanning_params();
+  params->set_max_trials(max_trials);
+  params->set_max_trial_runs(max_trial_runs);
 
-    tile::ConstBufferManager const_bufs;
-    const_bufs.allocator = std::make_shared<PlatformAllocator>(*evaluator);
-    for (const auto& kvp : invoker->runinfo->input_shapes) {
-      if (kvp.second.is_const) {
-        const_bufs.buffers[kvp.first] = in_buffers[kvp.first];
-      }
+  tile::ConstBufferManager const_bufs;
+  const_bufs.allocator = std::make_shared<PlatformAllocator>(*evaluator);
+  for (const auto& kvp : invoker->runinfo->input_shapes) {
+    auto it = bindings.inputs.find(kvp.first);
+    if (kvp.second.is_const && it != bindings.inputs.end()) {
+      const_bufs.buffers[kvp.first] = it->second;
+    }
+  }
+  auto program = evaluator->MakeProgram(activity.ctx(), prog, &const_bufs);
+
+  invoker->resolved = std::make_unique<plaidml_invoker::Resolved>(plaidml_invoker::Resolved{
+      ToApplierParameterShapes(invoker->inputs), ToApplierParameterShapes(invoker->outputs), invoker->runinfo,
+      evaluator, bindings.consumed, program});
+  return program;
+}
+
+};  // namespace
+
+extern "C" plaidml_invocation* plaidml_schedule_invocation(vai_ctx* ctx, plaidml_invoker* invoker) {
+  if (!ctx || !invoker) {
+    vertexai::SetLastOOM();
+    return nullptr;
+  }
+  context::Activity activity{ctx->activity.ctx(), "plaidml::invoker::ScheduleInvocation"};
+  try {
+    auto invocation = std::make_unique<plaidml_invocation>();
+    auto rundown = std::make_shared<context::Rundown>();
+    rundown->TryEnterGate(activity.ctx().gate());
+    // While the invoker's parameters keep their shapes, the run resolved for them by a previous invocation still
+    // applies.
+    if (!invoker->runinfo && invoker->resolved && ShapesMatch(invoker->inputs, invoker->resolved->input_shapes) &&
+        ShapesMatch(invoker->outputs, invoker->resolved->output_shapes)) {
+      invoker->runinfo = invoker->resolved->runinfo;
     }
-    auto program = evaluator->MakeProgram(activity.ctx(), prog, &const_bufs);
+    BuildInvokerRunInfo(invoker, "invoker_program");
+    BindInvokerBuffers(invoker);
+    auto program = ResolveInvokerProgram(activity.ctx(), invoker);
 
     // Run the program
-    auto result = program->Run(activity.ctx(), in_buffers, out_buffers);
-    result.then(boost::launch::async, [rundown = std::move(rundown)](decltype(result) fut) {
+    auto result = program->Run(activity.ctx(), invoker->bindings->inputs, invoker->bindings->outputs);
+    result.then(vertexai::RuntimeExecutor(), [rundown = std::move(rundown)](decltype(result) fut) {
       try {
         fut.get();
       } catch (const std::exception& ex) {
@@ -1738,6 +1946,8 @@ struct plaidml_executable {
   BufferMap input_bufs;
   BufferMap output_bufs;
   std::shared_ptr<tile::Program> program;
+  // Prepared on the first run and replayed thereafter; declared after the program, which it must not outlive.
+  std::unique_ptr<tile::RunPlan> plan;
 };
 
 extern "C" plaidml_executable* plaidml_device_compile(plaidml_device* device,         //
@@ -1780,7 +1990,10 @@ extern "C" plaidml_executable* plaidml_device_compile(plaidml_device* device,
 
 extern "C" void plaidml_executable_run(plaidml_executable* exec) {
   context::Context ctx;
-  exec->program->Run(ctx, exec->input_bufs, exec->output_bufs).get();
+  if (!exec->plan) {
+    exec->plan = exec->program->Prepare(ctx, exec->input_bufs, exec->output_bufs);
+  }
+  exec->plan->Run(ctx).get();
 }
 
 extern "C" void plaidml_executable_free(plaidml_executable* exec) { delete exec; }
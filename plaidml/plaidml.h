@@ -169,6 +169,9 @@ PLAIDML_API plaidml_executable* plaidml_device_compile(plaidml_device* device,
                                                        size_t noutputs,                //
                                                        const plaidml_binding* outputs);
 
+// Runs the executable on the buffers bound when it was compiled.  The first run prepares a plan (the memory map, step
+// launch list, and temporary buffers of the program) which subsequent runs replay, so repeated runs cost little more
+// than launching the program's kernels; the contents of the bound buffers may change freely between runs.
 PLAIDML_API void plaidml_executable_run(plaidml_executable* exec);
 PLAIDML_API void plaidml_executable_free(plaidml_executable* exec);
 
@@ -527,6 +530,22 @@ typedef enum {
 // and other operations that assume they will no longer be changed
 PLAIDML_API bool plaidml_set_invoker_const(plaidml_invoker* invoker);
 
+// Declares that an invoker's function is batch-polymorphic: the outermost
+// dimension of each of the inputs and outputs marked by
+// plaidml_set_invoker_batched is a batch dimension of at most max_batch
+// elements, and each element of the batch is computed independently of the
+// others.  The function must be written in terms of its inputs' dimensions,
+// rather than constants derived from a particular batch size.  Invocations with
+// different batch sizes may then share compiled programs.  A max_batch of zero
+// removes the declaration.
+PLAIDML_API bool plaidml_set_invoker_max_batch(plaidml_invoker* invoker, uint64_t max_batch);
+
+// Marks one of an invoker's inputs or outputs as batched: its outermost
+// dimension is the batch dimension declared by plaidml_set_invoker_max_batch.
+// Inputs and outputs are unbatched unless marked; all the batched ones must
+// have the same batch size.
+PLAIDML_API bool plaidml_set_invoker_batched(plaidml_invoker* invoker, const char* name);
+
 // Serializes an invoker to a file.  All inputs to the invoker must
 // already be set to concrete values that are consistent in size.
 PLAIDML_API bool plaidml_save_invoker(plaidml_invoker* invoker, const char* filename, plaidml_file_format format);
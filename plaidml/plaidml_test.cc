@@ -390,4 +390,42 @@ TEST(PlaidML_C_API, Save) {
   }
 }
 
+TEST(PlaidML_C_API, SaveOverLoadedFile) {
+  vai_clear_status();
+  auto ctx = std::make_shared<vertexai::ctx>();
+  auto devices = plaidml::enumerate_devices(ctx, vertexai::testing::PlaidMLConfig());
+  plaidml::device dev = devices[0].open();
+  plaidml::function matmul("function (B[X,Z], C[Z,Y]) -> (A) { A[x,y : X,Y] = +(B[x,z] * C[z,y]); }");
+
+  plaidml::tensor<float> fixed = dev.allocate(plaidml::shape<float>(ctx, {1000, 1000}));
+  {
+    plaidml::mapping<float> data = fixed.map(plaidml::map_for_write);
+    for (size_t i = 0; i < 1000; i++) {
+      for (size_t j = 0; j < 1000; j++) {
+        data(i, j) = 7;
+      }
+    }
+  }
+  plaidml::placeholder var(2);
+  plaidml::variable out = matmul(fixed, var);
+  plaidml::function fixed_mul = plaidml::compose().input("C", var).output("A", out);
+  fixed_mul.save("test_resave.plaidml");
+
+  // The loaded function's tensor may be mapped straight from the file; saving it back to the same file must neither
+  // disturb the mapping nor read the tensor from a file it has already truncated.
+  plaidml::function loaded;
+  loaded.load(ctx, dev, "test_resave.plaidml");
+  loaded.save("test_resave.plaidml");
+  plaidml::function reloaded;
+  reloaded.load(ctx, dev, "test_resave.plaidml");
+
+  for (auto* func : {&loaded, &reloaded}) {
+    plaidml::tensor<float> output = dev.allocate(plaidml::shape<float>(ctx, {1000, 1000}));
+    plaidml::invoker(ctx, *func).set_input("C", fixed).set_output("A", output).invoke();
+    plaidml::mapping<float> data = output.map(plaidml::map_for_read);
+    EXPECT_FLOAT_EQ(data(0u, 0u), 49000);
+    EXPECT_FLOAT_EQ(data(999u, 999u), 49000);
+  }
+}
+
 }  // namespace
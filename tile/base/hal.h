@@ -146,6 +146,13 @@ class Memory {
 
   // Makes an arena for use with the associated device.
   virtual std::shared_ptr<Arena> MakeArena(std::uint64_t size, BufferAccessMask access) = 0;
+
+  // Makes a buffer for use with the associated device whose initial contents are a range of a file, which the buffer
+  // maps privately: the file's pages are read as they're first accessed, and changes to the buffer are not written
+  // back to the file.  Returns null if the memory cannot map the file range.
+  virtual std::shared_ptr<Buffer> MapFile(const std::string& path, std::uint64_t offset, std::uint64_t size) {
+    return nullptr;
+  }
 };
 
 // A Tile executable program that can be run on a processor.
@@ -194,7 +201,8 @@ class Loader {
  public:
   virtual ~Loader() noexcept {}
 
-  // Loads a program for execution on this device.
+  // Loads a program for execution on this device.  The serialized executable is the concatenation of the serialized
+  // code of each of the program's kernels, as returned by Library::Serialize, in any order.
   virtual boost::future<std::unique_ptr<Library>> Deserialize(const context::Context& ctx,
                                                               const std::string& serialized_executable,
                                                               const std::vector<lang::KernelInfo>& info) = 0;
@@ -27,6 +27,15 @@ class Platform {
   virtual std::shared_ptr<Buffer> MakeBuffer(const context::Context& ctx, const std::string& device_id,
                                              std::uint64_t size) = 0;
 
+  // Makes a buffer on the target device whose initial contents are a range of a file, mapping the file into the
+  // device's memory if the device can address it directly.  Changes to the buffer's contents are never written back to
+  // the file.  Returns null if the file cannot be mapped, in which case the caller should make a buffer and read the
+  // file into it.
+  virtual std::shared_ptr<Buffer> MapBuffer(const context::Context& ctx, const std::string& device_id,
+                                            const std::string& path, std::uint64_t offset, std::uint64_t size) {
+    return nullptr;
+  }
+
   // Builds (pre-compiling if possible) a program for executing the supplied Program
   virtual std::unique_ptr<Program> MakeProgram(const context::Context& ctx, const proto::Program& program,
                                                ConstBufferManager* const_bufs) = 0;
@@ -5,6 +5,9 @@
 #include <gmock/gmock.h>
 #include <half.hpp>
 
+#include <cstring>
+#include <vector>
+
 #include "base/util/error.h"
 #include "base/util/logging.h"
 #include "testing/matchers.h"
@@ -245,6 +248,32 @@ TEST_P(PlatformTest, VectorAddWorks) {
   CheckExpected(shape, c, vector_add::Expected);
 }
 
+TEST_P(PlatformTest, PreparedRunReplays) {
+  auto shape = SimpleShape(param_.dtype, {4, 4});
+  auto program = MakeProgram(nullptr, multiply::Code, shape);
+  auto a = MakeInput(shape, multiply::Input);
+  auto b = MakeInput(shape, multiply::Input);
+  auto c = MakeOutput(shape);
+  auto plan = program->Prepare(ctx_, {{"A", a}, {"B", b}}, {{"C", c}});
+  plan->Run(ctx_).get();
+  CheckExpected(shape, c, multiply::Expected);
+
+  // Replays see the bound buffers' current contents, and keep earlier outputs intact.
+  auto first = c->MapCurrent(ctx_).get();
+  {
+    auto view = a->MapDiscard(ctx_);
+    std::memset(view->data(), 0, view->size());
+    view->WriteBack(ctx_);
+  }
+  plan->Run(ctx_).get();
+  CheckExpected(shape, c, std::vector<int>(multiply::Expected.size(), 0));
+  EXPECT_THAT(CastOutput(shape, first.get()), Eq(multiply::Expected));
+  first.reset();
+
+  plan->Run(ctx_).get();
+  CheckExpected(shape, c, std::vector<int>(multiply::Expected.size(), 0));
+}
+
 TEST_P(PlatformTest, MatMulWorks) {
   auto shape = SimpleShape(param_.dtype, {4, 4});
   auto program = MakeProgram(nullptr, multiply::Code, shape);
@@ -6,13 +6,26 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "base/context/context.h"
+#include "base/util/executor.h"
 #include "tile/base/buffer.h"
 
 namespace vertexai {
 namespace tile {
 
+// RunPlan is a run of a Program with a fixed set of bindings, prepared once so that it can be replayed with as little
+// per-run work as possible.
+class RunPlan {
+ public:
+  virtual ~RunPlan() {}
+
+  // Runs the program on the bindings supplied when the plan was prepared.  The contents of the bound buffers may
+  // change between runs.  Runs of a plan are ordered: each begins once the previous one has completed.
+  virtual boost::future<void> Run(const context::Context& ctx) = 0;
+};
+
 // Program represents a Tile program that's been compiled by a Platform.
 class Program {
  public:
@@ -26,7 +39,44 @@ class Program {
   // once the returned future is resolved.
   virtual boost::future<void> Run(const context::Context& ctx, std::map<std::string, std::shared_ptr<Buffer>> inputs,
                                   std::map<std::string, std::shared_ptr<Buffer>> outputs) = 0;
+
+  // Prepares a plan for running the program repeatedly on the supplied bindings.  The plan refers to the program, and
+  // must not outlive it.  By default, each run of the plan is simply a run of the program.
+  virtual std::unique_ptr<RunPlan> Prepare(const context::Context& ctx,
+                                           std::map<std::string, std::shared_ptr<Buffer>> inputs,
+                                           std::map<std::string, std::shared_ptr<Buffer>> outputs);
 };
 
+namespace detail {
+
+class ReplayRunPlan final : public RunPlan {
+ public:
+  ReplayRunPlan(Program* program, std::map<std::string, std::shared_ptr<Buffer>> inputs,
+                std::map<std::string, std::shared_ptr<Buffer>> outputs)
+      : program_{program}, inputs_{std::move(inputs)}, outputs_{std::move(outputs)} {}
+
+  boost::future<void> Run(const context::Context& ctx) final {
+    if (previous_.valid()) {
+      previous_.wait();
+    }
+    previous_ = program_->Run(ctx, inputs_, outputs_).share();
+    return previous_.then(RuntimeExecutor(), [](boost::shared_future<void> fut) { fut.get(); });
+  }
+
+ private:
+  Program* program_;
+  std::map<std::string, std::shared_ptr<Buffer>> inputs_;
+  std::map<std::string, std::shared_ptr<Buffer>> outputs_;
+  boost::shared_future<void> previous_;
+};
+
+}  // namespace detail
+
+inline std::unique_ptr<RunPlan> Program::Prepare(const context::Context& ctx,
+                                                 std::map<std::string, std::shared_ptr<Buffer>> inputs,
+                                                 std::map<std::string, std::shared_ptr<Buffer>> outputs) {
+  return std::make_unique<detail::ReplayRunPlan>(this, std::move(inputs), std::move(outputs));
+}
+
 }  // namespace tile
 }  // namespace vertexai
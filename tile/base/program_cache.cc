@@ -2,54 +2,139 @@
 
 #include "tile/base/program_cache.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <sstream>
+#include <utility>
 
+#include "base/util/error.h"
 #include "base/util/logging.h"
+#include "base/util/perf_counter.h"
 
 namespace vertexai {
 namespace tile {
 
-ProgramCache::ProgramCache(std::shared_ptr<Platform> platform, std::size_t size_max)
-    : platform_{platform}, cache_{size_max} {}
+namespace {
 
-std::tuple<std::string, std::shared_ptr<Program>> ProgramCache::GetProgram(const context::Context& ctx,
-                                                                           const std::string& fallback_id,
-                                                                           const tile::proto::Program& program,
-                                                                           ConstBufferManager* const_bufs) {
-  auto entry = GetEntry(fallback_id, program);
-  VLOG(3) << "Using compiled program " << entry->id() << " for user program " << program.id();
-  return std::make_tuple(entry->id(), entry->GetProgram(ctx, platform_.get(), const_bufs));
-}
+PerfCounter cache_hits("program_cache_hits");
+PerfCounter cache_misses("program_cache_misses");
+PerfCounter cache_evictions("program_cache_evictions");
+PerfCounter cache_bytes("program_cache_bytes");
 
-std::shared_ptr<lang::Program> ProgramCache::GetParsedProgram(const context::Context& ctx,
-                                                              const std::string& fallback_id,
-                                                              const tile::proto::Program& program) {
-  return GetEntry(fallback_id, program)->GetParsedProgram();
-}
-
-namespace {
+// A rough allowance for the memory a compiled program retains beyond its constant buffers: its kernels, schedule,
+// and device executable.
+const std::size_t compiled_overhead_ = 256 * 1024;
 
 template <typename M>
 void SerializeShapemap(std::ostringstream* serialized, const M& m) {
-  std::map<std::string, const proto::TensorShape&> shapes;
+  std::map<std::string, const typename M::mapped_type&> params;
   for (const auto& t : m) {
-    shapes.emplace(t.first, t.second.shape());
+    params.emplace(t.first, t.second);
   }
-  for (const auto& t : shapes) {
+  for (const auto& t : params) {
+    const auto& shape = t.second.shape();
     (*serialized) << t.first.length() << ':';
     (*serialized) << t.first;
-    (*serialized) << t.second.type() << ':';
-    for (const auto& dim : t.second.dims()) {
+    (*serialized) << shape.type() << (t.second.batched() ? 'b' : ':');
+    for (const auto& dim : shape.dims()) {
       (*serialized) << dim.size() << '/' << dim.stride() << ':';
     }
   }
 }
 
+// Finds the batch size of a batch-polymorphic program, checking that its batched parameters agree on it.
+template <typename M>
+void FindBatch(const M& m, std::uint64_t* batch, bool* found) {
+  for (const auto& t : m) {
+    if (!t.second.batched()) {
+      continue;
+    }
+    if (!t.second.shape().dims_size()) {
+      throw error::InvalidArgument{"Batched program parameter " + t.first + " has no dimensions"};
+    }
+    std::uint64_t size = t.second.shape().dims(0).size();
+    if (*found && size != *batch) {
+      throw error::InvalidArgument{"Batched program parameter " + t.first + " has batch size " +
+                                   std::to_string(size) + "; expected " + std::to_string(*batch)};
+    }
+    *batch = size;
+    *found = true;
+  }
+}
+
+template <typename M>
+void SetBatch(M* m, std::uint64_t batch) {
+  for (auto& t : *m) {
+    if (t.second.batched()) {
+      t.second.mutable_shape()->mutable_dims(0)->set_size(batch);
+    }
+  }
+}
+
+// Returns a batch-polymorphic program with its batch size rounded up to the next power of two, capped at the
+// program's max_batch.  Every batch size in a bucket maps to the same program, and so to the same cache entry; the
+// platform runs the smaller batches as padded copies of the bucket's.
+tile::proto::Program BucketBatch(const tile::proto::Program& program) {
+  std::uint64_t batch = 0;
+  bool found = false;
+  FindBatch(program.inputs(), &batch, &found);
+  FindBatch(program.outputs(), &batch, &found);
+  if (program.max_batch() < batch) {
+    throw error::InvalidArgument{"Program batch size " + std::to_string(batch) + " exceeds its maximum of " +
+                                 std::to_string(program.max_batch())};
+  }
+  std::uint64_t bucket = 1;
+  while (bucket < batch) {
+    bucket <<= 1;
+  }
+  bucket = std::min<std::uint64_t>(bucket, program.max_batch());
+  tile::proto::Program result = program;
+  if (found && bucket != batch) {
+    SetBatch(result.mutable_inputs(), bucket);
+    SetBatch(result.mutable_outputs(), bucket);
+  }
+  return result;
+}
+
 }  // namespace
 
-std::shared_ptr<ProgramCache::Entry> ProgramCache::GetEntry(const std::string& fallback_id,
-                                                            const tile::proto::Program& program) {
+ProgramCache::ProgramCache(std::shared_ptr<Platform> platform, std::size_t byte_budget)
+    : platform_{platform}, shard_budget_{byte_budget / kShardCount}, enabled_{byte_budget > 0} {}
+
+std::tuple<std::string, std::shared_ptr<Program>> ProgramCache::GetProgram(const context::Context& ctx,
+                                                                           const std::string& fallback_id,
+                                                                           const tile::proto::Program& program,
+                                                                           ConstBufferManager* const_bufs) {
+  if (program.max_batch()) {
+    return GetProgramForBucket(ctx, fallback_id, BucketBatch(program), const_bufs);
+  }
+  return GetProgramForBucket(ctx, fallback_id, program, const_bufs);
+}
+
+std::tuple<std::string, std::shared_ptr<Program>> ProgramCache::GetProgramForBucket(
+    const context::Context& ctx, const std::string& fallback_id, const tile::proto::Program& program,
+    ConstBufferManager* const_bufs) {
+  auto key = MakeKey(program);
+  auto entry = GetEntry(key, fallback_id, program);
+  VLOG(3) << "Using compiled program " << entry->id() << " for user program " << program.id();
+  auto compiled = entry->GetProgram(ctx, platform_.get(), const_bufs);
+  Recharge(key, entry);
+  return std::make_tuple(entry->id(), compiled);
+}
+
+std::shared_ptr<lang::Program> ProgramCache::GetParsedProgram(const context::Context& ctx,
+                                                              const std::string& fallback_id,
+                                                              const tile::proto::Program& program) {
+  if (program.max_batch()) {
+    auto bucketed = BucketBatch(program);
+    return GetEntry(MakeKey(bucketed), fallback_id, bucketed)->GetParsedProgram();
+  }
+  return GetEntry(MakeKey(program), fallback_id, program)->GetParsedProgram();
+}
+
+ProgramCache::Key ProgramCache::MakeKey(const tile::proto::Program& program) const {
   std::ostringstream serialized;
 
   // N.B. For cache lookup, we only serialize the parts of the program that
@@ -60,10 +145,15 @@ std::shared_ptr<ProgramCache::Entry> ProgramCache::GetEntry(const std::string& f
   SerializeShapemap(&serialized, program.inputs());
   SerializeShapemap(&serialized, program.outputs());
 
-  // The cache itself must be externally synchronized.
-  std::lock_guard<std::mutex> lock{mu_};
+  Key key{program.dev_id(), serialized.str(), 0};
+  std::hash<std::string> hasher;
+  key.hash = hasher(key.ops) * 31 + hasher(key.subdevice);
+  return key;
+}
 
-  return cache_.Lookup(Key{program.dev_id(), serialized.str()}, [&]() {
+std::shared_ptr<ProgramCache::Entry> ProgramCache::GetEntry(const Key& key, const std::string& fallback_id,
+                                                            const tile::proto::Program& program) {
+  auto make_entry = [&]() {
     std::string cid = "c" + std::to_string(next_id_++);
     if (program.id().size()) {
       cid = cid + '_' + program.id();
@@ -75,13 +165,86 @@ std::shared_ptr<ProgramCache::Entry> ProgramCache::GetEntry(const std::string& f
     cprog.CopyFrom(program);
     cprog.set_id(cid);
     return std::make_shared<ProgramCache::Entry>(cid, cprog);
-  });
+  };
+
+  if (!enabled_) {
+    cache_misses.inc();
+    return make_entry();
+  }
+
+  Shard* shard = ShardFor(key);
+  std::vector<std::shared_ptr<Entry>> evicted;  // Released after the lock
+  std::lock_guard<std::mutex> lock{shard->mu};
+  auto it = shard->index.find(key);
+  if (it != shard->index.end()) {
+    cache_hits.inc();
+    shard->lru.splice(shard->lru.begin(), shard->lru, it->second.lru);
+    return it->second.entry;
+  }
+
+  cache_misses.inc();
+  auto entry = make_entry();
+  std::size_t charged = key.subdevice.size() + key.ops.size() + entry->EstimateBytes();
+  it = shard->index.emplace(key, Slot{entry, charged, shard->lru.end()}).first;
+  shard->lru.push_front(&it->first);
+  it->second.lru = shard->lru.begin();
+  shard->bytes += charged;
+  cache_bytes.add(charged);
+  EvictLocked(shard, &evicted);
+  return entry;
+}
+
+void ProgramCache::Recharge(const Key& key, const std::shared_ptr<Entry>& entry) {
+  if (!enabled_) {
+    return;
+  }
+  Shard* shard = ShardFor(key);
+  std::vector<std::shared_ptr<Entry>> evicted;  // Released after the lock
+  std::lock_guard<std::mutex> lock{shard->mu};
+  auto it = shard->index.find(key);
+  if (it == shard->index.end() || it->second.entry != entry) {
+    // The entry was evicted (and possibly replaced) while it was in use.
+    return;
+  }
+  auto& slot = it->second;
+  std::size_t charged = key.subdevice.size() + key.ops.size() + entry->EstimateBytes();
+  if (charged == slot.charged) {
+    return;
+  }
+  shard->bytes += charged;
+  shard->bytes -= slot.charged;
+  cache_bytes.add(static_cast<int64_t>(charged) - static_cast<int64_t>(slot.charged));
+  slot.charged = charged;
+  EvictLocked(shard, &evicted);
+}
+
+void ProgramCache::EvictLocked(Shard* shard, std::vector<std::shared_ptr<Entry>>* evicted) {
+  // The most recently used entry is always retained, even if it exceeds the
+  // shard's budget by itself.
+  while (shard_budget_ < shard->bytes && shard->lru.size() > 1) {
+    auto victim = shard->index.find(*shard->lru.back());
+    VLOG(3) << "Evicting compiled program " << victim->second.entry->id();
+    shard->bytes -= victim->second.charged;
+    cache_bytes.add(-static_cast<int64_t>(victim->second.charged));
+    cache_evictions.inc();
+    evicted->emplace_back(std::move(victim->second.entry));
+    shard->lru.pop_back();
+    shard->index.erase(victim);
+  }
 }
 
 std::shared_ptr<Program> ProgramCache::Entry::GetProgram(const context::Context& ctx, Platform* dev,
                                                          ConstBufferManager* const_bufs) {
+  // Concurrent callers block here until the first caller's compilation completes, and then share its result.
   std::call_once(compile_once_, [this, ctx, dev, const_bufs]() {
     compiled_ = dev->MakeProgram(ctx, proto_, const_bufs);
+    std::size_t bytes = compiled_overhead_;
+    if (const_bufs) {
+      for (const auto& kvp : const_bufs->buffers) {
+        bytes += kvp.second->size();
+      }
+    }
+    bytes_ = bytes;
     proto_.Clear();
   });
   return compiled_;
@@ -2,14 +2,18 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "base/context/context.h"
-#include "tile/base/lru_cache.h"
 #include "tile/base/platform.h"
 #include "tile/base/program.h"
 #include "tile/lang/parser.h"
@@ -18,10 +22,28 @@
 namespace vertexai {
 namespace tile {
 
-// ProgramCache implements an LRU Tile program cache.
+// ProgramCache implements a Tile program cache.
+//
+// Entries are spread over a fixed number of shards by a hash of their key, each with its own lock and LRU list, so
+// concurrent lookups of different programs rarely contend.  Each entry carries an estimate of the memory it retains
+// (its key, its program until compiled, and the compiled program's constant buffers plus a fixed overhead); shards
+// evict their least recently used entries to stay within an even share of the cache's byte budget.
+//
+// Concurrent requests for the same program share a single entry, and the program is compiled only once; the other
+// requesters wait for that compilation instead of starting their own.
+//
+// Batch-polymorphic programs (those with a max_batch) are cached by batch bucket rather than by batch size: each
+// request is compiled with its batch size rounded up to a power of two (capped at max_batch), so a client sending many
+// different batch sizes builds at most a handful of programs.
+//
+// The cache maintains the performance counters program_cache_hits, program_cache_misses, program_cache_evictions, and
+// program_cache_bytes.  Compilation is asynchronous, so it is timed by the platform compiling the programs (e.g. the
+// local_machine platform's program_compile_ns), not by the cache.
 class ProgramCache final {
  public:
-  ProgramCache(std::shared_ptr<Platform> platform, std::size_t size_max);
+  // Constructs a cache holding up to byte_budget bytes of estimated program memory.  A budget of zero disables
+  // caching.
+  ProgramCache(std::shared_ptr<Platform> platform, std::size_t byte_budget);
 
   // Gets the the requested program, looking it up in the cache and building it if necessary.
   // The fallback ID is used as the program ID if the program has no ID -- since GetProgram
@@ -39,26 +61,26 @@ class ProgramCache final {
                                                   const tile::proto::Program& program);
 
  private:
+  static constexpr std::size_t kShardCount = 16;
+
   struct Key {
     std::string subdevice;
     std::string ops;
-  };
+    std::size_t hash;
 
-  struct KeyComp {
-    bool operator()(const Key& lhs, const Key& rhs) const {
-      if (lhs.subdevice < rhs.subdevice) {
-        return true;
-      }
-      if (rhs.subdevice < lhs.subdevice) {
-        return false;
-      }
-      return lhs.ops < rhs.ops;
+    bool operator==(const Key& other) const {
+      return hash == other.hash && subdevice == other.subdevice && ops == other.ops;
     }
   };
 
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const { return key.hash; }
+  };
+
   class Entry {
    public:
-    Entry(std::string id, tile::proto::Program proto) : id_{std::move(id)}, proto_{std::move(proto)} {}
+    Entry(std::string id, tile::proto::Program proto)
+        : id_{std::move(id)}, proto_{std::move(proto)}, bytes_{proto_.ByteSizeLong()} {}
 
     const std::string& id() const { return id_; }
 
@@ -66,21 +88,48 @@ class ProgramCache final {
 
     std::shared_ptr<lang::Program> GetParsedProgram();
 
+    // Estimates the memory retained by the entry, not counting its key.
+    std::size_t EstimateBytes() const { return bytes_; }
+
    private:
     std::string id_;
     std::once_flag compile_once_, parse_once_;
     tile::proto::Program proto_;
     std::shared_ptr<Program> compiled_;
     std::shared_ptr<lang::Program> parsed_;
+    std::atomic<std::size_t> bytes_{0};
   };
 
-  std::shared_ptr<Entry> GetEntry(const std::string& fallback_id, const tile::proto::Program& program);
+  struct Slot {
+    std::shared_ptr<Entry> entry;
+    std::size_t charged;                  // The bytes charged to the shard for this entry
+    std::list<const Key*>::iterator lru;  // The entry's position in its shard's LRU list
+  };
 
-  std::shared_ptr<Platform> platform_;
+  struct Shard {
+    std::mutex mu;
+    std::unordered_map<Key, Slot, KeyHash> index;
+    std::list<const Key*> lru;  // Keys of the index, most recently used first
+    std::size_t bytes = 0;
+  };
 
-  std::mutex mu_;
-  int next_id_ = 1;
-  LruCache<Key, std::shared_ptr<Entry>, KeyComp> cache_;
+  std::tuple<std::string, std::shared_ptr<Program>> GetProgramForBucket(const context::Context& ctx,
+                                                                        const std::string& fallback_id,
+                                                                        const tile::proto::Program& program,
+                                                                        ConstBufferManager* const_bufs);
+  Key MakeKey(const tile::proto::Program& program) const;
+  std::shared_ptr<Entry> GetEntry(const Key& key, const std::string& fallback_id, const tile::proto::Program& program);
+  void Recharge(const Key& key, const std::shared_ptr<Entry>& entry);
+  // Evicts entries until the shard is within its budget, moving them to evicted so that the caller can release them
+  // after unlocking the shard: releasing the last reference to a program waits for its compilation to finish.
+  void EvictLocked(Shard* shard, std::vector<std::shared_ptr<Entry>>* evicted);
+  Shard* ShardFor(const Key& key) { return &shards_[key.hash % kShardCount]; }
+
+  std::shared_ptr<Platform> platform_;
+  const std::size_t shard_budget_;
+  const bool enabled_;
+  std::atomic<int> next_id_{1};
+  std::array<Shard, kShardCount> shards_;
 };
 
 }  // namespace tile
@@ -0,0 +1,205 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/base/program_cache.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/util/perf_counter.h"
+
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Gt;
+using ::testing::Le;
+
+namespace vertexai {
+namespace tile {
+namespace {
+
+class FakeProgram final : public Program {
+ public:
+  explicit FakeProgram(std::function<void()> on_destroy) : on_destroy_{std::move(on_destroy)} {}
+
+  ~FakeProgram() { on_destroy_(); }
+
+  boost::future<void> Run(const context::Context& ctx, std::map<std::string, std::shared_ptr<Buffer>> inputs,
+                          std::map<std::string, std::shared_ptr<Buffer>> outputs) final {
+    return boost::make_ready_future();
+  }
+
+ private:
+  std::function<void()> on_destroy_;
+};
+
+// A platform which counts the programs it's asked to make.
+class FakePlatform final : public Platform {
+ public:
+  std::shared_ptr<Buffer> MakeBuffer(const context::Context& ctx, const std::string& device_id,
+                                     std::uint64_t size) final {
+    return nullptr;
+  }
+
+  std::unique_ptr<Program> MakeProgram(const context::Context& ctx, const proto::Program& program,
+                                       ConstBufferManager* const_bufs) final {
+    made_++;
+    return std::make_unique<FakeProgram>([this, program]() {
+      if (on_destroy_) {
+        on_destroy_(program);
+      }
+    });
+  }
+
+  std::shared_ptr<Program> MakeProgram(const context::Context& ctx, const std::string& device_id,
+                                       const lang::RunInfo& runinfo, ConstBufferManager* const_bufs) final {
+    return nullptr;
+  }
+
+  void ListDevices(const context::Context& ctx, const proto::ListDevicesRequest& request,
+                   proto::ListDevicesResponse* response) final {}
+
+  void RegisterCostModel(const lang::TileCostFunction& cost_fn) final {}
+
+  std::size_t made() const { return made_; }
+
+  // Sets a function to be called with a program's proto when the program is destroyed.
+  void set_on_destroy(std::function<void(const proto::Program&)> on_destroy) { on_destroy_ = std::move(on_destroy); }
+
+ private:
+  std::size_t made_ = 0;
+  std::function<void(const proto::Program&)> on_destroy_;
+};
+
+proto::Program MakeProgram(std::size_t n) {
+  proto::Program program;
+  program.set_code("function (I[N]) -> (O) { O = I + " + std::to_string(n) + "; }");
+  return program;
+}
+
+class ProgramCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override { platform_ = std::make_shared<FakePlatform>(); }
+
+  std::shared_ptr<Program> Get(ProgramCache* cache, std::size_t n) {
+    return std::get<1>(cache->GetProgram(ctx_, "", MakeProgram(n)));
+  }
+
+  context::Context ctx_;
+  std::shared_ptr<FakePlatform> platform_;
+};
+
+TEST_F(ProgramCacheTest, Hits) {
+  ProgramCache cache{platform_, 1 << 30};
+  auto hits = GetPerfCounter("program_cache_hits");
+  auto first = Get(&cache, 1);
+  auto second = Get(&cache, 1);
+  EXPECT_THAT(second, Eq(first));
+  EXPECT_THAT(platform_->made(), Eq(1));
+  EXPECT_THAT(GetPerfCounter("program_cache_hits") - hits, Eq(1));
+  EXPECT_THAT(Get(&cache, 2), ::testing::Ne(first));
+  EXPECT_THAT(platform_->made(), Eq(2));
+}
+
+TEST_F(ProgramCacheTest, Disabled) {
+  ProgramCache cache{platform_, 0};
+  Get(&cache, 1);
+  Get(&cache, 1);
+  EXPECT_THAT(platform_->made(), Eq(2));
+}
+
+TEST_F(ProgramCacheTest, RetainsWithinBudget) {
+  constexpr std::size_t kPrograms = 40;
+  ProgramCache cache{platform_, 1 << 30};
+  auto evictions = GetPerfCounter("program_cache_evictions");
+  for (std::size_t n = 0; n < kPrograms; ++n) {
+    Get(&cache, n);
+  }
+  for (std::size_t n = 0; n < kPrograms; ++n) {
+    Get(&cache, n);
+  }
+  EXPECT_THAT(platform_->made(), Eq(kPrograms));
+  EXPECT_THAT(GetPerfCounter("program_cache_evictions"), Eq(evictions));
+}
+
+TEST_F(ProgramCacheTest, EvictsOverBudget) {
+  // With a budget this small, each shard keeps only its most recently used entry.
+  constexpr std::size_t kPrograms = 40;
+  ProgramCache cache{platform_, 16};
+  auto evictions = GetPerfCounter("program_cache_evictions");
+  auto bytes = GetPerfCounter("program_cache_bytes");
+  for (std::size_t n = 0; n < kPrograms; ++n) {
+    Get(&cache, n);
+    // The most recently used entry is never evicted.
+    auto made = platform_->made();
+    Get(&cache, n);
+    EXPECT_THAT(platform_->made(), Eq(made));
+  }
+  auto evicted = static_cast<std::size_t>(GetPerfCounter("program_cache_evictions") - evictions);
+  EXPECT_THAT(evicted, Ge(kPrograms - 16));
+  EXPECT_THAT(evicted, Le(kPrograms - 1));
+
+  // The bytes charged are those of the retained entries, each a compiled program plus its key.
+  auto retained = kPrograms - evicted;
+  auto charged = static_cast<std::size_t>(GetPerfCounter("program_cache_bytes") - bytes);
+  EXPECT_THAT(charged, Ge(retained * 256 * 1024));
+  EXPECT_THAT(charged, Le(retained * (256 * 1024 + 1024)));
+
+  // Evicted programs are rebuilt on their next use.
+  for (std::size_t n = 0; n < kPrograms; ++n) {
+    Get(&cache, n);
+  }
+  EXPECT_THAT(platform_->made(), Gt(kPrograms));
+}
+
+TEST_F(ProgramCacheTest, ReleasesEvictedProgramsUnlocked) {
+  // Destroying a program may take as long as its compilation, so evicted programs are released only after their
+  // shard is unlocked: here, the first evicted program looks itself up again as it's destroyed, which would deadlock
+  // on its shard's lock if it were still held.
+  bool reentered = false;
+  ProgramCache cache{platform_, 16};
+  platform_->set_on_destroy([&](const proto::Program& program) {
+    if (!reentered) {
+      reentered = true;
+      std::get<1>(cache.GetProgram(ctx_, "", program));
+    }
+  });
+  for (std::size_t n = 0; n < 40 && !reentered; ++n) {
+    Get(&cache, n);
+  }
+  EXPECT_TRUE(reentered);
+  platform_->set_on_destroy(nullptr);
+}
+
+TEST_F(ProgramCacheTest, SharesBatchBuckets) {
+  ProgramCache cache{platform_, 1 << 30};
+  auto batched = [](std::uint64_t batch) {
+    proto::Program program;
+    program.set_code("function (I[N]) -> (O) { O = I; }");
+    program.set_max_batch(8);
+    auto* input = &(*program.mutable_inputs())["I"];
+    input->set_batched(true);
+    input->mutable_shape()->set_type(proto::TensorShape::FLOAT32);
+    auto* dim = input->mutable_shape()->add_dims();
+    dim->set_size(batch);
+    dim->set_stride(1);
+    return program;
+  };
+  context::Context ctx;
+  auto three = std::get<1>(cache.GetProgram(ctx, "", batched(3)));
+  auto four = std::get<1>(cache.GetProgram(ctx, "", batched(4)));
+  auto five = std::get<1>(cache.GetProgram(ctx, "", batched(5)));
+  EXPECT_THAT(four, Eq(three));
+  EXPECT_THAT(five, ::testing::Ne(three));
+  EXPECT_THAT(platform_->made(), Eq(2));
+}
+
+}  // namespace
+}  // namespace tile
+}  // namespace vertexai
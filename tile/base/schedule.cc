@@ -19,6 +19,9 @@ void Alloc::Log(el::base::type::ostream_t& os) const {
     os << "Tmp: ";
   }
   os << byte_size << " bytes";
+  if (device) {
+    os << " on d" << device;
+  }
   if (safe_self_alias_allocs.size()) {
     os << " May-alias:";
     for (const auto& ap : safe_self_alias_allocs) {
@@ -33,7 +36,11 @@ void Step::Log(el::base::type::ostream_t& os) const {
       os << "Run: k" << kidx;
       break;
     case Tag::kCopy:
-      os << "Copy(" << byte_count << ')';
+      os << "Copy(" << byte_count;
+      if (from_offset || to_offset) {
+        os << " from +" << from_offset << " to +" << to_offset;
+      }
+      os << ')';
       break;
     default:
       os << "<InvalidStep>";
@@ -57,6 +64,9 @@ void Step::Log(el::base::type::ostream_t& os) const {
     os << 'a' << output.allocp->idx;
   }
   os << ')';
+  if (device) {
+    os << " on d" << device;
+  }
   if (deps.size()) {
     os << " deps=[";
     bool first = true;
@@ -101,6 +111,7 @@ void ScheduleToProto(proto::Schedule* pb, const Schedule& schedule) {
     apb->set_size(alloc.byte_size);
     apb->set_input(alloc.input);
     apb->set_output(alloc.output);
+    apb->set_device(alloc.device);
   }
 
   std::size_t sidx = 0;
@@ -109,6 +120,7 @@ void ScheduleToProto(proto::Schedule* pb, const Schedule& schedule) {
     for (auto dep : step.deps) {
       spb->add_deps(dep->idx);
     }
+    spb->set_device(step.device);
     switch (step.tag) {
       case Step::Tag::kRun: {
         auto* run_pb = spb->mutable_run();
@@ -134,7 +146,9 @@ void ScheduleToProto(proto::Schedule* pb, const Schedule& schedule) {
               " has an incorrect input count; expected: 1, got: " + std::to_string(step.inputs.size())};
         }
         copy_pb->set_from_aidx(step.inputs[0]->idx);
+        copy_pb->set_from_offset(step.from_offset);
         copy_pb->set_to_aidx(step.outputs[0].allocp->idx);
+        copy_pb->set_to_offset(step.to_offset);
         copy_pb->set_count_bytes(step.byte_count);
         break;
       }
@@ -27,8 +27,9 @@ struct Alloc {
   std::size_t idx = 0;
   std::uint64_t byte_size = 0;
   std::set<Alloc*> safe_self_alias_allocs;
-  std::string input;   // If non-empty, this is a program input.
-  std::string output;  // If non-empty, this is a program output.
+  std::string input;       // If non-empty, this is a program input.
+  std::string output;      // If non-empty, this is a program output.
+  std::size_t device = 0;  // The index of the device holding a temporary, in schedules spanning several devices.
 };
 
 inline MAKE_LOGGABLE(Alloc, alloc, os) {
@@ -55,8 +56,11 @@ struct Step {
   std::vector<OutputInfo> outputs;
   std::vector<Alloc*> inputs;
 
-  std::size_t kidx = 0;          // Used for run steps
-  std::uint64_t byte_count = 0;  // Used for copy steps
+  std::size_t device = 0;         // The index of the device taking the step, in schedules spanning several devices
+  std::size_t kidx = 0;           // Used for run steps
+  std::uint64_t byte_count = 0;   // Used for copy steps
+  std::uint64_t from_offset = 0;  // Used for copy steps
+  std::uint64_t to_offset = 0;    // Used for copy steps
 };
 
 inline MAKE_LOGGABLE(Step, step, os) {
@@ -0,0 +1,100 @@
+// Copyright 2019 Intel Corporation.
+
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/text_format.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "base/util/logging.h"
+#include "base/util/runfiles_db.h"
+#include "tile/codegen/driver.h"
+#include "tile/lang/gen_stripe.h"
+#include "tile/lang/parser.h"
+#include "tile/proto/support.h"
+#include "tile/targets/targets.h"
+
+namespace gp = ::google::protobuf;
+
+namespace vertexai {
+namespace tile {
+namespace codegen {
+namespace {
+
+// Measures the time taken to lower the resnet50 test network to Stripe and to
+// run the CPU target's default pass pipeline over it.  The benchmark only uses
+// the public codegen interfaces, so it builds unchanged against earlier trees;
+// to compare two trees, run it on each:
+//
+//   bazel test --test_output=streamed //tile/codegen/bench:pipeline_bench
+
+const int runs_ = 3;
+
+tile::proto::Program MakeProgram(const std::string& filename) {
+  tile::proto::Program result;
+  std::ifstream in{filename};
+  if (!in) {
+    LOG(FATAL) << "Unable to read program proto from " << filename;
+  }
+  gp::io::IstreamInputStream zcis{&in};
+  if (!gp::TextFormat::Parse(&zcis, &result)) {
+    LOG(FATAL) << "Failed to parse program proto from " << filename;
+  }
+  return result;
+}
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(PipelineBench, Resnet50) {
+  RunfilesDB rdb{"com_intel_plaidml/plaidml/testdata"};
+  auto program = MakeProgram(rdb["resnet50.tpb"]);
+  const auto& stage = targets::GetConfigs().configs().at("cpu").stages().at("default");
+
+  double best_lower = 0;
+  double best_optimize = 0;
+  std::string first_code;
+  for (int run = 0; run < runs_; ++run) {
+    lang::Parser parser;
+    lang::RunInfo runinfo;
+    runinfo.program = parser.Parse(program.code());
+    runinfo.input_shapes = FromProto(program.inputs());
+    runinfo.output_shapes = FromProto(program.outputs());
+    runinfo.program_name = "resnet50";
+
+    auto start = std::chrono::steady_clock::now();
+    auto stripe = lang::GenerateStripe(runinfo);
+    double lower = Seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    CompilerState state(stripe);
+    Optimize(&state, stage.passes(), OptimizeOptions{});
+    double optimize = Seconds(start);
+
+    best_lower = run ? std::min(best_lower, lower) : lower;
+    best_optimize = run ? std::min(best_optimize, optimize) : optimize;
+
+    // The pipeline is deterministic; a run which differs from the first
+    // indicates state leaking between compilations.
+    std::ostringstream code;
+    code << *stripe->entry;
+    if (run) {
+      EXPECT_EQ(first_code, code.str());
+    } else {
+      first_code = code.str();
+    }
+  }
+
+  LOG(INFO) << "resnet50: GenerateStripe=" << best_lower << "s Optimize(cpu/default)=" << best_optimize
+            << "s (best of " << runs_ << ")";
+}
+
+}  // namespace
+}  // namespace codegen
+}  // namespace tile
+}  // namespace vertexai
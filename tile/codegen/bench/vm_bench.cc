@@ -0,0 +1,98 @@
+// Copyright 2019 Intel Corporation.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/util/logging.h"
+#include "tile/codegen/test/vm_reference.h"
+#include "tile/codegen/vm.h"
+#include "tile/lang/gen_stripe.h"
+#include "tile/lib/lib.h"
+
+namespace vertexai {
+namespace tile {
+namespace codegen {
+namespace {
+
+// Measures the time taken to run small programs on VmProgram and on the interpreter it replaced, and checks that
+// they compute the same results:
+//
+//   bazel test --test_output=streamed //tile/codegen/bench:vm_bench
+
+using plaidml::edsl::TensorShape;
+
+const int runs_ = 3;
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Compare(const lang::RunInfo& runinfo) {
+  auto program = lang::GenerateStripe(runinfo);
+  std::map<std::string, std::vector<float>> inputs;
+  int seed = 0;
+  for (const auto& ref : program->entry->refs) {
+    if (!ref.has_tag("user")) {
+      continue;
+    }
+    auto& buffer = inputs[ref.into()];
+    buffer.resize(ref.interior_shape.elem_size());
+    if (ref.dir == stripe::RefDir::In) {
+      for (auto& value : buffer) {
+        value = (seed++ * 7) % 9 - 4;
+      }
+    }
+  }
+
+  double best_reference = 0;
+  double best_vm = 0;
+  double best_vm_prepared = 0;
+  for (int run = 0; run < runs_; ++run) {
+    auto expected = inputs;
+    auto start = std::chrono::steady_clock::now();
+    test::ReferenceExecuteProgram(*program->entry, &expected);
+    double reference = Seconds(start);
+
+    // Once with the time taken to compile the program, and once without.
+    auto actual = inputs;
+    start = std::chrono::steady_clock::now();
+    VmProgram vm{*program->entry};
+    vm.Run(&actual);
+    double with_compile = Seconds(start);
+    actual = inputs;
+    start = std::chrono::steady_clock::now();
+    vm.Run(&actual);
+    double prepared = Seconds(start);
+
+    EXPECT_EQ(expected, actual);
+    best_reference = run ? std::min(best_reference, reference) : reference;
+    best_vm = run ? std::min(best_vm, with_compile) : with_compile;
+    best_vm_prepared = run ? std::min(best_vm_prepared, prepared) : prepared;
+  }
+
+  LOG(INFO) << runinfo.program_name << ": reference=" << best_reference << "s VmProgram=" << best_vm
+            << "s (excluding compilation: " << best_vm_prepared << "s) (best of " << runs_ << ")";
+}
+
+TEST(VmBench, MatMul) {
+  Compare(lib::LoadMatMul("matmul",                                     //
+                          TensorShape(PLAIDML_DATA_FLOAT32, {64, 64}),  //
+                          TensorShape(PLAIDML_DATA_FLOAT32, {64, 64})));
+}
+
+TEST(VmBench, Conv2d) {
+  Compare(lib::LoadConv2d("conv2d",                                            //
+                          TensorShape(PLAIDML_DATA_FLOAT32, {1, 34, 34, 16}),  //
+                          TensorShape(PLAIDML_DATA_FLOAT32, {3, 3, 16, 16}),   //
+                          {1, 32, 32, 16}));
+}
+
+}  // namespace
+}  // namespace codegen
+}  // namespace tile
+}  // namespace vertexai
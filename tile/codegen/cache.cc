@@ -108,9 +108,10 @@ void FixPassthruIdx(const AliasMap& inner_map, Block* outer, Affine exp) {
   // Resolve the initialze idxs
   for (const auto& it : exp.getMap()) {
     if (it.first != "") {
-      size_t pos = it.first.find(':');
-      std::string idx_name = it.first.substr(pos + 1);
-      size_t idx_depth = std::stoi(it.first.substr(1, pos - 1));
+      const std::string& name = it.first;
+      size_t pos = name.find(':');
+      std::string idx_name = name.substr(pos + 1);
+      size_t idx_depth = std::stoi(name.substr(1, pos - 1));
       to_build.emplace(idx_name, idx_depth); 
     }
   }
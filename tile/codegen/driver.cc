@@ -2,14 +2,18 @@
 
 #include "tile/codegen/driver.h"
 
+#include <memory>
+
 #include <boost/format.hpp>
 
 #include "base/config/config.h"
 #include "base/util/any_factory_map.h"
+#include "base/util/env.h"
 #include "base/util/throw.h"
 #include "tile/codegen/alias.h"
 #include "tile/codegen/compile_pass.h"
 #include "tile/codegen/emitc.h"
+#include "tile/codegen/vm.h"
 
 namespace vertexai {
 namespace tile {
@@ -98,6 +102,10 @@ class ConfigsRegistry {
 void Optimize(CompilerState* state, const Passes& passes, const OptimizeOptions& options) {
   size_t counter = 0;
   DumpProgram(*state->entry(), options, "initial", counter++);
+  std::unique_ptr<ProgramChecker> checker;
+  if (options.verify_passes) {
+    checker = std::make_unique<ProgramChecker>(*state->entry());
+  }
   for (const auto& pass : passes) {
     IVLOG(1, "Optimization Pass " << pass.name());
     std::unique_ptr<CompilePass> compile_pass =
@@ -109,6 +117,9 @@ void Optimize(CompilerState* state, const Passes& passes, const OptimizeOptions&
     compile_pass->Apply(state);
     DumpProgram(*state->entry(), options, pass.name(), counter++);
     ValidateBlock(state->entry());
+    if (checker) {
+      checker->Check(*state->entry(), "Optimization pass '" + pass.name() + "'");
+    }
   }
   // Remove constants that are no longer used
   if (state->const_bufs == nullptr) {
@@ -125,6 +136,8 @@ void Optimize(CompilerState* state, const Passes& passes, const OptimizeOptions&
   IVLOG(3, "All optimization passes complete");
 }
 
+bool VerifyPassesRequested() { return !env::Get("PLAIDML_VERIFY_PASSES").empty(); }
+
 void Configs::Register(const std::string& name, const std::string& pb_bytes) {
   ConfigsRegistry::Instance()->Register(name, pb_bytes);
 }
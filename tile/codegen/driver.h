@@ -19,12 +19,16 @@ struct OptimizeOptions {
   bool dump_passes_proto = false;
   bool dump_code = false;
   boost::filesystem::path dbg_dir;
+  bool verify_passes = false;  // Runs the program before and after each pass, and checks the results agree
 };
 
 using Passes = google::protobuf::RepeatedPtrField<proto::Pass>;
 
 void Optimize(CompilerState* state, const Passes& passes, const OptimizeOptions& options);
 
+// Whether PLAIDML_VERIFY_PASSES is set, asking whoever builds the OptimizeOptions to turn on verify_passes.
+bool VerifyPassesRequested();
+
 struct Configs {
   static void Register(const std::string& name, const std::string& pb_bytes);
   static proto::Config Resolve(const std::string& name);
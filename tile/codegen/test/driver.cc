@@ -0,0 +1,75 @@
+// Copyright 2019, Intel Corp.
+
+#include <gtest/gtest.h>
+
+#include "base/proto/proto.h"
+#include "tile/codegen/codegen.pb.h"
+#include "tile/codegen/driver.h"
+#include "tile/lang/gen_stripe.h"
+#include "tile/lib/lib.h"
+#include "tile/stripe/stripe.h"
+
+namespace vertexai {
+namespace tile {
+namespace codegen {
+namespace test {
+
+using plaidml::edsl::TensorShape;
+
+TEST(Driver, VerifyPasses) {
+  auto runinfo = lib::LoadMatMul("matmul",                                     //
+                                 TensorShape(PLAIDML_DATA_FLOAT32, {16, 16}),  //
+                                 TensorShape(PLAIDML_DATA_FLOAT32, {16, 16}));
+  auto program = GenerateStripe(runinfo);
+  auto stage = ParseProtoText<proto::Stage>(R"(
+    passes: [
+      {
+        name: "loc_prog"
+        pass: {
+          [type.vertex.ai/vertexai.tile.codegen.proto.LocateMemoryPass] {
+            reqs: ["program"]
+            loc: { devs: [{name: "DRAM"}] }
+          }
+        }
+      }, {
+        name: "autotile"
+        pass: {
+          [type.vertex.ai/vertexai.tile.codegen.proto.AutotilePass] {
+            reqs: ["kernel"]
+            outer_set: ["fit_part"]
+            skip_1d: true
+            only_po2: true
+            max_total_size: 64
+            input_cost: 1.0
+            output_cost: 1.0
+            copy_tags: true
+          }
+        }
+      }, {
+        name: "compute_deps"
+        pass: {
+          [type.vertex.ai/vertexai.tile.codegen.proto.ComputeDepsPass] {
+            reqs: ["all"]
+          }
+        }
+      }, {
+        name: "dead_code_elimination"
+        pass: {
+          [type.vertex.ai/vertexai.tile.codegen.proto.DeadCodeEliminationPass] {
+            reqs: ["all"]
+          }
+        }
+      }
+    ]
+  )");
+  OptimizeOptions options;
+  options.verify_passes = true;
+  CompilerState state(program);
+  // Each pass preserves the results of the program, so the checks pass.
+  EXPECT_NO_THROW(Optimize(&state, stage.passes(), options));
+}
+
+}  // namespace test
+}  // namespace codegen
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,446 @@
+// Copyright 2019, Intel Corp.
+
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tile/codegen/test/vm_reference.h"
+#include "tile/codegen/tile.h"
+#include "tile/codegen/vm.h"
+#include "tile/lang/gen_stripe.h"
+#include "tile/lib/lib.h"
+#include "tile/stripe/stripe.h"
+
+using ::testing::ContainerEq;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+namespace vertexai {
+namespace tile {
+namespace codegen {
+namespace test {
+
+using plaidml::edsl::TensorShape;
+
+// Builds a program which applies an intrinsic of a type elementwise: each element of the output O is computed from the
+// corresponding elements of the inputs I0, I1 and so on.  The inputs are of the intrinsic's type.
+std::shared_ptr<stripe::Block> IntrinsicProgram(const std::string& name, DataType type, size_t arity,
+                                                DataType out_type, size_t count) {
+  auto program = std::make_shared<stripe::Block>();
+  program->name = "program";
+  auto kernel = std::make_shared<stripe::Block>();
+  kernel->name = "kernel";
+  kernel->idxs.emplace_back("i", count);
+  auto add_ref = [&](stripe::RefDir dir, const std::string& ref_name, DataType ref_type) {
+    stripe::Refinement ref{dir, "", ref_name, {stripe::Affine{}}, tile::TensorShape(ref_type, {{1, count}})};
+    ref.set_tag("user");
+    program->refs.emplace(ref);
+    kernel->refs.emplace(
+        stripe::Refinement{dir, ref_name, ref_name, {stripe::Affine{"i"}}, tile::TensorShape(ref_type, {{1, 1}})});
+  };
+  auto op = std::make_shared<stripe::Intrinsic>();
+  op->name = name;
+  op->type = type;
+  for (size_t i = 0; i < arity; ++i) {
+    auto ref_name = "I" + std::to_string(i);
+    add_ref(stripe::RefDir::In, ref_name, type);
+    kernel->stmts.push_back(std::make_shared<stripe::Load>(ref_name, "$" + ref_name));
+    op->inputs.push_back("$" + ref_name);
+  }
+  add_ref(stripe::RefDir::Out, "O", out_type);
+  op->outputs.push_back("$O");
+  kernel->stmts.push_back(op);
+  kernel->stmts.push_back(std::make_shared<stripe::Store>("$O", "O"));
+  program->stmts.push_back(kernel);
+  return program;
+}
+
+template <typename T>
+std::vector<char> ToBytes(const std::vector<T>& values) {
+  std::vector<char> bytes(values.size() * sizeof(T));
+  std::memcpy(bytes.data(), values.data(), bytes.size());
+  return bytes;
+}
+
+template <typename T>
+std::vector<T> FromBytes(const std::vector<char>& bytes) {
+  std::vector<T> values(bytes.size() / sizeof(T));
+  std::memcpy(values.data(), bytes.data(), values.size() * sizeof(T));
+  return values;
+}
+
+// Applies an intrinsic of a type to each row of operands, held in buffers of the C++ type corresponding to the type,
+// and returns the results, stored as the indicated type (booleans are read back as uint8_t).
+template <typename T, typename R = T>
+std::vector<R> RunTyped(const std::string& name, DataType type, const std::vector<std::vector<T>>& operands,
+                        DataType out_type) {
+  size_t count = operands[0].size();
+  std::map<std::string, std::vector<char>> buffers;
+  for (size_t i = 0; i < operands.size(); ++i) {
+    buffers["I" + std::to_string(i)] = ToBytes(operands[i]);
+  }
+  buffers["O"] = std::vector<char>(count * sizeof(R));
+  VmProgram(*IntrinsicProgram(name, type, operands.size(), out_type, count)).Run(&buffers);
+  return FromBytes<R>(buffers["O"]);
+}
+
+template <typename T>
+std::vector<T> RunTyped(const std::string& name, DataType type, const std::vector<std::vector<T>>& operands) {
+  return RunTyped<T, T>(name, type, operands, type);
+}
+
+// Applies an intrinsic of a type to each row of operands, passed and returned as floats; the output is stored as the
+// intrinsic's type.
+std::vector<float> RunFloats(const std::string& name, DataType type, const std::vector<std::vector<float>>& operands,
+                             DataType out_type) {
+  size_t count = operands[0].size();
+  std::map<std::string, Buffer> buffers;
+  for (size_t i = 0; i < operands.size(); ++i) {
+    buffers["I" + std::to_string(i)] = operands[i];
+  }
+  buffers["O"] = Buffer(count);
+  VmProgram(*IntrinsicProgram(name, type, operands.size(), out_type, count)).Run(&buffers);
+  return buffers["O"];
+}
+
+TEST(Vm, TypedMatMul) {
+  auto runinfo = lib::LoadMatMul("matmul",                                 //
+                                 TensorShape(PLAIDML_DATA_INT8, {3, 3}),  //
+                                 TensorShape(PLAIDML_DATA_INT8, {3, 3}));
+  auto program = GenerateStripe(runinfo);
+  std::map<std::string, std::vector<float>> data = {
+      {"A", {1, 2, 3, 4, 5, 6, 7, 8, 9}},
+      {"B", {20, 0, 0, 0, 20, 0, 0, 0, 20}},
+      {"C", std::vector<float>(9)},
+  };
+  VmProgram(*program->entry).Run(&data);
+  // Products are computed in the 8-bit type of the inputs, and wrap.
+  std::vector<float> expected = {20, 40, 60, 80, 100, 120, 140 - 256, 160 - 256, 180 - 256};
+  EXPECT_THAT(data["C"], ContainerEq(expected));
+}
+
+TEST(Vm, CheckRewrites) {
+  auto runinfo = lib::LoadMatMul("matmul",                                     //
+                                 TensorShape(PLAIDML_DATA_FLOAT32, {10, 10}),  //
+                                 TensorShape(PLAIDML_DATA_FLOAT32, {10, 10}));
+  auto program = GenerateStripe(runinfo);
+  ProgramChecker checker(*program->entry);
+
+  auto kernel = program->entry->SubBlock(0)->SubBlock(0);
+  ApplyTile(kernel.get(), {4, 3, 2});
+  EXPECT_NO_THROW(checker.Check(*program->entry, "ApplyTile"));
+
+  for (auto& idx : kernel->idxs) {
+    if (idx.affine == stripe::Affine{}) {
+      idx.range--;
+      break;
+    }
+  }
+  try {
+    checker.Check(*program->entry, "Shrinking an index");
+    FAIL() << "ProgramChecker accepted a broken rewrite";
+  } catch (const std::exception& ex) {
+    EXPECT_THAT(ex.what(), HasSubstr("Shrinking an index changed the results of the program"));
+  }
+}
+
+TEST(Vm, SignedIntegersWrap) {
+  EXPECT_THAT(RunTyped<int8_t>("add", DataType::INT8, {{127, -128}, {1, -1}}), ElementsAre(-128, 127));
+  EXPECT_THAT(RunTyped<int8_t>("mul", DataType::INT8, {{16, -128}, {16, -1}}), ElementsAre(0, -128));
+  EXPECT_THAT(RunTyped<int8_t>("neg", DataType::INT8, {{-128, 5}}), ElementsAre(-128, -5));
+
+  EXPECT_THAT(RunTyped<int16_t>("add", DataType::INT16, {{32767}, {1}}), ElementsAre(-32768));
+  EXPECT_THAT(RunTyped<int16_t>("mul", DataType::INT16, {{256, 200}, {256, 200}}), ElementsAre(0, 40000 - 65536));
+
+  const int32_t i32_max = std::numeric_limits<int32_t>::max();
+  const int32_t i32_min = std::numeric_limits<int32_t>::min();
+  EXPECT_THAT(RunTyped<int32_t>("add", DataType::INT32, {{i32_max}, {1}}), ElementsAre(i32_min));
+  EXPECT_THAT(RunTyped<int32_t>("sub", DataType::INT32, {{i32_min}, {1}}), ElementsAre(i32_max));
+  EXPECT_THAT(RunTyped<int32_t>("mul", DataType::INT32, {{65536}, {65536}}), ElementsAre(0));
+  EXPECT_THAT(RunTyped<int32_t>("div", DataType::INT32, {{i32_min}, {-1}}), ElementsAre(i32_min));
+  EXPECT_THAT(RunTyped<int32_t>("mod", DataType::INT32, {{i32_min}, {-1}}), ElementsAre(0));
+
+  const int64_t i64_max = std::numeric_limits<int64_t>::max();
+  const int64_t i64_min = std::numeric_limits<int64_t>::min();
+  EXPECT_THAT(RunTyped<int64_t>("add", DataType::INT64, {{i64_max}, {1}}), ElementsAre(i64_min));
+  EXPECT_THAT(RunTyped<int64_t>("mul", DataType::INT64, {{int64_t{1} << 32}, {int64_t{1} << 32}}), ElementsAre(0));
+  EXPECT_THAT(RunTyped<int64_t>("neg", DataType::INT64, {{i64_min}}), ElementsAre(i64_min));
+  EXPECT_THAT(RunTyped<int64_t>("mad", DataType::INT64, {{i64_max}, {2}, {2}}), ElementsAre(0));
+}
+
+TEST(Vm, UnsignedIntegersWrap) {
+  EXPECT_THAT(RunTyped<uint8_t>("sub", DataType::UINT8, {{0}, {1}}), ElementsAre(255));
+  EXPECT_THAT(RunTyped<uint8_t>("mul", DataType::UINT8, {{16}, {17}}), ElementsAre(16));
+  EXPECT_THAT(RunTyped<uint16_t>("add", DataType::UINT16, {{65535}, {1}}), ElementsAre(0));
+  EXPECT_THAT(RunTyped<uint32_t>("mul", DataType::UINT32, {{65536}, {65537}}), ElementsAre(65536));
+  EXPECT_THAT(RunTyped<uint64_t>("sub", DataType::UINT64, {{0}, {1}}),
+              ElementsAre(std::numeric_limits<uint64_t>::max()));
+}
+
+TEST(Vm, IntegerDivision) {
+  // Division truncates toward zero, and the remainder takes the sign of the dividend.
+  EXPECT_THAT(RunTyped<int32_t>("div", DataType::INT32, {{7, -7, 7, -7}, {2, 2, -2, -2}}), ElementsAre(3, -3, -3, 3));
+  EXPECT_THAT(RunTyped<int32_t>("mod", DataType::INT32, {{7, -7, 7, -7}, {2, 2, -2, -2}}), ElementsAre(1, -1, 1, -1));
+  EXPECT_THROW(RunTyped<int32_t>("div", DataType::INT32, {{1}, {0}}), std::exception);
+  EXPECT_THROW(RunTyped<int8_t>("mod", DataType::INT8, {{1}, {0}}), std::exception);
+  EXPECT_THROW(RunTyped<uint64_t>("div", DataType::UINT64, {{1}, {0}}), std::exception);
+}
+
+TEST(Vm, Shifts) {
+  // Shifting by the width of the type or more shifts every bit out.
+  EXPECT_THAT(RunTyped<int32_t>("bit_left", DataType::INT32, {{1, 1, 1, 3}, {3, 31, 32, -1}}),
+              ElementsAre(8, std::numeric_limits<int32_t>::min(), 0, 0));
+  EXPECT_THAT(RunTyped<int32_t>("bit_right", DataType::INT32, {{-16, -1, 16, 16}, {2, 40, 40, 1}}),
+              ElementsAre(-4, -1, 0, 8));
+  EXPECT_THAT(RunTyped<uint8_t>("bit_left", DataType::UINT8, {{0x81}, {1}}), ElementsAre(2));
+  EXPECT_THAT(RunTyped<int64_t>("bit_left", DataType::INT64, {{1}, {40}}), ElementsAre(int64_t{1} << 40));
+}
+
+template <typename T>
+void CheckFloatSpecials(DataType type) {
+  const T inf = std::numeric_limits<T>::infinity();
+  const T nan = std::numeric_limits<T>::quiet_NaN();
+
+  auto quotients = RunTyped<T>("div", type, {{1, -1, 0}, {0, 0, 0}});
+  EXPECT_EQ(quotients[0], inf);
+  EXPECT_EQ(quotients[1], -inf);
+  EXPECT_TRUE(std::isnan(quotients[2]));
+
+  auto sums = RunTyped<T>("add", type, {{inf, inf, nan}, {-inf, 1, 1}});
+  EXPECT_TRUE(std::isnan(sums[0]));
+  EXPECT_EQ(sums[1], inf);
+  EXPECT_TRUE(std::isnan(sums[2]));
+
+  auto products = RunTyped<T>("mul", type, {{0, -2}, {inf, 0}});
+  EXPECT_TRUE(std::isnan(products[0]));
+  EXPECT_TRUE(std::signbit(products[1]));
+
+  auto roots = RunTyped<T>("sqrt", type, {{-1, inf, -0.0}});
+  EXPECT_TRUE(std::isnan(roots[0]));
+  EXPECT_EQ(roots[1], inf);
+  EXPECT_TRUE(roots[2] == 0 && std::signbit(roots[2]));
+
+  auto logs = RunTyped<T>("log", type, {{0, -1, inf}});
+  EXPECT_EQ(logs[0], -inf);
+  EXPECT_TRUE(std::isnan(logs[1]));
+  EXPECT_EQ(logs[2], inf);
+
+  EXPECT_THAT(RunTyped<T>("exp", type, {{-inf, inf, 1000}}), ElementsAre(0, inf, inf));
+  EXPECT_EQ(RunTyped<T>("mod", type, {{inf, 1}, {1, inf}})[1], 1);
+
+  // Every comparison with NaN is false, except for inequality.
+  EXPECT_THAT((RunTyped<T, uint8_t>("cmp_eq", type, {{nan, 1}, {nan, 1}}, DataType::BOOLEAN)), ElementsAre(0, 1));
+  EXPECT_THAT((RunTyped<T, uint8_t>("neq", type, {{nan, 1}, {nan, 1}}, DataType::BOOLEAN)), ElementsAre(1, 0));
+  EXPECT_THAT((RunTyped<T, uint8_t>("lt", type, {{nan, 1}, {1, nan}}, DataType::BOOLEAN)), ElementsAre(0, 0));
+  EXPECT_THAT((RunTyped<T, uint8_t>("gte", type, {{nan, 1}, {1, nan}}, DataType::BOOLEAN)), ElementsAre(0, 0));
+}
+
+TEST(Vm, FloatSpecials) {
+  CheckFloatSpecials<float>(DataType::FLOAT32);
+  CheckFloatSpecials<double>(DataType::FLOAT64);
+}
+
+TEST(Vm, HalfPrecision) {
+  // Half precision values are computed in single precision, and rounded when stored.
+  const float inf = std::numeric_limits<float>::infinity();
+  EXPECT_THAT(RunFloats("add", DataType::FLOAT16, {{2048, 65504, 1}, {1, 65504, 0.5}}, DataType::FLOAT16),
+              ElementsAre(2048, inf, 1.5));
+  EXPECT_THAT(RunFloats("add", DataType::FLOAT16, {{2048}, {1}}, DataType::FLOAT32), ElementsAre(2049));
+}
+
+TEST(Vm, Conversions) {
+  // Stores convert to the type of the refinement.
+  EXPECT_THAT((RunTyped<int32_t, int8_t>("add", DataType::INT32, {{127, 300}, {1, 0}}, DataType::INT8)),
+              ElementsAre(-128, 44));
+  EXPECT_THAT((RunTyped<float, int32_t>("assign", DataType::FLOAT32, {{2.75f, -2.75f}}, DataType::INT32)),
+              ElementsAre(2, -2));
+  EXPECT_THAT((RunTyped<int32_t, uint8_t>("assign", DataType::INT32, {{0, 7}}, DataType::BOOLEAN)),
+              ElementsAre(0, 1));
+  EXPECT_THAT((RunTyped<int64_t, double>("assign", DataType::INT64, {{int64_t{1} << 40}}, DataType::FLOAT64)),
+              ElementsAre(1099511627776.0));
+}
+
+// The expected results of each intrinsic the VM supports, computed in float32 unless otherwise noted.
+struct IntrinsicCase {
+  DataType type;
+  std::vector<std::vector<float>> operands;
+  std::vector<float> expected;
+};
+
+const std::map<std::string, IntrinsicCase>& IntrinsicCases() {
+  static const std::map<std::string, IntrinsicCase> cases{
+      {"add", {DataType::FLOAT32, {{1.5, 2}, {2, -3}}, {3.5, -1}}},
+      {"sub", {DataType::FLOAT32, {{1.5, 2}, {2, -3}}, {-0.5, 5}}},
+      {"mul", {DataType::FLOAT32, {{1.5, 2}, {2, -3}}, {3, -6}}},
+      {"div", {DataType::FLOAT32, {{3, -6}, {2, 4}}, {1.5, -1.5}}},
+      {"mod", {DataType::FLOAT32, {{7, -7}, {3, 3}}, {1, -1}}},
+      {"neg", {DataType::FLOAT32, {{1.5, -2}}, {-1.5, 2}}},
+      {"mad", {DataType::FLOAT32, {{2, 3}, {3, 4}, {1, -1}}, {7, 11}}},
+      {"max", {DataType::FLOAT32, {{1, 5}, {2, -3}}, {2, 5}}},
+      {"min", {DataType::FLOAT32, {{1, 5}, {2, -3}}, {1, -3}}},
+      {"lt", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {1, 0, 0}}},
+      {"lte", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {1, 1, 0}}},
+      {"gt", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {0, 0, 1}}},
+      {"gte", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {0, 1, 1}}},
+      {"eq", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {0, 1, 0}}},
+      {"neq", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {1, 0, 1}}},
+      {"cmp_lt", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {1, 0, 0}}},
+      {"cmp_le", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {1, 1, 0}}},
+      {"cmp_gt", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {0, 0, 1}}},
+      {"cmp_ge", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {0, 1, 1}}},
+      {"cmp_eq", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {0, 1, 0}}},
+      {"cmp_ne", {DataType::FLOAT32, {{1, 2, 3}, {2, 2, 2}}, {1, 0, 1}}},
+      {"and", {DataType::FLOAT32, {{0, 1, 1, 0}, {1, 0, 2, 0}}, {0, 0, 1, 0}}},
+      {"or", {DataType::FLOAT32, {{0, 1, 1, 0}, {1, 0, 2, 0}}, {1, 1, 1, 0}}},
+      {"xor", {DataType::FLOAT32, {{0, 1, 1, 0}, {1, 0, 2, 0}}, {1, 1, 0, 0}}},
+      {"not", {DataType::FLOAT32, {{0, 2}}, {1, 0}}},
+      {"bit_and", {DataType::INT32, {{12, -1}, {10, 7}}, {8, 7}}},
+      {"bit_or", {DataType::INT32, {{12, 1}, {10, 2}}, {14, 3}}},
+      {"bit_xor", {DataType::INT32, {{12, -1}, {10, 0}}, {6, -1}}},
+      {"bit_not", {DataType::INT32, {{0, 5}}, {-1, -6}}},
+      {"bit_left", {DataType::INT32, {{1, 3}, {4, 1}}, {16, 6}}},
+      {"bit_right", {DataType::INT32, {{16, -8}, {2, 1}}, {4, -4}}},
+      {"cond", {DataType::FLOAT32, {{1, 0}, {5, 5}, {7, 7}}, {5, 7}}},
+      {"assign", {DataType::FLOAT32, {{2.5, -1}}, {2.5, -1}}},
+      {"ident", {DataType::FLOAT32, {{2.5, -1}}, {2.5, -1}}},
+      {"as_float", {DataType::FLOAT32, {{3, -1}}, {3, -1}}},
+      {"as_int", {DataType::INT32, {{3, -1}}, {3, -1}}},
+      {"as_uint", {DataType::UINT32, {{3, 7}}, {3, 7}}},
+      {"sqrt", {DataType::FLOAT32, {{4, 2.25}}, {2, 1.5}}},
+      {"exp", {DataType::FLOAT32, {{0, 1}}, {1, std::exp(1.0f)}}},
+      {"log", {DataType::FLOAT32, {{1, std::exp(1.0f)}}, {0, 1}}},
+      {"pow", {DataType::FLOAT32, {{2, 9}, {10, 0.5}}, {1024, 3}}},
+      {"tanh", {DataType::FLOAT32, {{0, 0.5}}, {0, std::tanh(0.5f)}}},
+      {"sinh", {DataType::FLOAT32, {{0, 0.5}}, {0, std::sinh(0.5f)}}},
+      {"cosh", {DataType::FLOAT32, {{0, 0.5}}, {1, std::cosh(0.5f)}}},
+      {"sin", {DataType::FLOAT32, {{0, 0.5}}, {0, std::sin(0.5f)}}},
+      {"cos", {DataType::FLOAT32, {{0, 0.5}}, {1, std::cos(0.5f)}}},
+      {"tan", {DataType::FLOAT32, {{0, 0.5}}, {0, std::tan(0.5f)}}},
+      {"asin", {DataType::FLOAT32, {{0, 0.5}}, {0, std::asin(0.5f)}}},
+      {"acos", {DataType::FLOAT32, {{1, 0.5}}, {0, std::acos(0.5f)}}},
+      {"atan", {DataType::FLOAT32, {{0, 0.5}}, {0, std::atan(0.5f)}}},
+      {"ceil", {DataType::FLOAT32, {{1.2, -1.2}}, {2, -1}}},
+      {"floor", {DataType::FLOAT32, {{1.2, -1.2}}, {1, -2}}},
+      {"round", {DataType::FLOAT32, {{2.5, -2.5, 1.4}}, {3, -3, 1}}},
+  };
+  return cases;
+}
+
+TEST(Vm, Intrinsics) {
+  const auto& cases = IntrinsicCases();
+  for (const auto& name : VmIntrinsics()) {
+    auto it = cases.find(name);
+    if (it == cases.end()) {
+      ADD_FAILURE() << "No test case for intrinsic '" << name << "'";
+      continue;
+    }
+    const auto& test = it->second;
+    auto results = RunFloats(name, test.type, test.operands, test.type);
+    ASSERT_EQ(results.size(), test.expected.size()) << name;
+    for (size_t i = 0; i < results.size(); ++i) {
+      EXPECT_NEAR(results[i], test.expected[i], 1e-6 * std::max(1.0f, std::fabs(test.expected[i])))
+          << name << " #" << i;
+    }
+  }
+  EXPECT_THROW(RunFloats("no_such_intrinsic", DataType::FLOAT32, {{1}}, DataType::FLOAT32), std::exception);
+  EXPECT_THROW(RunFloats("add", DataType::FLOAT32, {{1}}, DataType::FLOAT32), std::exception);
+}
+
+TEST(Vm, Aggregations) {
+  struct Case {
+    std::string agg_op;
+    float init;
+    float expected;
+  };
+  for (const auto& test : std::vector<Case>{{stripe::Intrinsic::SUM, 0, 4},
+                                            {stripe::Intrinsic::PROD, 1, -24},
+                                            {stripe::Intrinsic::MAX, -100, 4},
+                                            {stripe::Intrinsic::MIN, 100, -3}}) {
+    // Every element of the input is aggregated into the output's single element.
+    auto program = IntrinsicProgram("assign", DataType::FLOAT32, 1, DataType::FLOAT32, 4);
+    auto kernel = program->SubBlock(0);
+    auto ref = kernel->ref_by_into("O");
+    ref->mut().access = {stripe::Affine{}};
+    ref->mut().agg_op = test.agg_op;
+    program->ref_by_into("O")->mut().interior_shape = tile::TensorShape(DataType::FLOAT32, {{1, 1}});
+    std::map<std::string, Buffer> buffers{{"I0", {2, -3, 4, 1}}, {"O", {test.init}}};
+    VmProgram(*program).Run(&buffers);
+    EXPECT_THAT(buffers["O"], ElementsAre(test.expected)) << test.agg_op;
+  }
+}
+
+// Runs a program on the VM and on the interpreter it replaced, over the same small integral inputs (so that float
+// sums are exact whatever order they're computed in) and zeroed outputs, and checks the results are identical.
+void CheckAgainstReference(const stripe::Block& program) {
+  std::map<std::string, Buffer> data;
+  int seed = 0;
+  for (const auto& ref : program.refs) {
+    if (!ref.has_tag("user")) {
+      continue;
+    }
+    auto& buffer = data[ref.into()];
+    buffer.resize(ref.interior_shape.elem_size());
+    if (ref.dir != stripe::RefDir::In) {
+      continue;
+    }
+    for (auto& value : buffer) {
+      value = (seed++ * 7) % 9 - 4;
+    }
+  }
+  auto expected = data;
+  ReferenceExecuteProgram(program, &expected);
+  VmProgram(program).Run(&data);
+  for (const auto& kvp : expected) {
+    EXPECT_THAT(data.at(kvp.first), ContainerEq(kvp.second)) << kvp.first;
+  }
+}
+
+TEST(Vm, MatchesReferenceInterpreter) {
+  auto f32 = [](const std::vector<uint64_t>& dims) { return TensorShape(PLAIDML_DATA_FLOAT32, dims); };
+  std::vector<lang::RunInfo> cases{
+      lib::LoadMatMul("matmul", f32({7, 5}), f32({5, 9})),
+      lib::LoadMatMulIntermediate("matmul_add", f32({6, 6}), f32({6, 6}), f32({6, 6})),
+      lib::LoadEltwiseAdd("add", f32({4, 6}), f32({4, 6})),
+      lib::LoadEltwiseMul("mul", f32({3, 1, 5}), f32({3, 4, 5})),
+      lib::LoadEltwiseMultiAdd("multi_add", f32({8}), f32({8}), f32({8}), f32({8})),
+      lib::LoadConv1d("conv1d", f32({1, 12, 3}), f32({3, 3, 4}), {1, 10, 4}),
+      lib::LoadConv2d("conv2d", f32({1, 6, 6, 3}), f32({3, 3, 3, 2}), {1, 4, 4, 2}),
+  };
+  lang::RunInfo relu;
+  relu.program_name = "conv_bias_relu";
+  relu.code = R"***(
+    function (In[X, CI], K[I, CI, CO], B[CO]) -> (R) {
+      O[x, co : X, CO] = +(In[x+i-1, ci] * K[i, ci, co]);
+      BO = O + B;
+      R = relu(BO);
+    }
+  )***";
+  relu.input_shapes.emplace("In", SimpleShape(DataType::FLOAT32, {5, 4}));
+  relu.input_shapes.emplace("K", SimpleShape(DataType::FLOAT32, {3, 4, 4}));
+  relu.input_shapes.emplace("B", SimpleShape(DataType::FLOAT32, {4}));
+  relu.output_shapes.emplace("R", SimpleShape(DataType::FLOAT32, {5, 4}));
+  cases.push_back(relu);
+
+  for (const auto& runinfo : cases) {
+    SCOPED_TRACE(runinfo.program_name);
+    auto program = GenerateStripe(runinfo);
+    CheckAgainstReference(*program->entry);
+  }
+
+  // Tiling moves the accesses into nested blocks, and leaves some tiles partially covered.
+  auto program = GenerateStripe(cases[0]);
+  ApplyTile(program->entry->SubBlock(0)->SubBlock(0).get(), {4, 3, 2});
+  CheckAgainstReference(*program->entry);
+}
+
+}  // namespace test
+}  // namespace codegen
+}  // namespace tile
+}  // namespace vertexai
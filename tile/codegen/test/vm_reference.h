@@ -0,0 +1,24 @@
+// Copyright 2019, Intel Corp.
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "tile/stripe/stripe.h"
+
+namespace vertexai {
+namespace tile {
+namespace codegen {
+namespace test {
+
+// The interpreter VmProgram replaced, kept to check the VM against: it walks the Stripe tree directly, looking
+// everything up by name and computing everything in single precision.  It only supports the add, mul, cmp_lt and
+// cond intrinsics, and the assign and sum aggregations.
+void ReferenceExecuteProgram(const stripe::Block& program, std::map<std::string, std::vector<float>>* buffers);
+
+}  // namespace test
+}  // namespace codegen
+}  // namespace tile
+}  // namespace vertexai
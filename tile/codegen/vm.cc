@@ -3,11 +3,18 @@
 #include "tile/codegen/vm.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <set>
+#include <type_traits>
+#include <utility>
 
 #include <boost/format.hpp>
+#include <half.hpp>
 
 #include "base/util/lookup.h"
-#include "base/util/stream_container.h"
 #include "base/util/throw.h"
 #include "tile/stripe/stripe.h"
 
@@ -19,219 +26,1554 @@ using namespace stripe;  // NOLINT
 
 namespace {
 
-std::map<std::string, std::function<float(float, float)>> BINARY_OPS = {
-    {"add", [](float a, float b) { return a + b; }},
-    {"mul", [](float a, float b) { return a * b; }},
-    {"cmp_lt", [](float a, float b) { return a < b; }},
+template <typename T>
+struct Tag {
+  using type = T;
 };
 
-std::map<std::string, std::function<float(float, float, float)>> TERNARY_OPS = {
-    {"cond", [](float c, float t, float f) { return c ? t : f; }},
+// The in-memory representation of an INT128 element.
+struct Int128 {
+  uint64_t lo;
+  int64_t hi;
 };
 
-class Scope {
- public:
-  Scope() {}
-  explicit Scope(Scope* outer) : outer_(outer), depth_(outer->depth_ + 1) {}
-
-  void ExecuteProgram(const Block& block, std::map<std::string, Buffer>* buffers) {
-    Scope outer;
-    outer_ = &outer;
-    std::map<std::string, Buffer> tmps;
-    for (const auto& ref : block.refs) {
-      assert(ref.from.empty());
-      if (ref.has_tag("user")) {
-        refs_[ref.into()] = &safe_at(buffers, ref.into());
-      } else {
-        Buffer buf(ref.interior_shape.elem_size());
-        tmps.emplace(ref.into(), buf);
-        refs_[ref.into()] = &safe_at(&tmps, ref.into());
+// Elem describes how elements of a storage type are read into and written from registers, which hold Values.
+template <typename S>
+struct Elem {
+  using Value = S;
+  static Value Read(const char* ptr) {
+    S elem;
+    std::memcpy(&elem, ptr, sizeof(S));
+    return elem;
+  }
+  static void Write(char* ptr, Value value) { std::memcpy(ptr, &value, sizeof(S)); }
+};
+
+template <>
+struct Elem<bool> {
+  using Value = bool;
+  static Value Read(const char* ptr) { return *reinterpret_cast<const uint8_t*>(ptr) != 0; }
+  static void Write(char* ptr, Value value) { *reinterpret_cast<uint8_t*>(ptr) = value ? 1 : 0; }
+};
+
+template <>
+struct Elem<half_float::half> {
+  using Value = float;
+  static Value Read(const char* ptr) {
+    half_float::half elem;
+    std::memcpy(&elem, ptr, sizeof(elem));
+    return static_cast<float>(elem);
+  }
+  static void Write(char* ptr, Value value) {
+    half_float::half elem{value};
+    std::memcpy(ptr, &elem, sizeof(elem));
+  }
+};
+
+template <>
+struct Elem<Int128> {
+  using Value = int64_t;
+  static Value Read(const char* ptr) {
+    Int128 elem;
+    std::memcpy(&elem, ptr, sizeof(elem));
+    return static_cast<int64_t>(elem.lo);
+  }
+  static void Write(char* ptr, Value value) {
+    Int128 elem{static_cast<uint64_t>(value), value < 0 ? -1 : 0};
+    std::memcpy(ptr, &elem, sizeof(elem));
+  }
+};
+
+// Calls f with the Tag of the storage type of a DataType.
+template <typename F>
+void WithElem(DataType type, F&& f) {
+  switch (type) {
+    case DataType::BOOLEAN:
+      return f(Tag<bool>{});
+    case DataType::INT8:
+      return f(Tag<int8_t>{});
+    case DataType::INT16:
+      return f(Tag<int16_t>{});
+    case DataType::INT32:
+      return f(Tag<int32_t>{});
+    case DataType::INT64:
+      return f(Tag<int64_t>{});
+    case DataType::INT128:
+      return f(Tag<Int128>{});
+    case DataType::UINT8:
+      return f(Tag<uint8_t>{});
+    case DataType::UINT16:
+      return f(Tag<uint16_t>{});
+    case DataType::UINT32:
+    case DataType::PRNG:
+      return f(Tag<uint32_t>{});
+    case DataType::UINT64:
+      return f(Tag<uint64_t>{});
+    case DataType::FLOAT16:
+      return f(Tag<half_float::half>{});
+    case DataType::FLOAT32:
+      return f(Tag<float>{});
+    case DataType::FLOAT64:
+      return f(Tag<double>{});
+    default:
+      throw_with_trace(std::runtime_error("Unsupported data type: " + to_string(type)));
+  }
+}
+
+// The type in which values of a DataType are computed.
+DataType ValueType(DataType type) {
+  switch (type) {
+    case DataType::FLOAT16:
+      return DataType::FLOAT32;
+    case DataType::INT128:
+      return DataType::INT64;
+    case DataType::PRNG:
+      return DataType::UINT32;
+    default:
+      return type;
+  }
+}
+
+// Calls f with the Tag of the C++ type in which values of a DataType are computed.
+template <typename F>
+void WithValue(DataType type, F&& f) {
+  switch (ValueType(type)) {
+    case DataType::BOOLEAN:
+      return f(Tag<bool>{});
+    case DataType::INT8:
+      return f(Tag<int8_t>{});
+    case DataType::INT16:
+      return f(Tag<int16_t>{});
+    case DataType::INT32:
+      return f(Tag<int32_t>{});
+    case DataType::INT64:
+      return f(Tag<int64_t>{});
+    case DataType::UINT8:
+      return f(Tag<uint8_t>{});
+    case DataType::UINT16:
+      return f(Tag<uint16_t>{});
+    case DataType::UINT32:
+      return f(Tag<uint32_t>{});
+    case DataType::UINT64:
+      return f(Tag<uint64_t>{});
+    case DataType::FLOAT32:
+      return f(Tag<float>{});
+    case DataType::FLOAT64:
+      return f(Tag<double>{});
+    default:
+      throw_with_trace(std::runtime_error("Unsupported data type: " + to_string(type)));
+  }
+}
+
+int64_t ElemBytes(DataType type) {
+  if (type == DataType::PRNG) {
+    return sizeof(uint32_t);
+  }
+  return byte_width(type);
+}
+
+double ReadNumber(DataType type, const char* ptr) {
+  double result = 0;
+  WithElem(type, [&](auto tag) {
+    using S = typename decltype(tag)::type;
+    result = static_cast<double>(Elem<S>::Read(ptr));
+  });
+  return result;
+}
+
+void WriteNumber(DataType type, char* ptr, double value) {
+  WithElem(type, [&](auto tag) {
+    using S = typename decltype(tag)::type;
+    Elem<S>::Write(ptr, static_cast<typename Elem<S>::Value>(value));
+  });
+}
+
+struct Frame;
+struct Instr;
+
+using Reg = uint64_t;
+using Handler = void (*)(const Instr& in, Frame* frame);
+
+struct Instr {
+  Handler run = nullptr;
+  uint32_t dst = 0;
+  uint32_t src[3] = {0, 0, 0};
+  size_t aux = 0;  // The refinement, index expression, special, or block the instruction uses
+  Reg imm = 0;
+};
+
+// An affine, compiled against the index slots of a block.
+struct Linear {
+  int64_t constant = 0;
+  std::vector<std::pair<size_t, int64_t>> terms;
+
+  int64_t Eval(const int64_t* idxs) const {
+    int64_t result = constant;
+    for (const auto& term : terms) {
+      result += idxs[term.first] * term.second;
+    }
+    return result;
+  }
+
+  int64_t coeff(size_t idx) const {
+    for (const auto& term : terms) {
+      if (term.first == idx) {
+        return term.second;
       }
     }
-    ExecuteStatements(block);
+    return 0;
   }
+};
 
- private:
-  void ExecuteBlock(const Block& block) {
-    IVLOG(4, Tab() << "ExecuteBlock: " << block.name);
-    std::map<std::string, Buffer> buffers;
-    for (const auto& ref : block.refs) {
-      if (ref.from.empty()) {
-        Buffer buf(ref.interior_shape.elem_size());
-        buffers.emplace(ref.into(), buf);
-        refs_[ref.into()] = &safe_at(&buffers, ref.into());
-      } else {
-        refs_[ref.into()] = safe_at(outer_->refs_, ref.from);
+struct Loop {
+  uint64_t range;
+  Linear init;  // In terms of the enclosing block's indices
+};
+
+struct RefSlot {
+  enum class Kind {
+    Bound,    // Bound to a caller's buffer
+    Local,    // Allocated on entry to the block
+    Refined,  // A refinement of a refinement of the enclosing block
+  };
+
+  std::string name;
+  Kind kind;
+  TensorShape shape;
+  int64_t width;       // The size of an element, in bytes
+  size_t parent = 0;   // For refined refinements, the slot of the refinement in the enclosing block
+  uint64_t bytes = 0;  // For local refinements, the size of the allocation
+  std::string agg_op;
+  Linear access;  // The offset of the refinement, in bytes
+};
+
+struct SpecialOp {
+  void (*run)(const SpecialOp& op, Frame* frame);
+  std::string name;
+  std::vector<size_t> inputs;
+  std::vector<size_t> outputs;
+};
+
+// A lowered block.
+struct Proc {
+  size_t id;
+  std::string name;
+  std::vector<Loop> idxs;
+  std::vector<Linear> constraints;
+  std::vector<RefSlot> refs;
+  // For each index, how stepping it (and resetting the indices inside it) moves each refinement's offset and then
+  // each constraint.
+  std::vector<int64_t> carries;
+  std::vector<Linear> load_idxs;
+  std::vector<SpecialOp> specials;
+  std::vector<std::unique_ptr<Proc>> children;
+  std::vector<Instr> code;
+  uint32_t num_regs = 0;
+};
+
+// A view of a refinement: the allocation it refers to, and its current offset within it, in bytes.
+struct View {
+  char* base = nullptr;
+  int64_t size = 0;
+  int64_t offset = 0;
+};
+
+struct Machine;
+
+// The state of a running block.  Blocks don't recurse, so each block has a single frame for the whole run.
+struct Frame {
+  Machine* machine = nullptr;
+  const Proc* proc = nullptr;
+  std::vector<int64_t> idxs;
+  std::vector<int64_t> bases;
+  std::vector<uint64_t> counts;
+  std::vector<int64_t> constraints;
+  std::vector<View> views;
+  std::vector<Reg> regs;
+  std::vector<std::vector<char>> locals;
+
+  template <typename T>
+  T Get(uint32_t reg) const {
+    T value;
+    std::memcpy(&value, &regs[reg], sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  void Set(uint32_t reg, T value) {
+    std::memcpy(&regs[reg], &value, sizeof(T));
+  }
+};
+
+struct Machine {
+  Machine(const Proc& root, size_t num_procs) : frames(num_procs) { Prepare(root); }
+
+  void Prepare(const Proc& proc) {
+    Frame& frame = frames[proc.id];
+    frame.machine = this;
+    frame.proc = &proc;
+    frame.idxs.resize(proc.idxs.size());
+    frame.bases.resize(proc.idxs.size());
+    frame.counts.resize(proc.idxs.size());
+    frame.constraints.resize(proc.constraints.size());
+    frame.views.resize(proc.refs.size());
+    frame.regs.resize(proc.num_regs);
+    frame.locals.resize(proc.refs.size());
+    for (size_t slot = 0; slot < proc.refs.size(); ++slot) {
+      if (proc.refs[slot].kind == RefSlot::Kind::Local) {
+        frame.locals[slot].resize(proc.refs[slot].bytes);
       }
     }
-    if (block.idxs.size()) {
-      Loop(block, 0);
-    } else {
-      ExecuteStatements(block);
+    for (const auto& child : proc.children) {
+      Prepare(*child);
     }
   }
 
-  void Loop(const Block& block, size_t depth) {
-    const auto& idx = block.idxs[depth];
-    auto base = idx.affine.eval(outer_->idxs_);
-    for (size_t i = 0; i < idx.range; i++) {
-      idxs_[idx.name] = base + i;
-      if (depth < block.idxs.size() - 1) {
-        Loop(block, depth + 1);
-      } else {
-        ExecuteStatements(block);
+  std::vector<Frame> frames;
+};
+
+[[noreturn]] void OutOfBounds(const char* what, const Frame& frame, size_t slot, int64_t offset) {
+  const auto& ref = frame.proc->refs[slot];
+  throw_with_trace(std::runtime_error(
+      str(boost::format("%s: Out of bounds access on '%s' in block '%s', offset: %lld, size: %lld") % what %
+          ref.name % frame.proc->name % (offset / ref.width) % (frame.views[slot].size / ref.width))));
+}
+
+[[noreturn]] void DivisionByZero() { throw_with_trace(std::runtime_error("Integer division by zero")); }
+
+void RunBlock(const Proc& proc, const Frame* outer, Machine* machine) {
+  Frame& frame = machine->frames[proc.id];
+  for (size_t idx = 0; idx < proc.idxs.size(); ++idx) {
+    if (!proc.idxs[idx].range) {
+      return;
+    }
+    frame.bases[idx] = outer ? proc.idxs[idx].init.Eval(outer->idxs.data()) : proc.idxs[idx].init.constant;
+    frame.idxs[idx] = frame.bases[idx];
+    frame.counts[idx] = 0;
+  }
+  for (size_t slot = 0; slot < proc.refs.size(); ++slot) {
+    const auto& ref = proc.refs[slot];
+    auto& view = frame.views[slot];
+    int64_t origin = 0;
+    switch (ref.kind) {
+      case RefSlot::Kind::Bound:
+        break;
+      case RefSlot::Kind::Local:
+        std::fill(frame.locals[slot].begin(), frame.locals[slot].end(), 0);
+        view.base = frame.locals[slot].data();
+        view.size = frame.locals[slot].size();
+        break;
+      case RefSlot::Kind::Refined: {
+        const auto& outer_view = outer->views[ref.parent];
+        view.base = outer_view.base;
+        view.size = outer_view.size;
+        origin = outer_view.offset;
+      } break;
+    }
+    view.offset = origin + ref.access.Eval(frame.idxs.data());
+  }
+  for (size_t idx = 0; idx < proc.constraints.size(); ++idx) {
+    frame.constraints[idx] = proc.constraints[idx].Eval(frame.idxs.data());
+  }
+
+  size_t num_refs = proc.refs.size();
+  size_t num_constraints = proc.constraints.size();
+  for (;;) {
+    if (std::all_of(frame.constraints.begin(), frame.constraints.end(), [](int64_t value) { return value >= 0; })) {
+      for (const auto& in : proc.code) {
+        in.run(in, &frame);
       }
     }
+    // Step the indices like an odometer, moving the offsets and constraints along with them.
+    size_t idx = proc.idxs.size();
+    for (; idx; --idx) {
+      if (++frame.counts[idx - 1] < proc.idxs[idx - 1].range) {
+        break;
+      }
+      frame.counts[idx - 1] = 0;
+      frame.idxs[idx - 1] = frame.bases[idx - 1];
+    }
+    if (!idx) {
+      return;
+    }
+    ++frame.idxs[idx - 1];
+    const int64_t* carry = &proc.carries[(idx - 1) * (num_refs + num_constraints)];
+    for (size_t slot = 0; slot < num_refs; ++slot) {
+      frame.views[slot].offset += carry[slot];
+    }
+    for (size_t con = 0; con < num_constraints; ++con) {
+      frame.constraints[con] += carry[num_refs + con];
+    }
+  }
+}
+
+template <typename T>
+using IsNumber = std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>;
+
+template <typename T>
+using IsInteger = std::integral_constant<bool, std::is_integral<T>::value && !std::is_same<T, bool>::value>;
+
+// Integer arithmetic wraps around, as it does in compiled code, rather than overflowing.
+template <typename T, typename Enable = void>
+struct Arith {
+  static T Add(T a, T b) { return a + b; }
+  static T Sub(T a, T b) { return a - b; }
+  static T Mul(T a, T b) { return a * b; }
+  static T Neg(T a) { return -a; }
+  static T Div(T a, T b) { return a / b; }
+  static T Mod(T a, T b) { return std::fmod(a, b); }
+};
+
+template <typename T>
+struct Arith<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+  static T Add(T a, T b) { return static_cast<T>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)); }
+  static T Sub(T a, T b) { return static_cast<T>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)); }
+  static T Mul(T a, T b) { return static_cast<T>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)); }
+  static T Neg(T a) { return static_cast<T>(uint64_t{0} - static_cast<uint64_t>(a)); }
+  static T Div(T a, T b) {
+    if (!b) {
+      DivisionByZero();
+    }
+    if (std::is_signed<T>::value && b == static_cast<T>(-1)) {
+      return Neg(a);
+    }
+    return static_cast<T>(a / b);
+  }
+  static T Mod(T a, T b) {
+    if (!b) {
+      DivisionByZero();
+    }
+    if (std::is_signed<T>::value && b == static_cast<T>(-1)) {
+      return 0;
+    }
+    return static_cast<T>(a % b);
+  }
+};
+
+struct Add {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return Arith<T>::Add(a, b);
+  }
+};
+
+struct Sub {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return Arith<T>::Sub(a, b);
+  }
+};
+
+struct Mul {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return Arith<T>::Mul(a, b);
+  }
+};
+
+struct Div {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return Arith<T>::Div(a, b);
+  }
+};
+
+struct Mod {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return Arith<T>::Mod(a, b);
+  }
+};
+
+struct Neg {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T a) {
+    return Arith<T>::Neg(a);
+  }
+};
+
+struct Mad {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T a, T b, T c) {
+    return Arith<T>::Add(Arith<T>::Mul(a, b), c);
+  }
+};
+
+struct Max {
+  template <typename T>
+  using Valid = std::true_type;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return a < b ? b : a;
+  }
+};
+
+struct Min {
+  template <typename T>
+  using Valid = std::true_type;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return b < a ? b : a;
+  }
+};
+
+#define VM_COMPARISON(NAME, OP)        \
+  struct NAME {                        \
+    template <typename T>              \
+    using Valid = std::true_type;      \
+    template <typename T>              \
+    static bool Apply(T a, T b) {      \
+      return a OP b;                   \
+    }                                  \
+  };
+
+VM_COMPARISON(Lt, <)
+VM_COMPARISON(Lte, <=)
+VM_COMPARISON(Gt, >)
+VM_COMPARISON(Gte, >=)
+VM_COMPARISON(Eq, ==)
+VM_COMPARISON(Neq, !=)
+
+#undef VM_COMPARISON
+
+struct And {
+  template <typename T>
+  using Valid = std::is_same<T, bool>;
+  static bool Apply(bool a, bool b) { return a && b; }
+};
+
+struct Or {
+  template <typename T>
+  using Valid = std::is_same<T, bool>;
+  static bool Apply(bool a, bool b) { return a || b; }
+};
+
+struct Xor {
+  template <typename T>
+  using Valid = std::is_same<T, bool>;
+  static bool Apply(bool a, bool b) { return a != b; }
+};
+
+struct Not {
+  template <typename T>
+  using Valid = std::is_same<T, bool>;
+  static bool Apply(bool a) { return !a; }
+};
+
+struct BitAnd {
+  template <typename T>
+  using Valid = IsInteger<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return static_cast<T>(a & b);
+  }
+};
+
+struct BitOr {
+  template <typename T>
+  using Valid = IsInteger<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return static_cast<T>(a | b);
+  }
+};
+
+struct BitXor {
+  template <typename T>
+  using Valid = IsInteger<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return static_cast<T>(a ^ b);
+  }
+};
+
+struct BitNot {
+  template <typename T>
+  using Valid = IsInteger<T>;
+  template <typename T>
+  static T Apply(T a) {
+    return static_cast<T>(~a);
+  }
+};
+
+// Shifts by more than the width of the type shift every bit out.
+struct BitLeft {
+  template <typename T>
+  using Valid = IsInteger<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    if (b < 0 || static_cast<uint64_t>(b) >= sizeof(T) * 8) {
+      return 0;
+    }
+    return static_cast<T>(static_cast<uint64_t>(a) << b);
+  }
+};
+
+struct BitRight {
+  template <typename T>
+  using Valid = IsInteger<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    if (b < 0 || static_cast<uint64_t>(b) >= sizeof(T) * 8) {
+      return a < 0 ? static_cast<T>(-1) : 0;
+    }
+    return static_cast<T>(a >> b);
+  }
+};
+
+// Math functions are evaluated in single precision for single and half precision values, and in double precision
+// for everything else, as the JIT does.
+template <typename T>
+using MathType = typename std::conditional<std::is_same<T, float>::value, float, double>::type;
+
+template <typename Fn>
+struct Math {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T a) {
+    return static_cast<T>(Fn::Call(static_cast<MathType<T>>(a)));
   }
+};
+
+#define VM_MATH_FUNCTION(NAME, FN)   \
+  struct NAME##Fn {                  \
+    template <typename W>            \
+    static W Call(W a) {             \
+      return std::FN(a);             \
+    }                                \
+  };                                 \
+  using NAME = Math<NAME##Fn>;
+
+VM_MATH_FUNCTION(Sqrt, sqrt)
+VM_MATH_FUNCTION(Exp, exp)
+VM_MATH_FUNCTION(Log, log)
+VM_MATH_FUNCTION(Tanh, tanh)
+VM_MATH_FUNCTION(Sinh, sinh)
+VM_MATH_FUNCTION(Cosh, cosh)
+VM_MATH_FUNCTION(Sin, sin)
+VM_MATH_FUNCTION(Cos, cos)
+VM_MATH_FUNCTION(Tan, tan)
+VM_MATH_FUNCTION(Asin, asin)
+VM_MATH_FUNCTION(Acos, acos)
+VM_MATH_FUNCTION(Atan, atan)
+VM_MATH_FUNCTION(Ceil, ceil)
+VM_MATH_FUNCTION(Floor, floor)
+VM_MATH_FUNCTION(Round, round)
+
+#undef VM_MATH_FUNCTION
+
+struct Pow {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T a, T b) {
+    return static_cast<T>(std::pow(static_cast<MathType<T>>(a), static_cast<MathType<T>>(b)));
+  }
+};
+
+template <typename Op, typename T>
+void UnaryOp(const Instr& in, Frame* frame) {
+  frame->Set(in.dst, Op::Apply(frame->Get<T>(in.src[0])));
+}
+
+template <typename Op, typename T>
+void BinaryOp(const Instr& in, Frame* frame) {
+  frame->Set(in.dst, Op::Apply(frame->Get<T>(in.src[0]), frame->Get<T>(in.src[1])));
+}
+
+template <typename Op, typename T>
+void TernaryOp(const Instr& in, Frame* frame) {
+  frame->Set(in.dst, Op::Apply(frame->Get<T>(in.src[0]), frame->Get<T>(in.src[1]), frame->Get<T>(in.src[2])));
+}
+
+template <typename T>
+void CondOp(const Instr& in, Frame* frame) {
+  frame->Set(in.dst, frame->Get<bool>(in.src[0]) ? frame->Get<T>(in.src[1]) : frame->Get<T>(in.src[2]));
+}
+
+template <typename From, typename To>
+void CastOp(const Instr& in, Frame* frame) {
+  frame->Set(in.dst, static_cast<To>(frame->Get<From>(in.src[0])));
+}
+
+void ConstantOp(const Instr& in, Frame* frame) { frame->regs[in.dst] = in.imm; }
+
+void LoadIndexOp(const Instr& in, Frame* frame) {
+  frame->Set(in.dst, frame->proc->load_idxs[in.aux].Eval(frame->idxs.data()));
+}
+
+template <typename S>
+void LoadOp(const Instr& in, Frame* frame) {
+  const View& view = frame->views[in.aux];
+  if (view.offset < 0 || view.offset + static_cast<int64_t>(sizeof(S)) > view.size) {
+    OutOfBounds("LOAD", *frame, in.aux, view.offset);
+  }
+  frame->Set(in.dst, Elem<S>::Read(view.base + view.offset));
+}
+
+// Aggregations combine the previous contents of an element with the value stored to it.
+struct AggAssign {
+  template <typename T>
+  using Valid = std::true_type;
+  template <typename T>
+  static T Apply(T /* prev */, T value) {
+    return value;
+  }
+};
+
+struct AggAdd {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T prev, T value) {
+    return Arith<T>::Add(prev, value);
+  }
+};
+
+struct AggMul {
+  template <typename T>
+  using Valid = IsNumber<T>;
+  template <typename T>
+  static T Apply(T prev, T value) {
+    return Arith<T>::Mul(prev, value);
+  }
+};
+
+struct AggMax {
+  template <typename T>
+  using Valid = std::true_type;
+  template <typename T>
+  static T Apply(T prev, T value) {
+    return !(prev <= value) ? prev : value;
+  }
+};
 
-  bool CheckConstraints(const Block& block) {
-    for (const auto& constraint : block.constraints) {
-      if (constraint.eval(idxs_) < 0) {
-        return false;
+struct AggMin {
+  template <typename T>
+  using Valid = std::true_type;
+  template <typename T>
+  static T Apply(T prev, T value) {
+    return !(prev >= value) ? prev : value;
+  }
+};
+
+template <typename S, typename Agg>
+void StoreOp(const Instr& in, Frame* frame) {
+  using T = typename Elem<S>::Value;
+  const View& view = frame->views[in.aux];
+  if (view.offset < 0 || view.offset + static_cast<int64_t>(sizeof(S)) > view.size) {
+    OutOfBounds("STORE", *frame, in.aux, view.offset);
+  }
+  char* ptr = view.base + view.offset;
+  T value = frame->Get<T>(in.src[0]);
+  if (std::is_same<Agg, AggAssign>::value) {
+    Elem<S>::Write(ptr, value);
+  } else {
+    Elem<S>::Write(ptr, Agg::Apply(Elem<S>::Read(ptr), value));
+  }
+}
+
+void BlockOp(const Instr& in, Frame* frame) { RunBlock(*frame->proc->children[in.aux], frame, frame->machine); }
+
+void SpecialOpHandler(const Instr& in, Frame* frame) {
+  const auto& op = frame->proc->specials[in.aux];
+  op.run(op, frame);
+}
+
+template <typename Op, typename T>
+Handler PickUnary(std::true_type) {
+  return &UnaryOp<Op, T>;
+}
+
+template <typename Op, typename T>
+Handler PickUnary(std::false_type) {
+  return nullptr;
+}
+
+template <typename Op, typename T>
+Handler PickBinary(std::true_type) {
+  return &BinaryOp<Op, T>;
+}
+
+template <typename Op, typename T>
+Handler PickBinary(std::false_type) {
+  return nullptr;
+}
+
+template <typename Op, typename T>
+Handler PickTernary(std::true_type) {
+  return &TernaryOp<Op, T>;
+}
+
+template <typename Op, typename T>
+Handler PickTernary(std::false_type) {
+  return nullptr;
+}
+
+template <typename S, typename Agg>
+Handler PickStore(std::true_type) {
+  return &StoreOp<S, Agg>;
+}
+
+template <typename S, typename Agg>
+Handler PickStore(std::false_type) {
+  return nullptr;
+}
+
+template <typename Op>
+Handler SelectUnary(DataType type) {
+  Handler handler = nullptr;
+  WithValue(type, [&](auto tag) {
+    using T = typename decltype(tag)::type;
+    handler = PickUnary<Op, T>(typename Op::template Valid<T>{});
+  });
+  return handler;
+}
+
+template <typename Op>
+Handler SelectBinary(DataType type) {
+  Handler handler = nullptr;
+  WithValue(type, [&](auto tag) {
+    using T = typename decltype(tag)::type;
+    handler = PickBinary<Op, T>(typename Op::template Valid<T>{});
+  });
+  return handler;
+}
+
+template <typename Op>
+Handler SelectTernary(DataType type) {
+  Handler handler = nullptr;
+  WithValue(type, [&](auto tag) {
+    using T = typename decltype(tag)::type;
+    handler = PickTernary<Op, T>(typename Op::template Valid<T>{});
+  });
+  return handler;
+}
+
+Handler SelectCond(DataType type) {
+  Handler handler = nullptr;
+  WithValue(type, [&](auto tag) { handler = &CondOp<typename decltype(tag)::type>; });
+  return handler;
+}
+
+Handler SelectCast(DataType from, DataType to) {
+  Handler handler = nullptr;
+  WithValue(from, [&](auto from_tag) {
+    WithValue(to, [&](auto to_tag) {
+      handler = &CastOp<typename decltype(from_tag)::type, typename decltype(to_tag)::type>;
+    });
+  });
+  return handler;
+}
+
+Handler SelectLoad(DataType type) {
+  Handler handler = nullptr;
+  WithElem(type, [&](auto tag) { handler = &LoadOp<typename decltype(tag)::type>; });
+  return handler;
+}
+
+template <typename Agg>
+Handler SelectStore(DataType type) {
+  Handler handler = nullptr;
+  WithElem(type, [&](auto tag) {
+    using S = typename decltype(tag)::type;
+    handler = PickStore<S, Agg>(typename Agg::template Valid<typename Elem<S>::Value>{});
+  });
+  return handler;
+}
+
+Handler SelectStore(DataType type, const std::string& agg_op) {
+  if (agg_op.empty() || agg_op == Intrinsic::ASSIGN) {
+    return SelectStore<AggAssign>(type);
+  }
+  if (agg_op == Intrinsic::SUM) {
+    return SelectStore<AggAdd>(type);
+  }
+  if (agg_op == Intrinsic::PROD) {
+    return SelectStore<AggMul>(type);
+  }
+  if (agg_op == Intrinsic::MAX) {
+    return SelectStore<AggMax>(type);
+  }
+  if (agg_op == Intrinsic::MIN) {
+    return SelectStore<AggMin>(type);
+  }
+  throw_with_trace(std::runtime_error("Unsupported agg_op: " + agg_op));
+}
+
+// How an intrinsic converts its inputs, and the type of its result.
+enum class Operands {
+  Typed,      // Every input is converted to the intrinsic's type
+  Boolean,    // Every input is converted to a boolean
+  Condition,  // The first input is converted to a boolean, and the rest to the intrinsic's type
+};
+
+struct IntrinsicDef {
+  size_t arity;
+  Operands operands;
+  bool boolean_result;
+  Handler (*select)(DataType type);  // Null for intrinsics which only convert their input
+};
+
+const std::map<std::string, IntrinsicDef>& Intrinsics() {
+  static const std::map<std::string, IntrinsicDef> defs{
+      {"add", {2, Operands::Typed, false, &SelectBinary<Add>}},
+      {"sub", {2, Operands::Typed, false, &SelectBinary<Sub>}},
+      {"mul", {2, Operands::Typed, false, &SelectBinary<Mul>}},
+      {"div", {2, Operands::Typed, false, &SelectBinary<Div>}},
+      {"mod", {2, Operands::Typed, false, &SelectBinary<Mod>}},
+      {"neg", {1, Operands::Typed, false, &SelectUnary<Neg>}},
+      {"mad", {3, Operands::Typed, false, &SelectTernary<Mad>}},
+      {"max", {2, Operands::Typed, false, &SelectBinary<Max>}},
+      {"min", {2, Operands::Typed, false, &SelectBinary<Min>}},
+      {"lt", {2, Operands::Typed, true, &SelectBinary<Lt>}},
+      {"lte", {2, Operands::Typed, true, &SelectBinary<Lte>}},
+      {"gt", {2, Operands::Typed, true, &SelectBinary<Gt>}},
+      {"gte", {2, Operands::Typed, true, &SelectBinary<Gte>}},
+      {"eq", {2, Operands::Typed, true, &SelectBinary<Eq>}},
+      {"neq", {2, Operands::Typed, true, &SelectBinary<Neq>}},
+      {"cmp_lt", {2, Operands::Typed, true, &SelectBinary<Lt>}},
+      {"cmp_le", {2, Operands::Typed, true, &SelectBinary<Lte>}},
+      {"cmp_gt", {2, Operands::Typed, true, &SelectBinary<Gt>}},
+      {"cmp_ge", {2, Operands::Typed, true, &SelectBinary<Gte>}},
+      {"cmp_eq", {2, Operands::Typed, true, &SelectBinary<Eq>}},
+      {"cmp_ne", {2, Operands::Typed, true, &SelectBinary<Neq>}},
+      {"and", {2, Operands::Boolean, true, &SelectBinary<And>}},
+      {"or", {2, Operands::Boolean, true, &SelectBinary<Or>}},
+      {"xor", {2, Operands::Boolean, true, &SelectBinary<Xor>}},
+      {"not", {1, Operands::Boolean, true, &SelectUnary<Not>}},
+      {"bit_and", {2, Operands::Typed, false, &SelectBinary<BitAnd>}},
+      {"bit_or", {2, Operands::Typed, false, &SelectBinary<BitOr>}},
+      {"bit_xor", {2, Operands::Typed, false, &SelectBinary<BitXor>}},
+      {"bit_not", {1, Operands::Typed, false, &SelectUnary<BitNot>}},
+      {"bit_left", {2, Operands::Typed, false, &SelectBinary<BitLeft>}},
+      {"bit_right", {2, Operands::Typed, false, &SelectBinary<BitRight>}},
+      {"cond", {3, Operands::Condition, false, &SelectCond}},
+      {"assign", {1, Operands::Typed, false, nullptr}},
+      {"ident", {1, Operands::Typed, false, nullptr}},
+      {"as_float", {1, Operands::Typed, false, nullptr}},
+      {"as_int", {1, Operands::Typed, false, nullptr}},
+      {"as_uint", {1, Operands::Typed, false, nullptr}},
+      {"sqrt", {1, Operands::Typed, false, &SelectUnary<Sqrt>}},
+      {"exp", {1, Operands::Typed, false, &SelectUnary<Exp>}},
+      {"log", {1, Operands::Typed, false, &SelectUnary<Log>}},
+      {"pow", {2, Operands::Typed, false, &SelectBinary<Pow>}},
+      {"tanh", {1, Operands::Typed, false, &SelectUnary<Tanh>}},
+      {"sinh", {1, Operands::Typed, false, &SelectUnary<Sinh>}},
+      {"cosh", {1, Operands::Typed, false, &SelectUnary<Cosh>}},
+      {"sin", {1, Operands::Typed, false, &SelectUnary<Sin>}},
+      {"cos", {1, Operands::Typed, false, &SelectUnary<Cos>}},
+      {"tan", {1, Operands::Typed, false, &SelectUnary<Tan>}},
+      {"asin", {1, Operands::Typed, false, &SelectUnary<Asin>}},
+      {"acos", {1, Operands::Typed, false, &SelectUnary<Acos>}},
+      {"atan", {1, Operands::Typed, false, &SelectUnary<Atan>}},
+      {"ceil", {1, Operands::Typed, false, &SelectUnary<Ceil>}},
+      {"floor", {1, Operands::Typed, false, &SelectUnary<Floor>}},
+      {"round", {1, Operands::Typed, false, &SelectUnary<Round>}},
+  };
+  return defs;
+}
+
+// Calls f with the coordinates of each element of a shape.
+template <typename F>
+void ForEachElement(const TensorShape& shape, F&& f) {
+  std::vector<int64_t> coords(shape.dims.size());
+  for (const auto& dim : shape.dims) {
+    if (!dim.size) {
+      return;
+    }
+  }
+  for (;;) {
+    f(coords);
+    size_t dim = coords.size();
+    for (; dim; --dim) {
+      if (++coords[dim - 1] < static_cast<int64_t>(shape.dims[dim - 1].size)) {
+        break;
       }
+      coords[dim - 1] = 0;
+    }
+    if (!dim) {
+      return;
     }
-    return true;
   }
+}
+
+// Returns the address of an element of a refinement, checking that it lies within the refinement's allocation.
+char* ElementPtr(Frame* frame, size_t slot, int64_t elem, const char* what, int64_t bytes = 0) {
+  const auto& ref = frame->proc->refs[slot];
+  const auto& view = frame->views[slot];
+  int64_t offset = view.offset + elem * ref.width;
+  if (offset < 0 || offset + std::max(bytes, ref.width) > view.size) {
+    OutOfBounds(what, *frame, slot, offset);
+  }
+  return view.base + offset;
+}
+
+void CopyElement(Frame* frame, size_t dst, int64_t dst_elem, size_t src, int64_t src_elem) {
+  const auto& dst_ref = frame->proc->refs[dst];
+  const auto& src_ref = frame->proc->refs[src];
+  char* to = ElementPtr(frame, dst, dst_elem, "STORE");
+  const char* from = ElementPtr(frame, src, src_elem, "LOAD");
+  if (dst_ref.shape.type == src_ref.shape.type) {
+    std::memcpy(to, from, dst_ref.width);
+  } else {
+    WriteNumber(dst_ref.shape.type, to, ReadNumber(src_ref.shape.type, from));
+  }
+}
+
+int64_t ElementIndex(const TensorShape& shape, const std::vector<int64_t>& coords, size_t first, size_t count) {
+  int64_t elem = 0;
+  for (size_t dim = 0; dim < count; ++dim) {
+    elem += coords[first + dim] * shape.dims[dim].stride;
+  }
+  return elem;
+}
+
+void CheckRank(const SpecialOp& op, const TensorShape& shape, size_t rank) {
+  if (shape.dims.size() != rank) {
+    throw_with_trace(std::runtime_error(str(boost::format("Mismatched tensor ranks in special '%s'") % op.name)));
+  }
+}
 
-  size_t ComputeOffsetFor(const Block& block, const Refinement& ref) {
-    int offset = 0;
-    if (!ref.from.empty()) {
-      offset = safe_at(outer_->offsets_, ref.from);
+void Zero(const SpecialOp& op, Frame* frame) {
+  const auto& out = frame->proc->refs[op.outputs[0]];
+  ForEachElement(out.shape, [&](const std::vector<int64_t>& coords) {
+    char* ptr = ElementPtr(frame, op.outputs[0], ElementIndex(out.shape, coords, 0, coords.size()), "STORE");
+    std::memset(ptr, 0, out.width);
+  });
+}
+
+void Copy(const SpecialOp& op, Frame* frame) {
+  const auto& out = frame->proc->refs[op.outputs[0]];
+  const auto& in = frame->proc->refs[op.inputs[0]];
+  CheckRank(op, in.shape, out.shape.dims.size());
+  ForEachElement(out.shape, [&](const std::vector<int64_t>& coords) {
+    CopyElement(frame, op.outputs[0], ElementIndex(out.shape, coords, 0, coords.size()),  //
+                op.inputs[0], ElementIndex(in.shape, coords, 0, coords.size()));
+  });
+}
+
+void Reshape(const SpecialOp& op, Frame* frame) {
+  const auto& out = frame->proc->refs[op.outputs[0]];
+  int64_t bytes = out.shape.elem_size() * out.width;
+  char* to = ElementPtr(frame, op.outputs[0], 0, "STORE", bytes);
+  const char* from = ElementPtr(frame, op.inputs[0], 0, "LOAD", bytes);
+  std::memmove(to, from, bytes);
+}
+
+void PrngStep(const SpecialOp& op, Frame* frame) {
+  // The same generator as the CPU JIT's runtime: each word of the output is the xor of the three words of state, which
+  // then step as in tile/lang/gen_special.cc.
+  const auto& dest = frame->proc->refs[op.outputs[1]];
+  int64_t count = dest.shape.elem_size() * dest.width / sizeof(uint32_t);
+  if (!count) {
+    return;
+  }
+  uint32_t state[3];
+  std::memcpy(state, ElementPtr(frame, op.inputs[0], 0, "LOAD", sizeof(state)), sizeof(state));
+  char* buf = ElementPtr(frame, op.outputs[1], 0, "STORE", count * sizeof(uint32_t));
+  for (int64_t i = 0; i < count; ++i) {
+    uint32_t value = state[0] ^ state[1] ^ state[2];
+    std::memcpy(buf + i * sizeof(uint32_t), &value, sizeof(value));
+    state[0] = (((state[0] & 4294967294) << 12) ^ (((state[0] << 13) ^ state[0]) >> 19));
+    state[1] = (((state[1] & 4294967288) << 4) ^ (((state[1] << 2) ^ state[1]) >> 25));
+    state[2] = (((state[2] & 4294967280) << 17) ^ (((state[2] << 3) ^ state[2]) >> 11));
+  }
+  std::memcpy(ElementPtr(frame, op.outputs[0], 0, "STORE", sizeof(state)), state, sizeof(state));
+}
+
+void Shape(const SpecialOp& op, Frame* frame) {
+  const auto& out = frame->proc->refs[op.outputs[0]];
+  const auto& in = frame->proc->refs[op.inputs[0]];
+  int64_t stride = out.shape.dims.empty() ? 1 : out.shape.dims[0].stride;
+  for (size_t dim = 0; dim < in.shape.dims.size(); ++dim) {
+    char* ptr = ElementPtr(frame, op.outputs[0], dim * stride, "STORE");
+    WriteNumber(out.shape.type, ptr, in.shape.dims[dim].size);
+  }
+}
+
+int64_t ReadIndex(Frame* frame, size_t slot, int64_t elem, uint64_t size) {
+  const auto& ref = frame->proc->refs[slot];
+  auto value = static_cast<int64_t>(ReadNumber(ref.shape.type, ElementPtr(frame, slot, elem, "LOAD")));
+  return std::min(std::max<int64_t>(value, 0), static_cast<int64_t>(size) - 1);
+}
+
+// out[i..., j...] = data[idx[i...], j...]
+void Gather(const SpecialOp& op, Frame* frame) {
+  const auto& out = frame->proc->refs[op.outputs[0]];
+  const auto& data = frame->proc->refs[op.inputs[0]];
+  const auto& idx = frame->proc->refs[op.inputs[1]];
+  size_t idx_rank = idx.shape.dims.size();
+  if (data.shape.dims.empty()) {
+    CheckRank(op, data.shape, 1);
+  }
+  CheckRank(op, out.shape, idx_rank + data.shape.dims.size() - 1);
+  ForEachElement(out.shape, [&](const std::vector<int64_t>& coords) {
+    int64_t row = ReadIndex(frame, op.inputs[1], ElementIndex(idx.shape, coords, 0, idx_rank), data.shape.dims[0].size);
+    int64_t data_elem = row * data.shape.dims[0].stride;
+    for (size_t dim = 1; dim < data.shape.dims.size(); ++dim) {
+      data_elem += coords[idx_rank + dim - 1] * data.shape.dims[dim].stride;
     }
-    std::stringstream ss;
-    ss << "ref: " << ref.into() << ", offset = " << offset;
-    assert(ref.interior_shape.dims.size() == ref.access.size());
-    for (size_t i = 0; i < ref.interior_shape.dims.size(); i++) {
-      auto access = ref.access[i].eval(idxs_);
-      auto stride = ref.interior_shape.dims[i].stride;
-      offset += access * stride;
-      ss << " + (" << access << " * " << stride << ")";
+    CopyElement(frame, op.outputs[0], ElementIndex(out.shape, coords, 0, coords.size()), op.inputs[0], data_elem);
+  });
+}
+
+// out[idx[i...], j...] += expn[i..., j...]
+void Scatter(const SpecialOp& op, Frame* frame) {
+  const auto& out = frame->proc->refs[op.outputs[0]];
+  const auto& expn = frame->proc->refs[op.inputs[0]];
+  const auto& idx = frame->proc->refs[op.inputs[1]];
+  size_t idx_rank = idx.shape.dims.size();
+  if (out.shape.dims.empty()) {
+    CheckRank(op, out.shape, 1);
+  }
+  CheckRank(op, expn.shape, idx_rank + out.shape.dims.size() - 1);
+  ForEachElement(expn.shape, [&](const std::vector<int64_t>& coords) {
+    int64_t row = ReadIndex(frame, op.inputs[1], ElementIndex(idx.shape, coords, 0, idx_rank), out.shape.dims[0].size);
+    int64_t out_elem = row * out.shape.dims[0].stride;
+    for (size_t dim = 1; dim < out.shape.dims.size(); ++dim) {
+      out_elem += coords[idx_rank + dim - 1] * out.shape.dims[dim].stride;
     }
-    ss << " = " << offset;
-    IVLOG(5, Tab() << ss.str());
-    return offset;
+    char* to = ElementPtr(frame, op.outputs[0], out_elem, "STORE");
+    const char* from = ElementPtr(frame, op.inputs[0], ElementIndex(expn.shape, coords, 0, coords.size()), "LOAD");
+    WriteNumber(out.shape.type, to, ReadNumber(out.shape.type, to) + ReadNumber(expn.shape.type, from));
+  });
+}
+
+struct SpecialDef {
+  size_t inputs;
+  size_t outputs;
+  void (*run)(const SpecialOp& op, Frame* frame);
+};
+
+const std::map<std::string, SpecialDef>& Specials() {
+  static const std::map<std::string, SpecialDef> defs{
+      {"zero", {0, 1, &Zero}},         {"copy", {1, 1, &Copy}},       {"reshape", {1, 1, &Reshape}},
+      {"prng_step", {1, 2, &PrngStep}}, {"shape", {1, 1, &Shape}},     {"gather", {2, 1, &Gather}},
+      {"scatter", {3, 1, &Scatter}},
+  };
+  return defs;
+}
+
+struct Scalar {
+  uint32_t reg;
+  DataType type;  // Always a ValueType
+};
+
+class BlockLowering {
+ public:
+  BlockLowering(const Block& block, const BlockLowering* outer, size_t* next_id)
+      : block_{block}, outer_{outer}, next_id_{next_id}, proc_{std::make_unique<Proc>()} {}
+
+  std::unique_ptr<Proc> Lower() {
+    proc_->id = (*next_id_)++;
+    proc_->name = block_.name;
+    static const std::map<std::string, size_t> no_idxs;
+    for (const auto& idx : block_.idxs) {
+      proc_->idxs.emplace_back(Loop{idx.range, Compile(idx.affine, outer_ ? outer_->idxs_ : no_idxs, 1)});
+      idxs_.emplace(idx.name, idxs_.size());
+    }
+    for (const auto& constraint : block_.constraints) {
+      proc_->constraints.emplace_back(Compile(constraint, idxs_, 1));
+    }
+    for (const auto& ref : block_.refs) {
+      LowerRef(ref);
+    }
+    ComputeCarries();
+    for (const auto& stmt : block_.stmts) {
+      LowerStatement(*stmt);
+    }
+    return std::move(proc_);
   }
 
-  float DoLoad(const std::string& name, size_t offset) {
-    auto it = refs_.find(name);
-    if (it == refs_.end()) {
-      throw_with_trace(std::runtime_error("Unknown buffer"));
+ private:
+  [[noreturn]] void Fail(const std::string& msg) const {
+    throw_with_trace(std::runtime_error(str(boost::format("%s in block '%s'") % msg % block_.name)));
+  }
+
+  Linear Compile(const Affine& affine, const std::map<std::string, size_t>& idxs, int64_t scale) const {
+    Linear linear;
+    for (const auto& kvp : affine.getMap()) {
+      if (kvp.first.empty()) {
+        linear.constant = kvp.second * scale;
+        continue;
+      }
+      auto it = idxs.find(kvp.first);
+      if (it == idxs.end()) {
+        Fail("Unknown index '" + kvp.first + "'");
+      }
+      linear.terms.emplace_back(it->second, kvp.second * scale);
+    }
+    return linear;
+  }
+
+  void LowerRef(const Refinement& ref) {
+    RefSlot slot;
+    slot.name = ref.into();
+    slot.shape = ref.interior_shape;
+    slot.width = ElemBytes(ref.interior_shape.type);
+    slot.agg_op = ref.agg_op;
+    if (!slot.width) {
+      Fail("Unsupported data type " + to_string(ref.interior_shape.type) + " for '" + slot.name + "'");
+    }
+    if (!outer_) {
+      slot.kind = ref.has_tag("user") ? RefSlot::Kind::Bound : RefSlot::Kind::Local;
+    } else if (ref.from.empty()) {
+      slot.kind = RefSlot::Kind::Local;
+    } else {
+      slot.kind = RefSlot::Kind::Refined;
+      auto it = outer_->refs_.find(ref.from);
+      if (it == outer_->refs_.end()) {
+        Fail("Unknown refinement source '" + ref.from + "'");
+      }
+      slot.parent = it->second;
     }
-    if (offset >= it->second->size()) {
-      throw_with_trace(
-          std::runtime_error(str(boost::format("LOAD: Out of bounds access on '%s', offset: %zu, size: %zu") %  //
-                                 name % offset % it->second->size())));
+    if (slot.kind == RefSlot::Kind::Local) {
+      slot.bytes = ref.interior_shape.elem_size() * slot.width;
     }
-    return (*it->second)[offset];
+    slot.access = Compile(ref.FlatAccess(), idxs_, slot.width);
+    refs_.emplace(slot.name, proc_->refs.size());
+    proc_->refs.emplace_back(std::move(slot));
   }
 
-  void DoStore(const std::string& name, size_t offset, float value, const std::string& agg_op) {
+  void ComputeCarries() {
+    // When index k steps, the indices within it reset from the ends of their ranges to their starts.
+    std::vector<const Linear*> linears;
+    for (const auto& ref : proc_->refs) {
+      linears.push_back(&ref.access);
+    }
+    for (const auto& constraint : proc_->constraints) {
+      linears.push_back(&constraint);
+    }
+    for (size_t idx = 0; idx < proc_->idxs.size(); ++idx) {
+      for (const auto* linear : linears) {
+        int64_t carry = linear->coeff(idx);
+        for (size_t inner = idx + 1; inner < proc_->idxs.size(); ++inner) {
+          carry -= linear->coeff(inner) * static_cast<int64_t>(proc_->idxs[inner].range - 1);
+        }
+        proc_->carries.push_back(carry);
+      }
+    }
+  }
+
+  size_t RefSlotOf(const std::string& name) const {
     auto it = refs_.find(name);
     if (it == refs_.end()) {
-      throw_with_trace(std::runtime_error("Unknown buffer"));
+      Fail("Unknown refinement '" + name + "'");
     }
-    if (offset >= it->second->size()) {
-      throw_with_trace(
-          std::runtime_error(str(boost::format("STORE: Out of bounds access on '%s', offset: %zu, size: %zu") %  //
-                                 name % offset % it->second->size())));
+    return it->second;
+  }
+
+  Scalar ScalarOf(const std::string& name) const {
+    auto it = scalars_.find(name);
+    if (it == scalars_.end()) {
+      Fail("Undefined scalar '" + name + "'");
     }
-    if (agg_op == Intrinsic::SUM) {
-      (*it->second)[offset] += value;
-    } else {
-      (*it->second)[offset] = value;
+    return it->second;
+  }
+
+  Scalar Define(const std::string& name, DataType type) {
+    Scalar scalar{proc_->num_regs++, ValueType(type)};
+    scalars_[name] = scalar;
+    return scalar;
+  }
+
+  void Emit(Handler run, uint32_t dst, std::initializer_list<uint32_t> srcs = {}, size_t aux = 0, Reg imm = 0) {
+    Instr in;
+    in.run = run;
+    in.dst = dst;
+    std::copy(srcs.begin(), srcs.end(), in.src);
+    in.aux = aux;
+    in.imm = imm;
+    proc_->code.emplace_back(in);
+  }
+
+  Scalar Convert(Scalar value, DataType type) {
+    type = ValueType(type);
+    if (value.type == type) {
+      return value;
     }
+    Scalar result{proc_->num_regs++, type};
+    Emit(SelectCast(value.type, type), result.reg, {value.reg});
+    return result;
   }
 
-  float DoLoadIndex(const Affine& idx) { return idx.eval(idxs_); }
+  void LowerStatement(const Statement& stmt) {
+    switch (stmt.kind()) {
+      case StmtKind::Load: {
+        const auto& op = static_cast<const Load&>(stmt);
+        size_t slot = RefSlotOf(op.from);
+        DataType type = proc_->refs[slot].shape.type;
+        Emit(SelectLoad(type), Define(op.into, type).reg, {}, slot);
+      } break;
+      case StmtKind::Store: {
+        const auto& op = static_cast<const Store&>(stmt);
+        size_t slot = RefSlotOf(op.into);
+        const auto& ref = proc_->refs[slot];
+        Handler run = SelectStore(ref.shape.type, ref.agg_op);
+        if (!run) {
+          Fail("Unsupported agg_op '" + ref.agg_op + "' for " + to_string(ref.shape.type) + " '" + ref.name + "'");
+        }
+        Emit(run, 0, {Convert(ScalarOf(op.from), ref.shape.type).reg}, slot);
+      } break;
+      case StmtKind::LoadIndex: {
+        const auto& op = static_cast<const LoadIndex&>(stmt);
+        proc_->load_idxs.emplace_back(Compile(op.from, idxs_, 1));
+        Emit(&LoadIndexOp, Define(op.into, DataType::INT64).reg, {}, proc_->load_idxs.size() - 1);
+      } break;
+      case StmtKind::Constant: {
+        const auto& op = static_cast<const Constant&>(stmt);
+        Reg imm = 0;
+        if (op.type == ConstType::Integer) {
+          std::memcpy(&imm, &op.iconst, sizeof(op.iconst));
+          Emit(&ConstantOp, Define(op.name, DataType::INT64).reg, {}, 0, imm);
+        } else {
+          std::memcpy(&imm, &op.fconst, sizeof(op.fconst));
+          Emit(&ConstantOp, Define(op.name, DataType::FLOAT64).reg, {}, 0, imm);
+        }
+      } break;
+      case StmtKind::Intrinsic:
+        LowerIntrinsic(static_cast<const Intrinsic&>(stmt));
+        break;
+      case StmtKind::Special:
+        LowerSpecial(static_cast<const Special&>(stmt));
+        break;
+      case StmtKind::Block: {
+        const auto& inner = static_cast<const Block&>(stmt);
+        proc_->children.emplace_back(BlockLowering{inner, this, next_id_}.Lower());
+        Emit(&BlockOp, 0, {}, proc_->children.size() - 1);
+      } break;
+    }
+  }
 
-  void ExecuteStatements(const Block& block) {
-    if (!CheckConstraints(block)) {
+  void LowerIntrinsic(const Intrinsic& op) {
+    auto it = Intrinsics().find(op.name);
+    if (it == Intrinsics().end()) {
+      Fail("Unknown intrinsic '" + op.name + "'");
+    }
+    const auto& def = it->second;
+    if (op.inputs.size() != def.arity || op.outputs.size() != 1) {
+      Fail("Invalid operands for intrinsic '" + op.name + "'");
+    }
+    std::vector<Scalar> inputs;
+    for (size_t i = 0; i < op.inputs.size(); ++i) {
+      bool boolean = def.operands == Operands::Boolean || (def.operands == Operands::Condition && i == 0);
+      inputs.push_back(Convert(ScalarOf(op.inputs[i]), boolean ? DataType::BOOLEAN : op.type));
+    }
+    if (!def.select) {
+      scalars_[op.outputs[0]] = inputs[0];
       return;
     }
-    std::map<std::string, float> vars;
-    for (const auto& ref : block.refs) {
-      offsets_[ref.into()] = ComputeOffsetFor(block, ref);
-    }
-    IVLOG(5, Tab() << "idxs: " << StreamContainer(idxs_));
-    IVLOG(5, Tab() << "offsets: " << StreamContainer(offsets_));
-    for (const auto& stmt : block.stmts) {
-      switch (stmt->kind()) {
-        case StmtKind::Load: {
-          const auto& op = Load::Downcast(stmt);
-          vars[op->into] = DoLoad(op->from, offsets_[op->from]);
-        } break;
-        case StmtKind::Store: {
-          const auto& op = Store::Downcast(stmt);
-          auto it = block.ref_by_into(op->into, false);
-          if (it == block.refs.end()) {
-            throw_with_trace(std::runtime_error("Missing agg_op"));
-          }
-          DoStore(op->into, offsets_[op->into], vars[op->from], it->agg_op);
-        } break;
-        case StmtKind::LoadIndex: {
-          const auto& op = LoadIndex::Downcast(stmt);
-          vars[op->into] = DoLoadIndex(op->from);
-        } break;
-        case StmtKind::Intrinsic: {
-          const auto& op = Intrinsic::Downcast(stmt);
-          switch (op->inputs.size()) {
-            case 2: {
-              auto it = BINARY_OPS.find(op->name);
-              if (it == BINARY_OPS.end()) {
-                throw_with_trace(std::runtime_error(str(boost::format("Unsupported binary intrinsic: %s") % op->name)));
-              }
-              vars[op->outputs[0]] = it->second(vars[op->inputs[0]], vars[op->inputs[1]]);
-            } break;
-            case 3: {
-              auto it = TERNARY_OPS.find(op->name);
-              if (it == TERNARY_OPS.end()) {
-                throw_with_trace(
-                    std::runtime_error(str(boost::format("Unsupported ternary intrinsic: %s") % op->name)));
-              }
-              vars[op->outputs[0]] = it->second(vars[op->inputs[0]], vars[op->inputs[1]], vars[op->inputs[2]]);
-            } break;
-            default:
-              throw_with_trace(std::runtime_error(
-                  str(boost::format("Unsupported number of operands for intrinsic: %s") % op->name)));
-              break;
-          }
-        } break;
-        case StmtKind::Constant: {
-          const auto& op = Constant::Downcast(stmt);
-          switch (op->type) {
-            case ConstType::Integer:
-              vars[op->name] = op->iconst;
-              break;
-            case ConstType::Float:
-              vars[op->name] = op->fconst;
-              break;
-          }
-        } break;
-        case StmtKind::Block: {
-          Scope scope(this);
-          scope.ExecuteBlock(*Block::Downcast(stmt));
-        } break;
-        default:
-          break;
-      }
+    Handler run = def.select(def.operands == Operands::Boolean ? DataType::BOOLEAN : op.type);
+    if (!run) {
+      Fail("Unsupported type " + to_string(op.type) + " for intrinsic '" + op.name + "'");
+    }
+    Scalar output = Define(op.outputs[0], def.boolean_result ? DataType::BOOLEAN : op.type);
+    Instr in;
+    in.run = run;
+    in.dst = output.reg;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      in.src[i] = inputs[i].reg;
     }
+    proc_->code.emplace_back(in);
   }
 
-  std::string Tab() const { return std::string(depth_ * 2, ' '); }
+  void LowerSpecial(const Special& op) {
+    auto it = Specials().find(op.name);
+    if (it == Specials().end()) {
+      Fail("Unknown special '" + op.name + "'");
+    }
+    const auto& def = it->second;
+    if (op.inputs.size() != def.inputs || op.outputs.size() != def.outputs) {
+      Fail("Invalid operands for special '" + op.name + "'");
+    }
+    SpecialOp special;
+    special.run = def.run;
+    special.name = op.name;
+    for (const auto& name : op.inputs) {
+      special.inputs.push_back(RefSlotOf(name));
+    }
+    for (const auto& name : op.outputs) {
+      special.outputs.push_back(RefSlotOf(name));
+    }
+    proc_->specials.emplace_back(std::move(special));
+    Emit(&SpecialOpHandler, 0, {}, proc_->specials.size() - 1);
+  }
 
- private:
-  Scope* outer_ = nullptr;
-  size_t depth_ = 0;
-  std::map<std::string, int64_t> idxs_;
-  std::map<std::string, Buffer*> refs_;
-  std::map<std::string, size_t> offsets_;
+  const Block& block_;
+  const BlockLowering* outer_;
+  size_t* next_id_;
+  std::unique_ptr<Proc> proc_;
+  std::map<std::string, size_t> idxs_;
+  std::map<std::string, size_t> refs_;
+  std::map<std::string, Scalar> scalars_;
 };
 
+// Returns the names of the program's refinements which the program reads.
+std::set<std::string> ProgramInputs(const Block& program) {
+  std::set<std::string> inputs;
+  for (const auto& stmt : program.stmts) {
+    for (const auto& name : stmt->buffer_reads()) {
+      inputs.insert(name);
+    }
+  }
+  return inputs;
+}
+
+double Tolerance(DataType type) {
+  switch (type) {
+    case DataType::FLOAT16:
+      return 1e-2;
+    case DataType::FLOAT32:
+      return 1e-4;
+    default:
+      return 1e-9;
+  }
+}
+
 }  // namespace
 
+struct VmProgram::Impl {
+  std::unique_ptr<Proc> root;
+  size_t num_procs = 0;
+};
+
+VmProgram::VmProgram(const Block& program) : impl_{std::make_unique<Impl>()} {
+  impl_->root = BlockLowering{program, nullptr, &impl_->num_procs}.Lower();
+}
+
+VmProgram::~VmProgram() = default;
+
+void VmProgram::Run(std::map<std::string, std::vector<char>>* buffers) const {
+  const Proc& root = *impl_->root;
+  Machine machine{root, impl_->num_procs};
+  Frame& frame = machine.frames[root.id];
+  for (size_t slot = 0; slot < root.refs.size(); ++slot) {
+    if (root.refs[slot].kind == RefSlot::Kind::Bound) {
+      auto& buffer = safe_at(buffers, root.refs[slot].name);
+      frame.views[slot].base = buffer.data();
+      frame.views[slot].size = buffer.size();
+    }
+  }
+  RunBlock(root, nullptr, &machine);
+}
+
+void VmProgram::Run(std::map<std::string, Buffer>* buffers) const {
+  std::map<std::string, std::vector<char>> raw;
+  for (const auto& ref : impl_->root->refs) {
+    if (ref.kind == RefSlot::Kind::Bound) {
+      const auto& buffer = safe_at(buffers, ref.name);
+      auto& bytes = raw[ref.name];
+      bytes.resize(buffer.size() * ref.width);
+      for (size_t i = 0; i < buffer.size(); ++i) {
+        WriteNumber(ref.shape.type, &bytes[i * ref.width], buffer[i]);
+      }
+    }
+  }
+  Run(&raw);
+  for (const auto& ref : impl_->root->refs) {
+    if (ref.kind == RefSlot::Kind::Bound) {
+      auto& buffer = safe_at(buffers, ref.name);
+      const auto& bytes = raw[ref.name];
+      for (size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = ReadNumber(ref.shape.type, &bytes[i * ref.width]);
+      }
+    }
+  }
+}
+
 void ExecuteProgram(const Block& program, std::map<std::string, Buffer>* buffers) {
-  Scope scope;
-  scope.ExecuteProgram(program, buffers);
+  VmProgram(program).Run(buffers);
+}
+
+std::vector<std::string> VmIntrinsics() {
+  std::vector<std::string> names;
+  for (const auto& kvp : Intrinsics()) {
+    names.push_back(kvp.first);
+  }
+  return names;
+}
+
+ProgramChecker::ProgramChecker(const Block& program) {
+  auto inputs = ProgramInputs(program);
+  std::mt19937 rng;
+  for (const auto& ref : program.refs) {
+    if (!ref.has_tag("user")) {
+      continue;
+    }
+    DataType type = ref.interior_shape.type;
+    int64_t width = ElemBytes(type);
+    types_[ref.into()] = type;
+    auto& bytes = inputs_[ref.into()];
+    bytes.resize(ref.interior_shape.elem_size() * width);
+    if (!inputs.count(ref.into())) {
+      continue;
+    }
+    for (size_t offset = 0; offset < bytes.size(); offset += width) {
+      double value;
+      if (is_float(type)) {
+        value = static_cast<double>(rng() >> 8) / (1 << 23) - 1;
+      } else if (type == DataType::BOOLEAN) {
+        value = rng() & 1;
+      } else if (type == DataType::PRNG) {
+        value = rng();
+      } else if (is_uint(type)) {
+        value = rng() % 9;
+      } else {
+        value = static_cast<int>(rng() % 9) - 4;
+      }
+      WriteNumber(type, &bytes[offset], value);
+    }
+  }
+  expected_ = inputs_;
+  VmProgram(program).Run(&expected_);
+}
+
+void ProgramChecker::Check(const Block& program, const std::string& what) const {
+  auto actual = inputs_;
+  for (const auto& ref : program.refs) {
+    if (ref.has_tag("user") && !actual.count(ref.into())) {
+      actual[ref.into()].resize(ref.interior_shape.elem_size() * ElemBytes(ref.interior_shape.type));
+    }
+  }
+  VmProgram(program).Run(&actual);
+  for (const auto& kvp : expected_) {
+    DataType type = types_.at(kvp.first);
+    int64_t width = ElemBytes(type);
+    const auto& expected = kvp.second;
+    const auto& result = actual.at(kvp.first);
+    for (size_t offset = 0; offset < expected.size(); offset += width) {
+      double want = ReadNumber(type, &expected[offset]);
+      double got = ReadNumber(type, &result[offset]);
+      bool same;
+      if (is_float(type)) {
+        same = want == got || (std::isnan(want) && std::isnan(got)) ||
+               std::abs(want - got) <= Tolerance(type) * std::max(1.0, std::abs(want));
+      } else {
+        same = !std::memcmp(&expected[offset], &result[offset], width);
+      }
+      if (!same) {
+        throw_with_trace(std::runtime_error(
+            str(boost::format("%s changed the results of the program: element %zu of '%s' was %s, and is now %s") %
+                what % (offset / width) % kvp.first % want % got)));
+      }
+    }
+  }
 }
 
 }  // namespace codegen
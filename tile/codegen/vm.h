@@ -3,6 +3,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -14,8 +15,61 @@ namespace codegen {
 
 using Buffer = std::vector<float>;
 
+// VmProgram is a Stripe program lowered for the reference executor.
+//
+// Lowering resolves everything the program names -- indices, refinements, scalars, intrinsics -- to slots in flat
+// per-block tables, and compiles each block's statements to a sequence of typed instructions.  Refinement accesses
+// are precomputed as byte strides, which the block loops step incrementally, so running the program never looks
+// anything up by name.
+//
+// Every DataType may be loaded and stored: FLOAT16 values are computed in single precision and rounded when
+// stored, INT128 values are computed in 64 bits, and PRNG state is treated as 32-bit words.  Intrinsics follow the
+// CPU JIT's typing rules: inputs are converted to the intrinsic's type, comparisons and logical operations produce
+// booleans, and stores convert to the type of the refinement, combining with its previous contents according to its
+// agg_op.  Out of bounds accesses and integer division by zero throw.
+//
+// The program's refinements tagged "user" are bound to the caller's buffers by name; all other refinements with no
+// source are allocated and zeroed whenever their block is entered.
+class VmProgram {
+ public:
+  explicit VmProgram(const stripe::Block& program);
+  ~VmProgram();
+
+  // Runs the program over buffers holding elements of each refinement's type.
+  void Run(std::map<std::string, std::vector<char>>* buffers) const;
+
+  // Runs the program over float buffers, converting them to and from the type of each refinement.
+  void Run(std::map<std::string, Buffer>* buffers) const;
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
 void ExecuteProgram(const stripe::Block& program, std::map<std::string, Buffer>* buffers);
 
+// Returns the names of the intrinsics VmProgram supports.
+std::vector<std::string> VmIntrinsics();
+
+// ProgramChecker checks rewrites of a program against the program itself.
+//
+// On construction, the checker fills the buffers the program reads with deterministic pseudo-random data, and runs
+// the program to produce the reference results.  Checking a rewritten program runs it over the same inputs and
+// throws if any buffer it shares with the original ends up different: floating point results must agree to within
+// a tolerance suited to their precision, and everything else must match exactly.
+class ProgramChecker {
+ public:
+  explicit ProgramChecker(const stripe::Block& program);
+
+  // Checks the program; 'what' names the rewrite in the error.
+  void Check(const stripe::Block& program, const std::string& what) const;
+
+ private:
+  std::map<std::string, DataType> types_;
+  std::map<std::string, std::vector<char>> inputs_;
+  std::map<std::string, std::vector<char>> expected_;
+};
+
 }  // namespace codegen
 }  // namespace tile
 }  // namespace vertexai
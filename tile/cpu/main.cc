@@ -40,6 +40,7 @@ int main(int argc, char* argv[]) {
   codegen::OptimizeOptions options;
   options.dump_passes = true;
   options.dbg_dir = "/tmp/stripe_cpu/passes";
+  options.verify_passes = codegen::VerifyPassesRequested();
   codegen::Optimize(&state, stage.passes(), options);
 
   std::cout << "============================================================\n" << *program->entry << std::endl;
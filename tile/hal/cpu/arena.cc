@@ -2,21 +2,193 @@
 
 #include "tile/hal/cpu/arena.h"
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "base/util/env.h"
 #include "base/util/error.h"
+#include "base/util/logging.h"
 #include "tile/hal/cpu/buffer.h"
+#include "tile/hal/cpu/scheduler.h"
+#include "tile/hal/cpu/topology.h"
 
 namespace vertexai {
 namespace tile {
 namespace hal {
 namespace cpu {
+namespace {
+
+#ifdef __linux__
+
+// Arenas at least this large are mapped; smaller ones come from the heap,
+// where zeroing them costs less than a system call.
+const std::uint64_t mapping_threshold_ = 1 << 16;
+
+// The size of a transparent huge page.
+const std::size_t huge_page_size_ = 2 << 20;
+
+bool UseHugePages() {
+  static const bool huge = !env::Get("PLAIDML_CPU_HUGE_PAGES").empty();
+  return huge;
+}
+
+const int mpol_interleave_ = 3;  // From <numaif.h>, which requires libnuma
+
+void Interleave(void* addr, std::size_t len) {
+  const Topology& host = HostTopology();
+  if (host.nodes.size() < 2) {
+    return;
+  }
+  const std::size_t bits = sizeof(unsigned long) * CHAR_BIT;  // NOLINT(runtime/int)
+  std::vector<unsigned long> mask;                             // NOLINT(runtime/int)
+  for (auto node : host.nodes) {
+    mask.resize(std::max(mask.size(), node / bits + 1));
+    mask[node / bits] |= 1UL << (node % bits);
+  }
+  if (syscall(SYS_mbind, addr, len, mpol_interleave_, mask.data(), mask.size() * bits + 1, 0)) {
+    // The kernel may lack NUMA support; the pages are simply placed by first
+    // touch instead.
+    IVLOG(1, "Unable to interleave CPU arena across NUMA nodes: " << std::strerror(errno));
+  }
+}
+
+#endif
+
+}  // namespace
+
+Placement ParsePlacement(const std::string& name) {
+  if (name.empty() || name == "first_touch") {
+    return Placement::FIRST_TOUCH;
+  }
+  if (name == "interleave") {
+    return Placement::INTERLEAVE;
+  }
+  if (name == "workers") {
+    return Placement::WORKERS;
+  }
+  throw error::InvalidArgument{"Unknown CPU memory placement policy: " + name};
+}
+
+Arena::Arena(std::uint64_t size, Placement placement, Scheduler* scheduler) : size_{size} {
+#ifdef __linux__
+  if (mapping_threshold_ <= size) {
+    Map(placement, scheduler);
+    return;
+  }
+#endif
+  heap_.reset(new char[size ? size : 1]());
+  base_ = heap_.get();
+}
+
+Arena::Arena(const std::string& path, std::uint64_t offset, std::uint64_t size) : size_{size} {
+#ifdef __linux__
+  if (mapping_threshold_ <= size) {
+    MapFile(path, offset);
+    return;
+  }
+#endif
+  heap_.reset(new char[size ? size : 1]());
+  base_ = heap_.get();
+  std::ifstream file{path, std::ios::binary};
+  file.seekg(offset);
+  if (!file.read(base_, size)) {
+    throw error::NotFound{"Unable to read " + std::to_string(size) + " bytes from " + path};
+  }
+}
 
-Arena::Arena(std::uint64_t size) { mem_.resize(size, '\0'); }
+Arena::~Arena() {
+#ifdef __linux__
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+  }
+#endif
+}
+
+void Arena::Map(Placement placement, Scheduler* scheduler) {
+#ifdef __linux__
+  // Anonymous mappings read as zero until written, and each page is only
+  // allocated when first touched, so neither allocation nor zeroing touches
+  // the memory here.
+  std::size_t page_size = sysconf(_SC_PAGESIZE);
+  std::size_t align = UseHugePages() ? huge_page_size_ : page_size;
+  std::size_t length = (size_ + page_size - 1) / page_size * page_size;
+  // Huge pages must be naturally aligned, so over-allocate, then use an
+  // aligned window of the mapping.
+  mapping_size_ = length + align - page_size;
+  mapping_ = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    throw error::ResourceExhausted{"Unable to map " + std::to_string(size_) + " bytes of CPU memory"};
+  }
+  auto addr = reinterpret_cast<std::uintptr_t>(mapping_);
+  base_ = reinterpret_cast<char*>((addr + align - 1) / align * align);
+  if (UseHugePages() && madvise(base_, length, MADV_HUGEPAGE)) {
+    IVLOG(1, "Unable to use huge pages for CPU arena: " << std::strerror(errno));
+  }
+  switch (placement) {
+    case Placement::FIRST_TOUCH:
+      break;
+    case Placement::INTERLEAVE:
+      Interleave(base_, length);
+      break;
+    case Placement::WORKERS:
+      if (scheduler) {
+        // Fault the pages in from the workers, which take contiguous stretches
+        // of them just as they take contiguous stretches of a kernel's grid.
+        char* base = base_;
+        scheduler->ParallelFor(length / page_size, [base, page_size](std::size_t begin, std::size_t end) {
+          for (std::size_t page = begin; page < end; ++page) {
+            base[page * page_size] = 0;
+          }
+        });
+      }
+      break;
+  }
+#endif
+}
+
+void Arena::MapFile(const std::string& path, std::uint64_t offset) {
+#ifdef __linux__
+  // Mappings must start on a page boundary, so map from the page holding the
+  // start of the range.  The mapping is private and writable: pages that are
+  // only read are shared with the page cache (and so with every other process
+  // mapping the file), and pages that are written are copied.
+  std::size_t page_size = sysconf(_SC_PAGESIZE);
+  std::uint64_t skip = offset % page_size;
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw error::NotFound{"Unable to open " + path + ": " + std::strerror(errno)};
+  }
+  mapping_size_ = skip + size_;
+  mapping_ = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset - skip);
+  int err = errno;
+  close(fd);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    throw error::ResourceExhausted{"Unable to map " + std::to_string(size_) + " bytes of " + path + ": " +
+                                   std::strerror(err)};
+  }
+  base_ = static_cast<char*>(mapping_) + skip;
+#endif
+}
 
 std::shared_ptr<hal::Buffer> Arena::MakeBuffer(std::uint64_t offset, std::uint64_t size) {
-  if (mem_.size() < offset || mem_.size() < size || mem_.size() < (offset + size)) {
+  if (size_ < offset || size_ < size || size_ < (offset + size)) {
     throw error::OutOfRange{"Requesting memory outside arena bounds"};
   }
-  return std::make_shared<Buffer>(shared_from_this(), mem_.data() + offset, size);
+  return std::make_shared<Buffer>(shared_from_this(), base_ + offset, size);
 }
 
 }  // namespace cpu
@@ -2,8 +2,9 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
-#include <vector>
+#include <string>
 
 #include "tile/base/hal.h"
 
@@ -12,14 +13,58 @@ namespace tile {
 namespace hal {
 namespace cpu {
 
+class Scheduler;
+
+// Where the pages of an arena's memory are placed on a multi-node host.
+enum class Placement {
+  FIRST_TOUCH,  // On the node of the thread which first touches each page
+  INTERLEAVE,   // Round-robin across all of the nodes
+  WORKERS,      // Touched up front by the scheduler's workers
+};
+
+// Parses a placement policy name ("first_touch", "interleave", or "workers");
+// the empty string selects FIRST_TOUCH.
+Placement ParsePlacement(const std::string& name);
+
+// Arena owns a block of zero-initialized host memory.
+//
+// Large arenas are anonymous page-aligned mappings, populated lazily: no page
+// is written until something first touches it, so allocating costs nothing
+// up front, and under FIRST_TOUCH each page lands on the node of the kernel
+// worker that first writes it rather than on the node of the allocating
+// thread. Small arenas come from the heap.
+//
+// An arena may instead hold a range of a file, mapped privately: its pages are
+// read from the file (or shared from the page cache) as they're first touched,
+// and writes to them are never written back.
 class Arena : public hal::Arena, public std::enable_shared_from_this<Arena> {
  public:
-  explicit Arena(std::uint64_t size);
+  // Constructs an arena. The scheduler is only used for WORKERS placement; if
+  // it is null, WORKERS behaves like FIRST_TOUCH.
+  explicit Arena(std::uint64_t size, Placement placement = Placement::FIRST_TOUCH, Scheduler* scheduler = nullptr);
+
+  // Constructs an arena holding a range of a file. Small ranges (and all
+  // ranges, on hosts without mappings) are read into the heap instead.
+  Arena(const std::string& path, std::uint64_t offset, std::uint64_t size);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
 
   std::shared_ptr<hal::Buffer> MakeBuffer(std::uint64_t offset, std::uint64_t size) final;
 
+  char* base() const { return base_; }
+  std::uint64_t size() const { return size_; }
+
  private:
-  std::vector<char> mem_;
+  void Map(Placement placement, Scheduler* scheduler);
+  void MapFile(const std::string& path, std::uint64_t offset);
+
+  const std::uint64_t size_;
+  char* base_ = nullptr;
+  std::unique_ptr<char[]> heap_;
+  void* mapping_ = nullptr;
+  std::size_t mapping_size_ = 0;
 };
 
 }  // namespace cpu
@@ -6,6 +6,7 @@
 #include <utility>
 
 #include "base/util/error.h"
+#include "base/util/executor.h"
 #include "tile/hal/cpu/event.h"
 
 namespace vertexai {
@@ -37,7 +38,7 @@ boost::future<void*> Buffer::Sync(const std::vector<std::shared_ptr<hal::Event>>
     futures.emplace_back(ev->GetFuture());
   }
   auto alldeps = boost::when_all(futures.begin(), futures.end());
-  return alldeps.then([base = base_](decltype(alldeps) f) {
+  return alldeps.then(RuntimeExecutor(), [base = base_](decltype(alldeps) f) {
     f.get();
     return base;
   });
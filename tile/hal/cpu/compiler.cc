@@ -3,8 +3,12 @@
 #include "tile/hal/cpu/compiler.h"
 
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 
+#include <algorithm>
+#include <cctype>
 #include <exception>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <sstream>
@@ -12,11 +16,15 @@
 #include <utility>
 #include <vector>
 
+#include "base/util/env.h"
+#include "base/util/error.h"
+#include "base/util/executor.h"
 #include "base/util/logging.h"
 #include "tile/hal/cpu/emitllvm.h"
 #include "tile/hal/cpu/executable.h"
 #include "tile/hal/cpu/library.h"
 #include "tile/hal/cpu/runtime.h"
+#include "tile/hal/cpu/target.h"
 #include "tile/lang/semprinter.h"
 
 namespace vertexai {
@@ -24,35 +32,130 @@ namespace tile {
 namespace hal {
 namespace cpu {
 
-Compiler::Compiler() {}
+namespace {
 
-boost::future<std::unique_ptr<hal::Library>> Compiler::Build(const context::Context& ctx,
-                                                             const std::vector<lang::KernelInfo>& kernel_info,
-                                                             const hal::proto::HardwareSettings&) {
+// Captures the object code MCJIT emits for a kernel, so that the library can
+// be serialized and later reloaded without repeating code generation.
+class ObjectRecorder : public llvm::ObjectCache {
+ public:
+  void notifyObjectCompiled(const llvm::Module*, llvm::MemoryBufferRef obj) override {
+    object_ = obj.getBuffer().str();
+  }
+  std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module*) override { return nullptr; }
+  const std::string& object() const { return object_; }
+
+ private:
+  std::string object_;
+};
+
+// Generates code for a kernel's module on the indicated target, returning the
+// finalized engine and recording its object code.
+llvm::ExecutionEngine* CreateEngine(const lang::KernelInfo& ki, std::unique_ptr<llvm::Module> module,
+                                    const Target& target, std::string* object) {
+  std::string errStr;
+  std::unique_ptr<llvm::LegacyJITSymbolResolver> rez(new Runtime);
+  llvm::ExecutionEngine* ee = llvm::EngineBuilder(std::move(module))
+                                  .setErrorStr(&errStr)
+                                  .setEngineKind(llvm::EngineKind::JIT)
+                                  .setMCPU(target.cpu)
+                                  .setMAttrs(target.features)
+                                  .setVerifyModules(true)
+                                  .setSymbolResolver(std::move(rez))
+                                  .create();
+  if (!ee) {
+    throw error::Internal{"Failed to create ExecutionEngine for " + ki.kname + ": " + errStr};
+  }
+  ObjectRecorder recorder;
+  ee->setObjectCache(&recorder);
+  ee->finalizeObject();
+  ee->setObjectCache(nullptr);
+  *object = recorder.object();
+  return ee;
+}
+
+// Returns the number of threads kernels are compiled on: PLAIDML_CPU_COMPILE_THREADS, or zero (one per hardware thread)
+// if it's unset or malformed.
+std::size_t CompileThreads() {
+  auto threads = env::Get("PLAIDML_CPU_COMPILE_THREADS");
+  if (threads.empty()) {
+    return 0;
+  }
+  if (4 < threads.size() || !std::all_of(threads.begin(), threads.end(), [](char c) { return std::isdigit(c); })) {
+    LOG(WARNING) << "Ignoring malformed PLAIDML_CPU_COMPILE_THREADS: " << threads;
+    return 0;
+  }
+  return std::stoul(threads);
+}
+
+// Returns the executor on which kernels are compiled. It is separate from the
+// runtime executor so that compilation never ties up the threads running
+// programs, and bounded so that concurrent builds share it.
+boost::executors::executor& CompileExecutor() {
+  static auto executor = MakeThreadPoolExecutor(CompileThreads());
+  return *executor;
+}
+
+// A kernel compiled in its own context.
+struct KernelBuild {
+  std::shared_ptr<llvm::LLVMContext> context;
+  std::shared_ptr<llvm::ExecutionEngine> engine;
+  std::vector<KernelObject> objects;
+};
+
+}  // namespace
+
+void InitializeLLVM() {
   static std::once_flag init_once;
-  static std::shared_ptr<llvm::LLVMContext> llvm_ctx;
   std::call_once(init_once, []() {
     LLVMInitializeNativeTarget();
     LLVMLinkInMCJIT();
     LLVMInitializeNativeAsmPrinter();
     LLVMInitializeNativeAsmParser();
-    llvm_ctx = std::make_shared<llvm::LLVMContext>();
   });
+}
+
+Compiler::Compiler() {}
+
+boost::future<std::unique_ptr<hal::Library>> Compiler::Build(const context::Context& ctx,
+                                                             const std::vector<lang::KernelInfo>& kernel_info,
+                                                             const hal::proto::HardwareSettings&) {
+  InitializeLLVM();
 
   if (!kernel_info.size()) {
-    return boost::make_ready_future(std::unique_ptr<hal::Library>{
-        std::make_unique<cpu::Library>(llvm_ctx, std::vector<std::shared_ptr<llvm::ExecutionEngine>>{}, kernel_info)});
+    return boost::make_ready_future(std::unique_ptr<hal::Library>{std::make_unique<cpu::Library>(
+        std::vector<std::shared_ptr<llvm::LLVMContext>>{}, std::vector<std::shared_ptr<llvm::ExecutionEngine>>{},
+        std::map<std::string, std::vector<KernelObject>>{}, kernel_info)});
   }
-  std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines;
-  for (const auto& ki : kernel_info) {
-    BuildKernel(ki, llvm_ctx.get(), &engines);
+  // Each kernel is compiled as a separate task in its own context:
+  // LLVMContexts are not thread-safe, and nothing in one kernel's module
+  // refers to another's.
+  auto kernels = std::make_shared<std::vector<lang::KernelInfo>>(kernel_info);
+  std::vector<boost::future<KernelBuild>> builds;
+  for (std::size_t idx = 0; idx < kernels->size(); ++idx) {
+    builds.emplace_back(boost::async(CompileExecutor(), [kernels, idx]() {
+      KernelBuild build;
+      build.context = std::make_shared<llvm::LLVMContext>();
+      build.engine = BuildKernel((*kernels)[idx], build.context.get(), &build.objects);
+      return build;
+    }));
   }
-  std::unique_ptr<hal::Library> lib(new cpu::Library(llvm_ctx, engines, kernel_info));
-  return boost::make_ready_future<>(std::move(lib));
+  auto all = boost::when_all(builds.begin(), builds.end());
+  return all.then(RuntimeExecutor(), [kernels](decltype(all) fut) -> std::unique_ptr<hal::Library> {
+    std::vector<std::shared_ptr<llvm::LLVMContext>> contexts;
+    std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines;
+    std::map<std::string, std::vector<KernelObject>> objects;
+    auto builds = fut.get();
+    for (std::size_t idx = 0; idx < builds.size(); ++idx) {
+      auto build = builds[idx].get();
+      contexts.emplace_back(std::move(build.context));
+      engines.emplace_back(std::move(build.engine));
+      objects[(*kernels)[idx].kname] = std::move(build.objects);
+    }
+    return std::make_unique<cpu::Library>(contexts, engines, std::move(objects), *kernels);
+  });
 }
 
-void Compiler::BuildKernel(const lang::KernelInfo& ki, llvm::LLVMContext* context,
-                           std::vector<std::shared_ptr<llvm::ExecutionEngine>>* engines) {
+std::unique_ptr<llvm::Module> Compiler::EmitKernel(const lang::KernelInfo& ki, llvm::LLVMContext* context) {
   if (VLOG_IS_ON(4)) {
     sem::Print debug_emit(*ki.kfunc);
     VLOG(4) << "Compiling kernel:\n" << debug_emit.str();
@@ -69,21 +172,27 @@ void Compiler::BuildKernel(const lang::KernelInfo& ki, llvm::LLVMContext* contex
   if (VLOG_IS_ON(4)) {
     VLOG(4) << "Generated IR:\n" << emit.str();
   }
-  // Compile the IR into executable code.
-  std::string errStr;
-  std::unique_ptr<llvm::LegacyJITSymbolResolver> rez(new Runtime);
-  llvm::ExecutionEngine* ee = llvm::EngineBuilder(std::move(emit.result()))
-                                  .setErrorStr(&errStr)
-                                  .setEngineKind(llvm::EngineKind::JIT)
-                                  .setVerifyModules(true)
-                                  .setSymbolResolver(std::move(rez))
-                                  .create();
-  if (ee) {
-    ee->finalizeObject();
-    engines->emplace_back(ee);
-  } else {
-    std::cerr << "Failed to create ExecutionEngine: " << errStr << std::endl;
-  }
+  return std::move(emit.result());
+}
+
+std::shared_ptr<llvm::ExecutionEngine> Compiler::BuildKernel(const lang::KernelInfo& ki, llvm::LLVMContext* context,
+                                                             std::vector<KernelObject>* objects) {
+  // Compile the IR into executable code for the host; code for any other
+  // targets is only needed if the library is serialized, and is generated
+  // then.
+  KernelObject host{HostTarget(), ""};
+  std::shared_ptr<llvm::ExecutionEngine> engine{CreateEngine(ki, EmitKernel(ki, context), host.target, &host.object)};
+  objects->emplace_back(std::move(host));
+  return engine;
+}
+
+std::string Compiler::BuildObject(const lang::KernelInfo& ki, const Target& target) {
+  InitializeLLVM();
+  llvm::LLVMContext context;
+  std::string object;
+  // The engine is only needed to produce the object code, and is discarded.
+  std::unique_ptr<llvm::ExecutionEngine> discard{CreateEngine(ki, EmitKernel(ki, &context), target, &object)};
+  return object;
 }
 
 void Compiler::GenerateInvoker(const lang::KernelInfo& ki, llvm::Module* module) {
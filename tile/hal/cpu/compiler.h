@@ -3,9 +3,11 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "tile/base/hal.h"
+#include "tile/hal/cpu/library.h"
 
 namespace llvm {
 class ExecutionEngine;
@@ -18,6 +20,13 @@ namespace tile {
 namespace hal {
 namespace cpu {
 
+// Initializes LLVM's native target; safe to call repeatedly and concurrently.
+void InitializeLLVM();
+
+// Compiler builds each kernel in its own LLVMContext, so kernels (and the
+// builds of different programs) compile concurrently on a shared pool of
+// compile threads; its size is PLAIDML_CPU_COMPILE_THREADS, defaulting to the
+// hardware concurrency. Code is generated for the host CPU and its features.
 class Compiler final : public hal::Compiler {
  public:
   Compiler();
@@ -26,10 +35,15 @@ class Compiler final : public hal::Compiler {
                                                      const std::vector<lang::KernelInfo>& kernels,
                                                      const hal::proto::HardwareSettings& /* settings */) final;
 
+  // Generates a kernel's object code for a target, e.g. one of the portable
+  // targets described by CodegenTargets(), which need not be the host.
+  static std::string BuildObject(const lang::KernelInfo& ki, const Target& target);
+
  private:
-  void BuildKernel(const lang::KernelInfo&, llvm::LLVMContext* llvm_ctx,
-                   std::vector<std::shared_ptr<llvm::ExecutionEngine>>* engines);
-  void GenerateInvoker(const lang::KernelInfo&, llvm::Module*);
+  static std::unique_ptr<llvm::Module> EmitKernel(const lang::KernelInfo& ki, llvm::LLVMContext* llvm_ctx);
+  static std::shared_ptr<llvm::ExecutionEngine> BuildKernel(const lang::KernelInfo&, llvm::LLVMContext* llvm_ctx,
+                                                            std::vector<KernelObject>* objects);
+  static void GenerateInvoker(const lang::KernelInfo&, llvm::Module*);
 };
 
 }  // namespace cpu
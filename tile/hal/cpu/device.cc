@@ -2,17 +2,25 @@
 
 #include "tile/hal/cpu/device.h"
 
+#include <string>
 #include <utility>
 
 #include "tile/hal/cpu/compiler.h"
 #include "tile/hal/cpu/executor.h"
+#include "tile/hal/cpu/loader.h"
 
 namespace vertexai {
 namespace tile {
 namespace hal {
 namespace cpu {
 
-Device::Device() : compiler_{new Compiler}, executor_{new Executor} {}
+Device::Device() : compiler_{new Compiler}, loader_{new Loader}, executor_{new Executor}, description_{"CPU (LLVM)"} {}
+
+Device::Device(std::size_t node, const std::vector<std::size_t>& cpus)
+    : compiler_{new Compiler},
+      loader_{new Loader},
+      executor_{new Executor(cpus)},
+      description_{"CPU (LLVM), node " + std::to_string(node)} {}
 
 }  // namespace cpu
 }  // namespace hal
@@ -20,11 +20,14 @@ class Device final : public hal::Device {
  public:
   Device();
 
+  // Creates a device running on the indicated CPUs of a single memory node.
+  Device(std::size_t node, const std::vector<std::size_t>& cpus);
+
   void Initialize(const hal::proto::HardwareSettings& settings) final {
     // NOP
   }
 
-  std::string description() final { return "CPU (LLVM)"; }
+  std::string description() final { return description_; }
 
   hal::Compiler* compiler() final { return compiler_.get(); }
 
@@ -39,6 +42,7 @@ class Device final : public hal::Device {
   const std::unique_ptr<hal::Loader> loader_;
   const std::unordered_map<std::string, std::unique_ptr<hal::Loader>> il_loader_map_;
   const std::unique_ptr<hal::Executor> executor_;
+  const std::string description_;
 };
 
 }  // namespace cpu
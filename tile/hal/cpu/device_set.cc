@@ -2,11 +2,14 @@
 
 #include "tile/hal/cpu/device_set.h"
 
+#include <map>
 #include <utility>
 
+#include "base/util/env.h"
 #include "base/util/error.h"
 #include "tile/hal/cpu/device.h"
 #include "tile/hal/cpu/memory.h"
+#include "tile/hal/cpu/topology.h"
 #include "tile/hal/util/selector.h"
 
 namespace vertexai {
@@ -14,7 +17,24 @@ namespace tile {
 namespace hal {
 namespace cpu {
 
-DeviceSet::DeviceSet() : host_memory_{new Memory} { devices_.emplace_back(new Device); }
+DeviceSet::DeviceSet() : host_memory_{new Memory} {
+  // With PLAIDML_CPU_NODE_DEVICES set, each memory node of a multi-socket
+  // host becomes a separate device, so that programs can be sharded across
+  // the nodes with each shard's memory and threads kept node-local.
+  const Topology& host = HostTopology();
+  if (!env::Get("PLAIDML_CPU_NODE_DEVICES").empty() && 1 < host.nodes.size() &&
+      !host.core_nodes.empty() && host.core_nodes.size() == host.core_cpus.size()) {
+    std::map<std::size_t, std::vector<std::size_t>> node_cpus;
+    for (std::size_t core = 0; core < host.core_cpus.size(); ++core) {
+      node_cpus[host.core_nodes[core]].push_back(host.core_cpus[core]);
+    }
+    for (const auto& node : node_cpus) {
+      devices_.emplace_back(new Device(node.first, node.second));
+    }
+    return;
+  }
+  devices_.emplace_back(new Device);
+}
 
 const std::vector<std::shared_ptr<hal::Device>>& DeviceSet::devices() { return devices_; }
 
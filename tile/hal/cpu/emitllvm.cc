@@ -2,6 +2,8 @@
 
 #include "tile/hal/cpu/emitllvm.h"
 
+#include <boost/optional.hpp>
+
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include <llvm/Transforms/Scalar.h>
@@ -15,6 +17,7 @@
 #include "tile/lang/fnv1a64.h"
 #include "tile/lang/generate.h"
 #include "tile/lang/semprinter.h"
+#include "tile/targets/cpu/vecmath.h"
 
 namespace vertexai {
 namespace tile {
@@ -447,6 +450,48 @@ void Emit::Visit(const sem::CallExpr& n) {
     }
     vals.push_back(val);
   }
+  if (gentype.vec_width > 1) {
+    boost::optional<targets::cpu::vecmath::Function> fn;
+    switch (n.function) {
+      case sem::CallExpr::Function::EXP:
+        fn = targets::cpu::vecmath::Function::EXP;
+        break;
+      case sem::CallExpr::Function::LOG:
+        fn = targets::cpu::vecmath::Function::LOG;
+        break;
+      case sem::CallExpr::Function::POW:
+        fn = targets::cpu::vecmath::Function::POW;
+        break;
+      case sem::CallExpr::Function::TANH:
+        fn = targets::cpu::vecmath::Function::TANH;
+        break;
+      case sem::CallExpr::Function::SIN:
+        fn = targets::cpu::vecmath::Function::SIN;
+        break;
+      case sem::CallExpr::Function::COS:
+        fn = targets::cpu::vecmath::Function::COS;
+        break;
+      default:
+        break;
+    }
+    if (fn) {
+      // Vector transcendentals are generated inline, at the full vector width,
+      // rather than calling the C library once per element. Arguments which
+      // are all single or half precision are evaluated in single precision,
+      // which doubles the number of lanes per instruction.
+      if (std::all_of(vals.begin(), vals.end(), [](const value& val) {
+            return val.t.dtype == DataType::FLOAT16 || val.t.dtype == DataType::FLOAT32;
+          })) {
+        gentype.dtype = DataType::FLOAT32;
+      }
+      std::vector<llvm::Value*> args;
+      for (auto& val : vals) {
+        args.push_back(CastTo(val, gentype));
+      }
+      Resolve(value{targets::cpu::vecmath::Emit(&builder_, *fn, args), gentype});
+      return;
+    }
+  }
   typefix += "f64";
   // Cast each argument value to the common type used for this call. This may
   // require vector-expansion.
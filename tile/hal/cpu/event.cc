@@ -5,6 +5,7 @@
 #include <utility>
 
 #include "base/util/error.h"
+#include "base/util/executor.h"
 
 namespace vertexai {
 namespace tile {
@@ -28,7 +29,7 @@ boost::future<std::vector<std::shared_ptr<hal::Result>>> Event::WaitFor(
     futures.emplace_back(event->GetFuture());
   }
   auto deps = boost::when_all(futures.begin(), futures.end());
-  auto results = deps.then([](decltype(deps) fut) {
+  auto results = deps.then(RuntimeExecutor(), [](decltype(deps) fut) {
     std::vector<std::shared_ptr<hal::Result>> results;
     for (const auto& result : fut.get()) {
       results.emplace_back(result.get());
@@ -7,9 +7,8 @@
 #include <string>
 #include <vector>
 
-#include <boost/asio/thread_pool.hpp>
-
 #include "tile/base/hal.h"
+#include "tile/hal/cpu/scheduler.h"
 
 namespace llvm {
 class ExecutionEngine;
@@ -23,9 +22,9 @@ namespace cpu {
 
 class Executable final : public hal::Executable {
  public:
-  Executable(std::shared_ptr<llvm::LLVMContext> llvm_context,
+  Executable(std::vector<std::shared_ptr<llvm::LLVMContext>> llvm_contexts,
              std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines, std::vector<lang::KernelInfo> kis,
-             std::shared_ptr<boost::asio::thread_pool> thread_pool);
+             std::shared_ptr<Scheduler> scheduler);
   virtual ~Executable();
 
   std::shared_ptr<hal::Event> Run(const context::Context& ctx, std::size_t kidx,
@@ -36,10 +35,10 @@ class Executable final : public hal::Executable {
   static std::string InvokerName(std::string kname);
 
  private:
-  std::shared_ptr<llvm::LLVMContext> llvm_context_;
+  std::vector<std::shared_ptr<llvm::LLVMContext>> llvm_contexts_;
   std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines_;
   std::vector<lang::KernelInfo> kis_;
-  std::shared_ptr<boost::asio::thread_pool> thread_pool_;
+  std::shared_ptr<Scheduler> scheduler_;
 };
 
 }  // namespace cpu
@@ -2,16 +2,19 @@
 
 #include "tile/hal/cpu/executor.h"
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
 #include "base/util/compat.h"
 #include "base/util/error.h"
+#include "base/util/executor.h"
 #include "tile/hal/cpu/buffer.h"
 #include "tile/hal/cpu/event.h"
 #include "tile/hal/cpu/executable.h"
 #include "tile/hal/cpu/library.h"
 #include "tile/hal/cpu/memory.h"
+#include "tile/hal/cpu/topology.h"
 #include "tile/hal/util/selector.h"
 
 namespace vertexai {
@@ -20,11 +23,12 @@ namespace hal {
 namespace cpu {
 namespace {
 
-hal::proto::HardwareInfo GetHardwareInfo() {
+hal::proto::HardwareInfo GetHardwareInfo(std::size_t cores) {
   // Get the info required to tell the compiler how to generate efficient code for the target hardware.
   hal::proto::HardwareInfo info;
+  const Topology& host = HostTopology();
 
-  // TODO: We should use the actual processor identifier here.
+  // TODO: We should use the actual processor identifier here; device configurations currently select on this name.
   info.set_type(hal::proto::HardwareType::CPU);
   info.set_name("LLVM CPU");
   info.set_vendor("LLVM");
@@ -35,46 +39,55 @@ hal::proto::HardwareInfo GetHardwareInfo() {
   // workgroup.
   settings->set_threads(1);
 
-  // The vector size is currently the number of elements in the a SIMD register for some assumed datatype. We should
-  // probably change this to indicate the bit width of the register instead, because the number of elements depends on
-  // element type.
-  settings->set_vec_size(4);
+  // The vector size is the number of elements in a SIMD register, assuming 32-bit elements.
+  settings->set_vec_size(host.simd_bytes / 4);
 
   // GPUs have a concept of local memory, which works like an L1 cache that you manage explicitly. We'll let the
   // processor manage cache for us, which means we are using "global memory" in GPU terms.
   settings->set_use_global(true);
 
-  // Memory width is the size of a cache line. That is, what is the smallest unit of memory we can load at a time? This
-  // is technically variable but it happens to be the same for x86 and ARM architectures we care about.
-
-  settings->set_mem_width(64);
+  // Memory width is the size of a cache line. That is, what is the smallest unit of memory we can load at a time?
+  settings->set_mem_width(host.cache_line);
 
   // Maximum memory is another concept based on GPU local memory. It roughly means the size of the L1 cache: that is,
   // how much data can we efficiently read at one time?
+  std::uint64_t l1_size = 32768;
+  if (!host.caches.empty() && host.caches.front().level == 1) {
+    l1_size = host.caches.front().size;
+  }
+  settings->set_max_mem(l1_size);
 
-  settings->set_max_mem(32768);
-
-  // Maximum number of registers refers to the vector unit registers. It controls the number of outputs which can be
-  // generated at a time. This number is for NEON. 32-bit SSE had 8; AMD64 extended it to 16.
-  settings->set_max_regs(32);
+  // Maximum registers is the number of bytes of output the vector register file can hold at a time; it controls the
+  // number of outputs which can be generated at a time.
+  settings->set_max_regs(host.simd_registers * host.simd_bytes);
 
   // Minimum number of work groups: we need one workgroup per core.
-  settings->set_goal_groups(1);
+  settings->set_goal_groups(cores);
 
-  // No idea what flops per byte means.
-  // TODO: Fill this in with a more correct value.
+  // The ratio of arithmetic to L1 traffic at which a core saturates its vector units: roughly two vector FMAs per
+  // two vector loads per cycle, i.e. one flop per byte.
   settings->set_goal_flops_per_byte(1);
 
   // goal dimension sizes... still no idea what this does
   // TODO: Fill this in with a more correct value.
   settings->add_dim_sizes(0);
 
+  // The capacity of each cache level available to a single core; the cost model penalizes tiles whose working set
+  // spills out of each level in turn.
+  for (const auto& cache : host.caches) {
+    settings->add_cache_sizes(cache.size * std::max<std::size_t>(1, host.logical_cores / host.physical_cores) /
+                              cache.shared_cpus);
+  }
+
   return info;
 }
 
 }  // namespace
 
-Executor::Executor() : info_{GetHardwareInfo()}, memory_{new Memory()}, thread_pool_{new boost::asio::thread_pool} {}
+Executor::Executor(const std::vector<std::size_t>& cpus)
+    : info_{GetHardwareInfo(cpus.empty() ? HostTopology().physical_cores : cpus.size())},
+      scheduler_{cpus.empty() ? new Scheduler : new Scheduler(cpus)},
+      memory_{new Memory(scheduler_)} {}
 
 std::shared_ptr<hal::Event> Executor::Copy(const context::Context& ctx, const std::shared_ptr<hal::Buffer>& from,
                                            std::size_t from_offset, const std::shared_ptr<hal::Buffer>& to,
@@ -82,17 +95,17 @@ std::shared_ptr<hal::Event> Executor::Copy(const context::Context& ctx, const st
                                            const std::vector<std::shared_ptr<hal::Event>>& dependencies) {
   auto f = Buffer::Downcast(from);
   auto t = Buffer::Downcast(to);
-  if (f->size() <= from_offset || f->size() < length || f->size() < from_offset + length || t->size() <= to_offset ||
-      t->size() < length || t->size() < to_offset + length) {
+  if (f->size() < from_offset || f->size() - from_offset < length || t->size() < to_offset ||
+      t->size() - to_offset < length) {
     throw error::InvalidArgument{"Invalid copy request"};
   }
   auto deps = Event::WaitFor(dependencies);
   context::Context ctx_copy{ctx};
-  auto evt = deps.then([ctx = std::move(ctx_copy), f, t, from_offset, to_offset,
-                        length](decltype(deps) fut) -> std::shared_ptr<hal::Result> {
+  auto evt = deps.then(RuntimeExecutor(), [ctx = std::move(ctx_copy), f, t, from_offset, to_offset,
+                                           length](decltype(deps) fut) -> std::shared_ptr<hal::Result> {
     fut.get();
-    char* fb = static_cast<char*>(f->base()) + to_offset;
-    char* tb = static_cast<char*>(t->base()) + from_offset;
+    char* fb = static_cast<char*>(f->base()) + from_offset;
+    char* tb = static_cast<char*>(t->base()) + to_offset;
     auto start = std::chrono::high_resolution_clock::now();
     memcpy(tb, fb, length);
     return std::make_shared<Result>(ctx, "tile::hal::cpu::CopyMemory", start,
@@ -103,7 +116,7 @@ std::shared_ptr<hal::Event> Executor::Copy(const context::Context& ctx, const st
 
 boost::future<std::unique_ptr<hal::Executable>> Executor::Prepare(hal::Library* library) {
   auto lib = Library::Downcast(library);
-  auto k = std::make_unique<cpu::Executable>(lib->llvm_context(), lib->engines(), lib->kernels(), thread_pool_);
+  auto k = std::make_unique<cpu::Executable>(lib->llvm_contexts(), lib->engines(), lib->kernels(), scheduler_);
   return boost::make_ready_future(std::unique_ptr<hal::Executable>(std::move(k)));
 }
 
@@ -5,9 +5,8 @@
 #include <memory>
 #include <vector>
 
-#include <boost/asio/thread_pool.hpp>
-
 #include "tile/base/hal.h"
+#include "tile/hal/cpu/scheduler.h"
 
 namespace vertexai {
 namespace tile {
@@ -16,7 +15,9 @@ namespace cpu {
 
 class Executor : public hal::Executor {
  public:
-  Executor();
+  // Creates an executor running kernels on the indicated CPUs, or on every
+  // physical core if none are given.
+  explicit Executor(const std::vector<std::size_t>& cpus = {});
 
   const hal::proto::HardwareInfo& info() final { return info_; }
 
@@ -31,7 +32,7 @@ class Executor : public hal::Executor {
                                    std::size_t to_offset, std::size_t length,
                                    const std::vector<std::shared_ptr<hal::Event>>& dependencies) final;
 
-  boost::future<std::unique_ptr<Executable>> Prepare(Library* library) final;
+  boost::future<std::unique_ptr<hal::Executable>> Prepare(hal::Library* library) final;
 
   boost::future<std::vector<std::shared_ptr<hal::Result>>> WaitFor(
       const std::vector<std::shared_ptr<hal::Event>>& events) final;
@@ -42,8 +43,8 @@ class Executor : public hal::Executor {
 
  private:
   const hal::proto::HardwareInfo info_;
+  std::shared_ptr<Scheduler> scheduler_;
   std::unique_ptr<Memory> memory_;
-  std::shared_ptr<boost::asio::thread_pool> thread_pool_;
 };
 
 }  // namespace cpu
@@ -3,32 +3,101 @@
 #include "tile/hal/cpu/library.h"
 
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+
+#include <algorithm>
+#include <sstream>
 #include <utility>
 
 #include "base/util/error.h"
+#include "base/util/file.h"
+#include "tile/hal/cpu/compiler.h"
 
 namespace vertexai {
 namespace tile {
 namespace hal {
 namespace cpu {
+namespace {
+
+const char kernel_magic_[] = "plaidml-cpu-kernel-2";
+
+}  // namespace
 
 Library* Library::Downcast(hal::Library* library) {
   Library* exe = dynamic_cast<Library*>(library);
   return exe;
 }
 
-Library::Library(std::shared_ptr<llvm::LLVMContext> context,
+Library::Library(const std::vector<std::shared_ptr<llvm::LLVMContext>>& contexts,
                  const std::vector<std::shared_ptr<llvm::ExecutionEngine>>& engines,
+                 std::map<std::string, std::vector<KernelObject>> objects,
                  const std::vector<lang::KernelInfo>& kernels)
-    : context_{context}, engines_{engines}, kernels_{kernels} {}
+    : contexts_{contexts}, engines_{engines}, objects_{std::move(objects)}, kernels_{kernels} {}
 
 Library::~Library() {
-  // release all of the ExecutionEngine instances first, before the LLVMContext,
+  // release all of the ExecutionEngine instances first, before the LLVMContexts,
   // because each ExecutionEngine is associated with an llvm::Module, and
   // modules must not outlive their LLVMContext.
   engines_.clear();
 }
 
+std::map<std::string, std::string> Library::Serialize() {
+  std::map<std::string, std::string> result;
+  auto targets = CodegenTargets();
+  std::lock_guard<std::mutex> lock{mu_};
+  for (const auto& ki : kernels_) {
+    auto it = objects_.find(ki.kname);
+    if (it == objects_.end()) {
+      continue;
+    }
+    // Generate code for any targets the kernel hasn't been compiled for yet.
+    for (const auto& target : targets) {
+      bool compiled = std::any_of(it->second.begin(), it->second.end(),
+                                  [&](const KernelObject& obj) { return obj.target == target; });
+      if (!compiled && ki.kfunc) {
+        it->second.emplace_back(KernelObject{target, Compiler::BuildObject(ki, target)});
+      }
+    }
+    std::ostringstream records;
+    for (const auto& obj : it->second) {
+      std::ostringstream features;
+      for (const auto& feature : obj.target.features) {
+        features << feature << ',';
+      }
+      WriteString(records, kernel_magic_);
+      WriteString(records, obj.target.triple);
+      WriteString(records, obj.target.cpu);
+      WriteString(records, features.str());
+      WriteString(records, ki.kname);
+      WriteString(records, obj.object);
+    }
+    result.emplace(ki.kname, records.str());
+  }
+  return result;
+}
+
+std::map<std::string, std::vector<KernelObject>> Library::ParseObjects(const std::string& serialized) {
+  std::map<std::string, std::vector<KernelObject>> result;
+  std::istringstream in(serialized);
+  while (in.peek() != std::char_traits<char>::eof()) {
+    std::string magic;
+    std::string features;
+    std::string kname;
+    KernelObject obj;
+    if (!ReadString(in, &magic) || magic != kernel_magic_ || !ReadString(in, &obj.target.triple) ||
+        !ReadString(in, &obj.target.cpu) || !ReadString(in, &features) || !ReadString(in, &kname) ||
+        !ReadString(in, &obj.object)) {
+      throw error::InvalidArgument{"Malformed serialized CPU kernel"};
+    }
+    std::istringstream features_in(features);
+    std::string feature;
+    while (std::getline(features_in, feature, ',')) {
+      obj.target.features.emplace_back(feature);
+    }
+    result[kname].emplace_back(std::move(obj));
+  }
+  return result;
+}
+
 }  // namespace cpu
 }  // namespace hal
 }  // namespace tile
@@ -2,11 +2,14 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "tile/base/hal.h"
+#include "tile/hal/cpu/target.h"
 #include "tile/lang/generate.h"
 
 namespace llvm {
@@ -19,24 +22,44 @@ namespace tile {
 namespace hal {
 namespace cpu {
 
+// The relocatable object code generated for a kernel on one target.
+struct KernelObject {
+  Target target;
+  std::string object;
+};
+
 class Library final : public hal::Library {
  public:
   static Library* Downcast(hal::Library* library);
 
-  Library(std::shared_ptr<llvm::LLVMContext> context,
+  // Each kernel's engine is built in the corresponding context; its objects,
+  // keyed by kernel name, are the code generated for each of the targets it
+  // was compiled for.
+  Library(const std::vector<std::shared_ptr<llvm::LLVMContext>>& contexts,
           const std::vector<std::shared_ptr<llvm::ExecutionEngine>>& engines,
-          const std::vector<lang::KernelInfo>& kernels);
+          std::map<std::string, std::vector<KernelObject>> objects, const std::vector<lang::KernelInfo>& kernels);
   virtual ~Library();
 
-  std::map<std::string, std::string> Serialize() final { return {}; }
+  // Serializes each kernel's relocatable object code, keyed by kernel name,
+  // first generating code for any of CodegenTargets() the kernel lacks.
+  // Each value holds one self-describing record per target, naming the kernel
+  // and the target; any concatenation of records may be passed to the CPU
+  // Loader.
+  std::map<std::string, std::string> Serialize() final;
+
+  // Parses a concatenation of serialized kernel records, returning the object
+  // code keyed by kernel name. Throws if a record is malformed.
+  static std::map<std::string, std::vector<KernelObject>> ParseObjects(const std::string& serialized);
 
-  std::shared_ptr<llvm::LLVMContext> llvm_context() { return context_; }
+  const std::vector<std::shared_ptr<llvm::LLVMContext>>& llvm_contexts() { return contexts_; }
   const std::vector<std::shared_ptr<llvm::ExecutionEngine>>& engines() { return engines_; }
   const std::vector<lang::KernelInfo>& kernels() { return kernels_; }
 
  private:
-  std::shared_ptr<llvm::LLVMContext> context_;
+  std::vector<std::shared_ptr<llvm::LLVMContext>> contexts_;
   std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines_;
+  std::mutex mu_;
+  std::map<std::string, std::vector<KernelObject>> objects_;
   std::vector<lang::KernelInfo> kernels_;
 };
 
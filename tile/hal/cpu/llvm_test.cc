@@ -1,13 +1,33 @@
 // Copyright 2017-2018 Intel Corporation.
 
 #include <gmock/gmock.h>
+#include <llvm/ADT/Triple.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
 
 #include <half.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/context/context.h"
+#include "base/util/env.h"
+#include "base/util/error.h"
+#include "tile/hal/cpu/arena.h"
+#include "tile/hal/cpu/buffer.h"
+#include "tile/hal/cpu/compiler.h"
 #include "tile/hal/cpu/emitllvm.h"
+#include "tile/hal/cpu/executable.h"
+#include "tile/hal/cpu/library.h"
+#include "tile/hal/cpu/loader.h"
 #include "tile/hal/cpu/runtime.h"
+#include "tile/hal/cpu/scheduler.h"
+#include "tile/hal/cpu/target.h"
 #include "tile/lang/sembuilder.h"
 #include "tile/lang/semtree.h"
 
@@ -57,6 +77,33 @@ static llvm::ExecutionEngine* JIT(llvm::LLVMContext& context, const sem::Node& n
   return engine;
 }
 
+// Returns a single-work-item kernel which sets out[0] to in[0] + addend.
+lang::KernelInfo MakeAddKernel(const std::string& name, int32_t addend) {
+  using namespace sem::builder;  // NOLINT
+  lang::KernelInfo ki;
+  ki.kname = name;
+  ki.kfunc = _Function(name, voidType, {{ptrInt32Type, "out"}, {ptrInt32Type, "in"}},
+                       {_("out")[_Const(0)] = _("in")[_Const(0)] + _Const(addend)});
+  ki.gwork = {{1, 1, 1}};
+  return ki;
+}
+
+// Runs the named kernel's invoker from the engine on a single input, and
+// returns its output.
+int32_t InvokeScalar(llvm::ExecutionEngine* engine, const std::string& name, int32_t in) {
+  auto invoker =
+      (void (*)(void*, lang::GridSize*))engine->getFunctionAddress(hal::cpu::Executable::InvokerName(name));
+  if (!invoker) {
+    ADD_FAILURE() << "No invoker for " << name;
+    return 0;
+  }
+  int32_t out = 0;
+  void* args[] = {&out, &in};
+  lang::GridSize index = {{0, 0, 0}};
+  invoker(args, &index);
+  return out;
+}
+
 TEST(CpuDevice, LLVM_minimal) {
   using namespace sem::builder;  // NOLINT
   auto i = _("i");
@@ -428,6 +475,232 @@ TEST(CpuDevice, LLVM_vec_add_loop) {
   }
 }
 
+TEST(CpuDevice, LLVM_serialize_roundtrip) {
+  auto ki = MakeAddKernel("increment", 1);
+  context::Context ctx;
+  hal::proto::HardwareSettings settings;
+  hal::cpu::Compiler compiler;
+  auto built = compiler.Build(ctx, {ki}, settings).get();
+  auto serialized = built->Serialize();
+  ASSERT_THAT(serialized.size(), Eq(1));
+  EXPECT_THAT(serialized.count("increment"), Eq(1));
+
+  hal::cpu::Loader loader;
+  auto loaded = loader.Deserialize(ctx, serialized["increment"], {ki}).get();
+  auto lib = hal::cpu::Library::Downcast(loaded.get());
+  ASSERT_THAT(lib, NotNull());
+  ASSERT_THAT(lib->engines().size(), Eq(1));
+  EXPECT_THAT(InvokeScalar(lib->engines()[0].get(), "increment", 41), Eq(42));
+
+  // The reloaded library serializes to the same records.
+  EXPECT_THAT(loaded->Serialize(), Eq(serialized));
+  EXPECT_THROW(loader.Deserialize(ctx, "", {ki}), error::NotFound);
+}
+
+TEST(CpuDevice, LLVM_serialize_by_kernel_name) {
+  auto inc = MakeAddKernel("increment", 1);
+  auto add = MakeAddKernel("add_21", 21);
+  context::Context ctx;
+  hal::proto::HardwareSettings settings;
+  hal::cpu::Compiler compiler;
+  auto serialized = compiler.Build(ctx, {inc, add}, settings).get()->Serialize();
+  ASSERT_THAT(serialized.size(), Eq(2));
+
+  // Records are found by kernel name, whatever order the records and kernels come in.
+  hal::cpu::Loader loader;
+  auto loaded = loader.Deserialize(ctx, serialized["increment"] + serialized["add_21"], {add, inc}).get();
+  auto lib = hal::cpu::Library::Downcast(loaded.get());
+  ASSERT_THAT(lib, NotNull());
+  ASSERT_THAT(lib->engines().size(), Eq(2));
+  EXPECT_THAT(InvokeScalar(lib->engines()[0].get(), "add_21", 21), Eq(42));
+  EXPECT_THAT(loaded->Serialize(), Eq(serialized));
+}
+
+TEST(CpuDevice, LLVM_concurrent_builds) {
+  // Each thread builds a program of kernels adding different constants, so
+  // that any mixup between concurrent builds shows up in the results.
+  const int kThreads = 8;
+  const int kKernels = 3;
+  context::Context ctx;
+  hal::proto::HardwareSettings settings;
+  hal::cpu::Compiler compiler;
+  std::vector<std::vector<lang::KernelInfo>> programs(kThreads);
+  for (int tidx = 0; tidx < kThreads; ++tidx) {
+    for (int kidx = 0; kidx < kKernels; ++kidx) {
+      int addend = tidx * kKernels + kidx;
+      programs[tidx].emplace_back(MakeAddKernel("add_" + std::to_string(addend), addend));
+    }
+  }
+  std::vector<std::unique_ptr<hal::Library>> libs(kThreads);
+  std::vector<std::thread> threads;
+  for (int tidx = 0; tidx < kThreads; ++tidx) {
+    threads.emplace_back([&, tidx]() { libs[tidx] = compiler.Build(ctx, programs[tidx], settings).get(); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (int tidx = 0; tidx < kThreads; ++tidx) {
+    auto lib = hal::cpu::Library::Downcast(libs[tidx].get());
+    ASSERT_THAT(lib, NotNull());
+    ASSERT_THAT(lib->engines().size(), Eq(kKernels));
+    EXPECT_THAT(lib->Serialize().size(), Eq(kKernels));
+    for (int kidx = 0; kidx < kKernels; ++kidx) {
+      EXPECT_THAT(InvokeScalar(lib->engines()[kidx].get(), programs[tidx][kidx].kname, 1000),
+                  Eq(1000 + tidx * kKernels + kidx));
+    }
+  }
+}
+
+TEST(CpuDevice, LLVM_portable_targets) {
+  auto ki = MakeAddKernel("increment", 1);
+  context::Context ctx;
+  hal::proto::HardwareSettings settings;
+  hal::cpu::Compiler compiler;
+  auto built = compiler.Build(ctx, {ki}, settings).get();
+  // Code for the portable targets is only generated when it's serialized.
+  EXPECT_THAT(hal::cpu::Library::ParseObjects(built->Serialize()["increment"])["increment"].size(), Eq(1));
+  env::Set("PLAIDML_CPU_PORTABLE", "1");
+  auto serialized = built->Serialize();
+  env::Set("PLAIDML_CPU_PORTABLE", "");
+  auto objects = hal::cpu::Library::ParseObjects(serialized["increment"]);
+  ASSERT_THAT(objects.count("increment"), Eq(1));
+  auto& variants = objects["increment"];
+  bool x86_64 = llvm::Triple(hal::cpu::HostTarget().triple).getArch() == llvm::Triple::x86_64;
+  ASSERT_THAT(variants.size(), Eq(x86_64 ? 6 : 1));
+  EXPECT_THAT(variants[0].target, Eq(hal::cpu::HostTarget()));
+  if (!x86_64) {
+    return;
+  }
+
+  // Drop the host's own code, leaving the loader to pick an ISA level.
+  // Without its semantic tree, the library can't regenerate the host's code.
+  variants.erase(variants.begin());
+  lang::KernelInfo compiled = ki;
+  compiled.kfunc.reset();
+  hal::cpu::Library stripped({}, {}, {{"increment", variants}}, {compiled});
+  auto portable = stripped.Serialize()["increment"];
+  hal::cpu::Loader loader;
+  auto loaded = loader.Deserialize(ctx, portable, {ki}).get();
+  auto lib = hal::cpu::Library::Downcast(loaded.get());
+  ASSERT_THAT(lib, NotNull());
+  EXPECT_THAT(InvokeScalar(lib->engines()[0].get(), "increment", 41), Eq(42));
+}
+
+TEST(CpuDevice, SelectTarget) {
+  hal::cpu::Target host{"x86_64-unknown-linux-gnu", "haswell", {"+avx", "+avx2", "+fma", "-avx512f"}};
+  hal::cpu::Target baseline{host.triple, "x86-64", {}};
+  hal::cpu::Target avx2{host.triple, "x86-64", {"+avx", "+avx2", "+fma"}};
+  hal::cpu::Target avx512{host.triple, "x86-64", {"+avx", "+avx2", "+avx512f", "+fma"}};
+  hal::cpu::Target other{"aarch64-unknown-linux-gnu", "generic", {}};
+  EXPECT_TRUE(avx2.RunsOn(host));
+  EXPECT_FALSE(avx512.RunsOn(host));
+  EXPECT_FALSE(other.RunsOn(host));
+  EXPECT_THAT(hal::cpu::SelectTarget({baseline, avx2, avx512}, host), Eq(1));
+  EXPECT_THAT(hal::cpu::SelectTarget({avx512, baseline, host, avx2}, host), Eq(2));
+  EXPECT_THAT(hal::cpu::SelectTarget({avx512, other}, host), Eq(2));
+
+  // Targets survive the round trip through their descriptions.
+  hal::cpu::Target parsed;
+  ASSERT_TRUE(targets::cpu::ParseTarget(targets::cpu::to_string(host), &parsed));
+  EXPECT_THAT(parsed, Eq(host));
+  ASSERT_TRUE(targets::cpu::ParseTarget(targets::cpu::to_string(baseline), &parsed));
+  EXPECT_THAT(parsed, Eq(baseline));
+  EXPECT_FALSE(targets::cpu::ParseTarget("x86_64-unknown-linux-gnu", &parsed));
+}
+
+TEST(CpuScheduler, RunsEachIterationOnce) {
+  // Four workers deal out sixteen chunks; cover counts below, at and above that.
+  hal::cpu::Scheduler scheduler{4};
+  for (std::size_t count : {1, 2, 15, 16, 17, 1000}) {
+    std::vector<std::atomic<int>> runs(count);
+    scheduler.ParallelFor(count, [&runs](std::size_t begin, std::size_t end) {
+      for (auto idx = begin; idx < end; ++idx) {
+        ++runs[idx];
+      }
+    });
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      EXPECT_THAT(runs[idx].load(), Eq(1)) << "iteration " << idx << " of " << count;
+    }
+  }
+}
+
+TEST(CpuScheduler, ConcurrentCallers) {
+  hal::cpu::Scheduler scheduler{4};
+  const std::size_t kThreads = 8;
+  const std::size_t kLoops = 50;
+  const std::size_t kCount = 100;
+  std::vector<std::size_t> sums(kThreads);
+  std::vector<std::thread> threads;
+  for (std::size_t tidx = 0; tidx < kThreads; ++tidx) {
+    threads.emplace_back([&, tidx]() {
+      for (std::size_t loop = 0; loop < kLoops; ++loop) {
+        std::atomic<std::size_t> sum{0};
+        scheduler.ParallelFor(kCount, [&sum](std::size_t begin, std::size_t end) {
+          for (auto idx = begin; idx < end; ++idx) {
+            sum += idx + 1;
+          }
+        });
+        sums[tidx] += sum;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (auto sum : sums) {
+    EXPECT_THAT(sum, Eq(kLoops * kCount * (kCount + 1) / 2));
+  }
+}
+
+TEST(CpuScheduler, StealsAroundSlowChunk) {
+  // Two workers each start with four one-iteration chunks. Iteration 0 blocks
+  // until every other iteration has run, which only happens if the rest of
+  // its worker's chunks are stolen.
+  hal::cpu::Scheduler scheduler{2};
+  const std::size_t kCount = 8;
+  std::atomic<std::size_t> finished{0};
+  bool stolen = false;
+  scheduler.ParallelFor(kCount, [&](std::size_t begin, std::size_t end) {
+    if (begin == 0) {
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+      while (finished < kCount - (end - begin) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      stolen = finished == kCount - (end - begin);
+    }
+    finished += end - begin;
+  });
+  EXPECT_TRUE(stolen);
+  EXPECT_THAT(finished.load(), Eq(kCount));
+}
+
+TEST(CpuDevice, ArenaPlacement) {
+  EXPECT_THAT(hal::cpu::ParsePlacement(""), Eq(hal::cpu::Placement::FIRST_TOUCH));
+  EXPECT_THAT(hal::cpu::ParsePlacement("interleave"), Eq(hal::cpu::Placement::INTERLEAVE));
+  EXPECT_THAT(hal::cpu::ParsePlacement("workers"), Eq(hal::cpu::Placement::WORKERS));
+  EXPECT_THROW(hal::cpu::ParsePlacement("everywhere"), error::InvalidArgument);
+
+  // Heap-backed and mapped arenas alike must start out zeroed, and the mapped
+  // ones must be page-aligned, under every placement policy.
+  hal::cpu::Scheduler scheduler{2};
+  for (auto placement :
+       {hal::cpu::Placement::FIRST_TOUCH, hal::cpu::Placement::INTERLEAVE, hal::cpu::Placement::WORKERS}) {
+    for (std::uint64_t size : {std::uint64_t{100}, std::uint64_t{3} << 20}) {
+      auto arena = std::make_shared<hal::cpu::Arena>(size, placement, &scheduler);
+      if (size > 4096) {
+        EXPECT_THAT(reinterpret_cast<std::uintptr_t>(arena->base()) % 4096, Eq(0));
+      }
+      auto buffer = hal::cpu::Buffer::Downcast(arena->MakeBuffer(size / 2, size / 2));
+      auto data = static_cast<char*>(buffer->base());
+      EXPECT_THAT(std::count(data, data + size / 2, '\0'), Eq(static_cast<std::ptrdiff_t>(size / 2)));
+      data[size / 2 - 1] = 1;
+      EXPECT_THAT(arena->base()[size - 1], Eq(1));
+      EXPECT_THROW(arena->MakeBuffer(size / 2, size), error::OutOfRange);
+    }
+  }
+}
+
 }  // namespace
 }  // namespace testing
 }  // namespace tile
@@ -0,0 +1,92 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/hal/cpu/loader.h"
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <map>
+#include <utility>
+
+#include "base/util/error.h"
+#include "base/util/logging.h"
+#include "tile/hal/cpu/compiler.h"
+#include "tile/hal/cpu/library.h"
+#include "tile/hal/cpu/runtime.h"
+#include "tile/hal/cpu/target.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+namespace {
+
+std::shared_ptr<llvm::ExecutionEngine> LoadKernel(llvm::LLVMContext* context, const std::string& kname,
+                                                  const KernelObject& kobj) {
+  auto buffer = llvm::MemoryBuffer::getMemBufferCopy(kobj.object, kname);
+  auto obj = llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+  if (!obj) {
+    throw error::InvalidArgument{"Failed to load object code for CPU kernel " + kname + ": " +
+                                 llvm::toString(obj.takeError())};
+  }
+  llvm::object::OwningBinary<llvm::object::ObjectFile> binary(std::move(*obj), std::move(buffer));
+  // MCJIT insists on starting with a module, so we give it an empty one and
+  // then add the object file; finalizing resolves the kernel's external
+  // references through the Runtime, exactly as for a freshly-built kernel.
+  auto module = std::make_unique<llvm::Module>(kname, *context);
+  module->setTargetTriple(kobj.target.triple);
+  std::string errStr;
+  std::unique_ptr<llvm::LegacyJITSymbolResolver> rez(new Runtime);
+  llvm::ExecutionEngine* ee = llvm::EngineBuilder(std::move(module))
+                                  .setErrorStr(&errStr)
+                                  .setEngineKind(llvm::EngineKind::JIT)
+                                  .setSymbolResolver(std::move(rez))
+                                  .create();
+  if (!ee) {
+    throw error::Internal{"Failed to create ExecutionEngine for CPU kernel " + kname + ": " + errStr};
+  }
+  ee->addObjectFile(std::move(binary));
+  ee->finalizeObject();
+  return std::shared_ptr<llvm::ExecutionEngine>(ee);
+}
+
+}  // namespace
+
+boost::future<std::unique_ptr<hal::Library>> Loader::Deserialize(const context::Context& ctx,
+                                                                 const std::string& serialized_executable,
+                                                                 const std::vector<lang::KernelInfo>& info) {
+  InitializeLLVM();
+  auto objects = Library::ParseObjects(serialized_executable);
+  std::vector<std::shared_ptr<llvm::LLVMContext>> contexts;
+  std::vector<std::shared_ptr<llvm::ExecutionEngine>> engines;
+  std::map<std::string, std::vector<KernelObject>> kernel_objects;
+  for (const auto& ki : info) {
+    auto it = objects.find(ki.kname);
+    if (it == objects.end()) {
+      throw error::NotFound{"No object code for CPU kernel " + ki.kname};
+    }
+    std::vector<Target> targets;
+    for (const auto& obj : it->second) {
+      targets.emplace_back(obj.target);
+    }
+    auto best = SelectTarget(targets, HostTarget());
+    if (best == targets.size()) {
+      throw error::NotFound{"No object code for CPU kernel " + ki.kname + " runs on this host"};
+    }
+    IVLOG(2, "Loading CPU kernel " << ki.kname << " compiled for " << targets[best]);
+    contexts.emplace_back(std::make_shared<llvm::LLVMContext>());
+    engines.emplace_back(LoadKernel(contexts.back().get(), ki.kname, it->second[best]));
+    // Keep every target's code, so that the library serializes as portably as
+    // it was loaded.
+    kernel_objects[ki.kname] = std::move(it->second);
+  }
+  std::unique_ptr<hal::Library> lib(new cpu::Library(contexts, engines, std::move(kernel_objects), info));
+  return boost::make_ready_future<>(std::move(lib));
+}
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
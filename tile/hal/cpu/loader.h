@@ -0,0 +1,30 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tile/base/hal.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+
+// Loader rebuilds CPU libraries from the object code produced by
+// Library::Serialize, skipping IR generation and code generation entirely.
+class Loader final : public hal::Loader {
+ public:
+  // The serialized executable is any concatenation of the records produced by
+  // Library::Serialize that covers every kernel in info.
+  boost::future<std::unique_ptr<hal::Library>> Deserialize(const context::Context& ctx,
+                                                           const std::string& serialized_executable,
+                                                           const std::vector<lang::KernelInfo>& info) final;
+};
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
@@ -2,22 +2,42 @@
 
 #include "tile/hal/cpu/memory.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <utility>
 
-#include "tile/hal/cpu/arena.h"
+#include "base/util/env.h"
 #include "tile/hal/cpu/buffer.h"
+#include "tile/hal/cpu/scheduler.h"
+#include "tile/hal/cpu/topology.h"
 
 namespace vertexai {
 namespace tile {
 namespace hal {
 namespace cpu {
 
+Memory::Memory(std::shared_ptr<Scheduler> scheduler)
+    : scheduler_{std::move(scheduler)}, placement_{ParsePlacement(env::Get("PLAIDML_CPU_NUMA"))} {}
+
+std::size_t Memory::ArenaBufferAlignment() const {
+  return std::max<std::size_t>(HostTopology().cache_line, alignof(std::max_align_t));
+}
+
 std::shared_ptr<hal::Buffer> Memory::MakeBuffer(std::uint64_t size, BufferAccessMask /* access */) {
-  return std::make_shared<Arena>(size)->MakeBuffer(0, size);
+  // The arena only owns the allocation; small buffers come from the heap, and
+  // large ones are lazily-populated mappings.
+  return std::make_shared<Arena>(size, placement_, scheduler_.get())->MakeBuffer(0, size);
+}
+
+std::shared_ptr<hal::Buffer> Memory::MapFile(const std::string& path, std::uint64_t offset, std::uint64_t size) {
+  if (offset % ArenaBufferAlignment()) {
+    return nullptr;
+  }
+  return std::make_shared<Arena>(path, offset, size)->MakeBuffer(0, size);
 }
 
 std::shared_ptr<hal::Arena> Memory::MakeArena(std::uint64_t size, BufferAccessMask /* access */) {
-  return std::make_shared<Arena>(size);
+  return std::make_shared<Arena>(size, placement_, scheduler_.get());
 }
 
 }  // namespace cpu
@@ -6,27 +6,44 @@
 #include <cstdint>
 #include <memory>
 #include <ratio>
+#include <string>
 
 #include "tile/base/hal.h"
+#include "tile/hal/cpu/arena.h"
 
 namespace vertexai {
 namespace tile {
 namespace hal {
 namespace cpu {
 
+class Scheduler;
+
+// Memory allocates host memory for the CPU device. Arenas are placed on the
+// host's memory nodes according to the policy named by PLAIDML_CPU_NUMA (see
+// Placement); PLAIDML_CPU_HUGE_PAGES requests transparent huge pages for them.
 class Memory final : public hal::Memory {
  public:
-  Memory() {}
+  // Constructs a memory; the scheduler, if any, is the one whose workers will
+  // use the memory.
+  explicit Memory(std::shared_ptr<Scheduler> scheduler = nullptr);
 
   std::uint64_t size_goal() const final {
     // TODO: Actually query the system physical memory size.
     return 16 * std::giga::num;
   }
   BufferAccessMask AllowedAccesses() const final { return BufferAccessMask::ALL; }
-  std::size_t ArenaBufferAlignment() const final { return alignof(long double); /* TODO: Use std::max_align_t */ }
+  // Buffers start on cache line boundaries, so that buffers written by
+  // different workers never share a line.
+  std::size_t ArenaBufferAlignment() const final;
 
   std::shared_ptr<hal::Buffer> MakeBuffer(std::uint64_t size, BufferAccessMask access) final;
   std::shared_ptr<hal::Arena> MakeArena(std::uint64_t size, BufferAccessMask access) final;
+  // File ranges are mapped if they start on a buffer alignment boundary.
+  std::shared_ptr<hal::Buffer> MapFile(const std::string& path, std::uint64_t offset, std::uint64_t size) final;
+
+ private:
+  std::shared_ptr<Scheduler> scheduler_;
+  Placement placement_;
 };
 
 }  // namespace cpu
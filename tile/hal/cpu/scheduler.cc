@@ -0,0 +1,196 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/hal/cpu/scheduler.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+
+#include "base/util/logging.h"
+#include "tile/hal/cpu/topology.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+namespace {
+
+// Each worker receives about this many chunks of every loop, which leaves
+// thieves something to take when the cost of iterations is uneven.
+const std::size_t chunks_per_worker_ = 4;
+
+// The issuer polls for this many rounds of finding nothing to run before it
+// parks until its job completes.
+const std::size_t issuer_spins_ = 64;
+
+void PinToCpu(std::thread* thread, std::size_t cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int err = pthread_setaffinity_np(thread->native_handle(), sizeof(set), &set);
+  if (err) {
+    // E.g. the process is confined to a subset of the CPUs; the worker simply
+    // stays unpinned.
+    IVLOG(1, "Unable to pin CPU scheduler worker to CPU " << cpu << ": error " << err);
+  }
+#endif
+}
+
+}  // namespace
+
+Scheduler::Scheduler(std::size_t workers) {
+  const Topology& host = HostTopology();
+  if (!workers) {
+    workers = host.physical_cores;
+  }
+  workers = std::max<std::size_t>(workers, 1);
+  std::vector<std::size_t> cpus;
+  if (workers <= host.core_cpus.size()) {
+    cpus.assign(host.core_cpus.begin(), host.core_cpus.begin() + workers);
+  }
+  Start(workers, cpus);
+}
+
+Scheduler::Scheduler(const std::vector<std::size_t>& cpus) { Start(std::max<std::size_t>(cpus.size(), 1), cpus); }
+
+void Scheduler::Start(std::size_t workers, const std::vector<std::size_t>& cpus) {
+  for (std::size_t slot = 0; slot < workers; ++slot) {
+    workers_.emplace_back(new Worker);
+  }
+  for (std::size_t slot = 0; slot < workers; ++slot) {
+    auto& worker = *workers_[slot];
+    worker.thread = std::thread([this, slot]() { WorkerMain(slot); });
+    if (slot < cpus.size()) {
+      PinToCpu(&worker.thread, cpus[slot]);
+    }
+  }
+}
+
+Scheduler::~Scheduler() {
+  {
+    std::lock_guard<std::mutex> lock{idle_mu_};
+    shutdown_ = true;
+  }
+  idle_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+void Scheduler::ParallelFor(std::size_t count, const std::function<void(std::size_t, std::size_t)>& body) {
+  if (!count) {
+    return;
+  }
+  std::size_t chunks = std::min(count, workers_.size() * chunks_per_worker_);
+  if (chunks <= 1) {
+    body(0, count);
+    return;
+  }
+
+  // Deal the chunks out so that each worker starts on a contiguous stretch of
+  // the iteration space.
+  Job job{&body, {count}};
+  // Count the chunks before any can be taken, so that queued_ never drops
+  // below the number actually sitting in the deques.
+  queued_ += chunks;
+  std::size_t per_worker = (chunks + workers_.size() - 1) / workers_.size();
+  for (std::size_t slot = 0; slot * per_worker < chunks; ++slot) {
+    auto& worker = *workers_[slot];
+    std::lock_guard<std::mutex> lock{worker.mu};
+    for (std::size_t idx = slot * per_worker; idx < std::min(chunks, (slot + 1) * per_worker); ++idx) {
+      worker.chunks.push_back(Chunk{&job, count * idx / chunks, count * (idx + 1) / chunks});
+    }
+  }
+  {
+    // Taking the lock orders the notification after any worker's check of
+    // queued_, so that no worker can miss it and sleep through the job.
+    std::lock_guard<std::mutex> lock{idle_mu_};
+  }
+  idle_cv_.notify_all();
+
+  // Help out until nothing is left to take, then wait for the chunks still
+  // running on the workers: briefly by polling, then by parking.
+  for (std::size_t spins = 0; spins < issuer_spins_ && job.remaining.load(std::memory_order_acquire);) {
+    if (RunOne(workers_.size())) {
+      spins = 0;
+    } else {
+      ++spins;
+      std::this_thread::yield();
+    }
+  }
+  // Even if the count has already reached zero, the thread that completed the
+  // job may still be signalling it; waiting for done keeps the job alive until
+  // that thread is finished with it.
+  std::unique_lock<std::mutex> lock{job.mu};
+  job.done_cv.wait(lock, [&job]() { return job.done; });
+}
+
+void Scheduler::WorkerMain(std::size_t slot) {
+  for (;;) {
+    if (RunOne(slot)) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock{idle_mu_};
+    idle_cv_.wait(lock, [this]() { return shutdown_ || queued_.load(); });
+    if (shutdown_) {
+      return;
+    }
+  }
+}
+
+bool Scheduler::RunOne(std::size_t slot) {
+  Chunk chunk;
+  if (!Pop(slot, &chunk)) {
+    return false;
+  }
+  (*chunk.job->body)(chunk.begin, chunk.end);
+  auto* job = chunk.job;
+  auto size = chunk.end - chunk.begin;
+  if (job->remaining.fetch_sub(size, std::memory_order_acq_rel) == size) {
+    // This is the last access to the job: once done is set and the lock is
+    // released, its issuer may return and destroy it.
+    std::lock_guard<std::mutex> lock{job->mu};
+    job->done = true;
+    job->done_cv.notify_one();
+  }
+  return true;
+}
+
+bool Scheduler::Pop(std::size_t slot, Chunk* chunk) {
+  if (!queued_.load()) {
+    return false;
+  }
+  // Prefer the front of our own deque; failing that, steal from the back of
+  // the others', starting with our neighbor. Slots beyond the workers (i.e.
+  // issuing threads) only steal.
+  if (slot < workers_.size()) {
+    auto& own = *workers_[slot];
+    std::lock_guard<std::mutex> lock{own.mu};
+    if (!own.chunks.empty()) {
+      *chunk = own.chunks.front();
+      own.chunks.pop_front();
+      --queued_;
+      return true;
+    }
+  }
+  for (std::size_t offset = 1; offset <= workers_.size(); ++offset) {
+    auto& victim = *workers_[(slot + offset) % workers_.size()];
+    std::lock_guard<std::mutex> lock{victim.mu};
+    if (!victim.chunks.empty()) {
+      *chunk = victim.chunks.back();
+      victim.chunks.pop_back();
+      --queued_;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
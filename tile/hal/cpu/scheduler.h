@@ -0,0 +1,89 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+
+// Scheduler runs the grid iterations of CPU kernels on one worker thread per
+// physical core, each pinned to its core where the OS allows.
+//
+// ParallelFor splits the iteration space into chunks and deals contiguous runs
+// of chunks onto the workers' deques. A worker takes chunks from the front of
+// its own deque; when that runs dry, it steals from the back of another's. All
+// in-flight kernels share the same workers and deques, so concurrently-issued
+// kernels interleave instead of oversubscribing the cores.
+//
+// The issuing thread executes chunks too, and then waits for stragglers by
+// briefly polling an atomic count of outstanding iterations; if they're still
+// running after that, it parks until the thread completing the last iteration
+// wakes it.
+class Scheduler final {
+ public:
+  // Creates a scheduler with the indicated number of workers. If workers is
+  // zero, the scheduler uses one worker per physical core.
+  explicit Scheduler(std::size_t workers = 0);
+
+  // Creates a scheduler with one worker pinned to each of the indicated CPUs.
+  explicit Scheduler(const std::vector<std::size_t>& cpus);
+
+  ~Scheduler();
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  std::size_t size() const { return workers_.size(); }
+
+  // Invokes body(begin, end) over disjoint subranges covering [0, count), and
+  // returns once all of them have completed. The body must not throw.
+  void ParallelFor(std::size_t count, const std::function<void(std::size_t, std::size_t)>& body);
+
+ private:
+  struct Job {
+    const std::function<void(std::size_t, std::size_t)>* body;
+    std::atomic<std::size_t> remaining;  // Iterations not yet completed
+    std::mutex mu;
+    std::condition_variable done_cv;
+    bool done = false;  // Set, under mu, by the thread completing the last iteration
+  };
+
+  struct Chunk {
+    Job* job;
+    std::size_t begin;
+    std::size_t end;
+  };
+
+  struct Worker {
+    std::mutex mu;
+    std::deque<Chunk> chunks;
+    std::thread thread;
+  };
+
+  void Start(std::size_t workers, const std::vector<std::size_t>& cpus);
+  void WorkerMain(std::size_t slot);
+  bool RunOne(std::size_t slot);
+  bool Pop(std::size_t slot, Chunk* chunk);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<std::size_t> queued_{0};  // Chunks sitting in any deque
+  std::mutex idle_mu_;
+  std::condition_variable idle_cv_;
+  bool shutdown_ = false;
+};
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
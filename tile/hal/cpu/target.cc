@@ -0,0 +1,27 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/hal/cpu/target.h"
+
+#include <utility>
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+
+std::vector<Target> CodegenTargets() {
+  const Target& host = HostTarget();
+  std::vector<Target> targets{host};
+  if (!targets::cpu::PortableRequested()) {
+    return targets;
+  }
+  for (auto& target : targets::cpu::PortableTargets(host.triple)) {
+    targets.emplace_back(std::move(target));
+  }
+  return targets;
+}
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
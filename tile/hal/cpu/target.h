@@ -0,0 +1,31 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <vector>
+
+#include "tile/targets/cpu/isa.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+
+// Targets, and the ISA ladder used for portable code, are shared with the
+// stripe JIT.
+using targets::cpu::SelectTarget;
+using targets::cpu::Target;
+
+inline const Target& HostTarget() { return targets::cpu::HostIsa(); }
+
+// Returns the targets a serialized kernel carries code for, host first. If
+// PLAIDML_CPU_PORTABLE is set on an x86-64 host, the host is followed by the
+// portable x86-64 ISA levels, so that a serialized library runs well on any
+// host in a mixed fleet. Kernels are only ever run on the host, so code for
+// the other targets is generated when a library is serialized.
+std::vector<Target> CodegenTargets();
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
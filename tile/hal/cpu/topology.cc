@@ -0,0 +1,204 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/hal/cpu/topology.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Host.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include "base/util/logging.h"
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+namespace {
+
+const char sysfs_cpu_[] = "/sys/devices/system/cpu/";
+const char sysfs_node_[] = "/sys/devices/system/node/";
+
+bool ReadFile(const std::string& path, std::string* contents) {
+  std::ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  std::getline(in, *contents);
+  return true;
+}
+
+// Parses a sysfs CPU or node list, e.g. "0-3,8,10-11".
+std::vector<std::size_t> ParseList(const std::string& list) {
+  std::vector<std::size_t> ret;
+  std::istringstream in(list);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    if (item.empty()) {
+      continue;
+    }
+    auto dash = item.find('-');
+    std::size_t first = std::stoul(item.substr(0, dash));
+    std::size_t last = dash == std::string::npos ? first : std::stoul(item.substr(dash + 1));
+    for (std::size_t idx = first; idx <= last; ++idx) {
+      ret.push_back(idx);
+    }
+  }
+  return ret;
+}
+
+// Parses a sysfs cache size, e.g. "32K".
+std::uint64_t ParseSize(const std::string& size) {
+  std::size_t end = 0;
+  std::uint64_t ret = std::stoull(size, &end);
+  if (end < size.size()) {
+    switch (size[end]) {
+      case 'K':
+        ret <<= 10;
+        break;
+      case 'M':
+        ret <<= 20;
+        break;
+      case 'G':
+        ret <<= 30;
+        break;
+    }
+  }
+  return ret;
+}
+
+void ProbeFeatures(Topology* topo) {
+  topo->cpu_name = llvm::sys::getHostCPUName().str();
+  llvm::StringMap<bool> features;
+  if (!llvm::sys::getHostCPUFeatures(features)) {
+    return;
+  }
+  auto has = [&features](const char* name) { return features.lookup(name); };
+  if (has("avx512f")) {
+    topo->simd_bytes = 64;
+    topo->simd_registers = 32;
+  } else if (has("avx")) {
+    topo->simd_bytes = 32;
+    topo->simd_registers = 16;
+  } else if (has("neon")) {
+    topo->simd_bytes = 16;
+    topo->simd_registers = 32;
+  }
+}
+
+void ProbeCores(Topology* topo) {
+  topo->logical_cores = std::max(1u, std::thread::hardware_concurrency());
+  topo->physical_cores = topo->logical_cores;
+  std::string online;
+  if (!ReadFile(std::string(sysfs_cpu_) + "online", &online)) {
+    return;
+  }
+  // Hyperthreads of the same core share a package and core ID; we take the
+  // lowest-numbered CPU of each core to represent it.
+  std::map<std::pair<std::string, std::string>, std::size_t> cores;
+  for (auto cpu : ParseList(online)) {
+    std::string dir = std::string(sysfs_cpu_) + "cpu" + std::to_string(cpu) + "/topology/";
+    std::string package;
+    std::string core;
+    if (!ReadFile(dir + "physical_package_id", &package) || !ReadFile(dir + "core_id", &core)) {
+      return;
+    }
+    cores.emplace(std::make_pair(package, core), cpu);
+  }
+  if (!cores.empty()) {
+    topo->physical_cores = cores.size();
+    for (const auto& core : cores) {
+      topo->core_cpus.push_back(core.second);
+    }
+    std::sort(topo->core_cpus.begin(), topo->core_cpus.end());
+  }
+}
+
+void ProbeCaches(Topology* topo) {
+  for (unsigned idx = 0;; ++idx) {
+    std::string dir = std::string(sysfs_cpu_) + "cpu0/cache/index" + std::to_string(idx) + "/";
+    std::string type;
+    std::string level;
+    std::string size;
+    if (!ReadFile(dir + "type", &type) || !ReadFile(dir + "level", &level) || !ReadFile(dir + "size", &size)) {
+      break;
+    }
+    if (type == "Instruction") {
+      continue;
+    }
+    CacheLevel cache;
+    cache.level = std::stoul(level);
+    cache.size = ParseSize(size);
+    std::string shared;
+    if (ReadFile(dir + "shared_cpu_list", &shared)) {
+      cache.shared_cpus = std::max<std::size_t>(1, ParseList(shared).size());
+    }
+    std::string line;
+    if (cache.level == 1 && ReadFile(dir + "coherency_line_size", &line)) {
+      topo->cache_line = std::stoul(line);
+    }
+    topo->caches.push_back(cache);
+  }
+  std::sort(topo->caches.begin(), topo->caches.end(),
+            [](const CacheLevel& lhs, const CacheLevel& rhs) { return lhs.level < rhs.level; });
+}
+
+void ProbeNodes(Topology* topo) {
+  std::string online;
+  if (ReadFile(std::string(sysfs_node_) + "online", &online)) {
+    topo->nodes = ParseList(online);
+    topo->numa_nodes = std::max<std::size_t>(1, topo->nodes.size());
+  }
+  std::map<std::size_t, std::size_t> cpu_nodes;
+  for (auto node : topo->nodes) {
+    std::string cpus;
+    if (!ReadFile(std::string(sysfs_node_) + "node" + std::to_string(node) + "/cpulist", &cpus)) {
+      return;
+    }
+    for (auto cpu : ParseList(cpus)) {
+      cpu_nodes[cpu] = node;
+    }
+  }
+  std::vector<std::size_t> core_nodes;
+  for (auto cpu : topo->core_cpus) {
+    auto it = cpu_nodes.find(cpu);
+    if (it == cpu_nodes.end()) {
+      return;
+    }
+    core_nodes.push_back(it->second);
+  }
+  topo->core_nodes = std::move(core_nodes);
+}
+
+Topology Probe() {
+  Topology topo;
+  ProbeFeatures(&topo);
+  try {
+    ProbeCores(&topo);
+    ProbeCaches(&topo);
+    ProbeNodes(&topo);
+  } catch (const std::exception& ex) {
+    // Malformed sysfs contents; keep whatever we have.
+    IVLOG(1, "Unable to probe the CPU topology: " << ex.what());
+  }
+  IVLOG(1, "Host CPU: " << topo.cpu_name << " cores=" << topo.physical_cores << "/" << topo.logical_cores
+                        << " nodes=" << topo.numa_nodes << " simd=" << topo.simd_bytes << "x" << topo.simd_registers
+                        << " caches=" << topo.caches.size());
+  return topo;
+}
+
+}  // namespace
+
+const Topology& HostTopology() {
+  static const Topology topology = Probe();
+  return topology;
+}
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
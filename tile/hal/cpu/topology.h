@@ -0,0 +1,46 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vertexai {
+namespace tile {
+namespace hal {
+namespace cpu {
+
+// A data or unified cache level of the host processor.
+struct CacheLevel {
+  unsigned level = 0;           // 1 for L1, 2 for L2, ...
+  std::uint64_t size = 0;       // Capacity in bytes of a single instance of the cache
+  std::size_t shared_cpus = 1;  // The number of logical CPUs sharing an instance
+};
+
+// Describes the processor the HAL is running on.
+struct Topology {
+  std::string cpu_name;                 // LLVM's name for the host CPU, e.g. "skylake-avx512"
+  std::size_t logical_cores = 1;        // Hardware threads
+  std::size_t physical_cores = 1;       // Cores, not counting hyperthreads
+  std::size_t numa_nodes = 1;           // Memory nodes
+  std::vector<std::size_t> nodes;       // The memory node numbers, if known
+  std::size_t simd_bytes = 16;          // Width of the widest vector registers
+  std::size_t simd_registers = 16;      // Number of architectural vector registers
+  std::size_t cache_line = 64;          // Coherency line size
+  std::vector<CacheLevel> caches;       // Innermost level first
+  std::vector<std::size_t> core_cpus;   // One logical CPU number per physical core, if known
+  std::vector<std::size_t> core_nodes;  // The memory node of each of core_cpus, if known
+};
+
+// Returns the topology of the host processor. The probe reads the CPU's
+// feature flags through LLVM (which queries CPUID on x86) and the cache and
+// node layout from sysfs; anything it cannot determine keeps the defaults
+// above. The host is probed once, on first use.
+const Topology& HostTopology();
+
+}  // namespace cpu
+}  // namespace hal
+}  // namespace tile
+}  // namespace vertexai
@@ -67,6 +67,7 @@ lang::HardwareSettings ToHardwareSettings(const proto::HardwareSettings& setting
   result.goal_flops_per_byte = settings.goal_flops_per_byte();
   result.goal_dimension_sizes = std::move(dim_sizes);
   result.disable_io_aliasing = settings.disable_io_aliasing();
+  result.cache_sizes.assign(settings.cache_sizes().begin(), settings.cache_sizes().end());
 
   return result;
 }
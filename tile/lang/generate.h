@@ -50,6 +50,7 @@ struct HardwareSettings : public DirectSettings {
   uint64_t goal_flops_per_byte;                   // Where do we hit the ceiling on flops/byte
   std::vector<std::size_t> goal_dimension_sizes;  // How big to make each dimension in a work group
   bool disable_io_aliasing;
+  std::vector<std::uint64_t> cache_sizes;  // Per-work-group capacity of each cache level, innermost first
 };
 
 typedef std::array<size_t, 3> GridSize;
@@ -22,6 +22,7 @@
 #include "tile/math/matrix.h"
 
 #include "base/util/catch.h"
+#include "base/util/env.h"
 #include "base/util/logging.h"
 
 namespace vertexai {
@@ -160,6 +161,51 @@ TEST_CASE("Optimization of Convolution", "[conv_opt][opt]") {
   REQUIRE(score2 > .4);
 }
 
+TEST_CASE("TileOptimize memo keeps the most recently used results", "[opt]") {
+  env::Set("PLAIDML_TILE_OPT_MEMO_ENTRIES", "2");
+  ClearTileOptimizeMemo();
+  Parser p;
+  auto c = p.ParseContraction("O[i, j] = +(A[i, k] * B[k, j])");
+  auto optimize = [&](uint64_t size) {
+    FlatContraction op = Flatten(c, {
+                                        SimpleShape(DataType::FLOAT32, {size, size}),
+                                        SimpleShape(DataType::FLOAT32, {size, size}),
+                                        SimpleShape(DataType::FLOAT32, {size, size}),
+                                    });
+    return TileOptimize(TestGPU(), op, true).rbegin()->second;
+  };
+  auto first = optimize(16);
+  optimize(32);
+  REQUIRE(TileOptimizeMemoSize() == 2);
+  optimize(64);
+  REQUIRE(TileOptimizeMemoSize() == 2);
+  REQUIRE(optimize(16) == first);
+  REQUIRE(TileOptimizeMemoSize() == 2);
+  env::Set("PLAIDML_TILE_OPT_MEMO_ENTRIES", "");
+  ClearTileOptimizeMemo();
+}
+
+TEST_CASE("Cache hierarchy penalizes spilled working sets", "[opt]") {
+  auto settings = TestGPU();
+  proto::PerfStats perf;
+  perf.set_true_ops(1 << 20);
+  perf.set_work_groups(settings.goal_groups);
+  perf.set_inner_loops(1);
+  perf.set_mem_read(4096);
+  perf.set_mem_write(1024);
+  perf.set_out_regs(1024);
+  perf.set_operations(settings.threads);
+  perf.set_threads_used(settings.threads);
+  double uncached = ComputeScore(settings, perf);
+  settings.cache_sizes = {8 * 1024, 64 * 1024};
+  REQUIRE(ComputeScore(settings, perf) == uncached);
+  settings.cache_sizes = {4 * 1024, 64 * 1024};
+  double spilled = ComputeScore(settings, perf);
+  REQUIRE(spilled < uncached);
+  settings.cache_sizes = {2 * 1024, 4 * 1024};
+  REQUIRE(ComputeScore(settings, perf) < spilled);
+}
+
 TEST_CASE("Vectorized Flop Computation", "[conv_opt][opt]") {
   Parser p;
   auto c = p.ParseContraction("O[n, x, y, co] = +(K[i, j, co, ci] * I[n, x+i, y+j, ci])");
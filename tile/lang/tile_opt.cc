@@ -2,9 +2,18 @@
 #include "tile/lang/tile_opt.h"
 
 #include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <list>
+#include <mutex>
 #include <set>
+#include <sstream>
+#include <unordered_map>
 #include <utility>
 
+#include "base/util/env.h"
+#include "base/util/logging.h"
+#include "base/util/thread_pool.h"
 #include "tile/lang/out_plan.h"
 #include "tile/lang/read_plan.h"
 #include "tile/math/util.h"
@@ -223,24 +232,141 @@ double ComputeScore(const HardwareSettings& settings, const proto::PerfStats& pe
   // Compute the logical amount memory io (ignoring OOB)
   double bytes = perf.work_groups() * (perf.inner_loops() * perf.mem_read() + perf.mem_write());
   double flops_per_byte = perf.true_ops() / bytes;
-  double roof = std::min(flops_per_byte, static_cast<double>(settings.goal_flops_per_byte));
+  // On devices with a cache hierarchy, a work group is fed from the innermost
+  // cache level that holds its working set; each level further out delivers
+  // roughly half the bandwidth of the one inside it.
+  double bandwidth = 1.0;
+  if (!settings.cache_sizes.empty()) {
+    std::uint64_t working_set = perf.mem_read() + perf.mem_write() + perf.out_regs();
+    for (auto cache_size : settings.cache_sizes) {
+      if (working_set <= cache_size) {
+        break;
+      }
+      bandwidth /= 2;
+    }
+  }
+  double roof = std::min(flops_per_byte * bandwidth, static_cast<double>(settings.goal_flops_per_byte));
   double occupancy = std::min(perf.work_groups(), settings.goal_groups);
   double thread_ratio = perf.threads_used() / static_cast<double>(settings.threads);
   double roof_ratio = roof / static_cast<double>(settings.goal_flops_per_byte);
   double occ_ratio = occupancy / static_cast<double>(settings.goal_groups);
   double score = roof_ratio * occ_ratio * thread_ratio;
-  IVLOG(4, "  flops_per_byte=" << flops_per_byte << " occupancy=" << occupancy);
+  IVLOG(4, "  flops_per_byte=" << flops_per_byte << " bandwidth=" << bandwidth << " occupancy=" << occupancy);
   IVLOG(4, "  roof_ratio=" << roof_ratio << " occ_ratio=" << occ_ratio << " thread_ratio=" << thread_ratio
                            << " score=" << score);
   return score;
 }
 
-std::multimap<double, std::vector<uint64_t>> TileOptimize(const HardwareSettings& settings, const FlatContraction& op,
-                                                          bool fast) {
-  std::multimap<double, std::vector<uint64_t>> by_score;
+namespace {
+
+typedef std::multimap<double, std::vector<uint64_t>> TileScores;
+
+// Describes everything ComputeTileStats and ComputeScore consult, so that
+// searches over identical contractions on identical hardware share a result.
+std::string TileSearchKey(const HardwareSettings& settings, const FlatContraction& op, bool fast) {
+  std::ostringstream key;
+  key << op.TileKeyString() << ';' << op.post_ops.size() << ';' << op.kernel_outputs.size() << ';';
+  for (const auto& op_input : op.post_op_inputs) {
+    key << to_string(op_input.binding.shape.type) << ',';
+  }
+  key << ';' << settings.threads << ',' << settings.use_global << ',' << settings.mem_width << ','
+      << settings.max_mem << ',' << settings.max_regs << ',' << settings.goal_groups << ','
+      << settings.goal_flops_per_byte << ';';
+  for (auto cache_size : settings.cache_sizes) {
+    key << cache_size << ',';
+  }
+  key << ';' << fast;
+  return key.str();
+}
+
+// The memo keeps the most recently used results, up to a limit, so that a
+// long-lived process compiling many distinct shapes doesn't grow without bound.
+struct TileSearchMemo {
+  using Entries = std::list<std::pair<std::string, TileScores>>;
+
+  std::mutex mu;
+  Entries entries;  // Most recently used first
+  std::unordered_map<std::string, Entries::iterator> index;
+};
+
+const std::size_t kDefaultMemoEntries = 1024;
+
+// Returns the most results the memo holds, from PLAIDML_TILE_OPT_MEMO_ENTRIES.
+std::size_t MemoEntries() {
+  auto entries = env::Get("PLAIDML_TILE_OPT_MEMO_ENTRIES");
+  if (entries.empty()) {
+    return kDefaultMemoEntries;
+  }
+  if (9 < entries.size() || !std::all_of(entries.begin(), entries.end(), [](char c) { return std::isdigit(c); })) {
+    LOG(WARNING) << "Ignoring malformed PLAIDML_TILE_OPT_MEMO_ENTRIES: " << entries;
+    return kDefaultMemoEntries;
+  }
+  return std::stoul(entries);
+}
+
+TileSearchMemo& GetTileSearchMemo() {
+  static TileSearchMemo memo;
+  return memo;
+}
+
+// Returns the tiles reached by doubling one dimension of the given tile that
+// have not been scored yet.
+std::vector<std::vector<uint64_t>> UnscoredNeighbors(const FlatContraction& op, std::vector<uint64_t> tile,
+                                                     const std::map<std::vector<uint64_t>, double>& by_tile,
+                                                     const std::map<std::vector<uint64_t>, double>& scored) {
+  std::vector<std::vector<uint64_t>> ret;
+  for (size_t i = 0; i < tile.size(); i++) {
+    uint64_t prev = tile[i];
+    tile[i] = std::min(2 * tile[i], op.ranges[i]);
+    if (!by_tile.count(tile) && !scored.count(tile)) {
+      ret.push_back(tile);
+    }
+    tile[i] = prev;
+  }
+  return ret;
+}
+
+// Scores the unexplored neighbors of the tile being expanded, together with
+// those of the most promising tiles left on the frontier, across the global
+// thread pool. The frontier scores are speculative: the search visits one tile
+// at a time, and may stop (in fast mode) before reaching some of them. It
+// consumes the scores exactly where it would otherwise have computed them, so
+// the outcome of the search does not depend on the speculation.
+void ScoreNeighbors(const HardwareSettings& settings, const FlatContraction& op, const std::vector<uint64_t>& tile,
+                    const std::set<std::pair<double, std::vector<uint64_t>>>& to_do,
+                    const std::map<std::vector<uint64_t>, double>& by_tile,
+                    std::map<std::vector<uint64_t>, double>* scored) {
+  auto& pool = ThreadPool::Global();
+  auto tiles = UnscoredNeighbors(op, tile, by_tile, *scored);
+  if (tiles.empty()) {
+    return;
+  }
+  std::set<std::vector<uint64_t>> pending(tiles.begin(), tiles.end());
+  size_t width = pool.size();
+  for (auto it = to_do.rbegin(); it != to_do.rend() && width; ++it, --width) {
+    for (auto& neighbor : UnscoredNeighbors(op, it->second, by_tile, *scored)) {
+      if (pending.insert(neighbor).second) {
+        tiles.emplace_back(std::move(neighbor));
+      }
+    }
+  }
+  std::vector<double> scores(tiles.size());
+  pool.ParallelFor(tiles.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      scores[i] = ComputeScore(settings, ComputeTileStats(settings, op, tiles[i]));
+    }
+  });
+  for (size_t i = 0; i < tiles.size(); i++) {
+    scored->emplace(tiles[i], scores[i]);
+  }
+}
+
+TileScores SearchTiles(const HardwareSettings& settings, const FlatContraction& op, bool fast, bool parallel) {
+  TileScores by_score;
   size_t sz = op.ranges.size();
 
   std::map<std::vector<uint64_t>, double> by_tile;
+  std::map<std::vector<uint64_t>, double> scored;
   std::set<std::pair<double, std::vector<uint64_t>>> to_do;
   IVLOG(3, "Computing optimal tile cost");
   std::vector<uint64_t> tile(sz, 1);
@@ -256,11 +382,20 @@ std::multimap<double, std::vector<uint64_t>> TileOptimize(const HardwareSettings
     score = it->first;
     tile = it->second;
     to_do.erase(*it);
+    if (parallel) {
+      ScoreNeighbors(settings, op, tile, to_do, by_tile, &scored);
+    }
     for (size_t i = 0; i < sz; i++) {
       uint64_t prev = tile[i];
       tile[i] = std::min(2 * tile[i], op.ranges[i]);
       if (!by_tile.count(tile)) {
-        score = ComputeScore(settings, ComputeTileStats(settings, op, tile));
+        auto known = scored.find(tile);
+        if (known != scored.end()) {
+          score = known->second;
+          scored.erase(known);
+        } else {
+          score = ComputeScore(settings, ComputeTileStats(settings, op, tile));
+        }
         by_tile.emplace(tile, score);
         by_score.emplace(score, tile);
         if (score > 0) {
@@ -275,6 +410,56 @@ std::multimap<double, std::vector<uint64_t>> TileOptimize(const HardwareSettings
   return by_score;
 }
 
+}  // namespace
+
+std::multimap<double, std::vector<uint64_t>> TileOptimize(const HardwareSettings& settings, const FlatContraction& op,
+                                                          bool fast) {
+  bool parallel = env::Get("PLAIDML_TILE_OPT_PARALLEL") != "0";
+  if (env::Get("PLAIDML_TILE_OPT_MEMO") == "0") {
+    return SearchTiles(settings, op, fast, parallel);
+  }
+  auto& memo = GetTileSearchMemo();
+  auto key = TileSearchKey(settings, op, fast);
+  {
+    std::lock_guard<std::mutex> lock{memo.mu};
+    auto it = memo.index.find(key);
+    if (it != memo.index.end()) {
+      memo.entries.splice(memo.entries.begin(), memo.entries, it->second);
+      IVLOG(3, "Reusing optimal tile: " << it->second->second.rbegin()->second);
+      return it->second->second;
+    }
+  }
+  // Concurrent searches for the same key may race to fill the entry; they
+  // compute identical results, so whichever lands first is kept.
+  auto by_score = SearchTiles(settings, op, fast, parallel);
+  auto limit = MemoEntries();
+  TileSearchMemo::Entries evicted;  // Destroyed after the lock is released
+  std::lock_guard<std::mutex> lock{memo.mu};
+  if (limit && !memo.index.count(key)) {
+    memo.entries.emplace_front(key, by_score);
+    memo.index.emplace(std::move(key), memo.entries.begin());
+  }
+  while (limit < memo.entries.size()) {
+    memo.index.erase(memo.entries.back().first);
+    evicted.splice(evicted.end(), memo.entries, std::prev(memo.entries.end()));
+  }
+  return by_score;
+}
+
+void ClearTileOptimizeMemo() {
+  auto& memo = GetTileSearchMemo();
+  TileSearchMemo::Entries evicted;
+  std::lock_guard<std::mutex> lock{memo.mu};
+  memo.index.clear();
+  evicted.swap(memo.entries);
+}
+
+std::size_t TileOptimizeMemoSize() {
+  auto& memo = GetTileSearchMemo();
+  std::lock_guard<std::mutex> lock{memo.mu};
+  return memo.entries.size();
+}
+
 }  // namespace lang
 }  // namespace tile
 }  // namespace vertexai
@@ -23,10 +23,20 @@ proto::PerfStats ComputeTileStats(const DirectSettings& settings, const FlatCont
 // Compute score from PerfStats
 double ComputeScore(const HardwareSettings& settings, const proto::PerfStats& perf);
 
-// Performs tile size optimization
+// Performs tile size optimization.  Results are memoized, keyed on the
+// contraction's tiling-relevant shape and the hardware settings; the memo keeps
+// the 1024 most recently used results (PLAIDML_TILE_OPT_MEMO_ENTRIES overrides
+// the limit).  Set PLAIDML_TILE_OPT_MEMO=0 to disable the memo, or
+// PLAIDML_TILE_OPT_PARALLEL=0 to score candidate tiles on a single thread.
 std::multimap<double, std::vector<uint64_t>> TileOptimize(const HardwareSettings& settings, const FlatContraction& op,
                                                           bool fast);
 
+// Discards all memoized TileOptimize results.
+void ClearTileOptimizeMemo();
+
+// Returns the number of memoized TileOptimize results.
+std::size_t TileOptimizeMemoSize();
+
 }  // namespace lang
 }  // namespace tile
 }  // namespace vertexai
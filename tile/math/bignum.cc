@@ -1,13 +1,82 @@
 
 #include "tile/math/bignum.h"
 
+#include <limits>
+
 #include <boost/math/common_factor_rt.hpp>
 
 namespace vertexai {
 namespace tile {
 namespace math {
 
+namespace {
+
+bool FitsInt64(const Integer& x) {
+  return x > std::numeric_limits<int64_t>::min() && x <= std::numeric_limits<int64_t>::max();
+}
+
+}  // namespace
+
+Rational::Rational(const Integer& value) : num_{0}, den_{1} {
+  if (FitsInt64(value)) {
+    num_ = static_cast<int64_t>(value);
+  } else {
+    big_ = std::make_shared<const BigRational>(value);
+  }
+}
+
+Rational::Rational(const BigRational& value) : num_{0}, den_{1} {
+  Integer num = boost::multiprecision::numerator(value);
+  Integer den = boost::multiprecision::denominator(value);
+  if (FitsInt64(num) && FitsInt64(den)) {
+    num_ = static_cast<int64_t>(num);
+    den_ = static_cast<int64_t>(den);
+  } else {
+    big_ = std::make_shared<const BigRational>(value);
+  }
+}
+
+Rational::Rational(const Integer& num, const Integer& den) : num_{0}, den_{1} {
+  if (FitsInt64(num) && FitsInt64(den)) {
+    SetInline(static_cast<int64_t>(num), static_cast<int64_t>(den));
+  } else if (den < 0) {
+    *this = Rational{BigRational{-num, -den}};
+  } else {
+    *this = Rational{BigRational{num, den}};
+  }
+}
+
+void Rational::SetInline(int64_t num, int64_t den) {
+  if (den == 0) {
+    throw std::overflow_error("Division by zero.");
+  }
+  if (den < 0) {
+    num = -num;
+    den = -den;
+  }
+  int64_t g = detail::Gcd(detail::Magnitude(num), den);
+  num_ = num / g;
+  den_ = den / g;
+}
+
+std::string Rational::str() const {
+  if (big_) {
+    return big_->str();
+  }
+  if (den_ == 1) {
+    return std::to_string(num_);
+  }
+  return std::to_string(num_) + "/" + std::to_string(den_);
+}
+
 Integer Floor(const Rational& x) {
+  if (!x.big_) {
+    int64_t q = x.num_ / x.den_;
+    if (x.num_ % x.den_ && x.num_ < 0) {
+      --q;
+    }
+    return q;
+  }
   if (x < 0) {
     return (numerator(x) - denominator(x) + 1) / denominator(x);
   } else {
@@ -76,6 +145,17 @@ Rational XGCD(const Rational& a, const Rational& b, Integer& x, Integer& y) {  /
 }
 
 Rational GCD(const Rational& a, const Rational& b) {
+  if (!a.big_ && !b.big_) {
+    // Scale both to integers over the common denominator m, whose gcd over m is the result.
+    int64_t g = detail::Gcd(a.den_, b.den_);
+    int64_t m;
+    int64_t an;
+    int64_t bn;
+    if (detail::CheckedMul(a.den_ / g, b.den_, &m) && detail::CheckedMul(a.num_, m / a.den_, &an) &&
+        detail::CheckedMul(b.num_, m / b.den_, &bn)) {
+      return Rational(detail::Gcd(detail::Magnitude(an), detail::Magnitude(bn)), m);
+    }
+  }
   Integer m = boost::math::lcm(denominator(a), denominator(b));
   Integer g = boost::math::gcd(numerator(a * m), numerator(b * m));
   return Rational(g, m);
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 
 #include <boost/multiprecision/cpp_int.hpp>
 
@@ -11,7 +17,266 @@ namespace math {
 typedef boost::multiprecision::cpp_int_backend<> IntegerBackend;
 typedef boost::multiprecision::rational_adaptor<IntegerBackend> RationalBackend;
 typedef boost::multiprecision::number<IntegerBackend, boost::multiprecision::et_off> Integer;
-typedef boost::multiprecision::number<RationalBackend, boost::multiprecision::et_off> Rational;
+typedef boost::multiprecision::number<RationalBackend, boost::multiprecision::et_off> BigRational;
+
+namespace detail {
+
+// Overflow-checked int64 arithmetic.  These fail if the result doesn't fit, and also if it is INT64_MIN, which
+// Rational never holds inline, so that negating an inline value can't overflow.
+inline bool CheckedAdd(int64_t a, int64_t b, int64_t* r) {
+#if defined(__GNUC__) || defined(__clang__)
+  if (__builtin_add_overflow(a, b, r)) {
+    return false;
+  }
+#else
+  if ((b > 0 && a > std::numeric_limits<int64_t>::max() - b) ||
+      (b < 0 && a < std::numeric_limits<int64_t>::min() - b)) {
+    return false;
+  }
+  *r = a + b;
+#endif
+  return *r != std::numeric_limits<int64_t>::min();
+}
+
+// As above; a and b must not be INT64_MIN.
+inline bool CheckedMul(int64_t a, int64_t b, int64_t* r) {
+#if defined(__GNUC__) || defined(__clang__)
+  if (__builtin_mul_overflow(a, b, r)) {
+    return false;
+  }
+#else
+  uint64_t ua = a < 0 ? -static_cast<uint64_t>(a) : a;
+  uint64_t ub = b < 0 ? -static_cast<uint64_t>(b) : b;
+  if (ua && ub > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) / ua) {
+    return false;
+  }
+  *r = a * b;
+#endif
+  return *r != std::numeric_limits<int64_t>::min();
+}
+
+// The greatest common divisor of two non-negative values.
+inline int64_t Gcd(int64_t a, int64_t b) {
+  while (b) {
+    int64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+inline int64_t Magnitude(int64_t a) { return a < 0 ? -a : a; }
+
+}  // namespace detail
+
+// An exact rational number.
+//
+// Nearly every coefficient, offset, and range the compiler reasons about fits comfortably in 64 bits, so Rational
+// keeps its numerator and denominator inline as int64s and does its arithmetic in machine integers, checking each
+// step for overflow.  A result which doesn't fit is computed as a BigRational (an arbitrary-precision
+// boost::multiprecision rational), which the value then shares until it's reassigned.
+//
+// Values are always in lowest terms with a positive denominator, and are held inline whenever they fit, so equal
+// values always have equal representations.
+class Rational {
+ public:
+  Rational() : num_{0}, den_{1} {}
+
+  template <typename I, typename = typename std::enable_if<std::is_integral<I>::value>::type>
+  Rational(I value) : num_{0}, den_{1} {  // NOLINT(runtime/explicit)
+    if (FitsInline(value)) {
+      num_ = static_cast<int64_t>(value);
+    } else {
+      *this = Rational{BigRational{Integer{value}}};
+    }
+  }
+
+  template <typename I, typename J, typename = typename std::enable_if<std::is_integral<I>::value>::type,
+            typename = typename std::enable_if<std::is_integral<J>::value>::type>
+  Rational(I num, J den) : num_{0}, den_{1} {
+    if (FitsInline(num) && FitsInline(den)) {
+      SetInline(static_cast<int64_t>(num), static_cast<int64_t>(den));
+    } else {
+      *this = Rational{Integer{num}, Integer{den}};
+    }
+  }
+
+  // clang-format off
+  //cppcheck-suppress noExplicitConstructor  // NOLINT
+  Rational(const Integer& value);  // NOLINT(runtime/explicit)
+  //cppcheck-suppress noExplicitConstructor  // NOLINT
+  Rational(const BigRational& value);  // NOLINT(runtime/explicit)
+  // clang-format on
+  Rational(const Integer& num, const Integer& den);
+
+  // The value as an arbitrary-precision rational.
+  BigRational big() const { return big_ ? *big_ : BigRational{num_, den_}; }
+
+  std::string str() const;
+
+  explicit operator bool() const { return big_ || num_; }
+
+  // As for boost::multiprecision rationals, conversion to an integral type truncates towards zero.
+  template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value &&
+                                                           !std::is_same<T, bool>::value>::type>
+  explicit operator T() const {
+    if (big_) {
+      return static_cast<T>(*big_);
+    }
+    return std::is_integral<T>::value ? static_cast<T>(num_ / den_) : static_cast<T>(num_) / static_cast<T>(den_);
+  }
+
+  Rational operator-() const {
+    if (big_) {
+      return Rational{-*big_};
+    }
+    Rational result;
+    result.num_ = -num_;
+    result.den_ = den_;
+    return result;
+  }
+  Rational operator+() const { return *this; }
+
+  Rational& operator+=(const Rational& rhs) {
+    if (big_ || rhs.big_ || !AddInline(rhs.num_, rhs.den_)) {
+      *this = Rational{big() + rhs.big()};
+    }
+    return *this;
+  }
+  Rational& operator-=(const Rational& rhs) {
+    if (big_ || rhs.big_ || !AddInline(-rhs.num_, rhs.den_)) {
+      *this = Rational{big() - rhs.big()};
+    }
+    return *this;
+  }
+  Rational& operator*=(const Rational& rhs) {
+    if (big_ || rhs.big_ || !MulInline(rhs.num_, rhs.den_)) {
+      *this = Rational{big() * rhs.big()};
+    }
+    return *this;
+  }
+  Rational& operator/=(const Rational& rhs) {
+    if (rhs == 0) {
+      throw std::overflow_error("Division by zero.");
+    }
+    if (big_ || rhs.big_ || !MulInline(rhs.num_ < 0 ? -rhs.den_ : rhs.den_, detail::Magnitude(rhs.num_))) {
+      *this = Rational{big() / rhs.big()};
+    }
+    return *this;
+  }
+
+  friend Rational operator+(Rational lhs, const Rational& rhs) { return lhs += rhs; }
+  friend Rational operator-(Rational lhs, const Rational& rhs) { return lhs -= rhs; }
+  friend Rational operator*(Rational lhs, const Rational& rhs) { return lhs *= rhs; }
+  friend Rational operator/(Rational lhs, const Rational& rhs) { return lhs /= rhs; }
+
+  friend bool operator==(const Rational& lhs, const Rational& rhs) {
+    if (lhs.big_ || rhs.big_) {
+      // Inline and big values are never equal.
+      return lhs.big_ && rhs.big_ && *lhs.big_ == *rhs.big_;
+    }
+    return lhs.num_ == rhs.num_ && lhs.den_ == rhs.den_;
+  }
+  friend bool operator!=(const Rational& lhs, const Rational& rhs) { return !(lhs == rhs); }
+  friend bool operator<(const Rational& lhs, const Rational& rhs) { return Compare(lhs, rhs) < 0; }
+  friend bool operator>(const Rational& lhs, const Rational& rhs) { return Compare(lhs, rhs) > 0; }
+  friend bool operator<=(const Rational& lhs, const Rational& rhs) { return Compare(lhs, rhs) <= 0; }
+  friend bool operator>=(const Rational& lhs, const Rational& rhs) { return Compare(lhs, rhs) >= 0; }
+
+  friend Integer numerator(const Rational& x) {
+    return x.big_ ? boost::multiprecision::numerator(*x.big_) : Integer{x.num_};
+  }
+  friend Integer denominator(const Rational& x) {
+    return x.big_ ? boost::multiprecision::denominator(*x.big_) : Integer{x.den_};
+  }
+  friend Rational abs(const Rational& x) { return x < 0 ? -x : x; }
+
+  friend std::ostream& operator<<(std::ostream& os, const Rational& x) { return os << x.str(); }
+
+  friend Integer Floor(const Rational& x);
+  friend Rational GCD(const Rational& a, const Rational& b);
+
+ private:
+  template <typename I>
+  static bool FitsInline(I value) {
+    if (std::is_signed<I>::value) {
+      return static_cast<int64_t>(value) != std::numeric_limits<int64_t>::min();
+    }
+    return static_cast<uint64_t>(value) <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+  }
+
+  // Sets the value to num / den, both of which must fit inline.
+  void SetInline(int64_t num, int64_t den);
+
+  // Adds or multiplies the inline value by num / den (which must be in lowest terms, with den positive), returning
+  // false and leaving the value unchanged if the result doesn't fit inline.
+  bool AddInline(int64_t num, int64_t den) {
+    int64_t a = num_;
+    int64_t b = den_;
+    if (b == 1 && den == 1) {
+      int64_t sum;
+      if (!detail::CheckedAdd(a, num, &sum)) {
+        return false;
+      }
+      num_ = sum;
+      return true;
+    }
+    // Knuth's addition: with g = gcd(b, d), a/b + c/d = t / (b/g * d) where t = a*(d/g) + c*(b/g), and the only
+    // common factors t can have with the denominator are those it has with g.
+    int64_t g = detail::Gcd(b, den);
+    int64_t ad;
+    int64_t cb;
+    int64_t t;
+    if (!detail::CheckedMul(a, den / g, &ad) || !detail::CheckedMul(num, b / g, &cb) || !detail::CheckedAdd(ad, cb, &t)) {
+      return false;
+    }
+    int64_t g2 = g == 1 ? 1 : detail::Gcd(detail::Magnitude(t), g);
+    int64_t d;
+    if (!detail::CheckedMul(b / g, den / g2, &d)) {
+      return false;
+    }
+    num_ = t / g2;
+    den_ = t ? d : 1;
+    return true;
+  }
+
+  bool MulInline(int64_t num, int64_t den) {
+    if (num_ == 0 || num == 0) {
+      num_ = 0;
+      den_ = 1;
+      return true;
+    }
+    // Cancel across the product first, so that it's already in lowest terms.
+    int64_t g1 = detail::Gcd(detail::Magnitude(num_), den);
+    int64_t g2 = detail::Gcd(detail::Magnitude(num), den_);
+    int64_t n;
+    int64_t d;
+    if (!detail::CheckedMul(num_ / g1, num / g2, &n) || !detail::CheckedMul(den_ / g2, den / g1, &d)) {
+      return false;
+    }
+    num_ = n;
+    den_ = d;
+    return true;
+  }
+
+  static int Compare(const Rational& lhs, const Rational& rhs) {
+    if (!lhs.big_ && !rhs.big_) {
+      if (lhs.den_ == rhs.den_) {
+        return lhs.num_ < rhs.num_ ? -1 : lhs.num_ > rhs.num_;
+      }
+      int64_t l;
+      int64_t r;
+      if (detail::CheckedMul(lhs.num_, rhs.den_, &l) && detail::CheckedMul(rhs.num_, lhs.den_, &r)) {
+        return l < r ? -1 : l > r;
+      }
+    }
+    return lhs.big().compare(rhs.big());
+  }
+
+  int64_t num_;
+  int64_t den_;
+  std::shared_ptr<const BigRational> big_;  // Set if the value doesn't fit inline
+};
 
 inline std::string to_string(const Integer& x) { return x.str(); }
 inline std::string to_string(const Rational& x) { return x.str(); }
@@ -1,4 +1,7 @@
 
+#include <cstdint>
+#include <limits>
+
 #include "base/util/catch.h"
 #include "base/util/logging.h"
 #include "tile/math/basis.h"
@@ -66,6 +69,23 @@ TEST_CASE("XGCD", "[lattice]") {
   ValidateXGCD(Rational(-15, 8), Rational(-25, 6));
 }
 
+TEST_CASE("Rational overflow falls back to bignum", "[lattice]") {
+  const int64_t max = std::numeric_limits<int64_t>::max();
+  Rational big = Rational(max) + 1;
+  REQUIRE(numerator(big) == Integer(max) + 1);
+  REQUIRE(big - 1 == max);
+  REQUIRE(big > max);
+  REQUIRE(-big < -max);
+  REQUIRE(Rational(max, 3) * 3 == max);
+  Rational tiny = Rational(1, max) / 2;
+  REQUIRE(denominator(tiny) == Integer(max) * 2);
+  REQUIRE(tiny * 2 == Rational(1, max));
+  REQUIRE(Rational(1, 3) + Rational(1, 6) == Rational(1, 2));
+  REQUIRE(Rational(max - 2, max - 1) < Rational(max - 1, max));
+  REQUIRE(Floor(big / 2) == (Integer(max) + 1) / 2);
+  REQUIRE(Rational(std::numeric_limits<int64_t>::min()).str() == "-9223372036854775808");
+}
+
 TEST_CASE("From Poly Test", "[matrix][fromPoly]") {
   Polynomial<Rational> x("x"), y("y"), z("z");
   Matrix m;
@@ -118,6 +138,42 @@ TEST_CASE("Basic Polynomial<Rational> evaluation", "[]") {
   REQUIRE(r.eval({{"a0", 5}, {"a1", 9}}) == 33);
 }
 
+TEST_CASE("Interned symbols", "[symbol]") {
+  std::string name = "idx";
+  Symbol a{name}, b{"idx"}, c{"idy"};
+  REQUIRE(a == b);
+  REQUIRE(&a.str() == &b.str());
+  REQUIRE(a != c);
+  REQUIRE(a < c);
+  REQUIRE(Symbol() < a);
+  REQUIRE(Symbol().empty());
+  REQUIRE(a == name);
+}
+
+TEST_CASE("Unused symbols are released", "[symbol]") {
+  Symbol live{"live"};
+  auto before = InternedSymbolCount();
+  for (int i = 0; i < 10000; ++i) {
+    Symbol unused{"unused" + std::to_string(i)};
+  }
+  // Only the names still held by this thread's cache may remain.
+  REQUIRE(InternedSymbolCount() <= before + 1024);
+  REQUIRE(&Symbol{"live"}.str() == &live.str());
+}
+
+TEST_CASE("Polynomial<int64_t> terms stay in name order", "[]") {
+  Polynomial<int64_t> p = Polynomial<int64_t>("z", 2) + Polynomial<int64_t>("a") + 4 - Polynomial<int64_t>("m", 3);
+  REQUIRE(to_string(p) == "4 + a - 3*m + 2*z");
+  REQUIRE(p.constant() == 4);
+  REQUIRE(p["m"] == -3);
+  p -= Polynomial<int64_t>("a");
+  p.setConstant(0);
+  REQUIRE(to_string(p) == "-3*m + 2*z");
+  p.substitute("m", Polynomial<int64_t>("z") + 1);
+  REQUIRE(to_string(p) == "-3 - z");
+  REQUIRE(Polynomial<int64_t>("a") < Polynomial<int64_t>("b"));
+}
+
 TEST_CASE("HNFMatrix", "[hnf]") {
   Matrix m = MatrixLit({{0, Rational(1, 2)}, {Rational(1, 2), Rational(1, 2)}, {1, 0}});
   bool r = HermiteNormalForm(m);
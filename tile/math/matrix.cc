@@ -83,36 +83,45 @@ struct DualMatrix {
 };
 
 void Matrix::swapRows(size_t r, size_t s) {
-  for (size_t i = 0; i < size2(); i++) {
-    std::swap((*this)(r, i), (*this)(s, i));
+  if (r != s) {
+    std::swap_ranges(row(r), row(r) + size2(), row(s));
   }
 }
 
 void Matrix::multRow(size_t r, Rational multiplier) {
+  Rational* dest = row(r);
   for (size_t i = 0; i < size2(); i++) {
-    (*this)(r, i) *= multiplier;
+    if (dest[i] != 0) {
+      dest[i] *= multiplier;
+    }
   }
 }
 
 void Matrix::addRowMultToRow(size_t dest_row, size_t src_row, const Rational& multiplier) {
   if (multiplier != 0) {
+    Rational* dest = row(dest_row);
+    const Rational* src = row(src_row);
+    // Tableau rows are mostly zeros; skip them rather than multiplying them out.
     for (size_t i = 0; i < size2(); i++) {
-      (*this)(dest_row, i) += multiplier * (*this)(src_row, i);
+      if (src[i] != 0) {
+        dest[i] += multiplier * src[i];
+      }
     }
   }
 }
 
 void Matrix::makePivotAt(size_t row, size_t col) {
-  if ((*this)(row, col) == 0) {
+  Rational pivot = (*this)(row, col);
+  if (pivot == 0) {
     throw std::runtime_error("Cannot pivot matrix at entry containing 0");
   }
   for (size_t r = 0; r < size1(); ++r) {
-    if (r == row) {
+    if (r == row || (*this)(r, col) == 0) {
       continue;
     }
-    addRowMultToRow(r, row, -(*this)(r, col) / (*this)(row, col));
+    addRowMultToRow(r, row, -(*this)(r, col) / pivot);
   }
-  multRow(row, 1 / (*this)(row, col));
+  multRow(row, 1 / pivot);
 }
 
 bool Matrix::invert() {
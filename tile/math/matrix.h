@@ -2,6 +2,7 @@
 
 #include <string>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 #include <boost/numeric/ublas/io.hpp>
@@ -17,6 +18,8 @@ namespace math {
 
 class Matrix : public boost::numeric::ublas::matrix<Rational> {
  public:
+  static_assert(std::is_same<orientation_category, boost::numeric::ublas::row_major_tag>::value,
+                "Matrix row ops assume row-major storage");
   // Constructors (inherit all from ublas)
   Matrix() : boost::numeric::ublas::matrix<Rational>() {}
   Matrix(size_type size1, size_type size2) : boost::numeric::ublas::matrix<Rational>(size1, size2) {}
@@ -32,7 +35,9 @@ class Matrix : public boost::numeric::ublas::matrix<Rational> {
   Matrix(const boost::numeric::ublas::matrix_expression<AE>& ae)  // NOLINT(runtime/explicit)
       : boost::numeric::ublas::matrix<Rational>(ae) {}
 
-  // Row ops
+  // Row ops.  The storage is dense and row-major, so these walk each row as a contiguous array.
+  Rational* row(size_t r) { return &data()[r * size2()]; }
+  const Rational* row(size_t r) const { return &data()[r * size2()]; }
   void swapRows(size_t r, size_t s);
   void multRow(size_t r, Rational multiplier);
   void addRowMultToRow(size_t dest_row, size_t src_row, const Rational& multiplier);
@@ -12,12 +12,12 @@ template <typename T>
 Polynomial<T>::Polynomial() {}
 
 template <typename T>
-Polynomial<T>::Polynomial(const T& c) : Polynomial<T>("", c) {}
+Polynomial<T>::Polynomial(const T& c) : Polynomial<T>(Symbol(), c) {}
 
 template <typename T>
-Polynomial<T>::Polynomial(const std::string& i, const T& c) {
+Polynomial<T>::Polynomial(const Symbol& i, const T& c) {
   if (c) {
-    map_[i] = c;
+    map_.push_back(std::make_pair(i, c));
   }
 }
 
@@ -25,10 +25,13 @@ template <typename T>
 T Polynomial<T>::eval(const std::map<std::string, T>& values) const {
   T res = 0;
   for (const auto& kvp : map_) {
-    if (kvp.first == "") {
+    if (kvp.first.empty()) {
       res += kvp.second;
-    } else if (values.find(kvp.first) != values.end()) {
-      res += kvp.second * safe_at(values, kvp.first);
+      continue;
+    }
+    auto it = values.find(kvp.first);
+    if (it != values.end()) {
+      res += kvp.second * it->second;
     } else {
       throw std::runtime_error(
           str(boost::format("Failed to find value for %s, when evaluating %s") % kvp.first % toString()));
@@ -50,7 +53,7 @@ Polynomial<T> Polynomial<T>::partial_eval(const std::map<std::string, T>& values
 }
 
 template <typename T>
-T Polynomial<T>::operator[](const std::string& var) const {
+T Polynomial<T>::operator[](const Symbol& var) const {
   auto it = map_.find(var);
   if (it == map_.end()) {
     return 0;
@@ -59,24 +62,47 @@ T Polynomial<T>::operator[](const std::string& var) const {
 }
 
 template <typename T>
-const std::map<std::string, T>& Polynomial<T>::getMap() const {
+const typename Polynomial<T>::Map& Polynomial<T>::getMap() const {
   return map_;
 }
 
 template <typename T>
-std::map<std::string, T>& Polynomial<T>::mutateMap() {
+typename Polynomial<T>::Map& Polynomial<T>::mutateMap() {
   return map_;
 }
 
 template <typename T>
 Polynomial<T>& Polynomial<T>::operator+=(const Polynomial<T>& rhs) {
-  for (const auto& kvp : rhs.map_) {
-    T new_val = (map_[kvp.first] += kvp.second);
-    if (new_val == 0) {
-      map_.erase(kvp.first);
+  addScaled(rhs, 1);
+  return *this;
+}
+
+template <typename T>
+void Polynomial<T>::addScaled(const Polynomial<T>& rhs, const T& scale) {
+  if (rhs.map_.empty() || scale == 0) {
+    return;
+  }
+  // Both maps are sorted, so merge them, dropping terms which cancel.
+  Map sum;
+  sum.reserve(map_.size() + rhs.map_.size());
+  auto lit = map_.begin();
+  auto rit = rhs.map_.begin();
+  while (lit != map_.end() || rit != rhs.map_.end()) {
+    if (rit == rhs.map_.end() || (lit != map_.end() && lit->first < rit->first)) {
+      sum.push_back(std::move(*lit++));
+    } else if (lit == map_.end() || rit->first < lit->first) {
+      sum.push_back(std::make_pair(rit->first, rit->second * scale));
+      ++rit;
+    } else {
+      T value = lit->second + rit->second * scale;
+      if (value != 0) {
+        sum.push_back(std::make_pair(lit->first, std::move(value)));
+      }
+      ++lit;
+      ++rit;
     }
   }
-  return *this;
+  map_.swap(sum);
 }
 
 template <typename T>
@@ -91,7 +117,8 @@ bool Polynomial<T>::operator<(const Polynomial<T>& rhs) const {
 
 template <typename T>
 Polynomial<T>& Polynomial<T>::operator-=(const Polynomial<T>& rhs) {
-  return *this += -1 * rhs;
+  addScaled(rhs, -1);
+  return *this;
 }
 
 template <typename T>
@@ -118,28 +145,28 @@ Polynomial<T>& Polynomial<T>::operator/=(const T& rhs) {
 
 template <typename T>
 T Polynomial<T>::constant() const {
-  auto it = map_.find("");
-  return (it == map_.end() ? 0 : it->second);
+  auto it = map_.begin();
+  return (it == map_.end() || !it->first.empty() ? 0 : it->second);
 }
 
 template <typename T>
 void Polynomial<T>::setConstant(T value) {
   if (value == T(0)) {
-    map_.erase("");
+    map_.erase(Symbol());
   } else {
-    map_[""] = value;
+    map_[Symbol()] = value;
   }
 }
 
 template <typename T>
 T Polynomial<T>::tryDivide(const Polynomial<T>& p, bool ignoreConst) const {
   auto it = p.map_.begin();
-  if (ignoreConst && it != p.map_.end() && it->first == "") {
+  if (ignoreConst && it != p.map_.end() && it->first.empty()) {
     it++;
   }
   T val = 0;
   for (const auto& kvp : map_) {
-    if (ignoreConst && kvp.first == "") {
+    if (ignoreConst && kvp.first.empty()) {
       continue;
     }
     if (it == p.map_.end() || it->first != kvp.first) {
@@ -159,14 +186,15 @@ T Polynomial<T>::tryDivide(const Polynomial<T>& p, bool ignoreConst) const {
 }
 
 template <typename T>
-void Polynomial<T>::substitute(const std::string& var, const Polynomial<T>& replacement) {
-  if (map_.count(var) == 0) {
+void Polynomial<T>::substitute(const Symbol& var, const Polynomial<T>& replacement) {
+  auto it = map_.find(var);
+  if (it == map_.end()) {
     // If var isn't in this polynomial, nothing needs to be done
     return;
   }
-  T coeff = safe_at(map_, var);
-  map_.erase(var);
-  (*this) += coeff * replacement;
+  T coeff = it->second;
+  map_.erase(it);
+  addScaled(replacement, coeff);
 }
 
 template <typename T>
@@ -178,13 +206,13 @@ void Polynomial<T>::substitute(const std::map<std::string, Polynomial<T>>& repla
       result += Polynomial{name_value.first, name_value.second};
       continue;
     }
-    result += replacement->second * name_value.second;
+    result.addScaled(replacement->second, name_value.second);
   }
   map_.swap(result.map_);
 }
 
 template <typename T>
-void Polynomial<T>::substitute(const std::string& var, const T& replacement) {
+void Polynomial<T>::substitute(const Symbol& var, const T& replacement) {
   substitute(var, Polynomial<T>(replacement));
 }
 
@@ -195,7 +223,7 @@ Polynomial<T> Polynomial<T>::sym_eval(const std::map<std::string, Polynomial> va
     if (kvp.first.empty()) {
       out += Polynomial<T>(kvp.second);
     } else {
-      out += safe_at(values, kvp.first) * kvp.second;
+      out.addScaled(safe_at(values, kvp.first.str()), kvp.second);
     }
   }
   return out;
@@ -213,7 +241,7 @@ std::string Polynomial<T>::GetNonzeroIndex() const {
 }
 
 template <typename T>
-T Polynomial<T>::get(const std::string& name) const {
+T Polynomial<T>::get(const Symbol& name) const {
   auto it = map_.find(name);
   if (it == map_.end()) {
     return T();
@@ -246,9 +274,9 @@ std::string Polynomial<T>::toString() const {
       }
     }
     auto value = abs_value(kvp.second);
-    if (value != 1 || kvp.first == "") {
+    if (value != 1 || kvp.first.empty()) {
       ss << value;
-      if (kvp.first != "") {
+      if (!kvp.first.empty()) {
         ss << "*";
       }
     }
@@ -5,35 +5,46 @@
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <boost/operators.hpp>
 
 #include "base/util/logging.h"
 #include "tile/math/bignum.h"
+#include "tile/math/symbol.h"
 
 namespace vertexai {
 namespace tile {
 namespace math {
 
-// A linear Polynomial<Rational> of Rational coefficients
+// A linear Polynomial<Rational> of Rational coefficients.
+//
+// Terms are keyed by interned index symbols and kept in a small sorted vector,
+// so copying, comparing, and adding the small polynomials which make up most
+// affine accesses and constraints never allocates strings.
 template <typename T>
 class Polynomial : boost::additive<Polynomial<T>>,
                    boost::ring_operators<Polynomial<T>, T>,
                    boost::dividable<Polynomial<T>, T>,
                    boost::equality_comparable<Polynomial<T>> {
  public:
+  using Map = SymbolMap<T>;
+
   // Construct Polynomial<T>s
   Polynomial();  // Zero Polynomial
   // clang-format off
   //cppcheck-suppress noExplicitConstructor  // NOLINT
   Polynomial(const T& c);  // Constant Polynomial<T>  // NOLINT
   //cppcheck-suppress noExplicitConstructor  // NOLINT
-  Polynomial(const std::string& i, const T& c = 1);  // Monomial  // NOLINT
+  Polynomial(const Symbol& i, const T& c = 1);  // Monomial  // NOLINT
+  // Monomial of a named index, e.g. Polynomial<T>{"x"} or an index's std::string name
+  template <typename S, typename = typename std::enable_if<std::is_convertible<const S&, std::string>::value>::type>
+  Polynomial(const S& i, const T& c = 1) : Polynomial(Symbol(i), c) {}  // NOLINT
   // clang-format on
-  T operator[](const std::string& var) const;      // Quick coefficent access
-  const std::map<std::string, T>& getMap() const;  // Get inner map
-  std::map<std::string, T>& mutateMap();           // Get inner map for editing
+  T operator[](const Symbol& var) const;          // Quick coefficent access
+  const Map& getMap() const;                       // Get inner map
+  Map& mutateMap();                                // Get inner map for editing
   bool operator==(const Polynomial& rhs) const;    // Equality
   bool operator<(const Polynomial& rhs) const;     // Lexigraphical order
   Polynomial& operator+=(const Polynomial& rhs);   // Addition
@@ -41,7 +52,7 @@ class Polynomial : boost::additive<Polynomial<T>>,
   Polynomial operator-() const;                    // Unary minus
   Polynomial& operator*=(const T& rhs);            // Multiplication by a T
   Polynomial& operator/=(const T& rhs);            // Division by a rations
-  bool isConstant() const { return map_.size() == 0 || (map_.size() == 1 && map_.find("") != map_.end()); }
+  bool isConstant() const { return map_.size() == 0 || (map_.size() == 1 && map_.begin()->first.empty()); }
   T constant() const;         // Get the constant part of the Polynomial<T>
   void setConstant(T value);  // Set the constant part of the Polynomial<T> to value
   T eval(const std::map<std::string, T>& values) const;
@@ -50,9 +61,9 @@ class Polynomial : boost::additive<Polynomial<T>>,
   // This works even if p == 0
   T tryDivide(const Polynomial& p, bool ignoreConst = false) const;
   // Substitute replacement in for var in this polynomial
-  void substitute(const std::string& var, const Polynomial<T>& replacement);
+  void substitute(const Symbol& var, const Polynomial<T>& replacement);
   void substitute(const std::map<std::string, Polynomial<T>>& replacements);
-  void substitute(const std::string& var, const T& replacement);
+  void substitute(const Symbol& var, const T& replacement);
   // Symbolically evaluate a polynomial
   Polynomial sym_eval(const std::map<std::string, Polynomial<T>> values) const;
   // If the string has a nonzero coefficient for at least one of its nonconstant
@@ -60,14 +71,17 @@ class Polynomial : boost::additive<Polynomial<T>>,
   // which index you'll get. Returns empty string if no index w/ nonconst coeff
   std::string GetNonzeroIndex() const;
 
-  T get(const std::string& name) const;
+  T get(const Symbol& name) const;
 
   std::string toString() const;  // Pretty-print to string
 
  private:
+  // Adds scale * rhs to this polynomial
+  void addScaled(const Polynomial& rhs, const T& scale);
+
   // Map from index -> coefficient
-  // Constant offset is a coefficent of empty string
-  std::map<std::string, T> map_;
+  // Constant offset is a coefficent of the empty symbol, which sorts first
+  Map map_;
 };
 
 extern template class Polynomial<Rational>;
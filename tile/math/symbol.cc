@@ -0,0 +1,115 @@
+#include "tile/math/symbol.h"
+
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+#include <unordered_map>
+
+namespace vertexai {
+namespace tile {
+namespace math {
+
+// The interned names.  Symbols point at the table's entries, so the table is
+// never destroyed; its nodes never move, so the entries remain valid as it
+// grows.
+//
+// Every entry in the table has a nonzero count whenever mu_ is not held
+// exclusively: the last reference to a name is only dropped with mu_ held
+// exclusively, and the entry is erased before mu_ is released.  So taking a
+// reference under a shared lock never revives an entry that is being erased.
+class Symbol::Table {
+ public:
+  static Table& Get() {
+    static auto* table = new Table;
+    return *table;
+  }
+
+  Entry* Intern(const std::string& name) {
+    {
+      std::shared_lock<std::shared_timed_mutex> lock{mu_};
+      auto it = names_.find(name);
+      if (it != names_.end()) {
+        it->second.fetch_add(1, std::memory_order_relaxed);
+        return &*it;
+      }
+    }
+    std::unique_lock<std::shared_timed_mutex> lock{mu_};
+    auto it = names_.emplace(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple(0)).first;
+    it->second.fetch_add(1, std::memory_order_relaxed);
+    return &*it;
+  }
+
+  void Release(Entry* entry) {
+    // Dropping any reference but the last needs no lock.
+    auto refs = entry->second.load(std::memory_order_relaxed);
+    while (refs > 1) {
+      if (entry->second.compare_exchange_weak(refs, refs - 1, std::memory_order_acq_rel)) {
+        return;
+      }
+    }
+    std::unique_lock<std::shared_timed_mutex> lock{mu_};
+    if (entry->second.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      names_.erase(names_.find(entry->first));
+    }
+  }
+
+  std::size_t size() {
+    std::shared_lock<std::shared_timed_mutex> lock{mu_};
+    return names_.size();
+  }
+
+ private:
+  std::shared_timed_mutex mu_;
+  std::unordered_map<std::string, std::atomic<std::size_t>> names_;
+};
+
+namespace {
+
+// The most names a thread's cache holds before it starts over.
+constexpr std::size_t kCachedNames = 1024;
+
+}  // namespace
+
+Symbol::Entry* Symbol::EmptyEntry() {
+  static auto* empty = new Entry{std::piecewise_construct, std::forward_as_tuple(), std::forward_as_tuple(0)};
+  return empty;
+}
+
+void Symbol::Release(Entry* entry) {
+  if (!entry->first.empty()) {
+    Table::Get().Release(entry);
+  }
+}
+
+Symbol::Symbol() : entry_{EmptyEntry()} {}
+
+// Each thread remembers the names it has recently interned, so that repeatedly
+// naming the same indices doesn't contend for the table's lock.  The cache
+// holds references to its names, so it is cleared whenever it fills up, which
+// keeps the names it pins bounded.
+Symbol::Symbol(const std::string& name) {
+  if (name.empty()) {
+    entry_ = EmptyEntry();
+    return;
+  }
+  thread_local std::unordered_map<std::string, Symbol> cache;
+  auto it = cache.find(name);
+  if (it != cache.end()) {
+    entry_ = it->second.entry_;
+    Retain(entry_);
+    return;
+  }
+  entry_ = Table::Get().Intern(name);
+  if (cache.size() >= kCachedNames) {
+    cache.clear();
+  }
+  cache.emplace(name, *this);
+}
+
+Symbol::Symbol(const char* name) : Symbol(std::string{name}) {}
+
+std::size_t InternedSymbolCount() { return Symbol::Table::Get().size(); }
+
+}  // namespace math
+}  // namespace tile
+}  // namespace vertexai
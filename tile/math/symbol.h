@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <boost/container/small_vector.hpp>
+#include <boost/operators.hpp>
+
+namespace vertexai {
+namespace tile {
+namespace math {
+
+// An interned name.  Symbols with the same name share a single copy of it, so
+// copying a symbol never allocates, and comparing two symbols for equality is a
+// pointer comparison.  Symbols order lexicographically by name, exactly as the
+// names themselves do; the empty name sorts first.
+//
+// Interned names are reference counted: a name is dropped from the table once
+// no symbol refers to it, so the table only grows with the names in use.
+class Symbol : boost::totally_ordered<Symbol>,
+               boost::equality_comparable<Symbol, std::string>,
+               boost::equality_comparable<Symbol, const char*> {
+ public:
+  Symbol();  // The empty symbol
+  // clang-format off
+  //cppcheck-suppress noExplicitConstructor  // NOLINT
+  Symbol(const std::string& name);  // NOLINT
+  //cppcheck-suppress noExplicitConstructor  // NOLINT
+  Symbol(const char* name);  // NOLINT
+  // clang-format on
+  Symbol(const Symbol& rhs) : entry_{rhs.entry_} { Retain(entry_); }
+  Symbol(Symbol&& rhs) noexcept : entry_{rhs.entry_} { rhs.entry_ = EmptyEntry(); }
+  ~Symbol() { Release(entry_); }
+
+  Symbol& operator=(Symbol rhs) noexcept {
+    std::swap(entry_, rhs.entry_);
+    return *this;
+  }
+
+  const std::string& str() const { return entry_->first; }
+  operator const std::string&() const { return entry_->first; }  // NOLINT(runtime/explicit)
+  const char* c_str() const { return entry_->first.c_str(); }
+  bool empty() const { return entry_->first.empty(); }
+  std::size_t size() const { return entry_->first.size(); }
+
+  bool operator==(const Symbol& rhs) const { return entry_ == rhs.entry_; }
+  bool operator<(const Symbol& rhs) const { return entry_ != rhs.entry_ && entry_->first < rhs.entry_->first; }
+  bool operator==(const std::string& rhs) const { return entry_->first == rhs; }
+  bool operator==(const char* rhs) const { return entry_->first == rhs; }
+
+  std::size_t hash() const { return std::hash<const void*>{}(entry_); }
+
+  friend std::ostream& operator<<(std::ostream& os, const Symbol& sym) { return os << sym.str(); }
+  friend std::string operator+(const std::string& lhs, const Symbol& rhs) { return lhs + rhs.str(); }
+  friend std::string operator+(const Symbol& lhs, const std::string& rhs) { return lhs.str() + rhs; }
+  friend std::string operator+(const char* lhs, const Symbol& rhs) { return lhs + rhs.str(); }
+  friend std::string operator+(const Symbol& lhs, const char* rhs) { return lhs.str() + rhs; }
+
+ private:
+  // An interned name and the number of symbols referring to it.  The empty name
+  // lives outside the table and is never counted.
+  using Entry = std::pair<const std::string, std::atomic<std::size_t>>;
+  class Table;
+
+  static Entry* EmptyEntry();
+  static void Retain(Entry* entry) {
+    if (!entry->first.empty()) {
+      entry->second.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  static void Release(Entry* entry);
+
+  friend std::size_t InternedSymbolCount();
+
+  Entry* entry_;
+};
+
+// Returns the number of distinct non-empty names currently interned.
+std::size_t InternedSymbolCount();
+
+// SymbolMap maps symbols to values, keeping its entries sorted by symbol in a
+// small vector: the handful of entries a polynomial typically has live inline,
+// and lookups are linear scans comparing interned pointers.  The interface
+// follows std::map, and iteration visits the entries in the same order a
+// std::map<std::string, T> would.
+template <typename T>
+class SymbolMap : boost::totally_ordered<SymbolMap<T>> {
+ public:
+  using key_type = Symbol;
+  using mapped_type = T;
+  using value_type = std::pair<Symbol, T>;
+  using storage_type = boost::container::small_vector<value_type, 4>;
+  using size_type = std::size_t;
+  using iterator = typename storage_type::iterator;
+  using const_iterator = typename storage_type::const_iterator;
+
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+  const_iterator cbegin() const { return entries_.cbegin(); }
+  const_iterator cend() const { return entries_.cend(); }
+
+  size_type size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  void clear() { entries_.clear(); }
+  void reserve(size_type n) { entries_.reserve(n); }
+
+  iterator find(const Symbol& key) {
+    return std::find_if(entries_.begin(), entries_.end(), [&key](const value_type& kvp) { return kvp.first == key; });
+  }
+  const_iterator find(const Symbol& key) const {
+    return std::find_if(entries_.begin(), entries_.end(), [&key](const value_type& kvp) { return kvp.first == key; });
+  }
+  size_type count(const Symbol& key) const { return find(key) == end() ? 0 : 1; }
+
+  T& at(const Symbol& key) {
+    auto it = find(key);
+    if (it == end()) {
+      throw std::out_of_range{"SymbolMap::at: " + key.str()};
+    }
+    return it->second;
+  }
+  const T& at(const Symbol& key) const {
+    auto it = find(key);
+    if (it == end()) {
+      throw std::out_of_range{"SymbolMap::at: " + key.str()};
+    }
+    return it->second;
+  }
+
+  T& operator[](const Symbol& key) { return emplace(key, T()).first->second; }
+
+  template <typename V>
+  std::pair<iterator, bool> emplace(const Symbol& key, V&& value) {
+    auto it = lower_bound(key);
+    if (it != end() && it->first == key) {
+      return std::make_pair(it, false);
+    }
+    return std::make_pair(entries_.emplace(it, key, std::forward<V>(value)), true);
+  }
+  std::pair<iterator, bool> insert(const value_type& kvp) { return emplace(kvp.first, kvp.second); }
+
+  // Appends an entry which sorts after every existing entry.
+  void push_back(value_type kvp) { entries_.push_back(std::move(kvp)); }
+
+  size_type erase(const Symbol& key) {
+    auto it = find(key);
+    if (it == end()) {
+      return 0;
+    }
+    entries_.erase(it);
+    return 1;
+  }
+  iterator erase(const_iterator it) { return entries_.erase(it); }
+
+  void swap(SymbolMap& rhs) { entries_.swap(rhs.entries_); }
+
+  bool operator==(const SymbolMap& rhs) const { return entries_ == rhs.entries_; }
+  bool operator<(const SymbolMap& rhs) const {
+    return std::lexicographical_compare(entries_.begin(), entries_.end(), rhs.entries_.begin(), rhs.entries_.end());
+  }
+
+ private:
+  iterator lower_bound(const Symbol& key) {
+    return std::lower_bound(entries_.begin(), entries_.end(), key,
+                            [](const value_type& kvp, const Symbol& key) { return kvp.first < key; });
+  }
+
+  storage_type entries_;
+};
+
+}  // namespace math
+}  // namespace tile
+}  // namespace vertexai
+
+namespace std {
+
+template <>
+struct hash<vertexai::tile::math::Symbol> {
+  std::size_t operator()(const vertexai::tile::math::Symbol& sym) const { return sym.hash(); }
+};
+
+}  // namespace std
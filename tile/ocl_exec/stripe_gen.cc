@@ -29,6 +29,7 @@ KernelList GenerateProgram(const RunInfo& runinfo,       //
   options.dump_passes = !out_dir.empty();
   options.dump_passes_proto = !out_dir.empty();
   options.dbg_dir = out_dir + "/passes";
+  options.verify_passes = codegen::VerifyPassesRequested();
   IVLOG(1, *stripe->entry);
   const auto& cfgs = targets::GetConfigs();
   const auto& cfg = cfgs.configs().at(cfg_name);
@@ -5,6 +5,7 @@
 #include <utility>
 
 #include "base/util/error.h"
+#include "base/util/executor.h"
 #include "base/util/logging.h"
 
 namespace vertexai {
@@ -25,18 +26,35 @@ std::shared_ptr<Buffer> Buffer::Downcast(const std::shared_ptr<tile::Buffer>& bu
 
 Buffer::Buffer(const std::shared_ptr<DevInfo>& devinfo, const std::shared_ptr<MemStrategy>& mem_strategy,
                std::shared_ptr<MemChunk> chunk)
-    : devinfo_{devinfo}, mem_strategy_{mem_strategy}, size_{chunk->size()}, chunk_{std::move(chunk)} {}
+    : devinfo_{devinfo},
+      mem_strategy_{mem_strategy},
+      size_{chunk->size()},
+      chunk_{std::move(chunk)},
+      launched_{boost::make_ready_future().share()} {}
 
 Buffer::Buffer(const std::shared_ptr<DevInfo>& devinfo, const std::shared_ptr<MemStrategy>& mem_strategy,
                std::uint64_t size)
-    : devinfo_{devinfo}, mem_strategy_{mem_strategy}, size_{size} {}
+    : devinfo_{devinfo}, mem_strategy_{mem_strategy}, size_{size}, launched_{boost::make_ready_future().share()} {}
 
 boost::future<std::unique_ptr<View>> Buffer::MapCurrent(const context::Context& ctx) {
+  auto pending = launched();
+  if (!pending.is_ready()) {
+    // A run using this buffer is waiting for its program to compile; the current contents are whatever that run
+    // leaves behind, so we map the buffer once it's been launched.
+    context::Context ctx_copy{ctx};
+    return pending
+        .then(RuntimeExecutor(), [self = shared_from_this(), ctx = std::move(ctx_copy)](boost::shared_future<void>) {
+          return self->MapCurrent(ctx);
+        })
+        .unwrap();
+  }
   EnsureChunk(ctx);
   return chunk()->MapCurrent(ctx);
 }
 
 std::unique_ptr<View> Buffer::MapDiscard(const context::Context& ctx) {
+  // The new contents must not be clobbered by a deferred run that hasn't been launched yet.
+  launched().wait();
   EnsureChunk(ctx);
   return chunk()->MapDiscard(ctx);
 }
@@ -4,6 +4,7 @@
 
 #include <memory>
 #include <mutex>
+#include <utility>
 
 #include "tile/platform/local_machine/devinfo.h"
 #include "tile/platform/local_machine/mem_chunk.h"
@@ -43,12 +44,26 @@ class Buffer : public tile::Buffer, public std::enable_shared_from_this<Buffer>
   void RemapTo(std::shared_ptr<MemChunk> chunk);
   void EnsureChunk(const context::Context& ctx);
 
+  // Returns a future which is ready once every run using this buffer that was deferred until its program finished
+  // compiling has been launched.  Until then, the buffer's chunk does not reflect those runs.
+  boost::shared_future<void> launched() const {
+    std::lock_guard<std::mutex> lock{mu_};
+    return launched_;
+  }
+
+  // Records that a run using this buffer has been deferred until the supplied future becomes ready.
+  void DeferUntil(boost::shared_future<void> launched) {
+    std::lock_guard<std::mutex> lock{mu_};
+    launched_ = std::move(launched);
+  }
+
  private:
   const std::shared_ptr<DevInfo> devinfo_;
   const std::shared_ptr<MemStrategy> mem_strategy_;
   const std::uint64_t size_;
   mutable std::mutex mu_;
   std::shared_ptr<MemChunk> chunk_;
+  boost::shared_future<void> launched_;
 };
 
 }  // namespace local_machine
@@ -0,0 +1,309 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/platform/local_machine/cost_scheduler.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <queue>
+#include <set>
+#include <utility>
+
+#include "base/util/error.h"
+#include "tile/lang/tile_cache.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+// The most steps the scheduler will consider keeping in flight at once.
+constexpr std::size_t kMaxInFlight = 16;
+
+constexpr std::size_t kNoStep = std::numeric_limits<std::size_t>::max();
+
+// A step started by a simulation.
+struct Started {
+  std::size_t idx;      // The step
+  std::size_t held_by;  // The step whose completion made room for it to start, if it had to wait for room
+};
+
+// Simulates running an indexed schedule.  A step may start once its dependencies have completed, so long as the device
+// has room for its work groups and, if max_in_flight is non-zero, fewer than max_in_flight steps are running; of the
+// steps which may start, the one with the greatest priority does.  If size_goal is non-zero, steps which would take the
+// live temporaries past it are started only when nothing else can be, least growth first.  Returns the time at which
+// the last step completes, and, if started is non-null, fills it with the steps in the order they started.
+double Simulate(const CostModel& model, const schedule::Schedule& schedule, const std::vector<double>& priorities,
+                std::size_t max_in_flight, std::uint64_t size_goal, std::vector<Started>* started) {
+  std::size_t count = schedule.steps.size();
+  std::vector<const schedule::Step*> steps;
+  std::vector<std::vector<const schedule::Step*>> dependents(count);
+  std::vector<std::size_t> waiting(count);
+  std::map<const schedule::Alloc*, std::size_t> uses;
+  steps.reserve(count);
+  for (const auto& step : schedule.steps) {
+    steps.push_back(&step);
+    waiting[step.idx] = step.deps.size();
+    for (const auto* dep : step.deps) {
+      dependents[dep->idx].push_back(&step);
+    }
+    for (const auto* input : step.inputs) {
+      uses[input]++;
+    }
+    for (const auto& output : step.outputs) {
+      uses[output.allocp]++;
+    }
+  }
+
+  // Temporaries are live from when the first step using them starts until the last one completes.
+  std::set<const schedule::Alloc*> live;
+  std::uint64_t live_bytes = 0;
+  auto growth = [&live](const schedule::Step& step) {
+    std::uint64_t bytes = 0;
+    for (const auto& output : step.outputs) {
+      if (output.allocp->is_tmp() && !live.count(output.allocp)) {
+        bytes += output.allocp->byte_size;
+      }
+    }
+    return bytes;
+  };
+
+  std::vector<const schedule::Step*> ready;
+  std::vector<double> ready_time(count);
+  for (const auto* step : steps) {
+    if (!waiting[step->idx]) {
+      ready.push_back(step);
+    }
+  }
+  using Running = std::pair<double, std::size_t>;  // The time the step completes, and the step
+  std::priority_queue<Running, std::vector<Running>, std::greater<Running>> running;
+  std::uint64_t running_groups = 0;
+  std::size_t last_completed = kNoStep;
+  double now = 0;
+
+  for (std::size_t done = 0; done < count; ++done) {
+    // Start whatever the device has room for.
+    while (!max_in_flight || running.size() < max_in_flight) {
+      auto best = ready.end();
+      bool best_fits = false;
+      for (auto it = ready.begin(); it != ready.end(); ++it) {
+        const auto& step = **it;
+        if (running.size() && model.goal_groups() < running_groups + model.Groups(step)) {
+          continue;
+        }
+        bool fits = !size_goal || live_bytes + growth(step) <= size_goal;
+        if (best == ready.end() || (fits && !best_fits) ||
+            (fits == best_fits && (fits ? priorities[(*best)->idx] < priorities[step.idx]
+                                        : growth(step) < growth(**best)))) {
+          best = it;
+          best_fits = fits;
+        }
+      }
+      if (best == ready.end() || (!best_fits && running.size())) {
+        break;
+      }
+      const auto& step = **best;
+      ready.erase(best);
+      for (const auto& output : step.outputs) {
+        if (output.allocp->is_tmp() && live.insert(output.allocp).second) {
+          live_bytes += output.allocp->byte_size;
+        }
+      }
+      running_groups += model.Groups(step);
+      running.emplace(now + model.Time(step), step.idx);
+      if (started) {
+        started->push_back(Started{step.idx, ready_time[step.idx] < now ? last_completed : kNoStep});
+      }
+    }
+    if (running.empty()) {
+      throw error::Internal{"Unable to simulate a schedule whose dependencies form a cycle"};
+    }
+
+    // Complete the next step to finish.
+    now = running.top().first;
+    const auto& step = *steps[running.top().second];
+    running.pop();
+    running_groups -= model.Groups(step);
+    last_completed = step.idx;
+    auto release = [&](const schedule::Alloc* alloc) {
+      if (!--uses[alloc] && live.erase(alloc)) {
+        live_bytes -= alloc->byte_size;
+      }
+    };
+    for (const auto* input : step.inputs) {
+      release(input);
+    }
+    for (const auto& output : step.outputs) {
+      release(output.allocp);
+    }
+    for (const auto* dependent : dependents[step.idx]) {
+      if (!--waiting[dependent->idx]) {
+        ready.push_back(dependent);
+        ready_time[dependent->idx] = now;
+      }
+    }
+  }
+
+  return now;
+}
+
+// Adds dependencies so that no step overwrites an alloc before the steps reading its previous contents have completed;
+// AddDataflowDeps only orders each step after the writers of its inputs.
+void AddOverwriteDeps(schedule::Schedule* schedule) {
+  std::map<schedule::Alloc*, std::vector<schedule::Step*>> readers;
+  for (auto& step : schedule->steps) {
+    for (const auto& output : step.outputs) {
+      auto& alloc_readers = readers[output.allocp];
+      for (auto* reader : alloc_readers) {
+        if (reader != &step) {
+          step.deps.insert(reader);
+        }
+      }
+      alloc_readers.clear();
+    }
+    for (auto* input : step.inputs) {
+      readers[input].push_back(&step);
+    }
+  }
+}
+
+// Reorders an indexed schedule's steps by critical-path list scheduling, adding the dependencies which keep the device
+// to the simulated order.
+void ListSchedule(const CostModel& model, std::size_t max_in_flight, std::uint64_t size_goal,
+                  schedule::Schedule* schedule) {
+  // A step's priority is the length of the longest path from its start to the end of the program.  Dependencies are
+  // always on earlier steps, so walking the steps backwards visits each step's dependents before the step itself.
+  std::vector<double> priorities(schedule->steps.size());
+  std::vector<double> tails(schedule->steps.size());
+  for (auto it = schedule->steps.rbegin(); it != schedule->steps.rend(); ++it) {
+    priorities[it->idx] = tails[it->idx] + model.Time(*it);
+    for (const auto* dep : it->deps) {
+      tails[dep->idx] = std::max(tails[dep->idx], priorities[it->idx]);
+    }
+  }
+
+  std::vector<Started> started;
+  Simulate(model, *schedule, priorities, max_in_flight, size_goal, &started);
+
+  std::vector<std::list<schedule::Step>::iterator> steps;
+  for (auto it = schedule->steps.begin(); it != schedule->steps.end(); ++it) {
+    steps.push_back(it);
+  }
+  std::list<schedule::Step> ordered;
+  for (const auto& start : started) {
+    auto it = steps[start.idx];
+    if (start.held_by != kNoStep) {
+      it->deps.insert(&*steps[start.held_by]);
+    }
+    ordered.splice(ordered.end(), schedule->steps, it);
+  }
+  schedule->steps.swap(ordered);
+  schedule->Reindex();
+  RemoveImpliedDeps(schedule);
+}
+
+}  // namespace
+
+CostModel::CostModel(const lang::KernelList& kl, const hal::proto::HardwareSettings& settings)
+    : goal_groups_{std::max<std::uint64_t>(settings.goal_groups(), 1)} {
+  double flops_per_byte = std::max<std::uint64_t>(settings.goal_flops_per_byte(), 1);
+  std::vector<double> estimates;
+  double measured_time = 0;
+  double measured_estimate = 0;
+  for (const auto& ki : kl.kernels) {
+    double estimate = std::max({1.0, static_cast<double>(ki.tot_flops), ki.tot_bytes * flops_per_byte});
+    std::int64_t time = lang::TileCache::Instance()->GetDuration(ki.key, ki.settings, ki.tile.shape);
+    if (0 <= time) {
+      measured_time += time;
+      measured_estimate += estimate;
+    }
+    estimates.push_back(estimate);
+    kernel_times_.push_back(time);
+    kernel_groups_.push_back(
+        std::min(std::max<std::uint64_t>(ki.info.perf_stats().work_groups(), 1), goal_groups_));
+  }
+  double scale = 0 < measured_time ? measured_time / measured_estimate : 1;
+  for (std::size_t kidx = 0; kidx < kernel_times_.size(); ++kidx) {
+    if (kernel_times_[kidx] < 0) {
+      kernel_times_[kidx] = estimates[kidx] * scale;
+    }
+  }
+  // A copy reads and writes each of the bytes it moves.
+  byte_time_ = 2 * flops_per_byte * scale;
+}
+
+double CostModel::Time(const schedule::Step& step) const {
+  if (step.tag == schedule::Step::Tag::kCopy) {
+    return step.byte_count * byte_time_;
+  }
+  return step.kidx < kernel_times_.size() ? kernel_times_[step.kidx] : 1;
+}
+
+std::uint64_t CostModel::Groups(const schedule::Step& step) const {
+  if (step.tag == schedule::Step::Tag::kRun && step.kidx < kernel_groups_.size()) {
+    return kernel_groups_[step.kidx];
+  }
+  return 1;
+}
+
+double EstimateRunTime(const CostModel& model, const schedule::Schedule& schedule) {
+  // Steps start in schedule order.
+  std::vector<double> priorities(schedule.steps.size());
+  for (const auto& step : schedule.steps) {
+    priorities[step.idx] = -static_cast<double>(step.idx);
+  }
+  return Simulate(model, schedule, priorities, 0, 0, nullptr);
+}
+
+CostScheduler::CostScheduler(const std::shared_ptr<Placer>& placer, std::uint64_t size_goal,
+                             const hal::proto::HardwareSettings& settings)
+    : placer_{placer}, size_goal_{size_goal}, settings_{settings} {}
+
+schedule::Schedule CostScheduler::BuildSchedule(const tile::proto::Program& program, const lang::KernelList& kl) {
+  CostModel model{kl, settings_};
+
+  struct Candidate {
+    schedule::Schedule schedule;
+    std::unique_ptr<Placement> placement;
+    double run_time;
+    bool fits;
+  };
+  std::unique_ptr<Candidate> best;
+
+  for (std::size_t max_in_flight = 1;; max_in_flight *= 2) {
+    auto candidate = std::make_unique<Candidate>();
+    candidate->schedule = ToScheduleSteps(program, kl);
+    AddDataflowDeps(&candidate->schedule);
+    AddOverwriteDeps(&candidate->schedule);
+    ListSchedule(model, max_in_flight, size_goal_, &candidate->schedule);
+    candidate->placement = placer_->PlaceSchedule(program, &candidate->schedule);
+    candidate->run_time = EstimateRunTime(model, candidate->schedule);
+    candidate->fits = candidate->placement->device_memory_bytes() <= size_goal_;
+    IVLOG(1, "Cost scheduler: with up to " << max_in_flight << " steps in flight, the estimated run time is "
+                                           << candidate->run_time << " using "
+                                           << candidate->placement->device_memory_bytes() << " bytes");
+    std::size_t step_count = candidate->schedule.steps.size();
+    if (!best || (candidate->fits && !best->fits) ||
+        (candidate->fits == best->fits &&
+         (candidate->fits ? candidate->run_time < best->run_time
+                          : candidate->placement->device_memory_bytes() < best->placement->device_memory_bytes()))) {
+      best = std::move(candidate);
+    }
+    // Each step occupies at least one work group, so the device can't run more than goal_groups of them at once.
+    if (std::min<std::size_t>({kMaxInFlight, model.goal_groups(), step_count}) <= max_in_flight) {
+      break;
+    }
+  }
+
+  best->placement->Apply();
+  IVLOG(2, "Cost scheduler: final schedule is:\n" << best->schedule);
+  return std::move(best->schedule);
+}
+
+const char* CostScheduler::name() const { return "Cost"; }
+
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
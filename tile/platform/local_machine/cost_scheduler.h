@@ -0,0 +1,68 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "tile/platform/local_machine/placer.h"
+#include "tile/platform/local_machine/scheduler.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+
+// Estimates how long each step of a program takes to run, and how much of the device it occupies.
+//
+// A kernel's time is the time measured for it when its tile size was scanned, if the tile cache holds one (the cache
+// persists its entries in PLAIDML_TILE_CACHE).  Other kernels are estimated from their flops and memory traffic, as a
+// roofline at the device's goal_flops_per_byte, and copies from the bytes they move; the estimates are scaled to
+// nanoseconds by the kernels which were measured, so with no measurements at all, times are in arbitrary units.  A
+// kernel occupies as many of the device's goal_groups as it has work groups.
+class CostModel {
+ public:
+  CostModel(const lang::KernelList& kl, const hal::proto::HardwareSettings& settings);
+
+  double Time(const schedule::Step& step) const;
+  std::uint64_t Groups(const schedule::Step& step) const;
+  std::uint64_t goal_groups() const { return goal_groups_; }
+
+ private:
+  std::vector<double> kernel_times_;
+  std::vector<std::uint64_t> kernel_groups_;
+  double byte_time_;
+  std::uint64_t goal_groups_;
+};
+
+// Estimates how long a schedule takes to run: each step starts once its dependencies have completed and the device has
+// room for its work groups, and runs for the time the cost model gives it.
+double EstimateRunTime(const CostModel& model, const schedule::Schedule& schedule);
+
+// A list scheduler driven by a cost model of the program's steps.
+//
+// The scheduler simulates running the program on the device, starting the runnable step with the longest estimated
+// path to the end of the program whenever the device has room for it.  While the program's live temporaries exceed
+// the size goal, it prefers the steps which grow them least.  Each step which had to wait for room then depends on the
+// step whose completion made the room, which bounds the number of steps in flight.  The simulation is repeated for a
+// range of bounds, keeping the schedule with the shortest estimated run time whose placement fits within the size
+// goal -- or, if none of them fit, the one using the least memory.
+class CostScheduler final : public Scheduler {
+ public:
+  CostScheduler(const std::shared_ptr<Placer>& placer, std::uint64_t size_goal,
+                const hal::proto::HardwareSettings& settings);
+
+  schedule::Schedule BuildSchedule(const tile::proto::Program& program, const lang::KernelList& kl) final;
+
+  const char* name() const final;
+
+ private:
+  std::shared_ptr<Placer> placer_;
+  std::uint64_t size_goal_;
+  hal::proto::HardwareSettings settings_;
+};
+
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,36 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/platform/local_machine/cost_scheduler.h"
+
+#include "tile/platform/local_machine/block_placer.h"
+#include "tile/platform/local_machine/naive_placer.h"
+#include "tile/platform/local_machine/scheduler_test.h"
+
+using ::testing::Combine;
+using ::testing::Values;
+using ::testing::ValuesIn;
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+hal::proto::HardwareSettings GetSettings() {
+  hal::proto::HardwareSettings settings;
+  settings.set_goal_groups(16);
+  settings.set_goal_flops_per_byte(50);
+  return settings;
+}
+
+INSTANTIATE_TEST_CASE_P(
+    CostScheduler, SchedulerTest,
+    Combine(Values(std::make_shared<CostScheduler>(std::make_shared<NaivePlacer>(std::kilo::num), 4 * std::giga::num,
+                                                   GetSettings()),
+                   std::make_shared<CostScheduler>(std::make_shared<BlockPlacer>(std::kilo::num), 4 * std::giga::num,
+                                                   GetSettings())),
+            ValuesIn(SchedulerTest::GetTestPrograms())));
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
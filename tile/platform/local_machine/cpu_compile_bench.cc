@@ -0,0 +1,91 @@
+// Copyright 2019 Intel Corporation.
+
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/text_format.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "base/util/logging.h"
+#include "base/util/runfiles_db.h"
+#include "tile/hal/cpu/compiler.h"
+#include "tile/hal/cpu/device.h"
+#include "tile/hal/util/settings.h"
+#include "tile/lang/generate.h"
+#include "tile/lang/parser.h"
+#include "tile/proto/support.h"
+
+namespace gp = ::google::protobuf;
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+// Measures the throughput of the CPU HAL compiler over the kernels of the
+// local_machine test programs, building them one at a time and then all at
+// once.
+
+tile::proto::Program MakeProgram(const std::string& filename) {
+  tile::proto::Program result;
+  std::ifstream in{filename};
+  if (!in) {
+    LOG(FATAL) << "Unable to read program proto from " << filename;
+  }
+  gp::io::IstreamInputStream zcis{&in};
+  if (!gp::TextFormat::Parse(&zcis, &result)) {
+    LOG(FATAL) << "Failed to parse program proto from " << filename;
+  }
+  return result;
+}
+
+std::vector<lang::KernelInfo> GenerateKernels(const tile::proto::Program& program,
+                                              const hal::proto::HardwareSettings& settings) {
+  lang::Parser parser;
+  lang::TileOptimizer optimizer;
+  auto parsed = parser.Parse(program.code());
+  auto inputs = FromProto(program.inputs());
+  auto outputs = FromProto(program.outputs());
+  auto kernel_list = lang::GenerateProgram(parsed, inputs, outputs, hal::settings::ToHardwareSettings(settings),
+                                           optimizer, program.id(), 1);
+  return kernel_list.kernels;
+}
+
+class CpuCompileBench : public ::testing::TestWithParam<const char*> {};
+
+TEST_P(CpuCompileBench, Build) {
+  RunfilesDB rdb{"com_intel_plaidml/tile/platform/local_machine/testdata"};
+  auto program = MakeProgram(rdb[GetParam()]);
+  hal::cpu::Device device;
+  const auto& settings = device.executor()->info().settings();
+  auto kernels = GenerateKernels(program, settings);
+  ASSERT_FALSE(kernels.empty());
+  context::Context ctx;
+
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& ki : kernels) {
+    device.compiler()->Build(ctx, {ki}, settings).get();
+  }
+  double serial = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  auto library = device.compiler()->Build(ctx, kernels, settings).get();
+  double concurrent = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  LOG(INFO) << GetParam() << ": " << kernels.size() << " kernels; serial=" << serial << "s ("
+            << kernels.size() / serial << " kernels/s) concurrent=" << concurrent << "s ("
+            << kernels.size() / concurrent << " kernels/s)";
+
+  EXPECT_EQ(kernels.size(), library->Serialize().size());
+}
+
+INSTANTIATE_TEST_CASE_P(Programs, CpuCompileBench,
+                        ::testing::Values("lstm.tpb", "resnet50_train.tpb", "xception.tpb"));
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
@@ -6,6 +6,7 @@
 #include <utility>
 
 #include "base/util/compat.h"
+#include "base/util/executor.h"
 
 namespace vertexai {
 namespace tile {
@@ -32,6 +33,7 @@ class DirectMemChunk final : public MemChunk {
  public:
   DirectMemChunk(const context::Context& ctx, const std::shared_ptr<DevInfo>& devinfo, std::uint64_t size,
                  hal::Memory* source);
+  DirectMemChunk(const std::shared_ptr<DevInfo>& devinfo, std::uint64_t size, std::shared_ptr<hal::Buffer> mem);
 
   // Buffer implementation
   boost::future<std::unique_ptr<View>> MapCurrent(const context::Context& ctx) final;
@@ -72,12 +74,17 @@ DirectMemChunk::DirectMemChunk(const context::Context& ctx, const std::shared_pt
   mem_ = source->MakeBuffer(size_, hal::BufferAccessMask::ALL);
 }
 
+DirectMemChunk::DirectMemChunk(const std::shared_ptr<DevInfo>& devinfo, std::uint64_t size,
+                               std::shared_ptr<hal::Buffer> mem)
+    : size_{size}, devinfo_{devinfo}, deps_{std::make_shared<MemDeps>()}, mem_{std::move(mem)} {}
+
 boost::future<std::unique_ptr<View>> DirectMemChunk::MapCurrent(const context::Context& ctx) {
   context::Context ctx_copy{ctx};
   std::vector<std::shared_ptr<hal::Event>> deps;
   deps_->GetReadDependencies(&deps);
-  return mem_->MapCurrent(deps).then([ctx = std::move(ctx_copy), deps = deps_, size = size_,
-                                      mem = mem_](boost::future<void*> data_future) mutable -> std::unique_ptr<View> {
+  return mem_->MapCurrent(deps).then(
+      RuntimeExecutor(), [ctx = std::move(ctx_copy), deps = deps_, size = size_,
+                          mem = mem_](boost::future<void*> data_future) mutable -> std::unique_ptr<View> {
     void* data = data_future.get();
     return std::make_unique<DirectMemView>(ctx, std::move(deps), data, size, std::move(mem));
   });
@@ -103,6 +110,15 @@ std::shared_ptr<MemChunk> DirectMemStrategy::MakeChunk(const context::Context& c
   return std::make_shared<DirectMemChunk>(ctx, devinfo_, size, source_);
 }
 
+std::shared_ptr<MemChunk> DirectMemStrategy::MapChunk(const context::Context& ctx, const std::string& path,
+                                                      std::uint64_t offset, std::uint64_t size) const {
+  auto mem = source_->MapFile(path, offset, size);
+  if (!mem) {
+    return nullptr;
+  }
+  return std::make_shared<DirectMemChunk>(devinfo_, size, std::move(mem));
+}
+
 }  // namespace local_machine
 }  // namespace tile
 }  // namespace vertexai
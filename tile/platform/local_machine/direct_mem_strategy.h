@@ -3,6 +3,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 
 #include "tile/platform/local_machine/devinfo.h"
 #include "tile/platform/local_machine/mem_strategy.h"
@@ -17,6 +18,8 @@ class DirectMemStrategy final : public MemStrategy {
   DirectMemStrategy(const std::shared_ptr<DevInfo>& devinfo, hal::Memory* source);
 
   std::shared_ptr<MemChunk> MakeChunk(const context::Context& ctx, std::uint64_t size) const final;
+  std::shared_ptr<MemChunk> MapChunk(const context::Context& ctx, const std::string& path, std::uint64_t offset,
+                                     std::uint64_t size) const final;
 
  private:
   std::shared_ptr<DevInfo> devinfo_;
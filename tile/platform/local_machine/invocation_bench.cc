@@ -0,0 +1,110 @@
+// Copyright 2019 Intel Corporation.
+
+#include <gtest/gtest.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <boost/thread/executors/thread_executor.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/util/executor.h"
+#include "base/util/logging.h"
+#include "tile/platform/local_machine/platform.h"
+#include "tile/proto/support.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+// Measures the end-to-end latency of small program invocations on the CPU
+// device, and the number of threads created per invocation, with the runtime's
+// continuations bound to each kind of executor. The "thread" executor starts a
+// thread per continuation, as the default boost::future launch policy may.
+
+const std::size_t invocations_ = 1000;
+
+// Returns the next thread ID the kernel will hand out. Linux allocates thread
+// IDs sequentially, so the difference between two readings counts the threads
+// (and processes) created in between, plus one for the probe itself.
+long NextThreadId() {  // NOLINT(runtime/int)
+#ifdef __linux__
+  long tid = 0;  // NOLINT(runtime/int)
+  std::thread{[&tid]() { tid = syscall(SYS_gettid); }}.join();
+  return tid;
+#else
+  return 0;
+#endif
+}
+
+class InvocationBench : public ::testing::TestWithParam<const char*> {};
+
+TEST_P(InvocationBench, Run) {
+  std::string kind = GetParam();
+  if (kind == "inline") {
+    SetRuntimeExecutor(MakeInlineExecutor());
+  } else if (kind == "thread") {
+    SetRuntimeExecutor(std::make_shared<boost::executors::executor_adaptor<boost::executors::thread_executor>>());
+  } else {
+    SetRuntimeExecutor(MakeThreadPoolExecutor());
+  }
+
+  context::Context ctx;
+  proto::Platform config;
+  config.add_hardware_configs()->mutable_sel()->set_value(true);
+  Platform platform{ctx, config};
+
+  auto shape = SimpleShape(DataType::FLOAT32, {4, 4});
+  tile::proto::Program pb_program;
+  pb_program.set_code("function (A, B) -> (C) { C = A + B; }");
+  *(*pb_program.mutable_inputs())["A"].mutable_shape() = IntoProto(shape);
+  *(*pb_program.mutable_inputs())["B"].mutable_shape() = IntoProto(shape);
+  *(*pb_program.mutable_outputs())["C"].mutable_shape() = IntoProto(shape);
+  ConstBufferManager cbm;
+  auto program = platform.MakeProgram(ctx, pb_program, &cbm);
+
+  auto a = platform.MakeBuffer(ctx, "", shape.byte_size());
+  auto b = platform.MakeBuffer(ctx, "", shape.byte_size());
+  auto c = platform.MakeBuffer(ctx, "", shape.byte_size());
+  for (const auto& buf : {a, b}) {
+    auto view = buf->MapDiscard(ctx);
+    std::fill_n(reinterpret_cast<float*>(view->data()), shape.elem_size(), 1.f);
+    view->WriteBack(ctx);
+  }
+
+  // Warm up, so that compilation and first-touch costs are excluded.
+  program->Run(ctx, {{"A", a}, {"B", b}}, {{"C", c}}).get();
+
+  std::vector<double> latencies;
+  long first_tid = NextThreadId();  // NOLINT(runtime/int)
+  for (std::size_t idx = 0; idx < invocations_; ++idx) {
+    auto start = std::chrono::steady_clock::now();
+    program->Run(ctx, {{"A", a}, {"B", b}}, {{"C", c}}).get();
+    latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+  }
+  long threads = NextThreadId() - first_tid - 1;  // NOLINT(runtime/int)
+
+  auto view = c->MapCurrent(ctx).get();
+  EXPECT_EQ(2.f, reinterpret_cast<float*>(view->data())[0]);
+
+  std::sort(latencies.begin(), latencies.end());
+  LOG(INFO) << kind << ": " << static_cast<double>(threads) / invocations_
+            << " threads created per invocation; latency p50=" << latencies[latencies.size() / 2]
+            << "us p99=" << latencies[latencies.size() * 99 / 100] << "us max=" << latencies.back() << "us";
+}
+
+INSTANTIATE_TEST_CASE_P(Executors, InvocationBench, ::testing::Values("pool", "inline", "thread"));
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,82 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/platform/local_machine/library_cache.h"
+
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "base/util/env.h"
+#include "base/util/file.h"
+#include "base/util/logging.h"
+#include "tile/lang/fnv1a64.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+namespace fs = boost::filesystem;
+
+const char library_magic_[] = "plaidml-library-cache-1";
+
+}  // namespace
+
+LibraryCache::LibraryCache(const std::string& dir) : dir_{dir} {}
+
+LibraryCache* LibraryCache::Instance() {
+  static LibraryCache instance{env::Get("PLAIDML_LIBRARY_CACHE")};
+  return &instance;
+}
+
+std::string LibraryCache::PathFor(const std::string& device, const std::string& kernel) const {
+  std::string key = device + '\n' + kernel;
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << fnv1a64::hash(key.c_str());
+  return (fs::path(dir_) / name.str().substr(0, 2) / (name.str() + ".lib")).string();
+}
+
+boost::optional<std::string> LibraryCache::Lookup(const std::string& device, const std::string& kernel) const {
+  if (dir_.empty()) {
+    return boost::none;
+  }
+  auto path = PathFor(device, kernel);
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return boost::none;
+  }
+  std::string magic;
+  std::string file_device;
+  std::string file_kernel;
+  std::string code;
+  if (!ReadString(in, &magic) || magic != library_magic_ ||      //
+      !ReadString(in, &file_device) || file_device != device ||  //
+      !ReadString(in, &file_kernel) || file_kernel != kernel ||  //
+      !ReadString(in, &code)) {
+    IVLOG(1, "Ignoring mismatched library cache entry " << path);
+    return boost::none;
+  }
+  return code;
+}
+
+void LibraryCache::Record(const std::string& device, const std::string& kernel, const std::string& code) const {
+  if (dir_.empty()) {
+    return;
+  }
+  auto path = PathFor(device, kernel);
+  bool written = WriteFileAtomically(path, true, [&](std::ofstream& out) {
+    WriteString(out, library_magic_);
+    WriteString(out, device);
+    WriteString(out, kernel);
+    WriteString(out, code);
+  });
+  if (!written) {
+    IVLOG(1, "Unable to write library cache entry: " << path);
+  }
+}
+
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
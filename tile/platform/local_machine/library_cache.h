@@ -0,0 +1,48 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <boost/optional.hpp>
+
+#include <string>
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+
+// LibraryCache keeps the serialized code of the kernels compiled for devices
+// whose HAL can load libraries, so that a program whose kernels have all been
+// compiled for a device before -- by this process or any other sharing the
+// cache directory -- can be loaded instead of recompiled.
+//
+// Entries are keyed on a device signature and a kernel signature; the caller
+// is responsible for making these describe everything that could change the
+// generated code.  Each entry is stored in its own file beneath the cache
+// directory, named by a hash of the key; files are written privately and
+// renamed into place, so any number of processes may share a directory.  Each
+// file carries its full key, which is verified on load.
+class LibraryCache {
+ public:
+  // Constructs a cache; if dir is empty, the cache is disabled.
+  explicit LibraryCache(const std::string& dir = "");
+
+  // Returns the process-wide cache, stored in PLAIDML_LIBRARY_CACHE if set.
+  static LibraryCache* Instance();
+
+  bool enabled() const { return !dir_.empty(); }
+
+  // Returns the serialized code recorded for a kernel on a device, if any.
+  boost::optional<std::string> Lookup(const std::string& device, const std::string& kernel) const;
+
+  // Records the serialized code for a kernel on a device.
+  void Record(const std::string& device, const std::string& kernel, const std::string& code) const;
+
+ private:
+  std::string PathFor(const std::string& device, const std::string& kernel) const;
+
+  std::string dir_;
+};
+
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,76 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/platform/local_machine/library_cache.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+using ::testing::Eq;
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+class LibraryCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = fs::temp_directory_path() / fs::unique_path("library-cache-%%%%-%%%%");
+    fs::create_directories(dir_);
+  }
+
+  void TearDown() override { fs::remove_all(dir_); }
+
+  fs::path dir_;
+};
+
+TEST_F(LibraryCacheTest, Disabled) {
+  LibraryCache cache;
+  EXPECT_FALSE(cache.enabled());
+  cache.Record("device", "kernel", "code");
+  EXPECT_FALSE(cache.Lookup("device", "kernel"));
+}
+
+TEST_F(LibraryCacheTest, Persists) {
+  std::string code("object\0code\n", 12);
+  {
+    LibraryCache cache{dir_.string()};
+    EXPECT_TRUE(cache.enabled());
+    EXPECT_FALSE(cache.Lookup("device", "kernel\nsemtree"));
+    cache.Record("device", "kernel\nsemtree", code);
+  }
+  LibraryCache cache{dir_.string()};
+  auto found = cache.Lookup("device", "kernel\nsemtree");
+  ASSERT_TRUE(found);
+  EXPECT_THAT(*found, Eq(code));
+  EXPECT_FALSE(cache.Lookup("other device", "kernel\nsemtree"));
+  EXPECT_FALSE(cache.Lookup("device", "kernel\nother semtree"));
+}
+
+TEST_F(LibraryCacheTest, IgnoresCorruptEntries) {
+  LibraryCache cache{dir_.string()};
+  cache.Record("device", "kernel", std::string(1024, 'x'));
+  for (fs::recursive_directory_iterator it{dir_}, end; it != end; ++it) {
+    if (fs::is_regular_file(it->path())) {
+      fs::resize_file(it->path(), fs::file_size(it->path()) / 2);
+    }
+  }
+  EXPECT_FALSE(cache.Lookup("device", "kernel"));
+
+  // Recompiling replaces the corrupt entry.
+  cache.Record("device", "kernel", "fresh code");
+  auto found = cache.Lookup("device", "kernel");
+  ASSERT_TRUE(found);
+  EXPECT_THAT(*found, Eq("fresh code"));
+}
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
@@ -229,19 +229,7 @@ schedule::Schedule LooseScheduler::BuildSchedule(const tile::proto::Program& pro
 
   IVLOG(3, "Loose scheduler: loose schedule is:\n" << schedule);
 
-  // Remove implied dependencies.
-  std::vector<std::set<schedule::Step*>> transitive_deps{schedule.steps.size()};
-  for (auto& step : schedule.steps) {
-    auto& tdeps = transitive_deps[step.idx];
-    std::set<schedule::Step*> sdeps;
-    sdeps.swap(step.deps);
-    for (auto dep : sdeps) {
-      tdeps.insert(transitive_deps[dep->idx].begin(), transitive_deps[dep->idx].end());
-    }
-    std::set_difference(sdeps.begin(), sdeps.end(), tdeps.begin(), tdeps.end(),
-                        std::inserter(step.deps, step.deps.end()));
-    std::copy(step.deps.begin(), step.deps.end(), std::inserter(tdeps, tdeps.end()));
-  }
+  RemoveImpliedDeps(&schedule);
 
   // Apply the placement, generating the final schedule.
   placement->Apply();
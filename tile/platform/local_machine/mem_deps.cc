@@ -4,6 +4,8 @@
 
 #include <utility>
 
+#include "base/util/executor.h"
+
 namespace vertexai {
 namespace tile {
 namespace local_machine {
@@ -28,11 +30,12 @@ void MemDeps::AddReadDependency(std::shared_ptr<hal::Event> event) {
     fut = event->GetFuture();
     it = events_.emplace(events_.end(), std::move(event));
   }
-  fut.then([self = shared_from_this(), it](boost::shared_future<std::shared_ptr<hal::Result>> future) {
-    future.get();
-    std::lock_guard<std::mutex> lock{self->mu_};
-    self->events_.erase(it);
-  });
+  fut.then(RuntimeExecutor(),
+           [self = shared_from_this(), it](boost::shared_future<std::shared_ptr<hal::Result>> future) {
+             future.get();
+             std::lock_guard<std::mutex> lock{self->mu_};
+             self->events_.erase(it);
+           });
 }
 
 void MemDeps::Poison(std::exception_ptr ep) noexcept {
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 
 #include "base/context/context.h"
 #include "tile/platform/local_machine/mem_chunk.h"
@@ -18,6 +19,12 @@ class MemStrategy {
 
   // Allocates a memory object for kernels to use.
   virtual std::shared_ptr<MemChunk> MakeChunk(const context::Context& ctx, std::uint64_t size) const = 0;
+
+  // Makes a memory object holding a range of a file, if the strategy can map files directly; otherwise, returns null.
+  virtual std::shared_ptr<MemChunk> MapChunk(const context::Context& ctx, const std::string& path,
+                                             std::uint64_t offset, std::uint64_t size) const {
+    return nullptr;
+  }
 };
 
 }  // namespace local_machine
@@ -19,8 +19,10 @@
 #include "tile/hal/util/settings.h"
 #include "tile/platform/local_machine/block_placer.h"
 #include "tile/platform/local_machine/buffer.h"
+#include "tile/platform/local_machine/cost_scheduler.h"
 #include "tile/platform/local_machine/direct_mem_strategy.h"
 #include "tile/platform/local_machine/fifo_scheduler.h"
+#include "tile/platform/local_machine/linear_scheduler.h"
 #include "tile/platform/local_machine/loose_scheduler.h"
 #include "tile/platform/local_machine/program.h"
 #include "tile/platform/local_machine/tdep_scheduler.h"
@@ -70,6 +72,29 @@ bool MatchConfig(const proto::Platform& config, const hal::proto::HardwareInfo&
   return false;
 }
 
+std::shared_ptr<Scheduler> MakeScheduler(std::size_t alignment, std::uint64_t size_goal,
+                                         const hal::proto::HardwareSettings& settings) {
+  const auto& name = settings.scheduler();
+  IVLOG(1, "Using " << (name.empty() ? "fifo" : name) << " scheduler; size_goal=" << size_goal);
+  if (name.empty() || name == "fifo") {
+    return std::make_shared<fifo_scheduler::FifoScheduler>(alignment, size_goal, settings);
+  }
+  auto placer = std::make_shared<BlockPlacer>(alignment);
+  if (name == "cost") {
+    return std::make_shared<CostScheduler>(placer, size_goal, settings);
+  }
+  if (name == "loose") {
+    return std::make_shared<LooseScheduler>(placer, size_goal);
+  }
+  if (name == "linear") {
+    return std::make_shared<LinearScheduler>(placer);
+  }
+  if (name == "transitive_dep") {
+    return std::make_shared<TransitiveDepScheduler>(placer, 0);
+  }
+  throw error::InvalidArgument{"Unknown scheduler \"" + name + "\""};
+}
+
 }  // namespace
 
 Platform::Platform(const context::Context& ctx, const proto::Platform& config) {
@@ -133,14 +158,37 @@ Platform::Platform(const context::Context& ctx, const proto::Platform& config) {
             IVLOG(1, "Device is synchronous");
           }
           auto size_goal = memory->size_goal() * kGoalMemPercentage;
-          IVLOG(1, "Using fifo scheduler; size_goal=" << size_goal);
-          pd.scheduler = std::make_shared<fifo_scheduler::FifoScheduler>(memory->ArenaBufferAlignment(),
-                                                                         std::lround(std::floor(size_goal)), settings);
+          pd.scheduler = MakeScheduler(memory->ArenaBufferAlignment(), std::lround(std::floor(size_goal)), settings);
           devs_[id] = std::move(pd);
         }
       }
     }
   }
+
+  // A device group runs on its first device, except for the programs sharded across all of its devices.
+  for (const auto& group : config.device_groups()) {
+    if (devs_.count(group.id())) {
+      throw error::InvalidArgument{"Device group id \"" + group.id() + "\" is already in use"};
+    }
+    std::vector<std::string> ids{group.devices().begin(), group.devices().end()};
+    bool available = !ids.empty();
+    for (const auto& id : ids) {
+      auto it = devs_.find(id);
+      if (it == devs_.end() || it->second.devinfo->devset != devs_.at(ids.front()).devinfo->devset) {
+        VLOG(1) << "Skipping device group " << group.id() << ": device " << id
+                << " is unavailable, or not in the same device set as " << ids.front();
+        available = false;
+        break;
+      }
+    }
+    if (!available) {
+      continue;
+    }
+    PlatformDev pd = devs_.at(ids.front());
+    pd.id = group.id();
+    pd.group = std::move(ids);
+    devs_[group.id()] = std::move(pd);
+  }
 }
 
 void Platform::RegisterCostModel(const lang::TileCostFunction& cost_fn) { tile_optimizer_.RegisterModel(cost_fn); }
@@ -151,13 +199,29 @@ std::shared_ptr<tile::Buffer> Platform::MakeBuffer(const context::Context& ctx,
   return std::make_shared<Buffer>(platform_dev.devinfo, platform_dev.mem_strategy, size);
 }
 
+std::shared_ptr<tile::Buffer> Platform::MapBuffer(const context::Context& ctx, const std::string& device_id,
+                                                  const std::string& path, std::uint64_t offset, std::uint64_t size) {
+  auto& platform_dev = LookupDevice(device_id);
+  auto chunk = platform_dev.mem_strategy->MapChunk(ctx, path, offset, size);
+  if (!chunk) {
+    return nullptr;
+  }
+  return std::make_shared<Buffer>(platform_dev.devinfo, platform_dev.mem_strategy, std::move(chunk));
+}
+
 std::unique_ptr<tile::Program> Platform::MakeProgram(const context::Context& ctx, const tile::proto::Program& program,
                                                      ConstBufferManager* const_bufs) {
   auto& platform_dev = LookupDevice(program.dev_id());
+  std::vector<Program::Shard> shards;
+  for (const auto& id : platform_dev.group) {
+    auto& shard_dev = LookupDevice(id);
+    shards.emplace_back(Program::Shard{
+        shard_dev.devinfo, std::make_shared<TmpMemStrategy>(shard_dev.devinfo, shard_dev.tmp_mem_source)});
+  }
   return std::make_unique<Program>(ctx, program, platform_dev.devinfo, platform_dev.scheduler,
                                    platform_dev.mem_strategy,
                                    std::make_shared<TmpMemStrategy>(platform_dev.devinfo, platform_dev.tmp_mem_source),
-                                   platform_dev.tmp_mem_source, tile_optimizer_, const_bufs);
+                                   platform_dev.tmp_mem_source, tile_optimizer_, const_bufs, std::move(shards));
 }
 
 std::shared_ptr<tile::Program> Platform::MakeProgram(const context::Context& ctx,   //
@@ -180,7 +244,15 @@ void _fill_device(const Platform::PlatformDev& pdev, tile::proto::Device* dev) {
   options.add_whitespace = true;
   // options.preserve_proto_field_names = true;
   dev->set_dev_id(pdev.id);
-  dev->set_description(pdev.devinfo->dev->description());
+  if (pdev.group.size()) {
+    std::string description = "Group of";
+    for (const auto& id : pdev.group) {
+      description += (&id == &pdev.group.front() ? " " : ", ") + id;
+    }
+    dev->set_description(description);
+  } else {
+    dev->set_description(pdev.devinfo->dev->description());
+  }
   std::string buf;
   google::protobuf::util::MessageToJsonString(pdev.devinfo->dev->executor()->info().info(), &buf, options);
   dev->set_details(buf);
@@ -31,6 +31,7 @@ class Platform : public tile::Platform {
     std::shared_ptr<MemStrategy> mem_strategy;
     hal::Memory* tmp_mem_source;
     std::shared_ptr<Scheduler> scheduler;
+    std::vector<std::string> group;  // For a device group, the ids of its devices
   };
 
   Platform(const context::Context& ctx, const proto::Platform& config);
@@ -38,6 +39,9 @@ class Platform : public tile::Platform {
   std::shared_ptr<tile::Buffer> MakeBuffer(const context::Context& ctx, const std::string& device_id,
                                            std::uint64_t size) final;
 
+  std::shared_ptr<tile::Buffer> MapBuffer(const context::Context& ctx, const std::string& device_id,
+                                          const std::string& path, std::uint64_t offset, std::uint64_t size) final;
+
   std::unique_ptr<tile::Program> MakeProgram(const context::Context& ctx, const tile::proto::Program& program,
                                              ConstBufferManager* const_bufs) final;
 
@@ -3,21 +3,32 @@
 #include "tile/platform/local_machine/program.h"
 
 #include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <forward_list>
+#include <functional>
+#include <limits>
 #include <numeric>
 #include <set>
+#include <sstream>
 #include <unordered_set>
 #include <utility>
 
 #include "base/util/env.h"
 #include "base/util/error.h"
+#include "base/util/executor.h"
 #include "base/util/perf_counter.h"
+#include "base/util/stream_container.h"
 #include "tile/hal/util/settings.h"
 #include "tile/lang/parser.h"
+#include "tile/lang/semprinter.h"
 #include "tile/lang/tile_cache.h"
 #include "tile/ocl_exec/stripe_gen.h"
 #include "tile/platform/local_machine/buffer.h"
+#include "tile/platform/local_machine/library_cache.h"
+#include "tile/platform/local_machine/run_plan.h"
 #include "tile/platform/local_machine/run_request.h"
+#include "tile/platform/local_machine/trial_db.h"
 #include "tile/proto/support.h"
 
 namespace vertexai {
@@ -27,6 +38,7 @@ namespace {
 
 static PerfCounter pre_scan_time("pre_scan_time");
 static PerfCounter post_scan_time("post_scan_time");
+static PerfCounter compile_ns("program_compile_ns");
 
 void AllocateBuffers(const std::vector<std::string>& names, const ShapeMap& types, hal::Memory* memory,
                      std::vector<std::shared_ptr<hal::Buffer>>* buffers) {
@@ -36,35 +48,206 @@ void AllocateBuffers(const std::vector<std::string>& names, const ShapeMap& type
   }
 }
 
-int64_t TryKernel(const context::Context& ctx, const lang::KernelInfo& ki,
+// The number of untimed runs made of each candidate before its trials, letting
+// caches and clocks settle.
+const size_t warmup_runs_ = 1;
+
+// Describes the device a kernel is scanned on.
+std::string DeviceSignature(const DevInfo& devinfo) {
+  return devinfo.dev->description() + '\n' + devinfo.settings.ShortDebugString();
+}
+
+// Describes everything about a kernel which could affect which of its candidates wins: the contraction, the
+// operations fused onto it, the shapes of its parameters, and the tile sizes being considered.
+std::string KernelSignature(const lang::KernelInfo& ki, const ShapeMap& types) {
+  std::ostringstream sig;
+  sig << ki.key << '\n';
+  if (ki.flat) {
+    for (const auto& op : ki.flat->post_ops) {
+      sig << to_string(op) << '\n';
+    }
+  }
+  for (const auto& name : ki.outputs) {
+    sig << "out " << types.at(name) << '\n';
+  }
+  for (const auto& name : ki.inputs) {
+    sig << "in " << types.at(name) << '\n';
+  }
+  sig << "tiles " << StreamContainer(ki.tile.shape);
+  for (const auto& candidate : ki.candidates) {
+    sig << ' ' << StreamContainer(candidate.tile.shape);
+  }
+  return sig.str();
+}
+
+// Describes everything about a kernel which could affect the code compiled for it: its name, which its code is
+// looked up by, and its semantic tree.
+std::string KernelCodeSignature(const lang::KernelInfo& ki) { return ki.kname + '\n' + sem::Print(*ki.kfunc).str(); }
+
+// Returns the number of threads programs are compiled on: PLAIDML_PROGRAM_COMPILE_THREADS, or zero (one per hardware
+// thread) if it's unset or malformed.
+std::size_t ProgramCompileThreads() {
+  auto threads = env::Get("PLAIDML_PROGRAM_COMPILE_THREADS");
+  if (threads.empty()) {
+    return 0;
+  }
+  if (4 < threads.size() || !std::all_of(threads.begin(), threads.end(), [](char c) { return std::isdigit(c); })) {
+    LOG(WARNING) << "Ignoring malformed PLAIDML_PROGRAM_COMPILE_THREADS: " << threads;
+    return 0;
+  }
+  return std::stoul(threads);
+}
+
+// Returns the executor on which programs are compiled.  It is shared by every program, so that compiling many
+// programs at once doesn't start a thread for each of them, and separate from the runtime executor, since generating
+// and scanning kernels can keep a thread busy for a long time.
+boost::executors::executor& ProgramCompileExecutor() {
+  static auto executor = MakeThreadPoolExecutor(ProgramCompileThreads());
+  return *executor;
+}
+
+// Builds the library of a program's kernels for a device.  If the device's HAL can load libraries and the library cache
+// is enabled, the library is loaded from the cache when every kernel has been compiled for the device before, and the
+// code of each kernel compiled is added to the cache.  The device and kernels must outlive the returned future.
+boost::future<std::unique_ptr<hal::Library>> BuildLibrary(const context::Context& ctx, const DevInfo& devinfo,
+                                                          const std::vector<lang::KernelInfo>& kernels) {
+  auto* cache = LibraryCache::Instance();
+  auto* loader = devinfo.dev->loader();
+  bool cacheable = cache->enabled() && loader && kernels.size();
+  for (const auto& ki : kernels) {
+    cacheable = cacheable && ki.kfunc;
+  }
+  if (!cacheable) {
+    return devinfo.dev->compiler()->Build(ctx, kernels, devinfo.settings);
+  }
+
+  auto device_sig = DeviceSignature(devinfo);
+  std::vector<std::string> kernel_sigs;
+  std::string serialized;
+  bool cached = true;
+  for (const auto& ki : kernels) {
+    kernel_sigs.emplace_back(KernelCodeSignature(ki));
+    if (cached) {
+      auto code = cache->Lookup(device_sig, kernel_sigs.back());
+      if (code) {
+        serialized += *code;
+      } else {
+        cached = false;
+      }
+    }
+  }
+
+  auto compile = [ctx, &devinfo, &kernels, cache, device_sig, kernel_sigs]() {
+    return devinfo.dev->compiler()
+        ->Build(ctx, kernels, devinfo.settings)
+        .then(RuntimeExecutor(), [&kernels, cache, device_sig, kernel_sigs](
+                                     boost::future<std::unique_ptr<hal::Library>> built) {
+          auto lib = built.get();
+          auto codes = lib->Serialize();
+          for (std::size_t kidx = 0; kidx < kernels.size(); ++kidx) {
+            auto it = codes.find(kernels[kidx].kname);
+            if (it != codes.end()) {
+              cache->Record(device_sig, kernel_sigs[kidx], it->second);
+            }
+          }
+          return lib;
+        });
+  };
+  if (!cached) {
+    return compile();
+  }
+  boost::future<std::unique_ptr<hal::Library>> loaded;
+  try {
+    loaded = loader->Deserialize(ctx, serialized, kernels);
+  } catch (const std::exception& ex) {
+    IVLOG(1, "Unable to load cached library; recompiling: " << ex.what());
+    return compile();
+  }
+  return loaded
+      .then(RuntimeExecutor(),
+            [compile](boost::future<std::unique_ptr<hal::Library>> fut)
+                -> boost::future<std::unique_ptr<hal::Library>> {
+              try {
+                return boost::make_ready_future(fut.get());
+              } catch (const std::exception& ex) {
+                IVLOG(1, "Unable to load cached library; recompiling: " << ex.what());
+                return compile();
+              }
+            })
+      .unwrap();
+}
+
+struct Trial {
+  const lang::KernelInfo* ki;
+  std::shared_ptr<hal::Library> library;
+  std::unique_ptr<hal::Executable> executable;
+};
+
+// Builds the libraries for a set of kernels.  The builds are all started before any is waited for, so a compiler which
+// builds asynchronously overlaps them; the compiler itself is only ever called from this thread.  Kernels which fail to
+// build are left without a library.
+void BuildTrials(const context::Context& ctx, const DevInfo& devinfo, std::vector<Trial>* trials) {
+  std::vector<boost::future<std::unique_ptr<hal::Library>>> builds(trials->size());
+  auto build = [](const std::function<void()>& fn) {
+    try {
+      fn();
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "Skipping kernel failure: " << ex.what();
+    } catch (...) {
+      LOG(ERROR) << "Skipping unknown kernel failure";
+    }
+  };
+  for (size_t idx = 0; idx < trials->size(); ++idx) {
+    const auto& ki = *(*trials)[idx].ki;
+    if (lang::TileCache::Instance()->GetDuration(ki.key, ki.settings, ki.tile.shape) >= 0) {
+      continue;
+    }
+    build([&] { builds[idx] = devinfo.dev->compiler()->Build(ctx, {ki}, devinfo.settings); });
+  }
+  for (size_t idx = 0; idx < trials->size(); ++idx) {
+    if (builds[idx].valid()) {
+      build([&] { (*trials)[idx].library = builds[idx].get(); });
+    }
+  }
+}
+
+int64_t TryKernel(const context::Context& ctx, Trial* trial,
                   const std::vector<std::shared_ptr<hal::Buffer>>& buffers, const DevInfo& devinfo, size_t trial_runs) {
+  const auto& ki = *trial->ki;
   // Check in cache, and early return if found
   int64_t cached_time = lang::TileCache::Instance()->GetDuration(ki.key, ki.settings, ki.tile.shape);
   if (cached_time >= 0) {
     LOG(DEBUG) << "Cached kernel: " << ki.kname << ", key: " << ki.key << ", tile: " << ki.tile.shape;
     return cached_time;
   }
+  if (!trial->library) {
+    return std::numeric_limits<int64_t>::max();
+  }
 
   LOG(DEBUG) << "Trying kernel: " << ki.kname << ", key: " << ki.key << ", tile: " << ki.tile.shape;
   try {
     // Prep to do a real run
     auto& device = *devinfo.dev;
-    auto library = device.compiler()->Build(ctx, {ki}, devinfo.settings).get();
-    auto executable = device.executor()->Prepare(library.get()).get();
-    int64_t best_time = std::numeric_limits<int64_t>::max();
-
-    // Run trial_runs number of times, picking minimum time
-    for (size_t i = 0; i < trial_runs; i++) {
-      auto evt = executable->Run(ctx, 0, buffers, {}, true);
+    trial->executable = device.executor()->Prepare(trial->library.get()).get();
+    auto run = [&]() {
+      auto evt = trial->executable->Run(ctx, 0, buffers, {}, true);
       device.executor()->Flush();
       auto result = evt->GetFuture().get();
-      int64_t time = result->GetDuration().count();
-      best_time = std::min(time, best_time);
+      return static_cast<int64_t>(result->GetDuration().count());
+    };
+
+    for (size_t i = 0; i < warmup_runs_; i++) {
+      run();
+    }
+    std::vector<int64_t> times;
+    for (size_t i = 0; i < std::max<size_t>(trial_runs, 1); i++) {
+      times.push_back(run());
     }
+    int64_t time = EstimateTrialTime(std::move(times));
 
     // Save in cache and return
-    lang::TileCache::Instance()->AddEntry(ki.key, ki.settings, ki.tile.shape, best_time);
-    return best_time;
+    lang::TileCache::Instance()->AddEntry(ki.key, ki.settings, ki.tile.shape, time);
+    return time;
   } catch (const std::exception& ex) {
     LOG(ERROR) << "Skipping kernel failure: " << ex.what();
   } catch (...) {
@@ -127,11 +310,25 @@ lang::KernelList CompileProgram(const tile::proto::Program& program, const DevIn
     }
   }
 
+  auto* trial_db = TrialDB::Instance();
+  auto device_sig = DeviceSignature(devinfo);
   for (auto& ki : kernel_list.kernels) {
     if (ki.candidates.empty()) {
       continue;
     }
 
+    // If this kernel has been scanned on this device before, by this process or any other sharing the trial
+    // database, reuse the winner without building anything.
+    auto kernel_sig = KernelSignature(ki, kernel_list.types);
+    auto winner = trial_db->Lookup(device_sig, kernel_sig);
+    if (winner) {
+      ApplyWinner(*winner, &ki);
+      pre_scan_time.add(winner->duration);
+      post_scan_time.add(winner->duration);
+      IVLOG(1, "  known best: " << double(winner->duration) / 1e9 << ", tile: " << winner->tile);
+      continue;
+    }
+
     std::vector<std::shared_ptr<hal::Buffer>> buffers;
     AllocateBuffers(ki.outputs, kernel_list.types, memory, &buffers);
     AllocateBuffers(ki.inputs, kernel_list.types, memory, &buffers);
@@ -139,20 +336,33 @@ lang::KernelList CompileProgram(const tile::proto::Program& program, const DevIn
     std::vector<lang::KernelInfo> candidates;
     std::swap(candidates, ki.candidates);
 
-    size_t cur_num = 0;
+    // Compile every candidate up front, concurrently; then time them one at a time, so that the timings don't
+    // disturb each other.
+    std::vector<Trial> trials(candidates.size() + 1);
+    trials[0].ki = &ki;
+    for (size_t idx = 0; idx < candidates.size(); idx++) {
+      trials[idx + 1].ki = &candidates[idx];
+    }
+    BuildTrials(ctx, devinfo, &trials);
+
     size_t best_num = 0;
-    uint64_t best_time = TryKernel(ctx, ki, buffers, devinfo, trial_runs);
+    int64_t best_time = TryKernel(ctx, &trials[0], buffers, devinfo, trial_runs);
     pre_scan_time.add(best_time);
-    for (const auto& candidate : candidates) {
-      cur_num++;
-      uint64_t time = TryKernel(ctx, candidate, buffers, devinfo, trial_runs);
+    for (size_t cur_num = 1; cur_num < trials.size(); cur_num++) {
+      int64_t time = TryKernel(ctx, &trials[cur_num], buffers, devinfo, trial_runs);
+      trials[cur_num] = Trial{trials[cur_num].ki};
       if (time < best_time) {
         best_time = time;
-        ki = candidate;
         best_num = cur_num;
       }
     }
+    if (best_num) {
+      ki = candidates[best_num - 1];
+    }
     post_scan_time.add(best_time);
+    if (best_time < std::numeric_limits<int64_t>::max()) {
+      trial_db->Record(device_sig, kernel_sig, TrialDB::Winner{ki.tile.shape, best_time});
+    }
     IVLOG(1, "  best: " << double(best_time) / 1e9 << ", index: " << best_num);
     IVLOG(1, "  pre_scan_time: " << double(pre_scan_time.get()) / 1e9
                                  << ", post_scan_time: " << double(post_scan_time.get()) / 1e9);
@@ -172,62 +382,95 @@ lang::KernelList CompileProgram(const lang::RunInfo& runinfo,  //
   return codegen::GenerateProgram(runinfo, stripe_cfg, out_path, const_bufs);
 }
 
+// Returns whether a parameter's batch dimension is outermost and dense, so that any part of the batch occupies a
+// contiguous range of the parameter's buffer.
+template <typename P>
+bool HasDenseBatch(const P& param) {
+  auto shape = tile::FromProto(param.shape());
+  return shape.dims.size() && shape.dims[0].stride * shape.dims[0].size == shape.elem_size();
+}
+
+// Divides a batch-polymorphic program's batch between a number of shards, rewriting the program into the one each
+// shard runs.  Only a program whose outputs are all batched can be sharded, since an unbatched output may combine the
+// elements of the batch; returns false, leaving the program alone, if the program can't be sharded.
+bool ShardBatch(tile::proto::Program* program, std::size_t shards) {
+  if (shards < 2 || !program->max_batch() || !program->outputs_size()) {
+    return false;
+  }
+  std::uint64_t batch = 0;
+  for (const auto& output : program->outputs()) {
+    if (!output.second.batched() || !HasDenseBatch(output.second)) {
+      return false;
+    }
+    batch = output.second.shape().dims(0).size();
+  }
+  for (const auto& input : program->inputs()) {
+    if (input.second.batched() && !HasDenseBatch(input.second)) {
+      return false;
+    }
+  }
+  if (batch < shards) {
+    return false;
+  }
+  std::uint64_t shard_batch = (batch + shards - 1) / shards;
+  for (auto& input : *program->mutable_inputs()) {
+    if (input.second.batched()) {
+      input.second.mutable_shape()->mutable_dims(0)->set_size(shard_batch);
+    }
+  }
+  for (auto& output : *program->mutable_outputs()) {
+    output.second.mutable_shape()->mutable_dims(0)->set_size(shard_batch);
+  }
+  return true;
+}
+
+// Poisons the outputs of a run which could not be launched.
+void PoisonOutputs(const context::Context& ctx, const std::shared_ptr<DevInfo>& devinfo,
+                   const std::map<std::string, std::shared_ptr<tile::Buffer>>& outputs, std::exception_ptr ep) {
+  for (const auto& kvp : outputs) {
+    try {
+      auto buffer = Buffer::Downcast(kvp.second, devinfo);
+      buffer->EnsureChunk(ctx);
+      buffer->chunk()->deps()->Poison(ep);
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "Unable to poison output " << kvp.first << ": " << ex.what();
+    }
+  }
+}
+
 }  // namespace
 
 Program::Program(const context::Context& ctx, const tile::proto::Program& program,
                  const std::shared_ptr<DevInfo>& devinfo, const std::shared_ptr<Scheduler>& scheduler,
                  const std::shared_ptr<MemStrategy>& output_mem_strategy,
                  const std::shared_ptr<MemStrategy>& tmp_mem_strategy, hal::Memory* tmp_memory,
-                 const lang::TileOptimizer& optimizer, ConstBufferManager* const_bufs)
-    : devinfo_{devinfo}, output_mem_strategy_{output_mem_strategy}, tmp_mem_strategy_{tmp_mem_strategy} {
-  // TODO: Make this path asynchronous.
-  // Asynchronous programming is a little tricky in this case, since if we compile asynchronously, the
-  // compilation may not be complete when we're first asked to run a program, which means we'd need to save the run
-  // request and mark the output buffers somehow to indicate that they're not just not ready due to hal events, they're
-  // not ready due to compilation futures (which can't be waited on simultaneously).  There's a relatively
-  // straightforward dataflow-ish way to describe the resulting system, but it's more complicated than just
-  // compiling everything synchronously, so we just do everything synchronously for now.
-
+                 const lang::TileOptimizer& optimizer, ConstBufferManager* const_bufs, std::vector<Shard> shards)
+    : devinfo_{devinfo}, output_mem_strategy_{output_mem_strategy}, shards_{Shard{devinfo, tmp_mem_strategy}} {
   if (!devinfo->dev->compiler() || !devinfo->dev->executor()) {
     // TODO: Implement a mechanism for providing a pre-compiled program.
     throw error::Unavailable{"The requested device is unavailable for running Tile programs"};
   }
 
-  context::Activity activity{ctx, "tile::local_machine::Compile"};
-
-  kernel_list_ = CompileProgram(program, *devinfo_.get(), optimizer, const_bufs);
-  const_bufs_ = const_bufs->buffers;
-
-  tile::proto::Program new_program = program;  // Modify logical program inputs for const_bufs
-  for (const auto& kvp : const_bufs_) {
-    if (!program.inputs().count(kvp.first)) {
-      auto shape = kernel_list_.types.at(kvp.first);
-      vertexai::tile::proto::ProgramInput input;
-      (*input.mutable_shape()) = IntoProto(shape);
-      (*new_program.mutable_inputs())[kvp.first] = input;
-    }
+  // Compilation runs on the compile pool, and may outlive the caller's arguments, so it works from copies.
+  ConstBufferManager bufs;
+  if (const_bufs) {
+    bufs = *const_bufs;
   }
-  auto lib = devinfo_->dev->compiler()->Build(activity.ctx(), kernel_list_.kernels, devinfo_->settings).get();
-  executable_ = devinfo_->dev->executor()->Prepare(lib.get()).get();
-  schedule_ = scheduler->BuildSchedule(new_program, kernel_list_);
-
-  if (activity.ctx().is_logging_events()) {
-    hal::proto::CompilationInfo cinfo;
-    for (auto kernel : kernel_list_.kernels) {
-      (*cinfo.mutable_kernels())[kernel.kname] = kernel.info;
-    }
-    SummarizeSchedule(&cinfo, new_program, kernel_list_, schedule_);
-    *(cinfo.mutable_program()) = new_program;
-    activity.AddMetadata(cinfo);
-    schedule::proto::Schedule sched_pb;
-    schedule::ScheduleToProto(&sched_pb, schedule_);
-    for (auto kernel : kernel_list_.kernels) {
-      sched_pb.add_knames(kernel.kname);
-    }
-    activity.AddMetadata(sched_pb);
-  }
-
-  ValidateSchedule(new_program, kernel_list_, schedule_);
+  compiled_ = boost::async(ProgramCompileExecutor(),
+                           [this, ctx, program, scheduler, optimizer, bufs, shards]() mutable {
+                             auto start = std::chrono::steady_clock::now();
+                             auto activity = std::make_shared<context::Activity>(ctx, "tile::local_machine::Compile");
+                             tile::proto::Program shard_program = program;
+                             if (ShardBatch(&shard_program, shards.size())) {
+                               IVLOG(1, "Sharding program " << program.id() << " across " << shards.size()
+                                                            << " devices");
+                               shards_ = std::move(shards);
+                             }
+                             kernel_list_ = CompileProgram(shard_program, *devinfo_.get(), optimizer, &bufs);
+                             return Finish(activity, start, shard_program, scheduler, bufs);
+                           })
+                  .unwrap()
+                  .share();
 }
 
 Program::Program(const context::Context& ctx,                              //
@@ -240,54 +483,188 @@ Program::Program(const context::Context& ctx,                              //
                  ConstBufferManager* const_bufs)
     : devinfo_{devinfo},  //
       output_mem_strategy_{output_mem_strategy},
-      tmp_mem_strategy_{tmp_mem_strategy} {
+      shards_{Shard{devinfo, tmp_mem_strategy}} {
   if (!devinfo->dev->compiler() || !devinfo->dev->executor()) {
     // TODO: Implement a mechanism for providing a pre-compiled program.
     throw error::Unavailable{"The requested device is unavailable for running Tile programs"};
   }
 
-  context::Activity activity{ctx, "tile::local_machine::Compile"};
+  ConstBufferManager bufs;
+  if (const_bufs) {
+    bufs = *const_bufs;
+  }
+  compiled_ = boost::async(ProgramCompileExecutor(),
+                           [this, ctx, runinfo, scheduler, bufs]() mutable {
+                             auto start = std::chrono::steady_clock::now();
+                             auto activity = std::make_shared<context::Activity>(ctx, "tile::local_machine::Compile");
+                             kernel_list_ = CompileProgram(runinfo, *devinfo_.get(), &bufs);
+                             tile::proto::Program program;
+                             *program.mutable_inputs() = IntoProtoInput(runinfo.input_shapes);
+                             *program.mutable_outputs() = IntoProtoOutput(runinfo.output_shapes);
+                             return Finish(activity, start, program, scheduler, bufs);
+                           })
+                  .unwrap()
+                  .share();
+}
+
+Program::~Program() {
+  // Compilation and deferred runs refer to the program; wait for them to finish with it.
+  compiled_.wait();
+  std::unique_lock<std::mutex> lock{mu_};
+  deferred_cv_.wait(lock, [this]() { return !deferred_; });
+}
 
-  kernel_list_ = CompileProgram(runinfo, *devinfo_.get(), const_bufs);
-  const_bufs_ = const_bufs->buffers;
+boost::future<void> Program::Finish(const std::shared_ptr<context::Activity>& activity,
+                                    std::chrono::steady_clock::time_point start, const tile::proto::Program& program,
+                                    const std::shared_ptr<Scheduler>& scheduler, const ConstBufferManager& const_bufs) {
+  const_bufs_ = const_bufs.buffers;
+
+  // A HAL's libraries may only run on the device which built them, so each distinct device of the group builds its
+  // own, and only shards on the same device share one.  The libraries build while the program is scheduled.
+  std::vector<boost::future<std::unique_ptr<hal::Library>>> builds;
+  std::vector<std::size_t> shard_libs;
+  std::map<hal::Device*, std::size_t> device_libs;
+  for (const auto& shard : shards_) {
+    auto it = device_libs.emplace(shard.devinfo->dev.get(), builds.size());
+    if (it.second) {
+      builds.emplace_back(BuildLibrary(activity->ctx(), *shard.devinfo, kernel_list_.kernels));
+    }
+    shard_libs.push_back(it.first->second);
+  }
 
-  tile::proto::Program program;
-  *program.mutable_inputs() = IntoProtoInput(runinfo.input_shapes);
-  *program.mutable_outputs() = IntoProtoOutput(runinfo.output_shapes);
+  tile::proto::Program new_program = program;  // Modify logical program inputs for const_bufs
   for (const auto& kvp : const_bufs_) {
     if (!program.inputs().count(kvp.first)) {
       auto shape = kernel_list_.types.at(kvp.first);
       vertexai::tile::proto::ProgramInput input;
       (*input.mutable_shape()) = IntoProto(shape);
-      (*program.mutable_inputs())[kvp.first] = input;
+      (*new_program.mutable_inputs())[kvp.first] = input;
     }
   }
-  auto lib = devinfo_->dev->compiler()->Build(activity.ctx(), kernel_list_.kernels, devinfo_->settings).get();
-  executable_ = devinfo_->dev->executor()->Prepare(lib.get()).get();
-  schedule_ = scheduler->BuildSchedule(program, kernel_list_);
+  schedule_ = scheduler->BuildSchedule(new_program, kernel_list_);
+  if (new_program.max_batch()) {
+    AddBatchStaging(new_program, kernel_list_, &schedule_);
+  }
 
-  if (activity.ctx().is_logging_events()) {
+  if (activity->ctx().is_logging_events()) {
     hal::proto::CompilationInfo cinfo;
     for (auto kernel : kernel_list_.kernels) {
       (*cinfo.mutable_kernels())[kernel.kname] = kernel.info;
     }
-    SummarizeSchedule(&cinfo, program, kernel_list_, schedule_);
-    *(cinfo.mutable_program()) = program;
-    activity.AddMetadata(cinfo);
+    SummarizeSchedule(&cinfo, new_program, kernel_list_, schedule_);
+    *(cinfo.mutable_program()) = new_program;
+    activity->AddMetadata(cinfo);
     schedule::proto::Schedule sched_pb;
     schedule::ScheduleToProto(&sched_pb, schedule_);
     for (auto kernel : kernel_list_.kernels) {
       sched_pb.add_knames(kernel.kname);
     }
-    activity.AddMetadata(sched_pb);
+    activity->AddMetadata(sched_pb);
+  }
+
+  ValidateSchedule(new_program, kernel_list_, schedule_);
+  if (1 < shards_.size()) {
+    ShardSchedule(new_program, kernel_list_, shards_.size(), &schedule_);
   }
 
-  ValidateSchedule(program, kernel_list_, schedule_);
+  // Each shard prepares its device's library; the libraries are kept until every shard has.
+  auto built = boost::when_all(builds.begin(), builds.end());
+  return built
+      .then(RuntimeExecutor(),
+            [this, activity, start, shard_libs](decltype(built) fut) {
+              std::vector<std::shared_ptr<hal::Library>> libs;
+              for (auto& lib : fut.get()) {
+                libs.emplace_back(lib.get());
+              }
+              std::vector<boost::future<std::unique_ptr<hal::Executable>>> prepared;
+              for (std::size_t sidx = 0; sidx < shards_.size(); ++sidx) {
+                prepared.emplace_back(shards_[sidx].devinfo->dev->executor()->Prepare(libs[shard_libs[sidx]].get()));
+              }
+              auto all = boost::when_all(prepared.begin(), prepared.end());
+              return all.then(RuntimeExecutor(), [this, activity, start, libs](decltype(all) fut) {
+                for (auto& executable : fut.get()) {
+                  executables_.emplace_back(executable.get());
+                }
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                compile_ns.add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+              });
+            })
+      .unwrap();
+}
+
+std::shared_ptr<hal::Event> Program::Copy(const context::Context& ctx, const schedule::Step& step,
+                                          const std::shared_ptr<MemChunk>& from, const std::shared_ptr<MemChunk>& to,
+                                          const std::vector<std::shared_ptr<hal::Event>>& deps) const {
+  // A batch-polymorphic program may be bound to buffers holding a smaller batch than it was compiled for, leaving less
+  // to copy than the step describes -- or, for the last shards of a sharded program, nothing at all.
+  std::uint64_t from_offset = std::min(step.from_offset, from->size());
+  std::uint64_t to_offset = std::min(step.to_offset, to->size());
+  std::uint64_t length = std::min({step.byte_count, from->size() - from_offset, to->size() - to_offset});
+  return executor(step.device)->Copy(ctx, from->hal_buffer(), from_offset, to->hal_buffer(), to_offset, length, deps);
 }
 
 boost::future<void> Program::Run(const context::Context& ctx,
                                  std::map<std::string, std::shared_ptr<tile::Buffer>> inputs,
                                  std::map<std::string, std::shared_ptr<tile::Buffer>> outputs) {
+  // Work out what the run must wait for: compilation, and the launch of any earlier deferred runs sharing its
+  // buffers.
+  std::vector<boost::shared_future<void>> waits;
+  if (!compiled_.is_ready()) {
+    waits.emplace_back(compiled_);
+  }
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  for (const auto* bindings : {&inputs, &outputs}) {
+    for (const auto& kvp : *bindings) {
+      auto buffer = Buffer::Downcast(kvp.second, devinfo_);
+      auto launched = buffer->launched();
+      if (!launched.is_ready()) {
+        waits.emplace_back(std::move(launched));
+      }
+      buffers.emplace_back(std::move(buffer));
+    }
+  }
+  if (waits.empty()) {
+    return Launch(ctx, std::move(inputs), std::move(outputs));
+  }
+
+  IVLOG(1, "Deferring run of program " << this << " until it has been compiled");
+  auto launching = std::make_shared<boost::promise<void>>();
+  auto launched = launching->get_future().share();
+  for (const auto& buffer : buffers) {
+    buffer->DeferUntil(launched);
+  }
+  {
+    std::lock_guard<std::mutex> lock{mu_};
+    ++deferred_;
+  }
+  context::Context ctx_copy{ctx};
+  return boost::when_all(waits.begin(), waits.end())
+      .then(RuntimeExecutor(),
+            [this, ctx = std::move(ctx_copy), inputs = std::move(inputs), outputs = std::move(outputs),
+             launching](boost::future<std::vector<boost::shared_future<void>>>) {
+        boost::future<void> complete;
+        try {
+          complete = Launch(ctx, inputs, outputs);
+        } catch (...) {
+          auto ep = std::current_exception();
+          PoisonOutputs(ctx, devinfo_, outputs, ep);
+          complete = boost::make_exceptional_future<void>(ep);
+        }
+        launching->set_value();
+        std::lock_guard<std::mutex> lock{mu_};
+        --deferred_;
+        deferred_cv_.notify_all();
+        return complete;
+      })
+      .unwrap();
+}
+
+boost::future<void> Program::Launch(const context::Context& ctx,
+                                    std::map<std::string, std::shared_ptr<tile::Buffer>> inputs,
+                                    std::map<std::string, std::shared_ptr<tile::Buffer>> outputs) {
+  // Raises the compilation error, if any.
+  compiled_.get();
+
   std::map<std::string, std::shared_ptr<tile::Buffer>> rewrite_outputs;
   for (auto kvp : outputs) {
     rewrite_outputs.emplace(kernel_list_.var_rewrites.Lookup(kvp.first), std::move(kvp.second));
@@ -298,6 +675,22 @@ boost::future<void> Program::Run(const context::Context& ctx,
   return RunRequest::Run(ctx, this, std::move(inputs), std::move(rewrite_outputs));
 }
 
+std::unique_ptr<tile::RunPlan> Program::Prepare(const context::Context& ctx,
+                                                std::map<std::string, std::shared_ptr<tile::Buffer>> inputs,
+                                                std::map<std::string, std::shared_ptr<tile::Buffer>> outputs) {
+  // Raises the compilation error, if any.
+  compiled_.get();
+
+  std::map<std::string, std::shared_ptr<tile::Buffer>> rewrite_outputs;
+  for (auto kvp : outputs) {
+    rewrite_outputs.emplace(kernel_list_.var_rewrites.Lookup(kvp.first), std::move(kvp.second));
+  }
+  for (const auto& kvp : const_bufs_) {
+    inputs[kvp.first] = kvp.second;
+  }
+  return std::make_unique<RunPlan>(ctx, this, inputs, rewrite_outputs);
+}
+
 }  // namespace local_machine
 }  // namespace tile
 }  // namespace vertexai
@@ -2,12 +2,16 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "tile/base/buffer.h"
 #include "tile/base/program.h"
@@ -22,12 +26,33 @@ namespace vertexai {
 namespace tile {
 namespace local_machine {
 
+// Program is a Tile program compiled for a local device.
+//
+// Compilation (kernel generation, tile scanning, building the device library, and scheduling) runs asynchronously, on
+// a pool of threads shared by every program (PLAIDML_PROGRAM_COMPILE_THREADS threads, or one per hardware thread); the
+// constructor returns as soon as it has been queued.  The time from the start of each successful compilation until
+// the program is ready to run is added to the performance counter program_compile_ns.  Runs requested before compilation completes are deferred until
+// it does.  Each buffer used by a deferred run is marked as pending until the run has been launched, so that later
+// runs and mappings of the buffer are ordered after it.  If compilation fails, deferred runs poison their outputs and
+// report the failure through their futures.
+//
+// A program compiled for a group of devices is sharded across them when its batch can be divided between them: each
+// device runs the program's kernels on its own part of the batch, in its own temporaries, staging its part of the
+// batched inputs and outputs with copies.  Programs which can't be sharded run on the group's first device.
 class Program final : public tile::Program {
  public:
+  // A device running a shard of a program.
+  struct Shard {
+    std::shared_ptr<DevInfo> devinfo;
+    std::shared_ptr<MemStrategy> tmp_mem_strategy;
+  };
+
+  // The shards, if any, are the devices of the group the program is compiled for, starting with the program's device;
+  // they must all belong to the program's device set.
   Program(const context::Context& ctx, const tile::proto::Program& program, const std::shared_ptr<DevInfo>& devinfo,
           const std::shared_ptr<Scheduler>& scheduler, const std::shared_ptr<MemStrategy>& output_mem_strategy,
           const std::shared_ptr<MemStrategy>& tmp_mem_strategy, hal::Memory* tmp_memory,
-          const lang::TileOptimizer& optimizer, ConstBufferManager* const_bufs);
+          const lang::TileOptimizer& optimizer, ConstBufferManager* const_bufs, std::vector<Shard> shards = {});
 
   Program(const context::Context& ctx,                              //
           const lang::RunInfo& runinfo,                             //
@@ -38,24 +63,58 @@ class Program final : public tile::Program {
           hal::Memory* tmp_memory,                                  //
           ConstBufferManager* const_bufs);
 
+  ~Program();
+
   boost::future<void> Run(const context::Context& ctx, std::map<std::string, std::shared_ptr<tile::Buffer>> inputs,
                           std::map<std::string, std::shared_ptr<tile::Buffer>> outputs) final;
 
+  // Prepares a RunPlan for the supplied bindings, waiting for compilation to complete if necessary.
+  std::unique_ptr<tile::RunPlan> Prepare(const context::Context& ctx,
+                                         std::map<std::string, std::shared_ptr<tile::Buffer>> inputs,
+                                         std::map<std::string, std::shared_ptr<tile::Buffer>> outputs) final;
+
+  // Queues a schedule copy step between the chunks bound to its allocs, on the step's device.
+  std::shared_ptr<hal::Event> Copy(const context::Context& ctx, const schedule::Step& step,
+                                   const std::shared_ptr<MemChunk>& from, const std::shared_ptr<MemChunk>& to,
+                                   const std::vector<std::shared_ptr<hal::Event>>& deps) const;
+
+  // Returns a future which becomes ready when compilation completes, holding any compilation error.
+  const boost::shared_future<void>& compiled() const { return compiled_; }
+
+  // The remaining accessors are valid only once compilation has completed successfully.  Those taking a device
+  // index describe the device taking the schedule steps and holding the temporaries with that index.
   const std::shared_ptr<DevInfo>& devinfo() const { return devinfo_; }
   const std::shared_ptr<MemStrategy>& output_mem_strategy() const { return output_mem_strategy_; }
-  const std::shared_ptr<MemStrategy>& tmp_mem_strategy() const { return tmp_mem_strategy_; }
+  const std::shared_ptr<MemStrategy>& tmp_mem_strategy(std::size_t device = 0) const {
+    return shards_[device].tmp_mem_strategy;
+  }
+  hal::Executor* executor(std::size_t device = 0) const { return shards_[device].devinfo->dev->executor(); }
   const schedule::Schedule& schedule() const { return schedule_; }
   const lang::KernelList& kernel_list() const { return kernel_list_; }
-  const std::unique_ptr<hal::Executable>& executable() const { return executable_; }
+  const std::unique_ptr<hal::Executable>& executable(std::size_t device = 0) const { return executables_[device]; }
 
  private:
+  // Schedules the compiled kernels and builds and prepares their library on each shard's device, returning a future
+  // which becomes ready once every shard's executable is; compilation started at the indicated time.
+  boost::future<void> Finish(const std::shared_ptr<context::Activity>& activity,
+                             std::chrono::steady_clock::time_point start, const tile::proto::Program& program,
+                             const std::shared_ptr<Scheduler>& scheduler, const ConstBufferManager& const_bufs);
+  boost::future<void> Launch(const context::Context& ctx, std::map<std::string, std::shared_ptr<tile::Buffer>> inputs,
+                             std::map<std::string, std::shared_ptr<tile::Buffer>> outputs);
+
   std::shared_ptr<DevInfo> devinfo_;
   std::shared_ptr<MemStrategy> output_mem_strategy_;
-  std::shared_ptr<MemStrategy> tmp_mem_strategy_;
+  std::vector<Shard> shards_;
   lang::KernelList kernel_list_;
   schedule::Schedule schedule_;
   std::map<std::string, std::shared_ptr<tile::Buffer>> const_bufs_;
-  std::unique_ptr<hal::Executable> executable_;
+  std::vector<std::unique_ptr<hal::Executable>> executables_;
+  boost::shared_future<void> compiled_;
+
+  // Deferred runs refer to the program until they've been launched.
+  std::mutex mu_;
+  std::condition_variable deferred_cv_;
+  std::size_t deferred_ = 0;
 };
 
 }  // namespace local_machine
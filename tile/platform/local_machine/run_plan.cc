@@ -0,0 +1,213 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/platform/local_machine/run_plan.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "base/util/error.h"
+#include "base/util/executor.h"
+#include "base/util/logging.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+std::shared_ptr<Buffer> FindBuffer(const std::map<std::string, std::shared_ptr<tile::Buffer>>& bindings,
+                                   const std::string& name, const char* kind, const Program* program) {
+  auto it = bindings.find(name);
+  if (it == bindings.end()) {
+    throw error::NotFound{std::string{"Missing program "} + kind + ": " + name};
+  }
+  return Buffer::Downcast(it->second, program->devinfo());
+}
+
+}  // namespace
+
+RunPlan::RunPlan(const context::Context& ctx, const Program* program,
+                 const std::map<std::string, std::shared_ptr<tile::Buffer>>& inputs,
+                 const std::map<std::string, std::shared_ptr<tile::Buffer>>& outputs)
+    : program_{program} {
+  const auto& schedule = program->schedule();
+  bindings_.resize(schedule.allocs.size());
+  chunks_.resize(schedule.allocs.size());
+  for (const auto& alloc : schedule.allocs) {
+    auto& binding = bindings_[alloc.idx];
+    if (alloc.is_input()) {
+      binding.input = FindBuffer(inputs, alloc.input, "input", program);
+      buffers_.push_back(binding.input);
+    }
+    if (alloc.is_output()) {
+      binding.output = FindBuffer(outputs, alloc.output, "output", program);
+      buffers_.push_back(binding.output);
+    }
+    if (alloc.is_tmp()) {
+      // Temporaries are never visible outside of a run, so every run can use the same ones.
+      chunks_[alloc.idx] = program->tmp_mem_strategy(alloc.device)->MakeChunk(ctx, alloc.byte_size);
+    }
+  }
+
+  std::vector<bool> depended_on(schedule.steps.size());
+  steps_.reserve(schedule.steps.size());
+  for (const auto& step : schedule.steps) {
+    Step planned;
+    planned.step = &step;
+    planned.allocs.reserve(step.outputs.size() + step.inputs.size());
+    for (const auto& out : step.outputs) {
+      if (out.add_dep) {
+        planned.dep_params.push_back(planned.allocs.size());
+      }
+      planned.allocs.push_back(out.allocp->idx);
+    }
+    for (const auto& in : step.inputs) {
+      planned.allocs.push_back(in->idx);
+    }
+    if (step.tag == schedule::Step::Tag::kCopy && planned.allocs.size() != 2) {
+      throw error::Internal{"Invalid parameter count for copy step s" + std::to_string(step.idx)};
+    }
+    for (const auto& dep : step.deps) {
+      planned.deps.push_back(dep->idx);
+      depended_on[dep->idx] = true;
+    }
+    planned.params.resize(planned.allocs.size());
+    planned.root = step.deps.empty();
+    steps_.emplace_back(std::move(planned));
+  }
+  for (const auto& step : schedule.steps) {
+    if (!depended_on[step.idx]) {
+      terminal_steps_.push_back(step.idx);
+    }
+  }
+  events_.resize(schedule.steps.size());
+}
+
+boost::future<void> RunPlan::Run(const context::Context& ctx) {
+  std::lock_guard<std::mutex> lock{mu_};
+  VLOG(1) << "Running plan " << this << " of program " << program_;
+
+  // Runs of the program deferred until it compiled may still be about to use the bound buffers.
+  for (const auto& buffer : buffers_) {
+    auto launched = buffer->launched();
+    if (!launched.is_ready()) {
+      launched.wait();
+    }
+  }
+
+  context::Activity running{ctx, "tile::local_machine::Program::Run"};
+  {
+    context::Activity queueing{running.ctx(), "tile::local_machine::Program::Enqueue"};
+    try {
+      Launch(queueing.ctx());
+    } catch (...) {
+      // As with RunRequest, a failed launch poisons the bound chunks.  The temporaries are left alone: the next run
+      // rewrites them before reading them.
+      auto ep = std::current_exception();
+      for (std::size_t idx = 0; idx < bindings_.size(); ++idx) {
+        if ((bindings_[idx].input || bindings_[idx].output) && chunks_[idx]) {
+          chunks_[idx]->deps()->Poison(ep);
+        }
+      }
+      // Whatever was launched may still be using the temporaries.
+      previous_.clear();
+      for (const auto& event : events_) {
+        if (event) {
+          previous_.push_back(event);
+        }
+      }
+      return boost::make_ready_future();
+    }
+  }
+
+  for (std::size_t idx = 0; idx < bindings_.size(); ++idx) {
+    if (bindings_[idx].output) {
+      bindings_[idx].output->RemapTo(chunks_[idx]);
+    }
+  }
+
+  boost::future<std::vector<std::shared_ptr<hal::Result>>> results;
+  if (previous_.empty()) {
+    results = boost::make_ready_future<std::vector<std::shared_ptr<hal::Result>>>();
+  } else {
+    results = program_->executor()->WaitFor(previous_);
+  }
+  std::vector<boost::shared_future<std::shared_ptr<hal::Result>>> step_futures;
+  if (ctx.is_logging_events() || VLOG_IS_ON(1)) {
+    for (const auto& event : events_) {
+      step_futures.emplace_back(event->GetFuture());
+    }
+  }
+
+  // Keep the run's chunks referenced until it completes; the next run rebinds the plan's references to them.
+  return results.then(RuntimeExecutor(), [chunks = chunks_, running = std::move(running),
+                                          step_futures = std::move(step_futures)](decltype(results) fut) {
+    fut.get();
+    if (step_futures.size()) {
+      std::chrono::high_resolution_clock::duration total{std::chrono::high_resolution_clock::duration::zero()};
+      for (const auto& step_future : step_futures) {
+        auto result = step_future.get();
+        total += result->GetDuration();
+        result->LogStatistics();
+      }
+      VLOG(1) << "Total program execution duration: " << total.count();
+    }
+  });
+}
+
+void RunPlan::Launch(const context::Context& ctx) {
+  for (std::size_t idx = 0; idx < bindings_.size(); ++idx) {
+    const auto& binding = bindings_[idx];
+    if (binding.input) {
+      binding.input->EnsureChunk(ctx);
+      chunks_[idx] = binding.input->chunk();
+    } else if (binding.output) {
+      // Outputs get fresh chunks, as they do in RunRequest, so that views of a previous run's outputs stay valid.
+      chunks_[idx] = program_->output_mem_strategy()->MakeChunk(ctx, binding.output->size());
+    }
+  }
+
+  bool profile = ctx.is_logging_events() || VLOG_IS_ON(1);
+  for (auto& planned : steps_) {
+    const schedule::Step& step = *planned.step;
+    IVLOG(2, "Queueing s" << step.idx << ": " << step);
+    std::vector<std::shared_ptr<hal::Event>> deps;
+    deps.reserve(planned.deps.size() + (planned.root ? previous_.size() : 0));
+    for (auto dep : planned.deps) {
+      deps.push_back(events_[dep]);
+    }
+    if (planned.root) {
+      // The previous run may still be using the temporaries.
+      deps.insert(deps.end(), previous_.begin(), previous_.end());
+    }
+    for (std::size_t pidx = 0; pidx < planned.allocs.size(); ++pidx) {
+      const auto& chunk = chunks_[planned.allocs[pidx]];
+      chunk->deps()->GetReadDependencies(&deps);
+      planned.params[pidx] = chunk->hal_buffer();
+    }
+    std::shared_ptr<hal::Event> event;
+    switch (step.tag) {
+      case schedule::Step::Tag::kRun:
+        event = program_->executable(step.device)->Run(ctx, step.kidx, planned.params, deps, profile);
+        break;
+      case schedule::Step::Tag::kCopy:
+        event = program_->Copy(ctx, step, chunks_[planned.allocs[1]], chunks_[planned.allocs[0]], deps);
+        break;
+      default:
+        throw error::Internal{"Invalid schedule step s" + std::to_string(step.idx)};
+    }
+    for (auto pidx : planned.dep_params) {
+      chunks_[planned.allocs[pidx]]->deps()->AddReadDependency(event);
+    }
+    events_[step.idx] = std::move(event);
+  }
+
+  previous_.clear();
+  for (auto sidx : terminal_steps_) {
+    previous_.push_back(events_[sidx]);
+  }
+}
+
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,77 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "base/context/context.h"
+#include "tile/base/buffer.h"
+#include "tile/base/hal.h"
+#include "tile/base/program.h"
+#include "tile/base/schedule.h"
+#include "tile/platform/local_machine/buffer.h"
+#include "tile/platform/local_machine/mem_chunk.h"
+#include "tile/platform/local_machine/program.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+
+// RunPlan is a prepared run of a compiled Program.
+//
+// Where RunRequest works out the memory map and the dependencies of each step of the schedule on every run, a plan
+// does so once, when it's constructed: it resolves each schedule alloc to its binding, allocates the program's
+// temporaries, and records each step's parameters, step dependencies, and whether it's a terminal step.  Running the
+// plan then only resolves the chunks of the bound buffers (which may be remapped between runs), allocates fresh output
+// chunks, patches the parameter lists, and launches the steps.
+//
+// The temporaries are shared by every run of the plan, so each run's first steps wait for the previous run's last
+// steps to complete.
+class RunPlan final : public tile::RunPlan {
+ public:
+  // Prepares a plan.  The program must have been compiled successfully; the bindings must already have had the
+  // program's constants and output variable rewrites applied, as for RunRequest::Run.
+  RunPlan(const context::Context& ctx, const Program* program,
+          const std::map<std::string, std::shared_ptr<tile::Buffer>>& inputs,
+          const std::map<std::string, std::shared_ptr<tile::Buffer>>& outputs);
+
+  boost::future<void> Run(const context::Context& ctx) final;
+
+ private:
+  // How each schedule alloc is bound.
+  struct Binding {
+    std::shared_ptr<Buffer> input;   // Supplies the alloc's chunk, if set
+    std::shared_ptr<Buffer> output;  // Remapped to the alloc's chunk on launch, if set
+  };
+
+  struct Step {
+    const schedule::Step* step;
+    std::vector<std::size_t> allocs;         // The alloc of each parameter: outputs, then inputs
+    std::vector<std::size_t> dep_params;     // The outputs which the step's completion makes readable
+    std::vector<std::size_t> deps;           // The steps this step depends on
+    std::vector<std::shared_ptr<hal::Buffer>> params;
+    bool root;
+  };
+
+  void Launch(const context::Context& ctx);
+
+  const Program* program_;
+  std::vector<Binding> bindings_;
+  std::vector<std::shared_ptr<Buffer>> buffers_;
+  std::vector<Step> steps_;
+  std::vector<std::size_t> terminal_steps_;
+
+  std::mutex mu_;
+  std::vector<std::shared_ptr<MemChunk>> chunks_;
+  std::vector<std::shared_ptr<hal::Event>> events_;
+  std::vector<std::shared_ptr<hal::Event>> previous_;
+};
+
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
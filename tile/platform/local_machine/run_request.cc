@@ -5,6 +5,7 @@
 #include <unordered_set>
 
 #include "base/util/error.h"
+#include "base/util/executor.h"
 
 namespace vertexai {
 namespace tile {
@@ -22,11 +23,13 @@ boost::future<std::vector<std::shared_ptr<hal::Result>>> RunSchedule(const conte
     IVLOG(2, "Queueing s" << step.idx << ": " << step);
     std::vector<std::shared_ptr<hal::Event>> current_deps;
     std::vector<std::shared_ptr<hal::Buffer>> current_params;
+    std::vector<std::shared_ptr<MemChunk>> current_chunks;
     std::vector<std::shared_ptr<MemChunk>> current_dep_chunks;
 
-    auto add_chunk_param = [shim, &current_deps](std::size_t sidx, schedule::Alloc* alloc) {
+    auto add_chunk_param = [shim, &current_deps, &current_chunks](std::size_t sidx, schedule::Alloc* alloc) {
       std::shared_ptr<MemChunk> chunk = shim->LookupAlloc(sidx, alloc);
       chunk->deps()->GetReadDependencies(&current_deps);
+      current_chunks.push_back(chunk);
       return chunk;
     };
 
@@ -50,15 +53,14 @@ boost::future<std::vector<std::shared_ptr<hal::Result>>> RunSchedule(const conte
       case schedule::Step::Tag::kRun:
         // NOTE: VLOG_IS_ON(1) is needed here because LogResults depends on profiling
         // being enabled in order to print durations.
-        event = req->program()->executable()->Run(ctx, step.kidx, current_params, current_deps,
-                                                  ctx.is_logging_events() || VLOG_IS_ON(1));
+        event = req->program()->executable(step.device)->Run(ctx, step.kidx, current_params, current_deps,
+                                                             ctx.is_logging_events() || VLOG_IS_ON(1));
         break;
       case schedule::Step::Tag::kCopy:
         if (current_params.size() != 2) {
           throw error::Internal{"Invalid parameter count for copy step s" + std::to_string(step.idx)};
         }
-        event = req->program()->devinfo()->dev->executor()->Copy(ctx, current_params[1], 0, current_params[0], 0,
-                                                                 step.byte_count, current_deps);
+        event = req->program()->Copy(ctx, step, current_chunks[1], current_chunks[0], current_deps);
         break;
       default:
         throw error::Internal{"Invalid schedule step s" + std::to_string(step.idx)};
@@ -83,7 +85,7 @@ boost::future<std::vector<std::shared_ptr<hal::Result>>> RunSchedule(const conte
     for (const auto& dep : dep_set) {
       terminal_deps.emplace_back(dep);
     }
-    results = req->program()->devinfo()->dev->executor()->WaitFor(std::move(terminal_deps));
+    results = req->program()->executor()->WaitFor(std::move(terminal_deps));
   }
   if (ctx.is_logging_events() || VLOG_IS_ON(1)) {
     // We want to return results for *all* of the steps.
@@ -92,6 +94,7 @@ boost::future<std::vector<std::shared_ptr<hal::Result>>> RunSchedule(const conte
       dep_futures.emplace_back(dep->GetFuture());
     }
     results = results.then(
+        RuntimeExecutor(),
         [dep_futures = std::move(dep_futures)](boost::future<std::vector<std::shared_ptr<hal::Result>>> r) {
           r.get();
           // N.B. All of the step futures should be ready.
@@ -138,7 +141,8 @@ boost::future<void> RunRequest::Run(const context::Context& ctx, const Program*
   // Keep the shim and activity referenced until the program is complete.
   // N.B. It's important to keep the shim referenced because it's the thing that's actually holding
   // onto all of our chunk references; if those go away, unfortunate things happen.
-  return complete.then([shim = std::move(shim), running = std::move(running)](decltype(complete) fut) { fut.get(); });
+  return complete.then(RuntimeExecutor(), [shim = std::move(shim), running = std::move(running)](
+                                              decltype(complete) fut) { fut.get(); });
 }
 
 void RunRequest::LogRequest(const Program* program, const std::map<std::string, std::shared_ptr<tile::Buffer>>& inputs,
@@ -173,7 +177,7 @@ void RunRequest::LogRequest(const Program* program, const std::map<std::string,
 boost::future<void> RunRequest::LogResults(const context::Context& ctx,
                                            boost::future<std::vector<std::shared_ptr<hal::Result>>> results) {
   context::Context ctx_copy{ctx};
-  return results.then([ctx = std::move(ctx_copy)](decltype(results) future) {
+  return results.then(RuntimeExecutor(), [ctx = std::move(ctx_copy)](decltype(results) future) {
     auto results = future.get();
     if (VLOG_IS_ON(1) || ctx.is_logging_events()) {
       std::chrono::high_resolution_clock::duration total{std::chrono::high_resolution_clock::duration::zero()};
@@ -2,10 +2,12 @@
 
 #include "tile/platform/local_machine/scheduler.h"
 
+#include <algorithm>
 #include <iterator>
 #include <map>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/dynamic_bitset.hpp>
 
@@ -165,7 +167,7 @@ void AddDataflowDeps(schedule::Schedule* schedule) {
     IVLOG(5, "Adding dataflow deps to s" << step.idx);
     for (schedule::Alloc* allocp : step.inputs) {
       if (!allocp->byte_size) {
-        return;
+        continue;
       }
       auto ltwit = latest_tmp_writer.find(allocp);
       if (ltwit == latest_tmp_writer.end()) {
@@ -216,6 +218,166 @@ void AddLinearDeps(schedule::Schedule* schedule, std::size_t delta) {
   }
 }
 
+void RemoveImpliedDeps(schedule::Schedule* schedule) {
+  std::vector<std::set<schedule::Step*>> transitive_deps{schedule->steps.size()};
+  for (auto& step : schedule->steps) {
+    auto& tdeps = transitive_deps[step.idx];
+    std::set<schedule::Step*> sdeps;
+    sdeps.swap(step.deps);
+    for (auto dep : sdeps) {
+      tdeps.insert(transitive_deps[dep->idx].begin(), transitive_deps[dep->idx].end());
+    }
+    std::set_difference(sdeps.begin(), sdeps.end(), tdeps.begin(), tdeps.end(),
+                        std::inserter(step.deps, step.deps.end()));
+    std::copy(step.deps.begin(), step.deps.end(), std::inserter(tdeps, tdeps.end()));
+  }
+}
+
+void AddBatchStaging(const tile::proto::Program& program, const lang::KernelList& kl, schedule::Schedule* schedule) {
+  std::set<std::string> batched_inputs;
+  for (const auto& input : program.inputs()) {
+    if (input.second.batched()) {
+      batched_inputs.insert(input.first);
+    }
+  }
+  std::set<std::string> batched_outputs;
+  for (const auto& output : program.outputs()) {
+    if (output.second.batched()) {
+      batched_outputs.insert(kl.var_rewrites.Lookup(output.first));
+    }
+  }
+
+  std::vector<schedule::Alloc*> staged;
+  for (auto& alloc : schedule->allocs) {
+    if ((alloc.is_input() && batched_inputs.count(alloc.input)) ||
+        (alloc.is_output() && batched_outputs.count(alloc.output))) {
+      staged.push_back(&alloc);
+    }
+  }
+
+  for (schedule::Alloc* tmp : staged) {
+    std::vector<schedule::Step*> accessors;
+    for (auto& step : schedule->steps) {
+      bool accesses = std::count(step.inputs.begin(), step.inputs.end(), tmp) > 0;
+      for (const auto& oi : step.outputs) {
+        accesses |= oi.allocp == tmp;
+      }
+      if (accesses) {
+        accessors.push_back(&step);
+      }
+    }
+
+    // The alloc becomes a temporary, bound to the program's input and output through new allocs.
+    if (tmp->is_input() && batched_inputs.count(tmp->input)) {
+      schedule::Alloc bound;
+      bound.input = std::move(tmp->input);
+      bound.byte_size = tmp->byte_size;
+      tmp->input.clear();
+      auto* boundp = &*schedule->allocs.emplace(schedule->allocs.end(), std::move(bound));
+      schedule::Step copy{schedule::Step::Tag::kCopy};
+      copy.inputs.push_back(boundp);
+      copy.outputs.push_back(schedule::OutputInfo{tmp, true});
+      copy.byte_count = kl.types.at(boundp->input).byte_size();
+      auto* copyp = &*schedule->steps.emplace(schedule->steps.begin(), std::move(copy));
+      for (auto* step : accessors) {
+        step->deps.insert(copyp);
+      }
+      accessors.push_back(copyp);
+    }
+    if (tmp->is_output() && batched_outputs.count(tmp->output)) {
+      schedule::Alloc bound;
+      bound.output = std::move(tmp->output);
+      bound.byte_size = tmp->byte_size;
+      tmp->output.clear();
+      auto* boundp = &*schedule->allocs.emplace(schedule->allocs.end(), std::move(bound));
+      schedule::Step copy{schedule::Step::Tag::kCopy};
+      copy.inputs.push_back(tmp);
+      copy.outputs.push_back(schedule::OutputInfo{boundp, true});
+      copy.byte_count = kl.types.at(boundp->output).byte_size();
+      copy.deps.insert(accessors.begin(), accessors.end());
+      schedule->steps.emplace(schedule->steps.end(), std::move(copy));
+    }
+  }
+
+  schedule->Reindex();
+}
+
+void ShardSchedule(const tile::proto::Program& program, const lang::KernelList& kl, std::size_t shards,
+                   schedule::Schedule* schedule) {
+  std::set<std::string> batched_inputs;
+  for (const auto& input : program.inputs()) {
+    if (input.second.batched()) {
+      batched_inputs.insert(input.first);
+    }
+  }
+  std::set<std::string> batched_outputs;
+  for (const auto& output : program.outputs()) {
+    if (output.second.batched()) {
+      batched_outputs.insert(kl.var_rewrites.Lookup(output.first));
+    }
+  }
+
+  std::vector<schedule::Alloc*> tmps;
+  for (auto& alloc : schedule->allocs) {
+    if (alloc.is_tmp()) {
+      tmps.push_back(&alloc);
+    } else if (batched_inputs.count(alloc.input) || batched_outputs.count(alloc.output)) {
+      alloc.byte_size *= shards;
+    }
+  }
+  std::vector<schedule::Step*> steps;
+  for (auto& step : schedule->steps) {
+    steps.push_back(&step);
+  }
+
+  for (std::size_t shard = 1; shard < shards; ++shard) {
+    std::map<schedule::Alloc*, schedule::Alloc*> shard_allocs;
+    for (auto* tmp : tmps) {
+      schedule::Alloc alloc = *tmp;
+      alloc.device = shard;
+      shard_allocs[tmp] = &*schedule->allocs.emplace(schedule->allocs.end(), std::move(alloc));
+    }
+    auto lookup = [&shard_allocs](schedule::Alloc* alloc) {
+      auto it = shard_allocs.find(alloc);
+      return it == shard_allocs.end() ? alloc : it->second;
+    };
+    for (auto& kvp : shard_allocs) {
+      std::set<schedule::Alloc*> aliases;
+      for (auto* alias : kvp.first->safe_self_alias_allocs) {
+        aliases.insert(lookup(alias));
+      }
+      kvp.second->safe_self_alias_allocs = std::move(aliases);
+    }
+
+    std::map<schedule::Step*, schedule::Step*> shard_steps;
+    for (auto* original : steps) {
+      schedule::Step step = *original;
+      step.device = shard;
+      for (auto& input : step.inputs) {
+        input = lookup(input);
+      }
+      for (auto& output : step.outputs) {
+        output.allocp = lookup(output.allocp);
+      }
+      step.deps.clear();
+      for (auto* dep : original->deps) {
+        step.deps.insert(shard_steps.at(dep));
+      }
+      if (step.tag == schedule::Step::Tag::kCopy) {
+        if (batched_inputs.count(step.inputs[0]->input)) {
+          step.from_offset = shard * step.byte_count;
+        }
+        if (batched_outputs.count(step.outputs[0].allocp->output)) {
+          step.to_offset = shard * step.byte_count;
+        }
+      }
+      shard_steps[original] = &*schedule->steps.emplace(schedule->steps.end(), std::move(step));
+    }
+  }
+
+  schedule->Reindex();
+}
+
 void ValidateSchedule(const tile::proto::Program& program, const lang::KernelList& kl,
                       const schedule::Schedule& schedule) {
   boost::dynamic_bitset<> scheduled_kidxs{kl.kernels.size()};
@@ -36,6 +36,23 @@ void AddDataflowDeps(schedule::Schedule* schedule);
 // Adds linear dependencies to a schedule, with the given delta.
 void AddLinearDeps(schedule::Schedule* schedule, std::size_t delta);
 
+// Removes the dependencies of each step of an indexed schedule which are implied by its other dependencies.  This has
+// no logical effect, but simplifies things a little for the driver and the hardware device.
+void RemoveImpliedDeps(schedule::Schedule* schedule);
+
+// Stages a batch-polymorphic program's batched inputs and outputs through temporaries sized for the batch the
+// program was compiled for: each batched input is copied into its temporary before any step uses it, and each batched
+// output is copied out of its temporary once every step using it has completed.  Copies move no more than the bound
+// buffers hold, so the resulting schedule can be run on any smaller batch.
+void AddBatchStaging(const tile::proto::Program& program, const lang::KernelList& kl, schedule::Schedule* schedule);
+
+// Shards a batch-staged schedule across several devices, each running the schedule on its own part of the batch.  The
+// program is the one each shard runs, with its batch divided between the shards.  Every shard gets a copy of the
+// schedule's steps and temporaries, tagged with the index of its device; the program's inputs and outputs are shared,
+// with the batched ones growing to hold every shard's part, and each shard's staging copies moving its part of them.
+void ShardSchedule(const tile::proto::Program& program, const lang::KernelList& kl, std::size_t shards,
+                   schedule::Schedule* schedule);
+
 // Validates a schedule -- i.e. for the supplied kernel list, validate that:
 // * All kernels are run exactly once,
 // * All kernels have the correct number of outputs and inputs,
@@ -0,0 +1,108 @@
+// Copyright 2019 Intel Corporation.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "base/util/logging.h"
+#include "tile/platform/local_machine/platform.h"
+#include "tile/platform/local_machine/scheduler_test.h"
+#include "tile/proto/support.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+// Compares the FIFO and cost schedulers by running the local_machine test programs on the CPU device with each, and
+// checks that both schedules compute the same outputs.  The cost scheduler's kernel times come from the tile cache
+// where the kernels have been scanned with PLAIDML_TILE_CACHE set, and from its roofline estimates otherwise.
+//
+//   bazel test --test_output=streamed //tile/platform/local_machine:scheduler_bench
+
+const int runs_ = 5;
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Measured {
+  double compile_seconds;  // Compiling the program, including building its schedule
+  double run_seconds;      // The best of the timed runs
+  std::map<std::string, std::string> outputs;
+};
+
+Measured Measure(const std::string& scheduler, const tile::proto::Program& program) {
+  context::Context ctx;
+  proto::Platform config;
+  auto* hardware = config.add_hardware_configs();
+  hardware->mutable_sel()->set_value(true);
+  hardware->mutable_settings()->set_scheduler(scheduler);
+  Platform platform{ctx, config};
+
+  // The inputs are filled with a fixed pattern of small byte values; the outputs need only match between schedules.
+  std::map<std::string, std::shared_ptr<tile::Buffer>> inputs;
+  for (const auto& input : program.inputs()) {
+    auto size = FromProto(input.second.shape()).byte_size();
+    auto buffer = platform.MakeBuffer(ctx, "", size);
+    auto view = buffer->MapDiscard(ctx);
+    for (std::size_t idx = 0; idx < view->size(); ++idx) {
+      (*view)[idx] = static_cast<char>(idx % 3);
+    }
+    view->WriteBack(ctx);
+    inputs[input.first] = buffer;
+  }
+  std::map<std::string, std::shared_ptr<tile::Buffer>> outputs;
+  for (const auto& output : program.outputs()) {
+    outputs[output.first] = platform.MakeBuffer(ctx, "", FromProto(output.second.shape()).byte_size());
+  }
+
+  Measured result;
+  auto start = std::chrono::steady_clock::now();
+  ConstBufferManager cbm;
+  auto compiled = platform.MakeProgram(ctx, program, &cbm);
+  compiled->Run(ctx, inputs, outputs).get();
+  result.compile_seconds = Seconds(start);
+
+  for (int run = 0; run < runs_; ++run) {
+    start = std::chrono::steady_clock::now();
+    compiled->Run(ctx, inputs, outputs).get();
+    double seconds = Seconds(start);
+    result.run_seconds = run ? std::min(result.run_seconds, seconds) : seconds;
+  }
+
+  for (const auto& output : outputs) {
+    result.outputs[output.first] = output.second->MapCurrent(ctx).get()->str();
+  }
+  return result;
+}
+
+class SchedulerBench : public ::testing::TestWithParam<const char*> {};
+
+TEST_P(SchedulerBench, Run) {
+  auto program = LoadTestProgram(GetParam());
+  auto fifo = Measure("fifo", program);
+  auto cost = Measure("cost", program);
+
+  LOG(INFO) << GetParam() << ": fifo=" << fifo.run_seconds << "s (compiled in " << fifo.compile_seconds
+            << "s); cost=" << cost.run_seconds << "s (compiled in " << cost.compile_seconds << "s) (best of " << runs_
+            << " runs)";
+
+  for (const auto& output : fifo.outputs) {
+    EXPECT_TRUE(output.second == cost.outputs.at(output.first)) << "Output " << output.first << " differs";
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Programs, SchedulerBench,
+                        ::testing::Values("concat.tpb", "lstm.tpb", "prng.tpb", "resnet50_train.tpb", "xception.tpb"));
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
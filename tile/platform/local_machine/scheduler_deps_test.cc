@@ -0,0 +1,77 @@
+// Copyright 2019 Intel Corporation.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tile/platform/local_machine/scheduler.h"
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+schedule::Alloc* AddAlloc(schedule::Schedule* schedule, std::uint64_t byte_size, const std::string& input = "",
+                          const std::string& output = "") {
+  schedule->allocs.emplace_back();
+  auto* alloc = &schedule->allocs.back();
+  alloc->byte_size = byte_size;
+  alloc->input = input;
+  alloc->output = output;
+  return alloc;
+}
+
+schedule::Step* AddRun(schedule::Schedule* schedule, std::vector<schedule::Alloc*> inputs,
+                       std::vector<schedule::Alloc*> outputs) {
+  schedule->steps.emplace_back(schedule::Step::Tag::kRun);
+  auto* step = &schedule->steps.back();
+  step->inputs = std::move(inputs);
+  for (auto* output : outputs) {
+    step->outputs.emplace_back(schedule::OutputInfo{output, true});
+  }
+  return step;
+}
+
+TEST(AddDataflowDeps, SkipsEmptyInputs) {
+  // An empty input, or an empty temporary nothing writes, doesn't stop the steps reading it (and the steps after
+  // them) from depending on the writers of their other inputs.
+  schedule::Schedule schedule;
+  auto* empty_input = AddAlloc(&schedule, 0, "E");
+  auto* empty_tmp = AddAlloc(&schedule, 0);
+  auto* x = AddAlloc(&schedule, 16, "X");
+  auto* tmp = AddAlloc(&schedule, 16);
+  auto* y = AddAlloc(&schedule, 16, "", "Y");
+  auto* z = AddAlloc(&schedule, 16, "", "Z");
+  auto* first = AddRun(&schedule, {x}, {tmp});
+  auto* second = AddRun(&schedule, {empty_input, empty_tmp, tmp}, {y});
+  auto* third = AddRun(&schedule, {y, empty_input}, {z});
+  schedule.Reindex();
+
+  AddDataflowDeps(&schedule);
+
+  EXPECT_THAT(first->deps, IsEmpty());
+  EXPECT_THAT(second->deps, ElementsAre(first));
+  EXPECT_THAT(third->deps, ElementsAre(second));
+}
+
+TEST(AddDataflowDeps, RejectsUninitializedTemporaries) {
+  schedule::Schedule schedule;
+  auto* tmp = AddAlloc(&schedule, 16);
+  auto* y = AddAlloc(&schedule, 16, "", "Y");
+  AddRun(&schedule, {tmp}, {y});
+  schedule.Reindex();
+
+  EXPECT_THROW(AddDataflowDeps(&schedule), std::exception);
+}
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
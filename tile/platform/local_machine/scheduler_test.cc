@@ -6,6 +6,8 @@
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
 
+#include <fstream>
+
 #include <boost/core/demangle.hpp>
 
 #include "base/util/logging.h"
@@ -21,32 +23,48 @@ namespace gp = ::google::protobuf;
 namespace vertexai {
 namespace tile {
 namespace local_machine {
-namespace {
-
-tile::proto::Program MakeProgram(const std::string& filename) {
+tile::proto::Program LoadTestProgram(const std::string& filename) {
+  RunfilesDB rdb{"com_intel_plaidml/tile/platform/local_machine/testdata"};
+  std::string path = rdb[filename.c_str()];
   tile::proto::Program result;
-  std::ifstream in{filename};
+  std::ifstream in{path};
   if (!in) {
-    LOG(FATAL) << "Unable to read program proto from " << filename;
+    LOG(FATAL) << "Unable to read program proto from " << path;
   }
   gp::io::IstreamInputStream zcis{&in};
   if (!gp::TextFormat::Parse(&zcis, &result)) {
-    LOG(FATAL) << "Failed to parse program proto from " << filename;
+    LOG(FATAL) << "Failed to parse program proto from " << path;
   }
   return result;
 }
 
-}  // namespace
+void BatchAll(tile::proto::Program* program, std::uint64_t max_batch) {
+  program->set_max_batch(max_batch);
+  for (auto& input : *program->mutable_inputs()) {
+    input.second.set_batched(true);
+  }
+  for (auto& output : *program->mutable_outputs()) {
+    output.second.set_batched(true);
+  }
+}
+
+lang::KernelList GenerateKernels(const tile::proto::Program& program, const lang::HardwareSettings& settings) {
+  lang::Parser parser;
+  lang::TileOptimizer optimizer;
+  auto parsed = parser.Parse(program.code());
+  auto inputs = FromProto(program.inputs());
+  auto outputs = FromProto(program.outputs());
+  return lang::GenerateProgram(parsed, inputs, outputs, settings, optimizer, program.id(), 1);
+}
 
 std::vector<tile::proto::Program> SchedulerTest::GetTestPrograms() {
-  RunfilesDB rdb{"com_intel_plaidml/tile/platform/local_machine/testdata"};
   std::vector<tile::proto::Program> result;
-  result.emplace_back(MakeProgram(rdb["concat.tpb"]));
-  result.emplace_back(MakeProgram(rdb["prng.tpb"]));
-  result.emplace_back(MakeProgram(rdb["xception.tpb"]));
+  result.emplace_back(LoadTestProgram("concat.tpb"));
+  result.emplace_back(LoadTestProgram("prng.tpb"));
+  result.emplace_back(LoadTestProgram("xception.tpb"));
   if (FLAGS_test_long_schedules) {
-    result.emplace_back(MakeProgram(rdb["lstm.tpb"]));
-    result.emplace_back(MakeProgram(rdb["resnet50_train.tpb"]));
+    result.emplace_back(LoadTestProgram("lstm.tpb"));
+    result.emplace_back(LoadTestProgram("resnet50_train.tpb"));
   }
   return result;
 }
@@ -75,18 +93,70 @@ namespace {
 
 TEST_P(SchedulerTest, Schedule) {
   const auto& program = GetProgram();
-  lang::Parser parser;
-  lang::TileOptimizer optimizer;
-  auto parsed = parser.Parse(program.code());
-  auto inputs = FromProto(program.inputs());
-  auto outputs = FromProto(program.outputs());
-  auto kernel_list = lang::GenerateProgram(parsed, inputs, outputs, GetSettings(), optimizer, program.id(), 1);
+  auto kernel_list = GetKernels(program);
 
   auto schedule = GetScheduler()->BuildSchedule(program, kernel_list);
   SummarizeSchedule(nullptr, program, kernel_list, schedule);
   ValidateSchedule(program, kernel_list, schedule);
 }
 
+TEST_P(SchedulerTest, BatchStaging) {
+  auto program = GetProgram();
+  BatchAll(&program, 64);
+  auto kernel_list = GetKernels(program);
+
+  auto schedule = GetScheduler()->BuildSchedule(program, kernel_list);
+  AddBatchStaging(program, kernel_list, &schedule);
+  ValidateSchedule(program, kernel_list, schedule);
+}
+
+TEST_P(SchedulerTest, ShardSchedule) {
+  const std::size_t shards = 2;
+  auto program = GetProgram();
+  BatchAll(&program, 64);
+  auto kernel_list = GetKernels(program);
+
+  auto schedule = GetScheduler()->BuildSchedule(program, kernel_list);
+  AddBatchStaging(program, kernel_list, &schedule);
+  ValidateSchedule(program, kernel_list, schedule);
+  std::map<std::string, std::uint64_t> bound_sizes;
+  std::size_t tmp_count = 0;
+  for (const auto& alloc : schedule.allocs) {
+    if (alloc.is_tmp()) {
+      ++tmp_count;
+    } else {
+      bound_sizes[alloc.input + '/' + alloc.output] = alloc.byte_size;
+    }
+  }
+  std::size_t step_count = schedule.steps.size();
+
+  ShardSchedule(program, kernel_list, shards, &schedule);
+
+  ASSERT_EQ(schedule.steps.size(), step_count * shards);
+  ASSERT_EQ(schedule.allocs.size(), bound_sizes.size() + tmp_count * shards);
+  for (const auto& alloc : schedule.allocs) {
+    if (!alloc.is_tmp()) {
+      EXPECT_EQ(alloc.byte_size, bound_sizes.at(alloc.input + '/' + alloc.output) * shards);
+    }
+  }
+  for (const auto& step : schedule.steps) {
+    EXPECT_EQ(step.device, step.idx / step_count);
+    for (const auto* dep : step.deps) {
+      EXPECT_EQ(dep->device, step.device);
+    }
+    for (const auto* input : step.inputs) {
+      EXPECT_TRUE(!input->is_tmp() || input->device == step.device);
+    }
+    for (const auto& output : step.outputs) {
+      EXPECT_TRUE(!output.allocp->is_tmp() || output.allocp->device == step.device);
+    }
+    if (step.tag == schedule::Step::Tag::kCopy) {
+      EXPECT_EQ(step.from_offset, step.inputs[0]->is_input() ? step.device * step.byte_count : 0);
+      EXPECT_EQ(step.to_offset, step.outputs[0].allocp->is_output() ? step.device * step.byte_count : 0);
+    }
+  }
+}
+
 }  // namespace
 }  // namespace local_machine
 }  // namespace tile
@@ -4,6 +4,7 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
@@ -18,6 +19,15 @@ namespace local_machine {
 
 typedef std::tuple<std::shared_ptr<Scheduler>, tile::proto::Program> SchedulerTestParam;
 
+// Reads one of the programs in the local_machine testdata directory, e.g. "xception.tpb".
+tile::proto::Program LoadTestProgram(const std::string& filename);
+
+// Makes a program batch-polymorphic, with every input and output batched.
+void BatchAll(tile::proto::Program* program, std::uint64_t max_batch);
+
+// Parses a program and generates its kernels for the supplied hardware.
+lang::KernelList GenerateKernels(const tile::proto::Program& program, const lang::HardwareSettings& settings);
+
 void PrintTo(const SchedulerTestParam& param, ::std::ostream* os);
 
 // Scheduler implementation conformance tests.
@@ -41,6 +51,9 @@ class SchedulerTest : public ::testing::TestWithParam<SchedulerTestParam> {
   std::shared_ptr<Scheduler> GetScheduler() { return std::get<0>(GetParam()); }
   const tile::proto::Program& GetProgram() { return std::get<1>(GetParam()); }
   tile::lang::HardwareSettings GetSettings();
+
+  // Generates the kernels of a program for the test hardware settings.
+  lang::KernelList GetKernels(const tile::proto::Program& program) { return GenerateKernels(program, GetSettings()); }
 };
 
 }  // namespace local_machine
@@ -0,0 +1,281 @@
+// Copyright 2019 Intel Corporation.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/util/error.h"
+#include "base/util/executor.h"
+#include "base/util/factory.h"
+#include "base/util/perf_counter.h"
+#include "tile/hal/cpu/device.h"
+#include "tile/hal/cpu/device_set.h"
+#include "tile/platform/local_machine/platform.h"
+#include "tile/proto/support.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+// Runs a batch-polymorphic program on a group of two CPU devices, so that its batch is split between them, and checks
+// that it computes the same results as the program run on a single device.  The host may have only one CPU device, so
+// the group names it twice; each shard still gets its own part of the batch, its own staging copies, and its own
+// temporaries.
+
+const std::uint64_t kRows = 6;
+const std::uint64_t kCols = 5;
+
+tile::proto::Program MakeProgram(const std::string& dev_id, std::uint64_t batch) {
+  tile::proto::Program program;
+  program.set_id("shard_test");
+  program.set_dev_id(dev_id);
+  program.set_max_batch(8);
+  program.set_code(R"(
+    function (X[N, R], W[R, C], B[C]) -> (Y) {
+      T[n, c : N, C] = +(X[n, r] * W[r, c]);
+      Y = T + B;
+    }
+  )");
+  auto& x = (*program.mutable_inputs())["X"];
+  *x.mutable_shape() = IntoProto(SimpleShape(DataType::FLOAT32, {batch, kRows}));
+  x.set_batched(true);
+  *(*program.mutable_inputs())["W"].mutable_shape() = IntoProto(SimpleShape(DataType::FLOAT32, {kRows, kCols}));
+  *(*program.mutable_inputs())["B"].mutable_shape() = IntoProto(SimpleShape(DataType::FLOAT32, {kCols}));
+  auto& y = (*program.mutable_outputs())["Y"];
+  *y.mutable_shape() = IntoProto(SimpleShape(DataType::FLOAT32, {batch, kCols}));
+  y.set_batched(true);
+  return program;
+}
+
+// A HAL whose devices each keep their own state, as OpenCL's do: each device wraps a CPU device of its own, and refuses
+// to prepare libraries built by any other device.  Its devices are named "stateful cpu".
+class StatefulLibrary final : public hal::Library {
+ public:
+  StatefulLibrary(const hal::Device* owner, std::unique_ptr<hal::Library> library)
+      : owner_{owner}, library_{std::move(library)} {}
+
+  std::map<std::string, std::string> Serialize() final { return library_->Serialize(); }
+
+  const hal::Device* owner() const { return owner_; }
+  hal::Library* library() const { return library_.get(); }
+
+ private:
+  const hal::Device* owner_;
+  std::unique_ptr<hal::Library> library_;
+};
+
+class StatefulCompiler final : public hal::Compiler {
+ public:
+  StatefulCompiler(const hal::Device* owner, hal::Compiler* compiler) : owner_{owner}, compiler_{compiler} {}
+
+  boost::future<std::unique_ptr<hal::Library>> Build(const context::Context& ctx,
+                                                     const std::vector<lang::KernelInfo>& kernels,
+                                                     const hal::proto::HardwareSettings& settings) final {
+    auto owner = owner_;
+    return compiler_->Build(ctx, kernels, settings)
+        .then(RuntimeExecutor(),
+              [owner](boost::future<std::unique_ptr<hal::Library>> built) -> std::unique_ptr<hal::Library> {
+                return std::make_unique<StatefulLibrary>(owner, built.get());
+              });
+  }
+
+ private:
+  const hal::Device* owner_;
+  hal::Compiler* compiler_;
+};
+
+class StatefulExecutor final : public hal::Executor {
+ public:
+  StatefulExecutor(const hal::Device* owner, hal::Executor* executor) : owner_{owner}, executor_{executor} {
+    info_ = executor->info();
+    info_.set_name("stateful cpu");
+  }
+
+  const hal::proto::HardwareInfo& info() final { return info_; }
+  hal::Memory* device_memory() final { return executor_->device_memory(); }
+  hal::Memory* shared_memory() final { return executor_->shared_memory(); }
+  bool is_synchronous() const final { return executor_->is_synchronous(); }
+
+  std::shared_ptr<hal::Event> Copy(const context::Context& ctx, const std::shared_ptr<hal::Buffer>& from,
+                                   std::size_t from_offset, const std::shared_ptr<hal::Buffer>& to,
+                                   std::size_t to_offset, std::size_t length,
+                                   const std::vector<std::shared_ptr<hal::Event>>& dependencies) final {
+    return executor_->Copy(ctx, from, from_offset, to, to_offset, length, dependencies);
+  }
+
+  boost::future<std::unique_ptr<hal::Executable>> Prepare(hal::Library* library) final {
+    auto* stateful = dynamic_cast<StatefulLibrary*>(library);
+    if (!stateful || stateful->owner() != owner_) {
+      throw error::InvalidArgument{"Incompatible library for Tile device"};
+    }
+    return executor_->Prepare(stateful->library());
+  }
+
+  boost::future<std::vector<std::shared_ptr<hal::Result>>> WaitFor(
+      const std::vector<std::shared_ptr<hal::Event>>& events) final {
+    return executor_->WaitFor(events);
+  }
+
+  void Flush() final { executor_->Flush(); }
+
+ private:
+  const hal::Device* owner_;
+  hal::Executor* executor_;
+  hal::proto::HardwareInfo info_;
+};
+
+class StatefulDevice final : public hal::Device {
+ public:
+  StatefulDevice()
+      : device_{std::make_shared<hal::cpu::Device>()},
+        compiler_{this, device_->compiler()},
+        executor_{this, device_->executor()} {}
+
+  void Initialize(const hal::proto::HardwareSettings& settings) final { device_->Initialize(settings); }
+  std::string description() final { return "Stateful " + device_->description(); }
+  hal::Compiler* compiler() final { return &compiler_; }
+  hal::Loader* loader() final { return nullptr; }
+  const std::unordered_map<std::string, std::unique_ptr<hal::Loader>>& il_loader_map() final {
+    return device_->il_loader_map();
+  }
+  hal::Executor* executor() final { return &executor_; }
+
+ private:
+  std::shared_ptr<hal::cpu::Device> device_;
+  StatefulCompiler compiler_;
+  StatefulExecutor executor_;
+};
+
+class StatefulDeviceSet final : public hal::DeviceSet {
+ public:
+  StatefulDeviceSet() : devices_{std::make_shared<StatefulDevice>(), std::make_shared<StatefulDevice>()} {}
+
+  const std::vector<std::shared_ptr<hal::Device>>& devices() final { return devices_; }
+  hal::Memory* host_memory() final { return cpu_devices_.host_memory(); }
+
+ private:
+  hal::cpu::DeviceSet cpu_devices_;
+  std::vector<std::shared_ptr<hal::Device>> devices_;
+};
+
+class StatefulDriver final : public hal::Driver {
+ public:
+  StatefulDriver() : device_sets_{std::make_shared<StatefulDeviceSet>()} {}
+
+  const std::vector<std::shared_ptr<hal::DeviceSet>>& device_sets() final { return device_sets_; }
+
+ private:
+  std::vector<std::shared_ptr<hal::DeviceSet>> device_sets_;
+};
+
+[[gnu::unused]] char reg = []() -> char {
+  FactoryRegistrar<hal::Driver>::Instance()->Register(
+      "stateful",                                                                     //
+      [](const context::Context& ctx) { return std::make_unique<StatefulDriver>(); },  //
+      FactoryPriority::LOW);
+  return 0;
+}();
+
+std::shared_ptr<tile::Buffer> MakeBuffer(const context::Context& ctx, Platform* platform, const std::string& dev_id,
+                                         std::uint64_t count, int seed) {
+  auto buffer = platform->MakeBuffer(ctx, dev_id, count * sizeof(float));
+  auto view = buffer->MapDiscard(ctx);
+  auto* data = reinterpret_cast<float*>(view->data());
+  for (std::uint64_t idx = 0; idx < count; ++idx) {
+    // Small integers keep the results exact, whatever order the kernels sum in.
+    data[idx] = static_cast<float>((seed + idx * 7) % 11) - 5;
+  }
+  view->WriteBack(ctx);
+  return buffer;
+}
+
+std::vector<float> RunProgram(const context::Context& ctx, Platform* platform, const std::string& dev_id,
+                              std::uint64_t batch) {
+  auto program = MakeProgram(dev_id, batch);
+  ConstBufferManager cbm;
+  auto compiled = platform->MakeProgram(ctx, program, &cbm);
+  auto y = MakeBuffer(ctx, platform, dev_id, batch * kCols, 3);
+  compiled
+      ->Run(ctx,
+            {{"X", MakeBuffer(ctx, platform, dev_id, batch * kRows, 0)},
+             {"W", MakeBuffer(ctx, platform, dev_id, kRows * kCols, 1)},
+             {"B", MakeBuffer(ctx, platform, dev_id, kCols, 2)}},
+            {{"Y", y}})
+      .get();
+  auto view = y->MapCurrent(ctx).get();
+  const auto* data = reinterpret_cast<const float*>(view->data());
+  return std::vector<float>(data, data + batch * kCols);
+}
+
+TEST(ShardTest, MatchesUnshardedRun) {
+  context::Context ctx;
+  proto::Platform config;
+  config.add_hardware_configs()->mutable_sel()->set_value(true);
+
+  std::string dev_id;
+  {
+    Platform platform{ctx, config};
+    tile::proto::ListDevicesResponse devices;
+    platform.ListDevices(ctx, tile::proto::ListDevicesRequest{}, &devices);
+    ASSERT_LT(0, devices.devices_size());
+    dev_id = devices.devices(0).dev_id();
+  }
+
+  auto* group = config.add_device_groups();
+  group->set_id("pair");
+  group->add_devices(dev_id);
+  group->add_devices(dev_id);
+  Platform platform{ctx, config};
+
+  // An even batch splits evenly; an odd one leaves the second shard short.
+  for (std::uint64_t batch : {4, 5, 8}) {
+    SCOPED_TRACE(batch);
+    EXPECT_THAT(RunProgram(ctx, &platform, "pair", batch),
+                ::testing::ContainerEq(RunProgram(ctx, &platform, dev_id, batch)));
+  }
+}
+
+// A group whose devices can't share libraries builds a library on each of them.
+TEST(ShardTest, DevicesWithSeparateState) {
+  context::Context ctx;
+  proto::Platform config;
+  config.add_hardware_configs()->mutable_sel()->set_value(true);
+  auto* group = config.add_device_groups();
+  group->set_id("stateful");
+  group->add_devices("stateful_cpu.0");
+  group->add_devices("stateful_cpu.1");
+  Platform platform{ctx, config};
+
+  for (std::uint64_t batch : {4, 5}) {
+    SCOPED_TRACE(batch);
+    EXPECT_THAT(RunProgram(ctx, &platform, "stateful", batch),
+                ::testing::ContainerEq(RunProgram(ctx, &platform, "stateful_cpu.0", batch)));
+  }
+}
+
+TEST(ShardTest, CountsCompileTime) {
+  context::Context ctx;
+  proto::Platform config;
+  config.add_hardware_configs()->mutable_sel()->set_value(true);
+  Platform platform{ctx, config};
+  tile::proto::ListDevicesResponse devices;
+  platform.ListDevices(ctx, tile::proto::ListDevicesRequest{}, &devices);
+  ASSERT_LT(0, devices.devices_size());
+
+  auto before = GetPerfCounter("program_compile_ns");
+  RunProgram(ctx, &platform, devices.devices(0).dev_id(), 4);
+  EXPECT_LT(before, GetPerfCounter("program_compile_ns"));
+}
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
@@ -61,7 +61,7 @@ std::pair<std::vector<std::shared_ptr<MemChunk>>, std::list<Shim::AliasUpdate>>
     } else {
       // This is neither a program input nor a program output; the alloc is purely internal
       // to the program.  Make a temporary buffer for it.
-      chunk = program->tmp_mem_strategy()->MakeChunk(ctx, alloc.byte_size);
+      chunk = program->tmp_mem_strategy(alloc.device)->MakeChunk(ctx, alloc.byte_size);
     }
 
     chunk_infos.emplace_back(std::move(chunk));
@@ -0,0 +1,118 @@
+// Copyright 2019 Intel Corporation.
+
+#include <gmock/gmock.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/text_format.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "base/util/env.h"
+#include "base/util/logging.h"
+#include "base/util/runfiles_db.h"
+#include "tile/lang/generate.h"
+#include "tile/lang/parser.h"
+#include "tile/lang/tile_opt.h"
+#include "tile/proto/support.h"
+
+namespace gp = ::google::protobuf;
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+// Measures the time spent compiling the local_machine test programs, which is
+// dominated by the tile size search, with and without the TileOptimize memo
+// and parallel frontier expansion.
+
+tile::proto::Program MakeProgram(const std::string& filename) {
+  tile::proto::Program result;
+  std::ifstream in{filename};
+  if (!in) {
+    LOG(FATAL) << "Unable to read program proto from " << filename;
+  }
+  gp::io::IstreamInputStream zcis{&in};
+  if (!gp::TextFormat::Parse(&zcis, &result)) {
+    LOG(FATAL) << "Failed to parse program proto from " << filename;
+  }
+  return result;
+}
+
+lang::HardwareSettings GetSettings() {
+  lang::HardwareSettings settings;
+  settings.threads = 256;
+  settings.use_global = false;
+  settings.mem_width = 128;
+  settings.vec_size = 4;
+  settings.max_mem = 32768;
+  settings.max_regs = 16384;
+  settings.goal_groups = 16;
+  settings.goal_flops_per_byte = 50;
+  settings.goal_dimension_sizes.push_back(1024);
+  settings.goal_dimension_sizes.push_back(1024);
+  settings.goal_dimension_sizes.push_back(1024);
+  return settings;
+}
+
+struct Compiled {
+  double seconds;
+  std::vector<std::string> kernels;
+};
+
+Compiled Compile(const tile::proto::Program& program) {
+  lang::Parser parser;
+  lang::TileOptimizer optimizer;
+  auto parsed = parser.Parse(program.code());
+  auto inputs = FromProto(program.inputs());
+  auto outputs = FromProto(program.outputs());
+  auto start = std::chrono::steady_clock::now();
+  auto kernel_list = lang::GenerateProgram(parsed, inputs, outputs, GetSettings(), optimizer, program.id(), 1);
+  Compiled result;
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  for (const auto& ki : kernel_list.kernels) {
+    result.kernels.emplace_back(to_string(ki));
+  }
+  return result;
+}
+
+class TileOptBench : public ::testing::TestWithParam<const char*> {
+ protected:
+  void TearDown() override {
+    env::Set("PLAIDML_TILE_OPT_MEMO", "");
+    env::Set("PLAIDML_TILE_OPT_PARALLEL", "");
+  }
+};
+
+TEST_P(TileOptBench, Compile) {
+  RunfilesDB rdb{"com_intel_plaidml/tile/platform/local_machine/testdata"};
+  auto program = MakeProgram(rdb[GetParam()]);
+
+  env::Set("PLAIDML_TILE_OPT_MEMO", "0");
+  env::Set("PLAIDML_TILE_OPT_PARALLEL", "0");
+  auto baseline = Compile(program);
+
+  env::Set("PLAIDML_TILE_OPT_MEMO", "1");
+  env::Set("PLAIDML_TILE_OPT_PARALLEL", "1");
+  lang::ClearTileOptimizeMemo();
+  auto cold = Compile(program);
+  auto warm = Compile(program);
+
+  LOG(INFO) << GetParam() << ": serial=" << baseline.seconds << "s parallel=" << cold.seconds
+            << "s memoized=" << warm.seconds << "s (" << baseline.kernels.size() << " kernels)";
+
+  EXPECT_THAT(cold.kernels, ::testing::ContainerEq(baseline.kernels));
+  EXPECT_THAT(warm.kernels, ::testing::ContainerEq(baseline.kernels));
+  EXPECT_LT(warm.seconds, baseline.seconds);
+}
+
+INSTANTIATE_TEST_CASE_P(Programs, TileOptBench,
+                        ::testing::Values("concat.tpb", "lstm.tpb", "prng.tpb", "resnet50_train.tpb", "xception.tpb"));
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
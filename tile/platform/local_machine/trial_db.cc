@@ -0,0 +1,146 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/platform/local_machine/trial_db.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "base/util/env.h"
+#include "base/util/file.h"
+#include "base/util/logging.h"
+#include "tile/lang/fnv1a64.h"
+#include "tile/lang/tile_cache.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+namespace fs = boost::filesystem;
+
+const char trial_magic_[] = "plaidml-trial-db-1";
+
+// Trials which take longer than this multiple of the median are assumed to
+// have been disturbed (e.g. by preemption), and are discarded.
+const double outlier_ratio_ = 1.5;
+
+}  // namespace
+
+TrialDB::TrialDB(const std::string& dir) : dir_{dir} {}
+
+TrialDB* TrialDB::Instance() {
+  static TrialDB instance{env::Get("PLAIDML_TRIAL_DB")};
+  return &instance;
+}
+
+std::string TrialDB::PathFor(const std::string& device, const std::string& kernel) const {
+  std::string key = device + '\n' + kernel;
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << fnv1a64::hash(key.c_str());
+  // Fan the entries out over subdirectories named by the leading byte of the
+  // hash, keeping the directories small enough to search quickly.
+  return (fs::path(dir_) / name.str().substr(0, 2) / (name.str() + ".trial")).string();
+}
+
+boost::optional<TrialDB::Winner> TrialDB::Lookup(const std::string& device, const std::string& kernel) {
+  std::lock_guard<std::mutex> lock{mu_};
+  auto key = std::make_pair(device, kernel);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    return it->second;
+  }
+  if (dir_.empty()) {
+    return boost::none;
+  }
+  auto path = PathFor(device, kernel);
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return boost::none;
+  }
+  std::string magic;
+  std::string file_device;
+  std::string file_kernel;
+  std::string tile;
+  std::string duration;
+  if (!ReadString(in, &magic) || magic != trial_magic_ ||        //
+      !ReadString(in, &file_device) || file_device != device ||  //
+      !ReadString(in, &file_kernel) || file_kernel != kernel ||  //
+      !ReadString(in, &tile) || !ReadString(in, &duration)) {
+    IVLOG(1, "Ignoring mismatched trial database entry " << path);
+    return boost::none;
+  }
+  Winner winner;
+  std::istringstream tile_in(tile);
+  std::uint64_t size;
+  while (tile_in >> size) {
+    winner.tile.push_back(size);
+  }
+  try {
+    winner.duration = std::stoll(duration);
+  } catch (const std::exception&) {
+    return boost::none;
+  }
+  entries_.emplace(key, winner);
+  return winner;
+}
+
+void TrialDB::Record(const std::string& device, const std::string& kernel, const Winner& winner) {
+  std::lock_guard<std::mutex> lock{mu_};
+  entries_[std::make_pair(device, kernel)] = winner;
+  if (dir_.empty()) {
+    return;
+  }
+  // Write to a private file and rename it into place, so that concurrent
+  // readers and writers of the same entry only ever see complete files.
+  auto path = PathFor(device, kernel);
+  bool written = WriteFileAtomically(path, true, [&](std::ofstream& out) {
+    std::ostringstream tile;
+    for (auto size : winner.tile) {
+      tile << size << ' ';
+    }
+    WriteString(out, trial_magic_);
+    WriteString(out, device);
+    WriteString(out, kernel);
+    WriteString(out, tile.str());
+    WriteString(out, std::to_string(winner.duration));
+  });
+  if (!written) {
+    IVLOG(1, "Unable to write trial database entry: " << path);
+  }
+}
+
+void ApplyWinner(const TrialDB::Winner& winner, lang::KernelInfo* ki) {
+  if (winner.tile != ki->tile.shape) {
+    for (const auto& candidate : ki->candidates) {
+      if (candidate.tile.shape == winner.tile) {
+        *ki = candidate;
+        break;
+      }
+    }
+  }
+  ki->candidates.clear();
+  lang::TileCache::Instance()->AddEntry(ki->key, ki->settings, ki->tile.shape, winner.duration);
+}
+
+std::int64_t EstimateTrialTime(std::vector<std::int64_t> times) {
+  std::sort(times.begin(), times.end());
+  double limit = times[times.size() / 2] * outlier_ratio_;
+  std::int64_t total = 0;
+  std::size_t count = 0;
+  for (auto time : times) {
+    if (count && time > limit) {
+      break;
+    }
+    total += time;
+    count++;
+  }
+  return total / count;
+}
+
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
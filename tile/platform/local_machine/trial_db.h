@@ -0,0 +1,68 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tile/lang/generate.h"
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+
+// TrialDB remembers the outcome of kernel trial scans, so that a kernel which
+// has been scanned on a device never needs to be scanned there again.
+//
+// Entries are keyed on a device signature and a kernel signature; the caller
+// is responsible for making these describe everything that could change which
+// candidate wins.  If a directory is supplied, each entry is stored in its own
+// file beneath it, named by a hash of the key; files are written privately and
+// renamed into place, so any number of processes may share a directory.  Each
+// file carries its full key, which is verified on load.
+class TrialDB {
+ public:
+  struct Winner {
+    std::vector<std::uint64_t> tile;  // The tile size of the winning candidate
+    std::int64_t duration;            // Its measured time, in nanoseconds
+  };
+
+  // Constructs a database; if dir is empty, entries are kept in memory only.
+  explicit TrialDB(const std::string& dir = "");
+
+  // Returns the process-wide database, stored in PLAIDML_TRIAL_DB if set.
+  static TrialDB* Instance();
+
+  // Returns the recorded winner for a kernel on a device, if any.
+  boost::optional<Winner> Lookup(const std::string& device, const std::string& kernel);
+
+  // Records the winner for a kernel on a device.
+  void Record(const std::string& device, const std::string& kernel, const Winner& winner);
+
+ private:
+  std::string PathFor(const std::string& device, const std::string& kernel) const;
+
+  std::string dir_;
+  std::mutex mu_;
+  std::map<std::pair<std::string, std::string>, Winner> entries_;
+};
+
+// Applies a recorded winner to a kernel: switches the kernel to the winning
+// candidate, drops its candidates, and adds the winner's time to the tile
+// cache, where the schedulers' cost models look up kernel times.
+void ApplyWinner(const TrialDB::Winner& winner, lang::KernelInfo* ki);
+
+// Returns a robust estimate of a kernel's run time from the times of its trials, in nanoseconds: the mean of the trials
+// which are not outliers.  Trials which take longer than 1.5 times the median are assumed to have been disturbed (e.g.
+// by preemption), and are discarded.  There must be at least one trial.
+std::int64_t EstimateTrialTime(std::vector<std::int64_t> times);
+
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,127 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/platform/local_machine/trial_db.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "tile/platform/local_machine/cost_scheduler.h"
+
+namespace fs = boost::filesystem;
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+namespace vertexai {
+namespace tile {
+namespace local_machine {
+namespace {
+
+class TrialDBTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = fs::temp_directory_path() / fs::unique_path("trial-db-%%%%-%%%%");
+    fs::create_directories(dir_);
+  }
+
+  void TearDown() override { fs::remove_all(dir_); }
+
+  fs::path dir_;
+};
+
+TEST_F(TrialDBTest, InMemory) {
+  TrialDB db;
+  EXPECT_FALSE(db.Lookup("device", "kernel"));
+  db.Record("device", "kernel", TrialDB::Winner{{4, 8}, 1000});
+  auto winner = db.Lookup("device", "kernel");
+  ASSERT_TRUE(winner);
+  EXPECT_THAT(winner->tile, ElementsAre(4, 8));
+  EXPECT_THAT(winner->duration, Eq(1000));
+  EXPECT_FALSE(db.Lookup("other device", "kernel"));
+  EXPECT_FALSE(db.Lookup("device", "other kernel"));
+}
+
+TEST_F(TrialDBTest, Persists) {
+  {
+    TrialDB db{dir_.string()};
+    db.Record("device", "kernel\nwith newlines", TrialDB::Winner{{16, 1, 32}, 12345});
+    db.Record("device", "empty tile", TrialDB::Winner{{}, 7});
+  }
+  TrialDB db{dir_.string()};
+  auto winner = db.Lookup("device", "kernel\nwith newlines");
+  ASSERT_TRUE(winner);
+  EXPECT_THAT(winner->tile, ElementsAre(16, 1, 32));
+  EXPECT_THAT(winner->duration, Eq(12345));
+  winner = db.Lookup("device", "empty tile");
+  ASSERT_TRUE(winner);
+  EXPECT_TRUE(winner->tile.empty());
+  EXPECT_THAT(winner->duration, Eq(7));
+  EXPECT_FALSE(db.Lookup("other device", "kernel\nwith newlines"));
+}
+
+TEST_F(TrialDBTest, IgnoresCorruptEntries) {
+  {
+    TrialDB db{dir_.string()};
+    db.Record("device", "kernel", TrialDB::Winner{{4}, 1000});
+  }
+  for (fs::recursive_directory_iterator it{dir_}, end; it != end; ++it) {
+    if (fs::is_regular_file(it->path())) {
+      auto size = fs::file_size(it->path());
+      fs::resize_file(it->path(), size / 2);
+    }
+  }
+  TrialDB db{dir_.string()};
+  EXPECT_FALSE(db.Lookup("device", "kernel"));
+
+  // A fresh scan replaces the corrupt entry.
+  db.Record("device", "kernel", TrialDB::Winner{{4}, 900});
+  TrialDB reloaded{dir_.string()};
+  auto winner = reloaded.Lookup("device", "kernel");
+  ASSERT_TRUE(winner);
+  EXPECT_THAT(winner->duration, Eq(900));
+}
+
+TEST_F(TrialDBTest, PersistedWinnerReachesCostModel) {
+  {
+    TrialDB db{dir_.string()};
+    db.Record("device", "kernel", TrialDB::Winner{{4, 8}, 5000});
+  }
+  TrialDB db{dir_.string()};
+  auto winner = db.Lookup("device", "kernel");
+  ASSERT_TRUE(winner);
+
+  lang::KernelInfo ki;
+  ki.kname = "kernel";
+  ki.key = "trial_db_test persisted winner";
+  ki.tile.shape = {2, 2};
+  ki.candidates.emplace_back(ki);
+  ki.candidates.back().tile.shape = {4, 8};
+  ApplyWinner(*winner, &ki);
+  EXPECT_THAT(ki.tile.shape, ElementsAre(4, 8));
+  EXPECT_TRUE(ki.candidates.empty());
+
+  lang::KernelList kl;
+  kl.kernels.push_back(ki);
+  CostModel model{kl, hal::proto::HardwareSettings{}};
+  schedule::Step step{schedule::Step::Tag::kRun};
+  step.kidx = 0;
+  EXPECT_THAT(model.Time(step), Eq(5000));
+}
+
+TEST(EstimateTrialTime, Single) { EXPECT_THAT(EstimateTrialTime({42}), Eq(42)); }
+
+TEST(EstimateTrialTime, AveragesTrials) { EXPECT_THAT(EstimateTrialTime({90, 110, 100}), Eq(100)); }
+
+TEST(EstimateTrialTime, DiscardsOutliers) {
+  // The median is 110, so anything over 165 was disturbed.
+  EXPECT_THAT(EstimateTrialTime({100, 1000, 90, 110, 200}), Eq(100));
+}
+
+}  // namespace
+}  // namespace local_machine
+}  // namespace tile
+}  // namespace vertexai
@@ -2,10 +2,15 @@
 
 #include "tile/platform/stripejit/program.h"
 
+#include <iomanip>
+#include <map>
 #include <memory>
+#include <sstream>
 
 #include "base/util/env.h"
+#include "base/util/logging.h"
 #include "tile/codegen/driver.h"
+#include "tile/lang/fnv1a64.h"
 #include "tile/lang/gen_stripe.h"
 #include "tile/lang/parser.h"
 #include "tile/proto/support.h"
@@ -16,8 +21,64 @@ namespace vertexai {
 namespace tile {
 namespace stripejit {
 
+namespace {
+
+template <typename M>
+void SerializeShapemap(std::ostringstream* serialized, const M& m) {
+  std::map<std::string, const proto::TensorShape&> shapes;
+  for (const auto& t : m) {
+    shapes.emplace(t.first, t.second.shape());
+  }
+  for (const auto& t : shapes) {
+    (*serialized) << t.first.length() << ':';
+    (*serialized) << t.first;
+    (*serialized) << t.second.type() << ':';
+    for (const auto& dim : t.second.dims()) {
+      (*serialized) << dim.size() << '/' << dim.stride() << ':';
+    }
+  }
+}
+
+// Describes everything which determines the code the JIT will generate for a
+// program: its source, the shapes of its parameters, and the pass pipeline.
+// The host processor is accounted for separately by the JIT itself.
+std::string CacheKey(const tile::proto::Program& program, const codegen::proto::Stage& stage) {
+  std::ostringstream serialized;
+  serialized << program.code().length() << ':';
+  serialized << program.code();
+  SerializeShapemap(&serialized, program.inputs());
+  SerializeShapemap(&serialized, program.outputs());
+  serialized << stage.DebugString();
+  return serialized.str();
+}
+
+}  // namespace
+
 Program::Program(const context::Context& ctx, const tile::proto::Program& program, ConstBufferManager* const_bufs)
     : executable_{new targets::cpu::Native} {
+  const auto& cfgs = targets::GetConfigs();
+  const auto& cfg = cfgs.configs().at("cpu");
+  const auto& stage = cfg.stages().at("default");
+
+  // If a cache directory has been configured, look for object code compiled
+  // from the same program by an earlier process on an identical host (or, with
+  // PLAIDML_CPU_PORTABLE, any host with the same triple); on a hit we skip
+  // parsing, the codegen passes, and LLVM entirely.
+  boost::filesystem::path cache_path;
+  std::string cache_key;
+  auto cache_dir = env::Get("STRIPE_JIT_CACHE");
+  if (cache_dir.size()) {
+    cache_key = CacheKey(program, stage);
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0')
+         << fnv1a64::hash((cache_key + targets::cpu::ObjectTarget()).c_str()) << ".jit";
+    cache_path = boost::filesystem::path(cache_dir) / name.str();
+    if (executable_->load_object(cache_path.string(), cache_key)) {
+      VLOG(1) << "Loaded stripe program from cache: " << cache_path;
+      return;
+    }
+  }
+
   lang::Parser parser;
   lang::RunInfo runinfo;
   runinfo.program = parser.Parse(program.code());
@@ -27,19 +88,21 @@ Program::Program(const context::Context& ctx, const tile::proto::Program& progra
   auto stripe = GenerateStripe(runinfo);
   auto out_dir = boost::filesystem::path(env::Get("STRIPE_OUTPUT"));
   codegen::OptimizeOptions options = {
-      !out_dir.empty(),    // dump_passes
-      false,               // dump_passes_proto
-      false,               // dump_code
-      out_dir / "passes",  // dbg_dir
+      !out_dir.empty(),                  // dump_passes
+      false,                             // dump_passes_proto
+      false,                             // dump_code
+      out_dir / "passes",                // dbg_dir
+      codegen::VerifyPassesRequested(),  // verify_passes
   };
-  const auto& cfgs = targets::GetConfigs();
-  const auto& cfg = cfgs.configs().at("cpu");
-  const auto& stage = cfg.stages().at("default");
   codegen::CompilerState state(stripe);
   state.const_bufs = const_bufs;
   codegen::Optimize(&state, stage.passes(), options);
   std::map<std::string, targets::cpu::External> externals;
   executable_->compile(*stripe->entry, externals);
+  if (!cache_path.empty()) {
+    VLOG(1) << "Writing stripe program to cache: " << cache_path;
+    executable_->save_object(cache_path.string(), cache_key);
+  }
 }
 
 Program::~Program() {}
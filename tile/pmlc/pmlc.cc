@@ -64,6 +64,7 @@ bool App::parse(int argc, char* argv[]) {
       ("internal", "input specifies an internally defined network")                       //
       ("dump-passes", "dump passes in *.txt format")                                      //
       ("dump-passes-proto", "dump passes in *.pb format")                                 //
+      ("verify-passes", "check that each pass preserves the program's results")           //
 #ifdef ENABLE_LLVM_BITCODE
       ("llvm", "enable LLVM bitcode output")  //
 #endif
@@ -148,6 +149,7 @@ std::shared_ptr<Program> Main() {
     options.dump_passes_proto = true;
     options.dbg_dir = out_dir / "passes";
   }
+  options.verify_passes = app->args.count("verify-passes") || VerifyPassesRequested();
   return DefaultStage(*app, input_path, out_dir, stage, options);
 }
 
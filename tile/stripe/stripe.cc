@@ -747,8 +747,9 @@ Location RealizeLocation(const Location& loc, const Block& block) {
     for (auto& unit : dev.units) {
       std::map<std::string, Affine> tag_map;
       for (const auto& name_coeff : unit.getMap()) {
-        if (name_coeff.first.size() && name_coeff.first[0] == '#') {
-          auto tag = name_coeff.first.substr(1);
+        const std::string& name = name_coeff.first;
+        if (name.size() && name[0] == '#') {
+          auto tag = name.substr(1);
           for (const auto& idx : block.idxs) {
             if (idx.has_tag(tag)) {
               tag_map[name_coeff.first] = idx.name;
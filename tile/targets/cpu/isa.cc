@@ -0,0 +1,129 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/targets/cpu/isa.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Support/Host.h>
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+#include "base/util/env.h"
+
+namespace vertexai {
+namespace tile {
+namespace targets {
+namespace cpu {
+namespace {
+
+std::size_t EnabledCount(const Target& target) {
+  return std::count_if(target.features.begin(), target.features.end(),
+                       [](const std::string& feature) { return !feature.empty() && feature[0] == '+'; });
+}
+
+}  // namespace
+
+bool Target::RunsOn(const Target& host) const {
+  if (triple != host.triple) {
+    return false;
+  }
+  std::set<std::string> available{host.features.begin(), host.features.end()};
+  for (const auto& feature : features) {
+    if (!feature.empty() && feature[0] == '+' && !available.count(feature)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool operator==(const Target& lhs, const Target& rhs) {
+  return lhs.triple == rhs.triple && lhs.cpu == rhs.cpu && lhs.features == rhs.features;
+}
+
+std::ostream& operator<<(std::ostream& out, const Target& target) {
+  out << target.triple << ':' << target.cpu;
+  for (const auto& feature : target.features) {
+    out << ':' << feature;
+  }
+  return out;
+}
+
+std::string to_string(const Target& target) {
+  std::ostringstream out;
+  out << target;
+  return out.str();
+}
+
+bool ParseTarget(const std::string& description, Target* target) {
+  std::vector<std::string> fields;
+  std::istringstream in(description);
+  std::string field;
+  while (std::getline(in, field, ':')) {
+    fields.push_back(field);
+  }
+  if (fields.size() < 2) {
+    return false;
+  }
+  target->triple = fields[0];
+  target->cpu = fields[1];
+  target->features.assign(fields.begin() + 2, fields.end());
+  return true;
+}
+
+const Target& HostIsa() {
+  static const Target host = []() {
+    Target target{llvm::sys::getProcessTriple(), llvm::sys::getHostCPUName().str(), {}};
+    llvm::StringMap<bool> features;
+    if (llvm::sys::getHostCPUFeatures(features)) {
+      for (const auto& feature : features) {
+        target.features.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+      }
+      std::sort(target.features.begin(), target.features.end());
+    }
+    return target;
+  }();
+  return host;
+}
+
+std::vector<Target> PortableTargets(const std::string& triple) {
+  if (llvm::Triple(triple).getArch() != llvm::Triple::x86_64) {
+    return {};
+  }
+  std::vector<std::string> sse42{"+cx16", "+popcnt", "+sahf", "+sse3", "+sse4.1", "+sse4.2", "+ssse3"};
+  std::vector<std::string> avx2{sse42};
+  avx2.insert(avx2.end(), {"+avx", "+avx2", "+bmi", "+bmi2", "+f16c", "+fma", "+lzcnt", "+movbe"});
+  std::vector<std::string> avx512{avx2};
+  avx512.insert(avx512.end(), {"+avx512bw", "+avx512cd", "+avx512dq", "+avx512f", "+avx512vl"});
+  std::vector<std::string> icelake{avx512};
+  icelake.insert(icelake.end(), {"+avx512bitalg", "+avx512ifma", "+avx512vbmi", "+avx512vbmi2", "+avx512vnni",
+                                 "+avx512vpopcntdq"});
+  std::vector<Target> targets;
+  for (auto features : {std::vector<std::string>{}, sse42, avx2, avx512, icelake}) {
+    std::sort(features.begin(), features.end());
+    targets.emplace_back(Target{triple, "x86-64", features});
+  }
+  return targets;
+}
+
+bool PortableRequested() { return !env::Get("PLAIDML_CPU_PORTABLE").empty(); }
+
+std::size_t SelectTarget(const std::vector<Target>& candidates, const Target& host) {
+  std::size_t best = candidates.size();
+  for (std::size_t idx = 0; idx < candidates.size(); ++idx) {
+    if (candidates[idx] == host) {
+      return idx;
+    }
+    if (candidates[idx].RunsOn(host) &&
+        (best == candidates.size() || EnabledCount(candidates[idx]) > EnabledCount(candidates[best]))) {
+      best = idx;
+    }
+  }
+  return best;
+}
+
+}  // namespace cpu
+}  // namespace targets
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,63 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vertexai {
+namespace tile {
+namespace targets {
+namespace cpu {
+
+// Target describes what object code is generated for: the triple, the CPU
+// whose scheduling model is used, and the CPU features the code may use, in
+// LLVM's attribute syntax ("+avx2", "-avx512f").
+struct Target {
+  std::string triple;
+  std::string cpu;
+  std::vector<std::string> features;
+
+  // Returns true if code generated for this target can run on the indicated
+  // host: the triples match, and the host has every feature enabled here.
+  bool RunsOn(const Target& host) const;
+};
+
+bool operator==(const Target& lhs, const Target& rhs);
+
+// Writes a target as "triple:cpu:feature:feature...".
+std::ostream& operator<<(std::ostream& out, const Target& target);
+std::string to_string(const Target& target);
+
+// Parses a target written by operator<<. Returns false if the description
+// lacks a triple or CPU.
+bool ParseTarget(const std::string& description, Target* target);
+
+// Returns the host, with every feature LLVM knows about explicitly enabled or
+// disabled, so that code generation never assumes a feature the CPU name
+// implies but the host (e.g. a virtual machine) lacks.
+const Target& HostIsa();
+
+// Returns the ladder of x86-64 ISA levels for which portable object code is
+// generated: the baseline, then roughly Nehalem (SSE4.2), Haswell (AVX2),
+// Skylake-SP (AVX-512) and Icelake. Each level lists every feature it adds
+// along with those of the levels below it, and names the generic x86-64 CPU,
+// so that its code uses exactly the listed features. Returns no targets if
+// the triple isn't x86-64.
+std::vector<Target> PortableTargets(const std::string& triple);
+
+// Returns true if portable object code has been requested by setting
+// PLAIDML_CPU_PORTABLE. The CPU HAL and the stripe JIT both consult this.
+bool PortableRequested();
+
+// Returns the index of the candidate best suited to the host: an exact match
+// if there is one, otherwise the runnable candidate with the most features.
+// Returns candidates.size() if none of them can run on the host.
+std::size_t SelectTarget(const std::vector<Target>& candidates, const Target& host);
+
+}  // namespace cpu
+}  // namespace targets
+}  // namespace tile
+}  // namespace vertexai
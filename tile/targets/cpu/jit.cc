@@ -4,22 +4,36 @@
 
 #include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Object/ObjectFile.h>
 #include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/ToolOutputFile.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include <llvm/Transforms/Utils/Cloning.h>
 
 #include <algorithm>
+#include <cstdlib>
 #include <deque>
+#include <fstream>
+#include <limits>
 #include <memory>
+#include <set>
+#include <sstream>
 
 #include <half.hpp>
 
+#include "base/util/file.h"
 #include "base/util/lookup.h"
+#include "base/util/thread_pool.h"
 #include "tile/stripe/stripe.h"
+#include "tile/targets/cpu/isa.h"
+#include "tile/targets/cpu/vecmath.h"
 
 namespace vertexai {
 namespace tile {
@@ -28,23 +42,59 @@ namespace cpu {
 
 namespace {
 const char invoker_name_[] = "__invoke_";
+const char object_magic_[] = "stripe-jit-object-4";
+// Local buffers are carved out of scratch arenas at this alignment.
+const uint64_t scratch_align_ = 64;
+uint64_t AlignScratch(uint64_t offset) { return (offset + scratch_align_ - 1) / scratch_align_ * scratch_align_; }
+// Blocks bearing any of these tags are candidates for running their outermost
+// iteration space across the runtime's thread pool.
+const stripe::Tags parallel_tags_{"kernel", "contract_outer"};
+// Blocks bearing any of these tags are candidates for computing their
+// stencil index as the lanes of LLVM vectors.
+const stripe::Tags vector_tags_{"mac_inner"};
+
+bool PortableObjects() {
+  return PortableRequested() && !PortableTargets(HostIsa().triple).empty();
 }
+}  // namespace
 
 struct ProgramModule {
   std::unique_ptr<llvm::Module> module;
   std::vector<std::string> parameters;
   std::map<std::string, void*> externals;
+  uint64_t scratch_size = 0;
 };
 
 class Executable {
  public:
-  explicit Executable(const ProgramModule& module);
+  explicit Executable(const ProgramModule& module, const Target& target = HostIsa());
+  Executable(llvm::LLVMContext* context, const std::vector<std::string>& parameters, uint64_t scratch_size,
+             const std::string& object);
   void Run(const std::map<std::string, void*>& buffers);
   void Save(const std::string& filename);
+  const std::vector<std::string>& parameters() const { return parameters_; }
+  uint64_t scratch_size() const { return scratch_size_; }
+  const std::string& object() const { return object_; }
 
  private:
   std::unique_ptr<llvm::ExecutionEngine> engine_;
   std::vector<std::string> parameters_;
+  uint64_t scratch_size_ = 0;
+  std::string object_;
+};
+
+// Captures the object code MCJIT emits for a module, so that it can be written
+// to disk and reloaded without repeating optimization and code generation.
+class ObjectRecorder : public llvm::ObjectCache {
+ public:
+  void notifyObjectCompiled(const llvm::Module*, llvm::MemoryBufferRef obj) override {
+    object_ = obj.getBuffer().str();
+  }
+  std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module*) override { return nullptr; }
+  const std::string& object() const { return object_; }
+
+ private:
+  std::string object_;
 };
 
 class Error : public std::runtime_error {
@@ -70,7 +120,8 @@ class Compiler : private stripe::ConstStmtVisitor {
  protected:
   explicit Compiler(llvm::LLVMContext* context, llvm::Module* module, const std::map<std::string, External>& externals);
   void GenerateInvoker(const stripe::Block& program, llvm::Function* main);
-  llvm::Function* CompileBlock(const stripe::Block& block);
+  llvm::Function* GenerateTask(const stripe::Block& block, llvm::Function* function, const stripe::Index* split);
+  llvm::Function* CompileBlock(const stripe::Block& block, const stripe::Index* split = nullptr);
   void Visit(const stripe::Load&) override;
   void Visit(const stripe::Store&) override;
   void Visit(const stripe::LoadIndex&) override;
@@ -124,6 +175,7 @@ class Compiler : private stripe::ConstStmtVisitor {
     const stripe::Index* index = nullptr;
     llvm::Value* variable = nullptr;
     llvm::Value* init = nullptr;
+    llvm::Value* range = nullptr;  // Runtime range, when the index is split
   };
 
   struct Loop {
@@ -138,17 +190,30 @@ class Compiler : private stripe::ConstStmtVisitor {
   Scalar CheckBool(Scalar);
   llvm::Type* CType(DataType);
   llvm::Value* ElementPtr(const Buffer& buf);
+  llvm::Value* LoadElement(const Buffer& buf);
+  void StoreElement(const Buffer& buf, llvm::Value* value);
+  llvm::Value* Aggregate(const std::string& agg_op, DataType type, llvm::Value* value, llvm::Value* prev);
+  llvm::Value* Reduce(const std::string& agg_op, DataType type, llvm::Value* value);
+  llvm::Constant* Identity(const std::string& agg_op, DataType type);
   llvm::Value* Eval(const stripe::Affine& access);
   void OutputType(llvm::Value* ret, const stripe::Intrinsic&);
   void OutputBool(llvm::Value* ret, const stripe::Intrinsic&);
   void CallIntrinsicFunc(const stripe::Intrinsic&, const char* name_f32, const char* name_f64);
+  void CallVectorMath(const stripe::Intrinsic&, vecmath::Function fn);
   llvm::Type* IndexType();
   llvm::Value* IndexConst(ssize_t val);
-  llvm::FunctionType* BlockType(const stripe::Block&);
+  llvm::FunctionType* BlockType(const stripe::Block&, const stripe::Index* split);
+  llvm::FunctionType* TaskType();
+  const stripe::Index* ParallelIndex(const stripe::Block&);
+  const stripe::Index* VectorIndex(const stripe::Block&);
+  int64_t VectorStride(const Buffer& buf);
+  llvm::Value* Splat(llvm::Value* value);
+  llvm::Constant* LaneOffsets(int64_t stride);
+  bool NeedsZero(const stripe::Block&, const stripe::Refinement&);
   llvm::Value* MallocFunction();
-  llvm::Value* CallocFunction();
-  llvm::Value* FreeFunction();
   llvm::Value* PrngStepFunction();
+  llvm::Value* ParallelForFunction();
+  llvm::Value* ThreadScratchFunction();
 
   llvm::LLVMContext& context_;
   llvm::IRBuilder<> builder_;
@@ -159,6 +224,23 @@ class Compiler : private stripe::ConstStmtVisitor {
   std::map<std::string, Scalar> scalars_;
   std::map<std::string, Buffer> buffers_;
   std::map<std::string, Index> indexes_;
+  bool in_parallel_ = false;
+  // Each block function receives a scratch arena, from which it allocates the
+  // local buffers of the blocks it calls; the remainder of the arena is passed
+  // along as the callee's own scratch arena. scratch_size_ is the number of
+  // bytes this block function's arena must provide.
+  llvm::Value* scratch_ = nullptr;
+  uint64_t scratch_size_ = 0;
+  // In a vectorized block, the loop over the vector index runs once, and each
+  // scalar holds one lane per value of the index, starting at its initial
+  // value. If the block's constraints rule out some lanes, vector_mask_
+  // selects the lanes which remain active.
+  const stripe::Index* vector_idx_ = nullptr;
+  unsigned vector_width_ = 0;
+  llvm::Value* vector_mask_ = nullptr;
+  // The operands of each vector product, so that accumulating a product can
+  // be fused into a single multiply-add.
+  std::map<llvm::Value*, std::pair<llvm::Value*, llvm::Value*>> products_;
 };
 
 Compiler::Compiler(llvm::LLVMContext* context, const std::map<std::string, External>& externals)
@@ -180,6 +262,7 @@ ProgramModule Compiler::CompileProgram(const stripe::Block& program) {
   module_ = ret.module.get();
   llvm::Function* main = CompileBlock(program);
   ret.externals = external_funcptrs_;
+  ret.scratch_size = scratch_size_;
   // Generate a stub function we can invoke from the outside, passing buffers
   // as an array of generic pointers.
   GenerateInvoker(program, main);
@@ -259,16 +342,66 @@ void Compiler::GenerateInvoker(const stripe::Block& program, llvm::Function* mai
   for (unsigned i = 0; i < program.idxs.size(); ++i) {
     args.push_back(IndexConst(0));
   }
+  // The scratch arena for the run follows the buffer pointers in the array.
+  {
+    llvm::Value* index = builder_.getInt32(program.refs.size());
+    llvm::Value* elptr = builder_.CreateGEP(argvec, index);
+    args.push_back(builder_.CreateLoad(elptr));
+  }
   // Having built the argument list, we'll call the actual kernel using the
   // parameter signature it expects.
   builder_.CreateCall(main, args, "");
   builder_.CreateRetVoid();
 }
 
-llvm::Function* Compiler::CompileBlock(const stripe::Block& block) {
+llvm::Function* Compiler::GenerateTask(const stripe::Block& block, llvm::Function* function,
+                                       const stripe::Index* split) {
+  // Generate a wrapper which the runtime's parallel_for will call, on some
+  // worker thread, for each contiguous subrange of the split index. Like the
+  // invoker, it receives the block's parameters packed into an array of
+  // generic pointers: first the buffers, then the initial value of each index.
+  // It offsets the split index by the start of the subrange and passes the
+  // length of the subrange along as the split index's range.
+  auto linkage = llvm::Function::ExternalLinkage;
+  auto task = llvm::Function::Create(TaskType(), linkage, block.name + "_task", module_);
+  auto bb = llvm::BasicBlock::Create(context_, "entry", task);
+  builder_.SetInsertPoint(bb);
+  auto ai = task->arg_begin();
+  llvm::Value* argvec = &(*ai++);
+  llvm::Value* begin = &(*ai++);
+  llvm::Value* end = &(*ai);
+  std::vector<llvm::Value*> args;
+  unsigned i = 0;
+  for (auto& ref : block.refs) {
+    llvm::Value* elptr = builder_.CreateGEP(argvec, builder_.getInt32(i++));
+    llvm::Value* elval = builder_.CreateLoad(elptr);
+    llvm::Type* eltype = CType(ref.interior_shape.type)->getPointerTo();
+    args.push_back(builder_.CreateBitCast(elval, eltype));
+  }
+  for (auto& idx : block.idxs) {
+    llvm::Value* elptr = builder_.CreateGEP(argvec, builder_.getInt32(i++));
+    llvm::Value* init = builder_.CreatePtrToInt(builder_.CreateLoad(elptr), IndexType());
+    if (&idx == split) {
+      init = builder_.CreateAdd(init, begin);
+    }
+    args.push_back(init);
+  }
+  args.push_back(builder_.CreateSub(end, begin));
+  // Tasks run concurrently, so each draws its scratch arena from the worker
+  // thread running it rather than sharing the caller's.
+  std::vector<llvm::Value*> scratch_args{IndexConst(scratch_size_)};
+  args.push_back(builder_.CreateCall(ThreadScratchFunction(), scratch_args, ""));
+  builder_.CreateCall(function, args, "");
+  builder_.CreateRetVoid();
+  return task;
+}
+
+llvm::Function* Compiler::CompileBlock(const stripe::Block& block, const stripe::Index* split) {
   // Generate a function implementing the body of this block.
   // Buffers (refinements) will be passed in as function parameters, as will
-  // the initial value for each index.
+  // the initial value for each index. If the block's iteration space is split
+  // across threads, the range of the split index follows. The final parameter
+  // is the block's scratch arena.
 
   for (const auto& ref : block.refs) {
     buffers_[ref.into()] = Buffer{&ref};
@@ -276,11 +409,15 @@ llvm::Function* Compiler::CompileBlock(const stripe::Block& block) {
   for (const auto& idx : block.idxs) {
     indexes_[idx.name] = Index{&idx};
   }
+  if (!split) {
+    vector_idx_ = VectorIndex(block);
+    vector_width_ = vector_idx_ ? vector_idx_->range : 0;
+  }
 
   // create the LLVM function which will implement the Stripe block
   auto linkage = llvm::Function::ExternalLinkage;
   auto name = block.name;
-  auto func_type = BlockType(block);
+  auto func_type = BlockType(block, split);
   auto function = llvm::Function::Create(func_type, linkage, name, module_);
   // create a basic block; configure the builder to start there
   auto bb = llvm::BasicBlock::Create(context_, "entry", function);
@@ -296,12 +433,18 @@ llvm::Function* Compiler::CompileBlock(const stripe::Block& block) {
       ai->setName(param_name);
       assert(nullptr == buffers_[param_name].base);
       buffers_[param_name].base = &(*ai);
-    } else {
+    } else if (idx - block.refs.size() < block.idxs.size()) {
       idx -= block.refs.size();
       std::string param_name = block.idxs[idx].name;
       ai->setName(param_name);
       assert(nullptr == indexes_[param_name].init);
       indexes_[param_name].init = &(*ai);
+    } else if (split && idx == block.refs.size() + block.idxs.size()) {
+      ai->setName(split->name + "_range");
+      indexes_[split->name].range = &(*ai);
+    } else {
+      ai->setName("scratch");
+      scratch_ = &(*ai);
     }
   }
 
@@ -335,7 +478,13 @@ llvm::Function* Compiler::CompileBlock(const stripe::Block& block) {
     builder_.SetInsertPoint(loops[i].test);
     llvm::Value* index = builder_.CreateLoad(variable);
     assert(block.idxs[i].affine == Affine());
-    llvm::Value* range = IndexConst(block.idxs[i].range);
+    llvm::Value* range = indexes_[block.idxs[i].name].range;
+    if (&block.idxs[i] == vector_idx_) {
+      // A single iteration covers every lane of the vector index.
+      range = IndexConst(1);
+    } else if (!range) {
+      range = IndexConst(block.idxs[i].range);
+    }
     llvm::Value* limit = builder_.CreateAdd(init, range);
     llvm::Value* go = builder_.CreateICmpULT(index, limit);
     builder_.CreateCondBr(go, loops[i].body, loops[i].done);
@@ -347,9 +496,23 @@ llvm::Function* Compiler::CompileBlock(const stripe::Block& block) {
   llvm::Value* go = builder_.getTrue();
   for (auto& constraint : block.constraints) {
     llvm::Value* gateval = Eval(constraint);
+    if (vector_idx_ && constraint[vector_idx_->name]) {
+      // The constraint varies from lane to lane, so evaluate it per lane; the
+      // inactive lanes will be masked out of every access to memory.
+      llvm::Value* lanes = builder_.CreateAdd(Splat(gateval), LaneOffsets(constraint[vector_idx_->name]));
+      llvm::Value* check = builder_.CreateICmpSGE(lanes, llvm::Constant::getNullValue(lanes->getType()));
+      vector_mask_ = vector_mask_ ? builder_.CreateAnd(check, vector_mask_) : check;
+      continue;
+    }
     llvm::Value* check = builder_.CreateICmpSGE(gateval, IndexConst(0));
     go = builder_.CreateAnd(check, go);
   }
+  if (vector_mask_) {
+    // Skip the body altogether when no lane is active.
+    llvm::Value* bits = builder_.CreateBitCast(vector_mask_, builder_.getIntNTy(vector_width_));
+    llvm::Value* any = builder_.CreateICmpNE(bits, builder_.getIntN(vector_width_, 0));
+    go = builder_.CreateAnd(any, go);
+  }
   auto block_body = llvm::BasicBlock::Create(context_, "block", function);
   auto block_done = llvm::BasicBlock::Create(context_, "next", function);
   builder_.CreateCondBr(go, block_body, block_done);
@@ -387,8 +550,12 @@ void Compiler::Visit(const stripe::Load& load) {
   // Look up the address of the target element.
   // Load the value from that address and use it to redefine the
   // destination scalar.
-  llvm::Value* element = ElementPtr(from);
-  llvm::Value* value = builder_.CreateLoad(element);
+  llvm::Value* value = LoadElement(from);
+  if (vector_idx_ && !value->getType()->isVectorTy()) {
+    // The source does not vary along the vector index; broadcast the value
+    // to every lane.
+    value = Splat(value);
+  }
   scalars_[load.into] = Scalar{value, from.refinement->interior_shape.type};
 }
 
@@ -404,60 +571,35 @@ void Compiler::Visit(const stripe::Store& store) {
   Buffer into = buffers_[store.into];
   Scalar from = Cast(scalars_[store.from], into.refinement->interior_shape.type);
   llvm::Value* value = from.value;
-  llvm::Value* element = ElementPtr(into);
   std::string agg_op = into.refinement->agg_op;
-  if ("add" == agg_op) {
-    llvm::Value* prev = builder_.CreateLoad(element);
-    if (is_float(from.type)) {
-      value = builder_.CreateFAdd(value, prev);
-    } else if (is_int(from.type) || is_uint(from.type)) {
-      value = builder_.CreateAdd(value, prev);
-    } else {
-      throw Error("Invalid addition type: " + to_string(from.type));
-    }
-  } else if ("mul" == agg_op) {
-    llvm::Value* prev = builder_.CreateLoad(element);
-    if (is_float(from.type)) {
-      value = builder_.CreateFMul(value, prev);
-    } else if (is_int(from.type) || is_uint(from.type)) {
-      value = builder_.CreateMul(value, prev);
+  if (vector_idx_ && !VectorStride(into)) {
+    // Every lane aggregates into the same element: the vector index is an
+    // accumulation index for this output, so combine the lanes first.
+    value = Reduce(agg_op, from.type, value);
+  }
+  if (!agg_op.empty() && "assign" != agg_op) {
+    llvm::Value* prev = LoadElement(into);
+    auto product = products_.find(value);
+    if ("add" == agg_op && product != products_.end()) {
+      // Accumulate the product with a multiply-add, which the backend will
+      // emit as a fused instruction wherever the target supports one.
+      auto fmuladd = llvm::Intrinsic::getDeclaration(module_, llvm::Intrinsic::fmuladd, {value->getType()});
+      std::vector<llvm::Value*> args{product->second.first, product->second.second, prev};
+      value = builder_.CreateCall(fmuladd, args, "");
     } else {
-      throw Error("Invalid multiplication type: " + to_string(from.type));
-    }
-  } else if ("max" == agg_op) {
-    llvm::Value* prev = builder_.CreateLoad(element);
-    llvm::Value* flag = nullptr;
-    if (is_float(from.type)) {
-      flag = builder_.CreateFCmpUGT(prev, value);
-    } else if (is_int(from.type)) {
-      flag = builder_.CreateICmpSGT(prev, value);
-    } else if (is_uint(from.type)) {
-      flag = builder_.CreateICmpUGT(prev, value);
-    }
-    value = builder_.CreateSelect(flag, prev, value);
-  } else if ("min" == agg_op) {
-    llvm::Value* prev = builder_.CreateLoad(element);
-    llvm::Value* flag = nullptr;
-    if (is_float(from.type)) {
-      flag = builder_.CreateFCmpULT(prev, value);
-    } else if (is_int(from.type)) {
-      flag = builder_.CreateICmpSLT(prev, value);
-    } else if (is_uint(from.type)) {
-      flag = builder_.CreateICmpULT(prev, value);
+      value = Aggregate(agg_op, from.type, value, prev);
     }
-    value = builder_.CreateSelect(flag, prev, value);
-  } else if ("assign" == agg_op) {
-    // fall through to assignment
-  } else if (!agg_op.empty()) {
-    throw Error("Unimplemented agg_op: " + to_string(agg_op));
   }
-  builder_.CreateStore(value, element);
+  StoreElement(into, value);
 }
 
 void Compiler::Visit(const stripe::LoadIndex& load_index) {
   // op->from is an affine
   // op->into is the name of a destination scalar
   llvm::Value* rval = Eval(load_index.from);
+  if (vector_idx_) {
+    rval = builder_.CreateAdd(Splat(rval), LaneOffsets(load_index.from[vector_idx_->name]));
+  }
   scalars_[load_index.into] = Scalar{rval, DataType::INT64};
 }
 
@@ -475,6 +617,10 @@ void Compiler::Visit(const stripe::Constant& constant) {
       scalars_[constant.name] = Scalar{value, DataType::FLOAT64};
     } break;
   }
+  if (vector_idx_) {
+    auto& scalar = scalars_[constant.name];
+    scalar.value = Splat(scalar.value);
+  }
 }
 
 void Compiler::Visit(const stripe::Special& special) {
@@ -555,31 +701,38 @@ void Compiler::Visit(const stripe::Intrinsic& intrinsic) {
 }
 
 void Compiler::Visit(const stripe::Block& block) {
-  // Compile a nested block as a function in the same module
+  // Compile a nested block as a function in the same module. If it is safe to
+  // do so, we will divide its iteration space among the runtime's worker
+  // threads; anything nested inside a parallel block runs serially.
+  const stripe::Index* split = in_parallel_ ? nullptr : ParallelIndex(block);
   Compiler nested(&context_, module_, external_handlers_);
-  auto function = nested.CompileBlock(block);
+  nested.in_parallel_ = in_parallel_ || split;
+  auto function = nested.CompileBlock(block, split);
+  llvm::Function* task = split ? nested.GenerateTask(block, function, split) : nullptr;
   for (auto& fptr_iter : nested.external_funcptrs_) {
     external_funcptrs_.emplace(fptr_iter);
   }
   // Generate a list of args.
   // The argument list begins with a pointer to each refinement. We will either
   // pass along the address of a refinement from the current block, or allocate
-  // a new buffer for the nested block's use.
+  // a new buffer for the nested block's use from our scratch arena.
   std::vector<llvm::Value*> args;
-  std::vector<llvm::Value*> allocs;
+  uint64_t locals_size = 0;
   for (auto& ref : block.refs) {
     llvm::Value* buffer = nullptr;
     // When a refinement is neither in nor out, and it has no "from"
     // name, it represents a local allocation.
     if (ref.dir == stripe::RefDir::None && ref.from.empty()) {
-      // Allocate new storage for the buffer.
+      // Assign the buffer the next slot in the arena. The arena is reused from
+      // one call to the next, so clear the buffer if its previous contents
+      // could be observed.
       size_t size = ref.interior_shape.byte_size();
-      std::vector<llvm::Value*> calloc_args;
-      calloc_args.push_back(IndexConst(size));
-      calloc_args.push_back(IndexConst(1));
-      auto calloc_func = CallocFunction();
-      buffer = builder_.CreateCall(calloc_func, calloc_args, "");
-      allocs.push_back(buffer);
+      uint64_t offset = AlignScratch(locals_size);
+      locals_size = offset + size;
+      buffer = builder_.CreateGEP(scratch_, IndexConst(offset));
+      if (NeedsZero(block, ref)) {
+        builder_.CreateMemSet(buffer, builder_.getInt8(0), size, scratch_align_);
+      }
       llvm::Type* buftype = CType(ref.interior_shape.type)->getPointerTo();
       buffer = builder_.CreateBitCast(buffer, buftype);
     } else {
@@ -597,14 +750,35 @@ void Compiler::Visit(const stripe::Block& block) {
   for (auto& idx : block.idxs) {
     args.push_back(Eval(idx.affine));
   }
-  // Invoke the function. It does not return a value.
-  builder_.CreateCall(function, args, "");
-  // Free the temporary buffers we allocated as parameter values.
-  for (auto ptr : allocs) {
-    std::vector<llvm::Value*> free_args;
-    free_args.push_back(ptr);
-    auto free_func = FreeFunction();
-    builder_.CreateCall(free_func, free_args, "");
+  if (split) {
+    // Pack the args into an array of generic pointers, which the task wrapper
+    // will unpack, and have the runtime run the task over the split index's
+    // range. The array lives in the calling function's entry block so that
+    // repeated calls inside a loop do not grow the stack.
+    llvm::Function* caller = builder_.GetInsertBlock()->getParent();
+    llvm::IRBuilder<> entry_builder(&caller->getEntryBlock(), caller->getEntryBlock().begin());
+    llvm::Type* voidptr = builder_.getInt8PtrTy();
+    llvm::Value* argvec = entry_builder.CreateAlloca(voidptr, builder_.getInt32(args.size()));
+    for (size_t i = 0; i < args.size(); ++i) {
+      llvm::Value* arg = args[i];
+      if (arg->getType()->isPointerTy()) {
+        arg = builder_.CreateBitCast(arg, voidptr);
+      } else {
+        arg = builder_.CreateIntToPtr(arg, voidptr);
+      }
+      llvm::Value* elptr = builder_.CreateGEP(argvec, builder_.getInt32(i));
+      builder_.CreateStore(arg, elptr);
+    }
+    std::vector<llvm::Value*> pfor_args{task, argvec, IndexConst(split->range)};
+    builder_.CreateCall(ParallelForFunction(), pfor_args, "");
+  } else {
+    // The rest of our arena, past the local buffers, becomes the nested
+    // block's arena.
+    uint64_t nested_offset = AlignScratch(locals_size);
+    args.push_back(builder_.CreateGEP(scratch_, IndexConst(nested_offset)));
+    scratch_size_ = std::max(scratch_size_, nested_offset + nested.scratch_size_);
+    // Invoke the function. It does not return a value.
+    builder_.CreateCall(function, args, "");
   }
 }
 
@@ -731,6 +905,9 @@ void Compiler::Multiply(const stripe::Intrinsic& mul) {
   llvm::Value* ret = nullptr;
   if (is_float(mul.type)) {
     ret = builder_.CreateFMul(lhs.value, rhs.value);
+    if (vector_idx_) {
+      products_[ret] = std::make_pair(lhs.value, rhs.value);
+    }
   } else if (is_int(mul.type) || is_uint(mul.type)) {
     ret = builder_.CreateMul(lhs.value, rhs.value);
   } else {
@@ -976,17 +1153,57 @@ void Compiler::BitRight(const stripe::Intrinsic& stmt) {
   OutputType(ret, stmt);
 }
 
-void Compiler::Sqrt(const stripe::Intrinsic& stmt) { CallIntrinsicFunc(stmt, "sqrtf", "sqrt"); }
+void Compiler::Sqrt(const stripe::Intrinsic& stmt) {
+  if (!vector_idx_) {
+    CallIntrinsicFunc(stmt, "sqrtf", "sqrt");
+    return;
+  }
+  // The llvm.sqrt intrinsic is overloaded on vector types, and lowers to the
+  // target's packed square root (e.g. vsqrtps) instead of a call per lane.
+  // Like the C intrinsics, it evaluates single and half-precision floats in
+  // single precision and everything else in double precision.
+  assert(1 == stmt.inputs.size());
+  bool use_f32 = (stmt.type == DataType::FLOAT16 || stmt.type == DataType::FLOAT32);
+  DataType eval_type = use_f32 ? DataType::FLOAT32 : DataType::FLOAT64;
+  llvm::Value* op = Cast(Cast(scalars_[stmt.inputs[0]], stmt.type), eval_type).value;
+  auto sqrt = llvm::Intrinsic::getDeclaration(module_, llvm::Intrinsic::sqrt, {op->getType()});
+  Scalar ret{builder_.CreateCall(sqrt, {op}), eval_type};
+  OutputType(Cast(ret, stmt.type).value, stmt);
+}
 
-void Compiler::Exp(const stripe::Intrinsic& stmt) { CallIntrinsicFunc(stmt, "expf", "exp"); }
+void Compiler::Exp(const stripe::Intrinsic& stmt) {
+  if (vector_idx_) {
+    CallVectorMath(stmt, vecmath::Function::EXP);
+  } else {
+    CallIntrinsicFunc(stmt, "expf", "exp");
+  }
+}
 
-void Compiler::Log(const stripe::Intrinsic& stmt) { CallIntrinsicFunc(stmt, "logf", "log"); }
+void Compiler::Log(const stripe::Intrinsic& stmt) {
+  if (vector_idx_) {
+    CallVectorMath(stmt, vecmath::Function::LOG);
+  } else {
+    CallIntrinsicFunc(stmt, "logf", "log");
+  }
+}
 
-void Compiler::Pow(const stripe::Intrinsic& stmt) { CallIntrinsicFunc(stmt, "powf", "pow"); }
+void Compiler::Pow(const stripe::Intrinsic& stmt) { CallVectorMath(stmt, vecmath::Function::POW); }
 
-void Compiler::Tanh(const stripe::Intrinsic& stmt) { CallIntrinsicFunc(stmt, "tanhf", "tanh"); }
+void Compiler::Tanh(const stripe::Intrinsic& stmt) {
+  if (vector_idx_) {
+    CallVectorMath(stmt, vecmath::Function::TANH);
+  } else {
+    CallIntrinsicFunc(stmt, "tanhf", "tanh");
+  }
+}
 
-void Compiler::Cos(const stripe::Intrinsic& stmt) { CallIntrinsicFunc(stmt, "cosf", "cos"); }
+void Compiler::Cos(const stripe::Intrinsic& stmt) {
+  if (vector_idx_) {
+    CallVectorMath(stmt, vecmath::Function::COS);
+  } else {
+    CallIntrinsicFunc(stmt, "cosf", "cos");
+  }
+}
 
 void Compiler::Zero(const stripe::Special& zero) {
   // present in stripe.proto but not defined in the specification
@@ -1030,6 +1247,9 @@ Compiler::Scalar Compiler::Cast(Scalar v, DataType to_type) {
     return v;
   }
   llvm::Type* to_llvmtype = CType(to_type);
+  if (v.value->getType()->isVectorTy()) {
+    to_llvmtype = llvm::VectorType::get(to_llvmtype, v.value->getType()->getVectorNumElements());
+  }
   bool from_signed = is_int(v.type) || is_float(v.type);
   bool to_signed = is_int(to_type) || is_float(to_type);
   auto op = llvm::CastInst::getCastOpcode(v.value, from_signed, to_llvmtype, to_signed);
@@ -1083,6 +1303,130 @@ llvm::Value* Compiler::ElementPtr(const Buffer& buf) {
   return builder_.CreateGEP(buf.base, idxList);
 }
 
+llvm::Value* Compiler::LoadElement(const Buffer& buf) {
+  llvm::Value* element = ElementPtr(buf);
+  if (!vector_idx_ || !VectorStride(buf)) {
+    return builder_.CreateLoad(element);
+  }
+  // The lanes occupy consecutive elements, beginning with the element at the
+  // vector index's initial value.
+  unsigned align = byte_width(buf.refinement->interior_shape.type);
+  llvm::Type* vectype = llvm::VectorType::get(CType(buf.refinement->interior_shape.type), vector_width_);
+  llvm::Value* ptr = builder_.CreateBitCast(element, vectype->getPointerTo());
+  if (vector_mask_) {
+    return builder_.CreateMaskedLoad(ptr, align, vector_mask_);
+  }
+  return builder_.CreateAlignedLoad(ptr, align);
+}
+
+void Compiler::StoreElement(const Buffer& buf, llvm::Value* value) {
+  llvm::Value* element = ElementPtr(buf);
+  if (!vector_idx_ || !VectorStride(buf)) {
+    builder_.CreateStore(value, element);
+    return;
+  }
+  unsigned align = byte_width(buf.refinement->interior_shape.type);
+  llvm::Value* ptr = builder_.CreateBitCast(element, value->getType()->getPointerTo());
+  if (vector_mask_) {
+    builder_.CreateMaskedStore(value, ptr, align, vector_mask_);
+  } else {
+    builder_.CreateAlignedStore(value, ptr, align);
+  }
+}
+
+llvm::Value* Compiler::Aggregate(const std::string& agg_op, DataType type, llvm::Value* value, llvm::Value* prev) {
+  // Combine a value with the previous contents of its destination, according
+  // to the destination's aggregation operation (add, product/mul, min, max).
+  if ("add" == agg_op) {
+    if (is_float(type)) {
+      return builder_.CreateFAdd(value, prev);
+    } else if (is_int(type) || is_uint(type)) {
+      return builder_.CreateAdd(value, prev);
+    }
+    throw Error("Invalid addition type: " + to_string(type));
+  } else if ("mul" == agg_op) {
+    if (is_float(type)) {
+      return builder_.CreateFMul(value, prev);
+    } else if (is_int(type) || is_uint(type)) {
+      return builder_.CreateMul(value, prev);
+    }
+    throw Error("Invalid multiplication type: " + to_string(type));
+  } else if ("max" == agg_op) {
+    llvm::Value* flag = nullptr;
+    if (is_float(type)) {
+      flag = builder_.CreateFCmpUGT(prev, value);
+    } else if (is_int(type)) {
+      flag = builder_.CreateICmpSGT(prev, value);
+    } else if (is_uint(type)) {
+      flag = builder_.CreateICmpUGT(prev, value);
+    }
+    return builder_.CreateSelect(flag, prev, value);
+  } else if ("min" == agg_op) {
+    llvm::Value* flag = nullptr;
+    if (is_float(type)) {
+      flag = builder_.CreateFCmpULT(prev, value);
+    } else if (is_int(type)) {
+      flag = builder_.CreateICmpSLT(prev, value);
+    } else if (is_uint(type)) {
+      flag = builder_.CreateICmpULT(prev, value);
+    }
+    return builder_.CreateSelect(flag, prev, value);
+  }
+  throw Error("Unimplemented agg_op: " + to_string(agg_op));
+}
+
+llvm::Value* Compiler::Reduce(const std::string& agg_op, DataType type, llvm::Value* value) {
+  // Fold the lanes of a vector together, combining its upper half into its
+  // lower half for as long as the width is even. Inactive lanes contribute
+  // the aggregation's identity.
+  if (vector_mask_) {
+    value = builder_.CreateSelect(vector_mask_, value, Splat(Identity(agg_op, type)));
+  }
+  unsigned width = vector_width_;
+  while (width % 2 == 0) {
+    width /= 2;
+    std::vector<uint32_t> lower;
+    std::vector<uint32_t> upper;
+    for (unsigned i = 0; i < width; ++i) {
+      lower.push_back(i);
+      upper.push_back(width + i);
+    }
+    llvm::Value* undef = llvm::UndefValue::get(value->getType());
+    llvm::Value* lo = builder_.CreateShuffleVector(value, undef, lower);
+    llvm::Value* hi = builder_.CreateShuffleVector(value, undef, upper);
+    value = Aggregate(agg_op, type, hi, lo);
+  }
+  llvm::Value* ret = builder_.CreateExtractElement(value, uint64_t(0));
+  for (unsigned i = 1; i < width; ++i) {
+    ret = Aggregate(agg_op, type, builder_.CreateExtractElement(value, i), ret);
+  }
+  return ret;
+}
+
+llvm::Constant* Compiler::Identity(const std::string& agg_op, DataType type) {
+  llvm::Type* ctype = CType(type);
+  if ("add" == agg_op) {
+    return llvm::Constant::getNullValue(ctype);
+  } else if ("mul" == agg_op) {
+    return is_float(type) ? llvm::ConstantFP::get(ctype, 1.0) : llvm::ConstantInt::get(ctype, 1);
+  } else if ("max" == agg_op) {
+    if (is_float(type)) {
+      return llvm::ConstantFP::getInfinity(ctype, true);
+    } else if (is_int(type)) {
+      return llvm::ConstantInt::get(context_, llvm::APInt::getSignedMinValue(bit_width(type)));
+    }
+    return llvm::Constant::getNullValue(ctype);
+  } else if ("min" == agg_op) {
+    if (is_float(type)) {
+      return llvm::ConstantFP::getInfinity(ctype, false);
+    } else if (is_int(type)) {
+      return llvm::ConstantInt::get(context_, llvm::APInt::getSignedMaxValue(bit_width(type)));
+    }
+    return llvm::Constant::getAllOnesValue(ctype);
+  }
+  throw Error("Unimplemented agg_op: " + to_string(agg_op));
+}
+
 llvm::Value* Compiler::Eval(const stripe::Affine& access) {
   llvm::Value* offset = IndexConst(0);
   for (auto& term : access.getMap()) {
@@ -1122,10 +1466,35 @@ void Compiler::CallIntrinsicFunc(const stripe::Intrinsic& stmt, const char* name
   std::vector<llvm::Type*> argtypes{ctype};
   auto functype = llvm::FunctionType::get(ctype, argtypes, false);
   auto func = module_->getOrInsertFunction(name, functype);
-  llvm::Value* ret = builder_.CreateCall(func, argvals, "");
+  llvm::Value* ret = nullptr;
+  if (vector_idx_) {
+    // The C library has no vector flavors, so apply the function lane by lane.
+    ret = llvm::UndefValue::get(llvm::VectorType::get(ctype, vector_width_));
+    for (unsigned i = 0; i < vector_width_; ++i) {
+      std::vector<llvm::Value*> lane{builder_.CreateExtractElement(op.value, i)};
+      ret = builder_.CreateInsertElement(ret, builder_.CreateCall(func, lane, ""), i);
+    }
+  } else {
+    ret = builder_.CreateCall(func, argvals, "");
+  }
   OutputType(ret, stmt);
 }
 
+void Compiler::CallVectorMath(const stripe::Intrinsic& stmt, vecmath::Function fn) {
+  // Like the C intrinsics, vecmath evaluates single and half-precision floats
+  // in single precision and everything else in double precision. It generates
+  // inline code for whole vectors, so vectorized blocks keep every lane busy
+  // instead of calling the C library once per lane.
+  bool use_f32 = (stmt.type == DataType::FLOAT16 || stmt.type == DataType::FLOAT32);
+  DataType eval_type = use_f32 ? DataType::FLOAT32 : DataType::FLOAT64;
+  std::vector<llvm::Value*> args;
+  for (const auto& input : stmt.inputs) {
+    args.push_back(Cast(Cast(scalars_[input], stmt.type), eval_type).value);
+  }
+  Scalar ret{vecmath::Emit(&builder_, fn, args), eval_type};
+  OutputType(Cast(ret, stmt.type).value, stmt);
+}
+
 llvm::Type* Compiler::IndexType() {
   unsigned archbits = module_->getDataLayout().getPointerSizeInBits();
   return llvm::IntegerType::get(context_, archbits);
@@ -1136,7 +1505,7 @@ llvm::Value* Compiler::IndexConst(ssize_t val) {
   return llvm::ConstantInt::get(ssizetype, val);
 }
 
-llvm::FunctionType* Compiler::BlockType(const stripe::Block& block) {
+llvm::FunctionType* Compiler::BlockType(const stripe::Block& block, const stripe::Index* split) {
   // Generate a type for the function which will implement this block.
   std::vector<llvm::Type*> param_types;
   // Each buffer base address will be provided as a parameter.
@@ -1148,11 +1517,230 @@ llvm::FunctionType* Compiler::BlockType(const stripe::Block& block) {
   for (size_t i = 0; i < block.idxs.size(); ++i) {
     param_types.push_back(IndexType());
   }
+  // A split block also receives the range of its split index.
+  if (split) {
+    param_types.push_back(IndexType());
+  }
+  // Finally, every block receives a scratch arena.
+  param_types.push_back(builder_.getInt8PtrTy());
   // Blocks never return a value.
   llvm::Type* return_type = builder_.getVoidTy();
   return llvm::FunctionType::get(return_type, param_types, false);
 }
 
+llvm::FunctionType* Compiler::TaskType() {
+  // Task wrappers receive the packed parameter array and a subrange.
+  llvm::Type* arrayptr = builder_.getInt8PtrTy()->getPointerTo();
+  std::vector<llvm::Type*> param_types{arrayptr, IndexType(), IndexType()};
+  llvm::Type* return_type = builder_.getVoidTy();
+  return llvm::FunctionType::get(return_type, param_types, false);
+}
+
+const stripe::Index* Compiler::ParallelIndex(const stripe::Block& block) {
+  // Decide whether the iterations of this block may run concurrently, and if
+  // so, pick the index whose range we will divide among threads. We only
+  // consider tagged kernel blocks; anything smaller is not worth the dispatch.
+  if (!block.has_any_tags(parallel_tags_)) {
+    return nullptr;
+  }
+  // Local allocations are shared by every iteration of the block, and
+  // specials may carry state from one iteration to the next (e.g. PRNG).
+  for (const auto& ref : block.refs) {
+    if (ref.dir == stripe::RefDir::None && ref.from.empty()) {
+      return nullptr;
+    }
+  }
+  for (const auto& stmt : block.stmts) {
+    if (stmt->kind() == stripe::StmtKind::Special) {
+      return nullptr;
+    }
+  }
+  // An index is safe to split if distinct values of it write disjoint slices
+  // of every output: each output must step along some dimension by at least
+  // the extent swept in that dimension by one value of the index, which is the
+  // refined view plus the span of the block's other indexes. This rules out
+  // accumulation indexes, and indexes whose writes overlap through other terms
+  // (as in an x + k access), which would race on the same elements.
+  const stripe::Index* best = nullptr;
+  for (const auto& idx : block.idxs) {
+    if (idx.range < 2 || (best && idx.range <= best->range)) {
+      continue;
+    }
+    bool disjoint = true;
+    for (const auto& ref : block.refs) {
+      if (!IsWriteDir(ref.dir)) {
+        continue;
+      }
+      bool stepped = false;
+      if (ref.access.size() == ref.interior_shape.dims.size()) {
+        for (size_t i = 0; i < ref.access.size(); ++i) {
+          auto coeff = std::abs(ref.access[i][idx.name]);
+          if (!coeff) {
+            continue;
+          }
+          uint64_t extent = ref.interior_shape.dims[i].size;
+          for (const auto& other : block.idxs) {
+            if (&other != &idx) {
+              extent += std::abs(ref.access[i][other.name]) * (other.range - 1);
+            }
+          }
+          if (static_cast<uint64_t>(coeff) >= extent) {
+            stepped = true;
+          }
+        }
+      }
+      disjoint = disjoint && stepped;
+    }
+    if (disjoint) {
+      best = &idx;
+    }
+  }
+  return best;
+}
+
+const stripe::Index* Compiler::VectorIndex(const stripe::Block& block) {
+  // Decide whether to compute this block's iterations along its stencil index
+  // as the lanes of a vector. The stencil passes tag the inner block of each
+  // matched kernel, and tag the index along which its operands are laid out.
+  if (!block.has_any_tags(vector_tags_)) {
+    return nullptr;
+  }
+  const stripe::Index* vector_idx = nullptr;
+  for (const auto& idx : block.idxs) {
+    if (idx.range > 1 && idx.has_tag("stencil")) {
+      if (vector_idx) {
+        return nullptr;
+      }
+      vector_idx = &idx;
+    }
+  }
+  if (!vector_idx) {
+    return nullptr;
+  }
+  // Each lane must access either the element following its predecessor's, or
+  // the same element as every other lane. Booleans are excluded, since LLVM
+  // packs vectors of them into bits.
+  for (const auto& ref : block.refs) {
+    auto stride = ref.FlatAccess()[vector_idx->name];
+    if ((stride != 0 && stride != 1) || ref.interior_shape.type == DataType::BOOLEAN) {
+      return nullptr;
+    }
+  }
+  for (const auto& stmt : block.stmts) {
+    switch (stmt->kind()) {
+      case stripe::StmtKind::Block:
+      case stripe::StmtKind::Special:
+        return nullptr;
+      case stripe::StmtKind::Intrinsic:
+        if (external_handlers_.count(stripe::Intrinsic::Downcast(stmt)->name)) {
+          return nullptr;
+        }
+        break;
+      case stripe::StmtKind::Store: {
+        // Stores shared by every lane must reduce the lanes to a single value.
+        static const std::set<std::string> reductions{"add", "mul", "max", "min"};
+        auto ref = block.ref_by_into(stripe::Store::Downcast(stmt)->into);
+        if (!ref->FlatAccess()[vector_idx->name] && !reductions.count(ref->agg_op)) {
+          return nullptr;
+        }
+      } break;
+      default:
+        break;
+    }
+  }
+  return vector_idx;
+}
+
+int64_t Compiler::VectorStride(const Buffer& buf) { return buf.refinement->FlatAccess()[vector_idx_->name]; }
+
+llvm::Value* Compiler::Splat(llvm::Value* value) { return builder_.CreateVectorSplat(vector_width_, value); }
+
+llvm::Constant* Compiler::LaneOffsets(int64_t stride) {
+  // The offset of each lane's value of the vector index from its initial
+  // value, scaled by the stride.
+  std::vector<llvm::Constant*> offsets;
+  for (unsigned i = 0; i < vector_width_; ++i) {
+    offsets.push_back(llvm::ConstantInt::get(IndexType(), i * stride));
+  }
+  return llvm::ConstantVector::get(offsets);
+}
+
+bool Compiler::NeedsZero(const stripe::Block& block, const stripe::Refinement& ref) {
+  // Decide whether a local buffer's initial contents matter. Aggregating into
+  // the buffer reads its previous value; otherwise, the contents matter unless
+  // the first statement to use the buffer provably writes all of it.
+  auto reads_prior = [](const stripe::Refinement& ref) {
+    return IsReadDir(ref.dir) || ref.dir == stripe::RefDir::None || (!ref.agg_op.empty() && ref.agg_op != "assign");
+  };
+  if (!ref.agg_op.empty() && ref.agg_op != "assign") {
+    return true;
+  }
+  // An inner block writes every element if it stores into a single-element
+  // view which steps a distinct unconstrained index across each dimension.
+  const auto& dims = ref.interior_shape.dims;
+  auto covers = [&dims](const stripe::Block& inner, const stripe::Refinement& inner_ref) {
+    if (!inner.constraints.empty() || inner_ref.access.size() != dims.size() ||
+        inner_ref.interior_shape.elem_size() != 1) {
+      return false;
+    }
+    bool stored = false;
+    for (const auto& stmt : inner.stmts) {
+      if (stmt->kind() == stripe::StmtKind::Store && stripe::Store::Downcast(stmt)->into == inner_ref.into()) {
+        stored = true;
+      }
+    }
+    if (!stored) {
+      return false;
+    }
+    std::set<std::string> used;
+    for (size_t i = 0; i < dims.size(); ++i) {
+      const auto& access = inner_ref.access[i];
+      auto idx_name = access.GetNonzeroIndex();
+      if (idx_name.empty()) {
+        if (access.constant() || dims[i].size != 1) {
+          return false;
+        }
+        continue;
+      }
+      if (access != stripe::Affine(idx_name) || !used.insert(idx_name).second) {
+        return false;
+      }
+      auto idx = std::find_if(inner.idxs.begin(), inner.idxs.end(),
+                              [&idx_name](const stripe::Index& idx) { return idx.name == idx_name; });
+      if (idx == inner.idxs.end() || idx->affine != stripe::Affine{} || idx->range < dims[i].size) {
+        return false;
+      }
+    }
+    return true;
+  };
+  const auto& name = ref.into();
+  for (const auto& stmt : block.stmts) {
+    switch (stmt->kind()) {
+      case stripe::StmtKind::Block: {
+        auto inner = stripe::Block::Downcast(stmt);
+        for (const auto& inner_ref : inner->refs) {
+          if ((inner_ref.from.empty() ? inner_ref.into() : inner_ref.from) == name) {
+            return reads_prior(inner_ref) || !covers(*inner, inner_ref);
+          }
+        }
+      } break;
+      default: {
+        auto reads = stmt->buffer_reads();
+        if (std::find(reads.begin(), reads.end(), name) != reads.end()) {
+          return true;
+        }
+        auto writes = stmt->buffer_writes();
+        if (std::find(writes.begin(), writes.end(), name) != writes.end()) {
+          // A store writes a single element; other statements may write less
+          // than the whole buffer.
+          return stmt->kind() != stripe::StmtKind::Store || ref.interior_shape.elem_size() != 1;
+        }
+      } break;
+    }
+  }
+  return false;
+}
+
 llvm::Value* Compiler::MallocFunction(void) {
   std::vector<llvm::Type*> argtypes{IndexType()};
   llvm::Type* rettype = builder_.getInt8PtrTy();
@@ -1161,44 +1749,84 @@ llvm::Value* Compiler::MallocFunction(void) {
   return module_->getOrInsertFunction(funcname, functype);
 }
 
-llvm::Value* Compiler::CallocFunction(void) {
-  std::vector<llvm::Type*> argtypes{IndexType(), IndexType()};
-  llvm::Type* rettype = builder_.getInt8PtrTy();
+llvm::Value* Compiler::PrngStepFunction(void) {
+  llvm::Type* int32ptrType = builder_.getInt32Ty()->getPointerTo();
+  std::vector<llvm::Type*> argtypes{int32ptrType, int32ptrType, int32ptrType, IndexType()};
+  llvm::Type* rettype = llvm::Type::getVoidTy(context_);
   auto functype = llvm::FunctionType::get(rettype, argtypes, false);
-  const char* funcname = "calloc";
+  const char* funcname = "prng_step";
   return module_->getOrInsertFunction(funcname, functype);
 }
 
-llvm::Value* Compiler::FreeFunction(void) {
-  llvm::Type* ptrtype = builder_.getInt8PtrTy();
-  std::vector<llvm::Type*> argtypes{ptrtype};
+llvm::Value* Compiler::ParallelForFunction(void) {
+  llvm::Type* taskptrType = TaskType()->getPointerTo();
+  llvm::Type* arrayptr = builder_.getInt8PtrTy()->getPointerTo();
+  std::vector<llvm::Type*> argtypes{taskptrType, arrayptr, IndexType()};
   llvm::Type* rettype = llvm::Type::getVoidTy(context_);
   auto functype = llvm::FunctionType::get(rettype, argtypes, false);
-  const char* funcname = "free";
+  const char* funcname = "parallel_for";
   return module_->getOrInsertFunction(funcname, functype);
 }
 
-llvm::Value* Compiler::PrngStepFunction(void) {
-  llvm::Type* int32ptrType = builder_.getInt32Ty()->getPointerTo();
-  std::vector<llvm::Type*> argtypes{int32ptrType, int32ptrType, int32ptrType, IndexType()};
-  llvm::Type* rettype = llvm::Type::getVoidTy(context_);
+llvm::Value* Compiler::ThreadScratchFunction(void) {
+  std::vector<llvm::Type*> argtypes{IndexType()};
+  llvm::Type* rettype = builder_.getInt8PtrTy();
   auto functype = llvm::FunctionType::get(rettype, argtypes, false);
-  const char* funcname = "prng_step";
+  const char* funcname = "thread_scratch";
   return module_->getOrInsertFunction(funcname, functype);
 }
 
-Executable::Executable(const ProgramModule& module) : parameters_(module.parameters) {
+Executable::Executable(const ProgramModule& module, const Target& target)
+    : parameters_(module.parameters), scratch_size_(module.scratch_size) {
   std::string errStr;
   std::unique_ptr<llvm::LegacyJITSymbolResolver> rez(new Runtime(module.externals));
   assert(module.module);
   std::unique_ptr<llvm::Module> clone(llvm::CloneModule(*module.module));
+  // By default, generate code for the widest vector extensions the host
+  // supports. Code for other targets is only written out, never run.
   auto ee = llvm::EngineBuilder(std::move(clone))
                 .setErrorStr(&errStr)
                 .setEngineKind(llvm::EngineKind::JIT)
+                .setMCPU(target.cpu)
+                .setMAttrs(target.features)
                 .setVerifyModules(true)
                 .setSymbolResolver(std::move(rez))
                 .create();
   if (ee) {
+    ObjectRecorder recorder;
+    ee->setObjectCache(&recorder);
+    ee->finalizeObject();
+    ee->setObjectCache(nullptr);
+    engine_.reset(ee);
+    object_ = recorder.object();
+  } else {
+    throw Error("Failed to create ExecutionEngine: " + errStr);
+  }
+}
+
+Executable::Executable(llvm::LLVMContext* context, const std::vector<std::string>& parameters,
+                       uint64_t scratch_size, const std::string& object)
+    : parameters_(parameters), scratch_size_(scratch_size), object_(object) {
+  // Rebuild an engine around previously-emitted object code. MCJIT insists on
+  // starting with a module, so we give it an empty one, then add the object
+  // file; finalizing resolves its external references through the Runtime.
+  auto buffer = llvm::MemoryBuffer::getMemBufferCopy(object_, "stripe");
+  auto obj = llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+  if (!obj) {
+    throw Error("Failed to load object code: " + llvm::toString(obj.takeError()));
+  }
+  llvm::object::OwningBinary<llvm::object::ObjectFile> binary(std::move(*obj), std::move(buffer));
+  auto module = std::make_unique<llvm::Module>("stripe", *context);
+  module->setTargetTriple(llvm::sys::getProcessTriple());
+  std::string errStr;
+  std::unique_ptr<llvm::LegacyJITSymbolResolver> rez(new Runtime(std::map<std::string, void*>{}));
+  auto ee = llvm::EngineBuilder(std::move(module))
+                .setErrorStr(&errStr)
+                .setEngineKind(llvm::EngineKind::JIT)
+                .setSymbolResolver(std::move(rez))
+                .create();
+  if (ee) {
+    ee->addObjectFile(std::move(binary));
     ee->finalizeObject();
     engine_.reset(ee);
   } else {
@@ -1207,10 +1835,19 @@ Executable::Executable(const ProgramModule& module) : parameters_(module.paramet
 }
 
 void Executable::Run(const std::map<std::string, void*>& buffers) {
-  std::vector<void*> args(parameters_.size());
-  for (size_t i = 0; i < args.size(); ++i) {
+  std::vector<void*> args(parameters_.size() + 1);
+  for (size_t i = 0; i < parameters_.size(); ++i) {
     args[i] = safe_at(buffers, parameters_[i]);
   }
+  // Allocate the scratch arena for this run; the program carves all of its
+  // local buffers out of it.
+  std::unique_ptr<char[]> scratch;
+  if (scratch_size_) {
+    size_t space = scratch_size_ + scratch_align_;
+    scratch.reset(new char[space]);
+    void* base = scratch.get();
+    args.back() = std::align(scratch_align_, scratch_size_, base, space);
+  }
   void* argvec = args.data();
   uint64_t entrypoint = engine_->getFunctionAddress(invoker_name_);
   ((void (*)(void*))entrypoint)(argvec);
@@ -1235,6 +1872,28 @@ void prng_step(uint32_t* in_state, uint32_t* out_state, uint32_t* buf, size_t co
     in_state = out_state;
   }
 }
+void* thread_scratch(size_t size) {
+  // Parallel tasks take their scratch arenas from the thread running them.
+  // Each thread keeps a single arena, growing it as needed; a thread never
+  // runs more than one task at a time, so the arena is never shared.
+  thread_local std::unique_ptr<char[]> arena;
+  thread_local size_t capacity = 0;
+  if (capacity < size) {
+    arena.reset(new char[size + scratch_align_]);
+    capacity = size;
+  }
+  void* base = arena.get();
+  size_t space = capacity + scratch_align_;
+  return std::align(scratch_align_, size, base, space);
+}
+void parallel_for(void (*task)(void**, size_t, size_t), void** args, size_t count) {
+  // Runs the task over [0, count), dividing the range among the worker
+  // threads, and returns once every subrange has completed. We hand out a few
+  // grains per thread, leaving room for work-stealing to even out the load.
+  auto& pool = ThreadPool::Global();
+  size_t grain = count / (8 * (pool.size() + 1));
+  pool.ParallelFor(count, grain, [task, args](size_t begin, size_t end) { task(args, begin, end); });
+}
 }  // namespace rt
 
 template <typename T>
@@ -1249,6 +1908,8 @@ llvm::JITSymbol Runtime::findSymbol(const std::string& name) {
       {"__gnu_h2f_ieee", symInfo(rt::h2f)},  {"__gnu_f2h_ieee", symInfo(rt::f2h)},
       {"___truncsfhf2", symInfo(rt::f2h)},   {"___extendhfsf2", symInfo(rt::h2f)},
       {"prng_step", symInfo(rt::prng_step)}, {"_prng_step", symInfo(rt::prng_step)},
+      {"parallel_for", symInfo(rt::parallel_for)}, {"_parallel_for", symInfo(rt::parallel_for)},
+      {"thread_scratch", symInfo(rt::thread_scratch)}, {"_thread_scratch", symInfo(rt::thread_scratch)},
   };
   auto loc_rt = symbols.find(name);
   if (loc_rt != symbols.end()) {
@@ -1286,22 +1947,135 @@ struct Native::Impl {
   llvm::LLVMContext context;
   ProgramModule module;
   std::unique_ptr<Executable> executable;
+  // Object code for each target the program has been generated for, keyed by
+  // target description; the executable runs the host's entry, or the best of
+  // those loaded from disk.
+  std::map<std::string, std::string> objects;
 
   void compile(const stripe::Block& program, const std::map<std::string, External>& externals) {
     Compiler compiler(&context, externals);
     module = compiler.CompileProgram(program);
     assert(module.module);
+    if (!module.externals.empty()) {
+      // External handlers resolve to addresses in this process; the object
+      // code would be meaningless anywhere else.
+      cacheable = false;
+    }
     executable.reset(new Executable(module));
+    objects = {{HostTarget(), executable->object()}};
   }
 
   void run(const std::map<std::string, void*>& buffers) { executable->Run(buffers); }
 
   void save(const std::string& filename) {
+    if (!module.module) {
+      throw Error("No bitcode is available for a program loaded from object code");
+    }
     std::error_code ec;
     llvm::ToolOutputFile result(filename, ec, llvm::sys::fs::F_None);
     WriteBitcodeToFile(*module.module, result.os());
     result.keep();
   }
+
+  void save_object(const std::string& filename, const std::string& key) {
+    if (!cacheable) {
+      return;
+    }
+    if (PortableObjects() && module.module) {
+      // Add code for each portable ISA level, so that the file serves every
+      // host sharing this triple.
+      for (const auto& target : PortableTargets(HostIsa().triple)) {
+        auto description = to_string(target);
+        if (!objects.count(description)) {
+          objects.emplace(description, Executable(module, target).object());
+        }
+      }
+    }
+    // Write to a private file and rename it into place, so that concurrent
+    // readers and writers of the same entry only ever see complete files.
+    bool written = WriteFileAtomically(filename, true, [&](std::ofstream& out) {
+      WriteString(out, object_magic_);
+      WriteString(out, key);
+      WriteString(out, std::to_string(executable->scratch_size()));
+      WriteString(out, std::to_string(executable->parameters().size()));
+      for (const auto& param : executable->parameters()) {
+        WriteString(out, param);
+      }
+      WriteString(out, std::to_string(objects.size()));
+      for (const auto& kvp : objects) {
+        WriteString(out, kvp.first);
+        WriteString(out, kvp.second);
+      }
+    });
+    if (!written) {
+      IVLOG(1, "Unable to write stripe JIT object: " << filename);
+    }
+  }
+
+  bool load_object(const std::string& filename, const std::string& key) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+      return false;
+    }
+    // The file may be truncated or corrupt, in which case the program is
+    // simply recompiled.
+    std::string magic;
+    std::string file_key;
+    uint64_t scratch_size = 0;
+    uint64_t count = 0;
+    if (!ReadString(in, &magic) || magic != object_magic_ ||  //
+        !ReadString(in, &file_key) || file_key != key ||      //
+        !ReadNumber(in, &scratch_size) || !ReadNumber(in, &count)) {
+      return false;
+    }
+    std::vector<std::string> parameters;
+    for (; count; --count) {
+      std::string param;
+      if (!ReadString(in, &param)) {
+        return false;
+      }
+      parameters.emplace_back(std::move(param));
+    }
+    std::map<std::string, std::string> file_objects;
+    if (!ReadNumber(in, &count)) {
+      return false;
+    }
+    for (; count; --count) {
+      std::string description;
+      std::string object;
+      if (!ReadString(in, &description) || !ReadString(in, &object)) {
+        return false;
+      }
+      file_objects.emplace(std::move(description), std::move(object));
+    }
+    // Run the code that makes the most of this host.
+    std::vector<Target> targets;
+    std::vector<const std::string*> target_objects;
+    for (const auto& kvp : file_objects) {
+      Target target;
+      if (ParseTarget(kvp.first, &target)) {
+        targets.emplace_back(std::move(target));
+        target_objects.push_back(&kvp.second);
+      }
+    }
+    auto best = SelectTarget(targets, HostIsa());
+    if (best == targets.size()) {
+      IVLOG(1, "No object code in " << filename << " runs on this host");
+      return false;
+    }
+    try {
+      executable.reset(new Executable(&context, parameters, scratch_size, *target_objects[best]));
+    } catch (const std::exception& err) {
+      IVLOG(1, "Discarding stripe JIT object " << filename << ": " << err.what());
+      return false;
+    }
+    IVLOG(2, "Loaded stripe JIT object code for " << targets[best]);
+    objects = std::move(file_objects);
+    module = ProgramModule{};
+    return true;
+  }
+
+  bool cacheable = true;
 };
 
 Native::Native() : m_impl(new Native::Impl) {}
@@ -1311,6 +2085,19 @@ void Native::compile(const stripe::Block& program, const std::map<std::string, E
 }
 void Native::run(const std::map<std::string, void*>& buffers) { m_impl->run(buffers); }
 void Native::save(const std::string& filename) { m_impl->save(filename); }
+void Native::save_object(const std::string& filename, const std::string& key) { m_impl->save_object(filename, key); }
+bool Native::load_object(const std::string& filename, const std::string& key) {
+  return m_impl->load_object(filename, key);
+}
+
+std::string HostTarget() { return to_string(HostIsa()); }
+
+std::string ObjectTarget() {
+  if (PortableObjects()) {
+    return "portable:" + llvm::sys::getProcessTriple();
+  }
+  return HostTarget();
+}
 
 void JitExecute(const stripe::Block& program, const std::map<std::string, void*>& buffers) {
   llvm::LLVMContext context;
@@ -31,8 +31,28 @@ class Native {
   void compile(const stripe::Block& program, const std::map<std::string, External>& externals);
   void run(const std::map<std::string, void*>& buffers);
   void save(const std::string& filename);
+
+  // Writes the object code generated for the compiled program to the indicated
+  // file, labelled with a caller-supplied key. Programs which use external
+  // handlers are bound to this process, and are not written. If
+  // PLAIDML_CPU_PORTABLE is set on an x86-64 host, the file also carries code
+  // for a ladder of x86-64 ISA levels (baseline through AVX-512).
+  void save_object(const std::string& filename, const std::string& key);
+
+  // Restores a program written by save_object, without recompiling it, using
+  // the code best suited to this host. Returns false if the file is missing,
+  // was written for a different key, or holds no code this host can run.
+  bool load_object(const std::string& filename, const std::string& key);
 };
 
+// Describes the host processor (triple, CPU name and features) for which the
+// JIT generates code.
+std::string HostTarget();
+
+// Describes the hosts able to load the objects save_object writes: just this
+// host, or in portable mode, every host sharing its triple.
+std::string ObjectTarget();
+
 void JitExecute(const stripe::Block& program, const std::map<std::string, void*>& buffers);
 void JitExecute(const stripe::Block& program, const std::map<std::string, External>& externals,
                 const std::map<std::string, void*>& buffers);
@@ -3,6 +3,15 @@
 #include <gmock/gmock.h>
 #include <google/protobuf/text_format.h>
 
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "base/util/env.h"
+#include "base/util/file.h"
 #include "tile/codegen/tile.h"
 #include "tile/lang/compose.h"
 #include "tile/lang/gen_stripe.h"
@@ -418,6 +427,806 @@ TEST(Jit, JitNestedAlloc) {
   EXPECT_THAT(bufB, ContainerEq(expected));
 }
 
+TEST(Jit, JitNestedAllocZeroed) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc {}
+    idxs { name: "i" range: 3 }
+    refs [
+      {
+        key: "bufA"
+        value {
+          loc {}
+          dir: 1
+          access { offset: 0 terms {key:"i" value:1} }
+          interior_shape { type: FLOAT32 dims: {size:3 stride:1} }
+        }
+      },
+      {
+        key: "bufB"
+        value {
+          loc {}
+          dir: 2
+          access { offset: 0 terms {key:"i" value:1} }
+          interior_shape { type: FLOAT32 dims: {size:3 stride:1} }
+        }
+      }
+    ]
+    stmts { block {
+      refs [
+        {
+          key: "bufA"
+          value {
+            loc {}
+            dir: 1
+            interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+            access { }
+          }
+        },
+        {
+          key: "bufB"
+          value {
+            loc {}
+            dir: 2
+            interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+            access { }
+          }
+        },
+        {
+          key: "bufTemp"
+          value {
+            dir: 0
+            agg_op: "add"
+            interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+            access { }
+          }
+        }
+      ]
+      stmts { load { from:"bufA" into:"$1" } }
+      stmts { store { from:"$1" into:"bufTemp"} }
+      stmts { load { from:"bufTemp" into:"$2" } }
+      stmts { store { from:"$2" into:"bufB"} }
+    } }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  // The local accumulator must start from zero on every call, even though its
+  // storage is reused from one call to the next.
+  std::vector<float> bufA = {1, 2, 3};
+  std::vector<float> bufB = {0, 0, 0};
+  std::vector<float> expected = {1, 2, 3};
+
+  std::map<std::string, void*> buffers{{"bufA", bufA.data()}, {"bufB", bufB.data()}};
+  JitExecute(*block, buffers);
+
+  EXPECT_THAT(bufB, ContainerEq(expected));
+}
+
+TEST(Jit, JitNestedAllocPartialWrite) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc {}
+    refs [
+      {
+        key: "bufA"
+        value {
+          loc {}
+          dir: 1
+          access { }
+          interior_shape { type: FLOAT32 dims: {size:3 stride:1} }
+        }
+      },
+      {
+        key: "bufB"
+        value {
+          loc {}
+          dir: 2
+          access { }
+          interior_shape { type: FLOAT32 dims: {size:3 stride:1} }
+        }
+      },
+      {
+        key: "bufC"
+        value {
+          loc {}
+          dir: 2
+          access { }
+          interior_shape { type: FLOAT32 dims: {size:3 stride:1} }
+        }
+      }
+    ]
+    stmts { block {
+      refs [
+        { key: "bufA" value { loc {} dir: 1 access { } interior_shape { type: FLOAT32 dims: {size:3 stride:1} } } },
+        { key: "bufC" value { loc {} dir: 2 access { } interior_shape { type: FLOAT32 dims: {size:3 stride:1} } } },
+        { key: "bufX" value { dir: 0 access { } interior_shape { type: FLOAT32 dims: {size:3 stride:1} } } }
+      ]
+      stmts { block {
+        idxs { name: "i" range: 3 }
+        refs [
+          { key: "bufA" value { loc {} dir: 1 access { terms {key:"i" value:1} }
+                                interior_shape { type: FLOAT32 dims: {size:1 stride:1} } } },
+          { key: "bufX" value { dir: 2 access { terms {key:"i" value:1} }
+                                interior_shape { type: FLOAT32 dims: {size:1 stride:1} } } }
+        ]
+        stmts { load { from:"bufA" into:"$1" } }
+        stmts { store { from:"$1" into:"bufX"} }
+      } }
+      stmts { block {
+        idxs { name: "i" range: 3 }
+        refs [
+          { key: "bufX" value { dir: 1 access { terms {key:"i" value:1} }
+                                interior_shape { type: FLOAT32 dims: {size:1 stride:1} } } },
+          { key: "bufC" value { loc {} dir: 2 access { terms {key:"i" value:1} }
+                                interior_shape { type: FLOAT32 dims: {size:1 stride:1} } } }
+        ]
+        stmts { load { from:"bufX" into:"$1" } }
+        stmts { store { from:"$1" into:"bufC"} }
+      } }
+    } }
+    stmts { block {
+      refs [
+        { key: "bufA" value { loc {} dir: 1 access { } interior_shape { type: FLOAT32 dims: {size:3 stride:1} } } },
+        { key: "bufB" value { loc {} dir: 2 access { } interior_shape { type: FLOAT32 dims: {size:3 stride:1} } } },
+        { key: "bufY" value { dir: 0 access { } interior_shape { type: FLOAT32 dims: {size:3 stride:1} } } }
+      ]
+      stmts { block {
+        refs [
+          { key: "bufA" value { loc {} dir: 1 access { } interior_shape { type: FLOAT32 dims: {size:1 stride:1} } } },
+          { key: "bufY" value { dir: 2 access { } interior_shape { type: FLOAT32 dims: {size:1 stride:1} } } }
+        ]
+        stmts { load { from:"bufA" into:"$1" } }
+        stmts { store { from:"$1" into:"bufY"} }
+      } }
+      stmts { block {
+        idxs { name: "i" range: 3 }
+        refs [
+          { key: "bufY" value { dir: 1 access { terms {key:"i" value:1} }
+                                interior_shape { type: FLOAT32 dims: {size:1 stride:1} } } },
+          { key: "bufB" value { loc {} dir: 2 access { terms {key:"i" value:1} }
+                                interior_shape { type: FLOAT32 dims: {size:1 stride:1} } } }
+        ]
+        stmts { load { from:"bufY" into:"$1" } }
+        stmts { store { from:"$1" into:"bufB"} }
+      } }
+    } }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  // bufX is written in full, so it needn't be cleared; bufY is written only
+  // at its first element, so the rest of it must read as zero rather than as
+  // whatever bufX left in the scratch arena.
+  std::vector<float> bufA = {1, 2, 3};
+  std::vector<float> bufB = {7, 7, 7};
+  std::vector<float> bufC = {7, 7, 7};
+  std::map<std::string, void*> buffers{{"bufA", bufA.data()}, {"bufB", bufB.data()}, {"bufC", bufC.data()}};
+  JitExecute(*block, buffers);
+
+  EXPECT_THAT(bufC, ContainerEq(bufA));
+  EXPECT_THAT(bufB, ContainerEq(std::vector<float>{1, 0, 0}));
+}
+
+TEST(Jit, JitParallelKernel) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc {}
+    refs [
+      {
+        key: "bufA"
+        value {
+          loc {}
+          dir: 1
+          interior_shape { type: FLOAT32 dims: {size:1000 stride:1} }
+          access { }
+        }
+      },
+      {
+        key: "bufB"
+        value {
+          loc {}
+          dir: 2
+          interior_shape { type: FLOAT32 dims: {size:1000 stride:1} }
+          access { }
+        }
+      },
+      {
+        key: "bufS"
+        value {
+          loc {}
+          dir: 3
+          agg_op: "add"
+          interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+          access { }
+        }
+      }
+    ]
+    stmts {
+      attrs { key: "kernel" value {} }
+      block {
+        idxs { name: "i" range: 1000 }
+        refs [
+          {
+            key: "bufA"
+            value {
+              loc {}
+              dir: 1
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"i" value:1} }
+            }
+          },
+          {
+            key: "bufB"
+            value {
+              loc {}
+              dir: 2
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"i" value:1} }
+            }
+          }
+        ]
+        stmts { load { from:"bufA" into:"$1" } }
+        stmts { intrinsic { name:"add" type:FLOAT32 inputs:"$1" inputs:"$1" outputs:"$2"} }
+        stmts { store { from:"$2" into:"bufB"} }
+      }
+    }
+    stmts {
+      attrs { key: "kernel" value {} }
+      block {
+        idxs { name: "j" range: 1000 }
+        refs [
+          {
+            key: "bufA"
+            value {
+              loc {}
+              dir: 1
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"j" value:1} }
+            }
+          },
+          {
+            key: "bufS"
+            value {
+              loc {}
+              dir: 3
+              agg_op: "add"
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { }
+            }
+          }
+        ]
+        stmts { load { from:"bufA" into:"$1" } }
+        stmts { store { from:"$1" into:"bufS"} }
+      }
+    }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  std::vector<float> bufA(1000);
+  std::vector<float> bufB(1000);
+  std::vector<float> bufS{0};
+  std::vector<float> expected(1000);
+  for (size_t i = 0; i < bufA.size(); ++i) {
+    bufA[i] = i + 1;
+    expected[i] = 2 * (i + 1);
+  }
+
+  // The first kernel's index is split across threads; the second kernel's
+  // index is an accumulation index, which must run serially.
+  std::map<std::string, void*> buffers{{"bufA", bufA.data()}, {"bufB", bufB.data()}, {"bufS", bufS.data()}};
+  JitExecute(*block, buffers);
+
+  EXPECT_THAT(bufB, ContainerEq(expected));
+  EXPECT_THAT(bufS[0], Eq(500500.0));
+}
+
+TEST(Jit, JitParallelOverlappingKernel) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc {}
+    refs [
+      {
+        key: "bufA"
+        value {
+          loc {}
+          dir: 1
+          interior_shape { type: FLOAT32 dims: {size:1000 stride:1} }
+          access { }
+        }
+      },
+      {
+        key: "bufB"
+        value {
+          loc {}
+          dir: 3
+          agg_op: "add"
+          interior_shape { type: FLOAT32 dims: {size:1003 stride:1} }
+          access { }
+        }
+      }
+    ]
+    stmts {
+      attrs { key: "kernel" value {} }
+      block {
+        idxs { name: "x" range: 1000 }
+        idxs { name: "k" range: 4 }
+        refs [
+          {
+            key: "bufA"
+            value {
+              loc {}
+              dir: 1
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"x" value:1} }
+            }
+          },
+          {
+            key: "bufB"
+            value {
+              loc {}
+              dir: 3
+              agg_op: "add"
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"x" value:1} terms {key:"k" value:1} }
+            }
+          }
+        ]
+        stmts { load { from:"bufA" into:"$1" } }
+        stmts { store { from:"$1" into:"bufB"} }
+      }
+    }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  std::vector<float> bufA(1000, 1);
+  std::vector<float> bufB(1003);
+  std::vector<float> expected(1003);
+  for (size_t x = 0; x < bufA.size(); ++x) {
+    for (size_t k = 0; k < 4; ++k) {
+      expected[x + k] += bufA[x];
+    }
+  }
+
+  // Neighbouring values of x write overlapping elements of bufB through k, so
+  // neither index may be split across threads.
+  std::map<std::string, void*> buffers{{"bufA", bufA.data()}, {"bufB", bufB.data()}};
+  for (int run = 0; run < 10; ++run) {
+    std::fill(bufB.begin(), bufB.end(), 0);
+    JitExecute(*block, buffers);
+    EXPECT_THAT(bufB, ContainerEq(expected));
+  }
+}
+
+TEST(Jit, JitVectorMac) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc {}
+    idxs { name: "k" range: 3 }
+    refs [
+      {
+        key: "bufA"
+        value {
+          loc {}
+          dir: 1
+          interior_shape { type: FLOAT32 dims: {size:8 stride:1} }
+          access { }
+        }
+      },
+      {
+        key: "bufB"
+        value {
+          loc {}
+          dir: 1
+          interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+          access { offset: 0 terms {key:"k" value:1} }
+        }
+      },
+      {
+        key: "bufC"
+        value {
+          loc {}
+          dir: 2
+          agg_op: "add"
+          interior_shape { type: FLOAT32 dims: {size:8 stride:1} }
+          access { }
+        }
+      },
+      {
+        key: "bufS"
+        value {
+          loc {}
+          dir: 2
+          agg_op: "add"
+          interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+          access { }
+        }
+      }
+    ]
+    stmts {
+      attrs { key: "mac_inner" value {} }
+      block {
+        idxs { name: "a" range: 8 attrs { key: "stencil" value {} } }
+        constraints { offset: 4 terms {key:"a" value:-1} }
+        refs [
+          {
+            key: "bufA"
+            value {
+              loc {}
+              dir: 1
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"a" value:1} }
+            }
+          },
+          {
+            key: "bufB"
+            value {
+              loc {}
+              dir: 1
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { }
+            }
+          },
+          {
+            key: "bufC"
+            value {
+              loc {}
+              dir: 2
+              agg_op: "add"
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"a" value:1} }
+            }
+          },
+          {
+            key: "bufS"
+            value {
+              loc {}
+              dir: 2
+              agg_op: "add"
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { }
+            }
+          }
+        ]
+        stmts { load { from:"bufA" into:"$a" } }
+        stmts { load { from:"bufB" into:"$b" } }
+        stmts { intrinsic { name:"mul" type:FLOAT32 inputs:"$a" inputs:"$b" outputs:"$c"} }
+        stmts { store { from:"$c" into:"bufC"} }
+        stmts { store { from:"$c" into:"bufS"} }
+      }
+    }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  // The inner block's lanes past the constraint must neither contribute to
+  // the reduction nor overwrite their outputs.
+  std::vector<float> bufA = {1, 2, 3, 4, 5, 100, 100, 100};
+  std::vector<float> bufB = {1, 2, 3};
+  std::vector<float> bufC = {0, 0, 0, 0, 0, 7, 7, 7};
+  std::vector<float> bufS = {0};
+  std::vector<float> expected = {6, 12, 18, 24, 30, 7, 7, 7};
+
+  std::map<std::string, void*> buffers{
+      {"bufA", bufA.data()}, {"bufB", bufB.data()}, {"bufC", bufC.data()}, {"bufS", bufS.data()}};
+  JitExecute(*block, buffers);
+
+  EXPECT_THAT(bufC, ContainerEq(expected));
+  EXPECT_THAT(bufS[0], Eq(90.0));
+}
+
+TEST(Jit, JitVectorSqrt) {
+  // Square roots in a vectorized block are taken on whole vectors, in each
+  // floating-point width.
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc {}
+    refs [
+      {
+        key: "bufA"
+        value {
+          loc {}
+          dir: 1
+          interior_shape { type: FLOAT32 dims: {size:8 stride:1} }
+          access { }
+        }
+      },
+      {
+        key: "bufB"
+        value {
+          loc {}
+          dir: 2
+          interior_shape { type: FLOAT32 dims: {size:8 stride:1} }
+          access { }
+        }
+      },
+      {
+        key: "bufC"
+        value {
+          loc {}
+          dir: 1
+          interior_shape { type: FLOAT64 dims: {size:8 stride:1} }
+          access { }
+        }
+      },
+      {
+        key: "bufD"
+        value {
+          loc {}
+          dir: 2
+          interior_shape { type: FLOAT64 dims: {size:8 stride:1} }
+          access { }
+        }
+      }
+    ]
+    stmts {
+      attrs { key: "mac_inner" value {} }
+      block {
+        idxs { name: "a" range: 8 attrs { key: "stencil" value {} } }
+        refs [
+          {
+            key: "bufA"
+            value {
+              loc {}
+              dir: 1
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"a" value:1} }
+            }
+          },
+          {
+            key: "bufB"
+            value {
+              loc {}
+              dir: 2
+              interior_shape { type: FLOAT32 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"a" value:1} }
+            }
+          },
+          {
+            key: "bufC"
+            value {
+              loc {}
+              dir: 1
+              interior_shape { type: FLOAT64 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"a" value:1} }
+            }
+          },
+          {
+            key: "bufD"
+            value {
+              loc {}
+              dir: 2
+              interior_shape { type: FLOAT64 dims: {size:1 stride:1} }
+              access { offset: 0 terms {key:"a" value:1} }
+            }
+          }
+        ]
+        stmts { load { from:"bufA" into:"$a" } }
+        stmts { intrinsic { name:"sqrt" type:FLOAT32 inputs:"$a" outputs:"$b"} }
+        stmts { store { from:"$b" into:"bufB"} }
+        stmts { load { from:"bufC" into:"$c" } }
+        stmts { intrinsic { name:"sqrt" type:FLOAT64 inputs:"$c" outputs:"$d"} }
+        stmts { store { from:"$d" into:"bufD"} }
+      }
+    }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  std::vector<float> bufA = {0, 1, 4, 9, 16, 25, 36, 49};
+  std::vector<float> bufB(8);
+  std::vector<double> bufC = {64, 81, 100, 121, 144, 169, 196, 225};
+  std::vector<double> bufD(8);
+
+  std::map<std::string, void*> buffers{
+      {"bufA", bufA.data()}, {"bufB", bufB.data()}, {"bufC", bufC.data()}, {"bufD", bufD.data()}};
+  JitExecute(*block, buffers);
+
+  EXPECT_THAT(bufB, ContainerEq(std::vector<float>{0, 1, 2, 3, 4, 5, 6, 7}));
+  EXPECT_THAT(bufD, ContainerEq(std::vector<double>{8, 9, 10, 11, 12, 13, 14, 15}));
+}
+
+TEST(Jit, JitObjectRoundTrip) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc {}
+    idxs { name: "i" range: 5 }
+    refs [
+      {
+        key: "bufA"
+        value {
+          loc {}
+          dir: 1
+          access { offset: 0 terms {key: "i" value: 1} }
+          interior_shape { type: FLOAT32 dims: {size:5 stride:1} }
+        }
+      },
+      {
+        key: "bufB"
+        value {
+          loc {}
+          dir: 2
+          access { offset: 0 terms {key: "i" value: 1} }
+          interior_shape { type: FLOAT32 dims: {size:5 stride:1} }
+        }
+      }
+    ]
+    stmts { load { from:"bufA" into:"$1" } }
+    stmts { intrinsic { name:"exp" type:FLOAT32 inputs:"$1" outputs:"$2" } }
+    stmts { store { from:"$2" into:"bufB"} }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("jit-%%%%-%%%%.jit");
+  {
+    Native native;
+    native.compile(*block, {});
+    native.save_object(path.string(), "key");
+  }
+
+  std::vector<float> bufA = {0, 1, 2, 3, 4};
+  std::vector<float> bufB(5);
+  std::map<std::string, void*> buffers{{"bufA", bufA.data()}, {"bufB", bufB.data()}};
+  Native native;
+  EXPECT_FALSE(native.load_object(path.string(), "other key"));
+  ASSERT_TRUE(native.load_object(path.string(), "key"));
+  native.run(buffers);
+  boost::filesystem::remove(path);
+
+  for (size_t i = 0; i < bufA.size(); ++i) {
+    EXPECT_FLOAT_EQ(bufB[i], std::exp(bufA[i]));
+  }
+}
+
+TEST(Jit, JitObjectCorrupt) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc {}
+    idxs { name: "i" range: 5 }
+    refs [
+      {
+        key: "bufA"
+        value {
+          loc {}
+          dir: 1
+          access { offset: 0 terms {key: "i" value: 1} }
+          interior_shape { type: FLOAT32 dims: {size:5 stride:1} }
+        }
+      },
+      {
+        key: "bufB"
+        value {
+          loc {}
+          dir: 2
+          access { offset: 0 terms {key: "i" value: 1} }
+          interior_shape { type: FLOAT32 dims: {size:5 stride:1} }
+        }
+      }
+    ]
+    stmts { load { from:"bufA" into:"$1" } }
+    stmts { store { from:"$1" into:"bufB"} }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("jit-%%%%-%%%%.jit");
+  {
+    Native native;
+    native.compile(*block, {});
+    native.save_object(path.string(), "key");
+  }
+  std::string contents;
+  {
+    std::ifstream in(path.string(), std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  auto write = [&path](const std::string& bytes) {
+    std::ofstream out(path.string(), std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+  };
+
+  // Truncated files are rejected, wherever they end.
+  for (size_t size = 0; size < contents.size(); size += std::max<size_t>(1, contents.size() / 64)) {
+    write(contents.substr(0, size));
+    Native native;
+    EXPECT_FALSE(native.load_object(path.string(), "key")) << "truncated to " << size << " bytes";
+  }
+
+  // So are files whose lengths and counts are garbage. The scratch size
+  // follows the magic number and the key.
+  std::istringstream header(contents);
+  std::string str;
+  ASSERT_TRUE(ReadString(header, &str) && ReadString(header, &str));
+  auto scratch_pos = static_cast<size_t>(header.tellg());
+  auto scratch_end = contents.find(':', scratch_pos);
+  {
+    auto corrupt = contents;
+    corrupt.replace(scratch_pos, scratch_end - scratch_pos, "99999999999999999999");
+    write(corrupt);
+    Native native;
+    EXPECT_FALSE(native.load_object(path.string(), "key"));
+  }
+  {
+    auto corrupt = contents;
+    std::fill(corrupt.begin() + scratch_end + 1, corrupt.begin() + contents.find('\n', scratch_end), 'x');
+    write(corrupt);
+    Native native;
+    EXPECT_FALSE(native.load_object(path.string(), "key"));
+  }
+
+  // The intact file still loads.
+  write(contents);
+  Native native;
+  EXPECT_TRUE(native.load_object(path.string(), "key"));
+  boost::filesystem::remove(path);
+}
+
+TEST(Jit, JitPortableObjectRoundTrip) {
+  stripe::proto::Block input_proto;
+  gp::TextFormat::ParseFromString(R"(
+    loc {}
+    idxs { name: "i" range: 5 }
+    refs [
+      {
+        key: "bufA"
+        value {
+          loc {}
+          dir: 1
+          access { offset: 0 terms {key: "i" value: 1} }
+          interior_shape { type: FLOAT32 dims: {size:5 stride:1} }
+        }
+      },
+      {
+        key: "bufB"
+        value {
+          loc {}
+          dir: 2
+          access { offset: 0 terms {key: "i" value: 1} }
+          interior_shape { type: FLOAT32 dims: {size:5 stride:1} }
+        }
+      }
+    ]
+    stmts { load { from:"bufA" into:"$1" } }
+    stmts { store { from:"$1" into:"bufB"} }
+  )",
+                                  &input_proto);
+  std::shared_ptr<stripe::Block> block{stripe::FromProto(input_proto)};
+
+  auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("jit-%%%%-%%%%.jit");
+  env::Set("PLAIDML_CPU_PORTABLE", "1");
+  {
+    Native native;
+    native.compile(*block, {});
+    native.save_object(path.string(), "key");
+  }
+  env::Set("PLAIDML_CPU_PORTABLE", "");
+  auto single = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("jit-%%%%-%%%%.jit");
+  {
+    Native native;
+    native.compile(*block, {});
+    native.save_object(single.string(), "key");
+  }
+  EXPECT_EQ(ObjectTarget(), HostTarget());
+  // On x86-64 hosts, the portable file carries code for each ISA level too.
+  EXPECT_GE(boost::filesystem::file_size(path), boost::filesystem::file_size(single));
+  boost::filesystem::remove(single);
+
+  std::vector<float> bufA = {0, 1, 2, 3, 4};
+  std::vector<float> bufB(5);
+  std::map<std::string, void*> buffers{{"bufA", bufA.data()}, {"bufB", bufB.data()}};
+  Native native;
+  ASSERT_TRUE(native.load_object(path.string(), "key"));
+  native.run(buffers);
+  boost::filesystem::remove(path);
+
+  for (size_t i = 0; i < bufA.size(); ++i) {
+    EXPECT_FLOAT_EQ(bufB[i], bufA[i]);
+  }
+}
+
 static float foo_impl(float a, float b) { return a * b; }
 
 TEST(Jit, JitExternalMUL_F32) {
@@ -0,0 +1,415 @@
+// Copyright 2019 Intel Corporation.
+
+#include <gtest/gtest.h>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <half.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "base/util/logging.h"
+#include "tile/targets/cpu/vecmath.h"
+
+namespace vertexai {
+namespace tile {
+namespace targets {
+namespace cpu {
+namespace test {
+namespace {
+
+// Returns the distance between two values in units in the last place, with
+// NaNs equal to each other and infinitely far from everything else.
+template <typename T>
+int64_t UlpDistance(T actual, T expected) {
+  if (std::isnan(actual) && std::isnan(expected)) {
+    return 0;
+  }
+  if (actual == expected) {
+    return 0;
+  }
+  if (!std::isfinite(actual) || !std::isfinite(expected)) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  using Int = typename std::conditional<sizeof(T) == 2, int16_t,
+                                       typename std::conditional<sizeof(T) == 4, int32_t, int64_t>::type>::type;
+  Int a;
+  Int e;
+  std::memcpy(&a, &actual, sizeof(a));
+  std::memcpy(&e, &expected, sizeof(e));
+  // Map the sign-magnitude representations onto a monotonic integer line.
+  long double la = a < 0 ? static_cast<long double>(std::numeric_limits<Int>::min()) - a : a;
+  long double le = e < 0 ? static_cast<long double>(std::numeric_limits<Int>::min()) - e : e;
+  return static_cast<int64_t>(std::fabs(la - le));
+}
+
+// Compiles loops which apply a vecmath function to arrays, a vector of lanes
+// at a time, for the host processor.
+class Kernels {
+ public:
+  Kernels() {
+    LLVMInitializeNativeTarget();
+    LLVMLinkInMCJIT();
+    LLVMInitializeNativeAsmPrinter();
+  }
+
+  // Returns a function computing out[i] = fn(x[i], y[i]) for i in [0, n), where
+  // n is a multiple of the width; y is ignored by single-argument functions.
+  template <typename T>
+  void (*Build(vecmath::Function fn, unsigned width))(const T* x, const T* y, T* out, int64_t n) {
+    auto module = std::make_unique<llvm::Module>("vecmath_test", context_);
+    llvm::IRBuilder<> builder{context_};
+    llvm::Type* elem_type = std::is_same<T, double>::value
+                                ? builder.getDoubleTy()
+                                : std::is_same<T, half_float::half>::value ? builder.getHalfTy() : builder.getFloatTy();
+    llvm::Type* vec_type = width > 1 ? llvm::VectorType::get(elem_type, width) : elem_type;
+    llvm::Type* ptr_type = elem_type->getPointerTo();
+    auto func_type = llvm::FunctionType::get(builder.getVoidTy(), {ptr_type, ptr_type, ptr_type, builder.getInt64Ty()},
+                                             false);
+    auto func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, "kernel", module.get());
+    auto arg = func->arg_begin();
+    llvm::Value* x = &*arg++;
+    llvm::Value* y = &*arg++;
+    llvm::Value* out = &*arg++;
+    llvm::Value* n = &*arg++;
+    auto entry = llvm::BasicBlock::Create(context_, "entry", func);
+    auto loop = llvm::BasicBlock::Create(context_, "loop", func);
+    auto done = llvm::BasicBlock::Create(context_, "done", func);
+    builder.SetInsertPoint(entry);
+    builder.CreateBr(loop);
+    builder.SetInsertPoint(loop);
+    auto index = builder.CreatePHI(builder.getInt64Ty(), 2);
+    index->addIncoming(builder.getInt64(0), entry);
+    auto lanes = [&](llvm::Value* base) {
+      return builder.CreateBitCast(builder.CreateGEP(base, index), vec_type->getPointerTo());
+    };
+    std::vector<llvm::Value*> args{builder.CreateAlignedLoad(lanes(x), sizeof(T))};
+    if (fn == vecmath::Function::POW) {
+      args.push_back(builder.CreateAlignedLoad(lanes(y), sizeof(T)));
+    }
+    builder.CreateAlignedStore(vecmath::Emit(&builder, fn, args), lanes(out), sizeof(T));
+    auto next = builder.CreateAdd(index, builder.getInt64(width));
+    index->addIncoming(next, loop);
+    builder.CreateCondBr(builder.CreateICmpULT(next, n), loop, done);
+    builder.SetInsertPoint(done);
+    builder.CreateRetVoid();
+    EXPECT_FALSE(llvm::verifyFunction(*func, &llvm::errs()));
+
+    std::vector<std::string> features;
+    llvm::StringMap<bool> host_features;
+    if (llvm::sys::getHostCPUFeatures(host_features)) {
+      for (const auto& feature : host_features) {
+        features.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+      }
+    }
+    std::string err;
+    std::unique_ptr<llvm::ExecutionEngine> engine{llvm::EngineBuilder(std::move(module))
+                                                      .setErrorStr(&err)
+                                                      .setEngineKind(llvm::EngineKind::JIT)
+                                                      .setMCPU(llvm::sys::getHostCPUName())
+                                                      .setMAttrs(features)
+                                                      .setOptLevel(llvm::CodeGenOpt::Aggressive)
+                                                      .create()};
+    if (!engine) {
+      throw std::runtime_error("Unable to create vecmath test engine: " + err);
+    }
+    engine->finalizeObject();
+    auto addr = engine->getFunctionAddress("kernel");
+    engines_.emplace_back(std::move(engine));
+    return reinterpret_cast<void (*)(const T*, const T*, T*, int64_t)>(addr);
+  }
+
+ private:
+  llvm::LLVMContext context_;
+  std::vector<std::unique_ptr<llvm::ExecutionEngine>> engines_;
+};
+
+// Compares a function over a domain against the C library, at scalar and
+// full vector widths, returning the maximum error in ulps; the relative
+// throughput is logged.
+template <typename T>
+int64_t MaxUlps(vecmath::Function fn, T (*ref)(T), T lo, T hi, bool log_scale, unsigned width) {
+  Kernels kernels;
+  auto kernel = kernels.Build<T>(fn, width);
+  const size_t count = 1 << 18;
+  std::vector<T> x(count);
+  std::vector<T> actual(count);
+  std::vector<T> expected(count);
+  std::mt19937_64 rng;
+  for (auto& val : x) {
+    if (log_scale) {
+      std::uniform_real_distribution<double> dist{std::log(static_cast<double>(lo)), std::log(static_cast<double>(hi))};
+      val = static_cast<T>(std::exp(dist(rng)));
+    } else {
+      std::uniform_real_distribution<double> dist{static_cast<double>(lo), static_cast<double>(hi)};
+      val = static_cast<T>(dist(rng));
+    }
+  }
+  auto start = std::chrono::steady_clock::now();
+  kernel(x.data(), x.data(), actual.data(), count);
+  auto vecmath_done = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < count; ++i) {
+    expected[i] = ref(x[i]);
+  }
+  auto libm_done = std::chrono::steady_clock::now();
+  int64_t worst = 0;
+  for (size_t i = 0; i < count; ++i) {
+    int64_t ulps = UlpDistance(actual[i], expected[i]);
+    if (worst < ulps) {
+      worst = ulps;
+      IVLOG(1, "f(" << x[i] << ") = " << actual[i] << ", expected " << expected[i] << " (" << ulps << " ulps)");
+    }
+  }
+  LOG(INFO) << (sizeof(T) == 4 ? "f32" : "f64") << " width " << width << " over [" << lo << ", " << hi
+            << "]: max error " << worst << " ulps, "
+            << std::chrono::duration<double>(libm_done - vecmath_done).count() /
+                   std::chrono::duration<double>(vecmath_done - start).count()
+            << "x the throughput of libm";
+  return worst;
+}
+
+// Checks a function at the special values, allowing results which underflow
+// to be flushed to zero.
+template <typename T>
+void CheckSpecials(vecmath::Function fn, T (*ref)(T), unsigned width) {
+  Kernels kernels;
+  auto kernel = kernels.Build<T>(fn, width);
+  const T inf = std::numeric_limits<T>::infinity();
+  std::vector<T> x{0,    -0.0, 1,    -1,     inf,   -inf, std::numeric_limits<T>::quiet_NaN(),
+                   1e-6, -1e-6, 0.5, 100,    -100,  1000, -1000,
+                   std::numeric_limits<T>::min(), std::numeric_limits<T>::max()};
+  while (x.size() % width) {
+    x.push_back(1);
+  }
+  std::vector<T> actual(x.size());
+  kernel(x.data(), x.data(), actual.data(), x.size());
+  for (size_t i = 0; i < x.size(); ++i) {
+    T expected = ref(x[i]);
+    if (std::fabs(expected) < std::numeric_limits<T>::min() && actual[i] == 0) {
+      continue;
+    }
+    EXPECT_LE(UlpDistance(actual[i], expected), 2) << "f(" << x[i] << ") = " << actual[i] << ", expected " << expected;
+  }
+}
+
+float ExpF(float x) { return std::exp(x); }
+float LogF(float x) { return std::log(x); }
+float TanhF(float x) { return std::tanh(x); }
+float SinF(float x) { return std::sin(x); }
+float CosF(float x) { return std::cos(x); }
+double Exp(double x) { return std::exp(x); }
+double Log(double x) { return std::log(x); }
+double Tanh(double x) { return std::tanh(x); }
+double Sin(double x) { return std::sin(x); }
+double Cos(double x) { return std::cos(x); }
+
+TEST(VecMath, Float) {
+  for (unsigned width : {1u, 8u}) {
+    EXPECT_LE(MaxUlps<float>(vecmath::Function::EXP, ExpF, -87.3f, 88.7f, false, width), 1);
+    EXPECT_LE(MaxUlps<float>(vecmath::Function::LOG, LogF, 1e-37f, 3e38f, true, width), 1);
+    EXPECT_LE(MaxUlps<float>(vecmath::Function::TANH, TanhF, -10.f, 10.f, false, width), 2);
+    EXPECT_LE(MaxUlps<float>(vecmath::Function::SIN, SinF, -6.28f, 6.28f, false, width), 2);
+    EXPECT_LE(MaxUlps<float>(vecmath::Function::COS, CosF, -6.28f, 6.28f, false, width), 2);
+  }
+  CheckSpecials<float>(vecmath::Function::EXP, ExpF, 8);
+  CheckSpecials<float>(vecmath::Function::LOG, LogF, 8);
+  CheckSpecials<float>(vecmath::Function::TANH, TanhF, 8);
+}
+
+TEST(VecMath, FloatSinCosAbsolute) {
+  Kernels kernels;
+  auto sin = kernels.Build<float>(vecmath::Function::SIN, 8);
+  auto cos = kernels.Build<float>(vecmath::Function::COS, 8);
+  std::vector<float> x(1 << 16);
+  for (size_t i = 0; i < x.size(); ++i) {
+    x[i] = -8192.f + 16384.f * i / x.size();
+  }
+  std::vector<float> s(x.size());
+  std::vector<float> c(x.size());
+  sin(x.data(), x.data(), s.data(), x.size());
+  cos(x.data(), x.data(), c.data(), x.size());
+  for (size_t i = 0; i < x.size(); ++i) {
+    EXPECT_NEAR(s[i], std::sin(static_cast<double>(x[i])), 2e-7) << "sin(" << x[i] << ")";
+    EXPECT_NEAR(c[i], std::cos(static_cast<double>(x[i])), 2e-7) << "cos(" << x[i] << ")";
+  }
+}
+
+TEST(VecMath, Half) {
+  // Half precision is evaluated in single precision, and every half is within
+  // 1 ulp of the correctly rounded result.
+  std::vector<half_float::half> x(1 << 16);
+  for (size_t i = 0; i < x.size(); ++i) {
+    uint16_t bits = i;
+    std::memcpy(&x[i], &bits, sizeof(bits));
+  }
+  std::vector<half_float::half> actual(x.size());
+  Kernels kernels;
+  for (auto fn_ref : std::vector<std::pair<vecmath::Function, double (*)(double)>>{{vecmath::Function::EXP, Exp},
+                                                                                  {vecmath::Function::LOG, Log},
+                                                                                  {vecmath::Function::TANH, Tanh},
+                                                                                  {vecmath::Function::SIN, Sin},
+                                                                                  {vecmath::Function::COS, Cos}}) {
+    kernels.Build<half_float::half>(fn_ref.first, 8)(x.data(), x.data(), actual.data(), x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+      auto expected = half_float::half_cast<half_float::half, std::round_to_nearest>(fn_ref.second(x[i]));
+      EXPECT_LE(UlpDistance(actual[i], expected), 1)
+          << "f" << static_cast<int>(fn_ref.first) << "(" << x[i] << ") = " << actual[i] << ", expected " << expected;
+    }
+  }
+}
+
+// Checks SIN and COS at their special values, and beyond the largest argument
+// they reduce: zeros keep their sign through SIN, infinities and NaNs become
+// NaN, and so does anything at least 2^29 in magnitude.
+template <typename T>
+void CheckSinCosSpecials(unsigned width) {
+  Kernels kernels;
+  auto sin = kernels.Build<T>(vecmath::Function::SIN, width);
+  auto cos = kernels.Build<T>(vecmath::Function::COS, width);
+  const T inf = std::numeric_limits<T>::infinity();
+  const T limit = 536870912;
+  const T below = std::nextafter(limit, T(0));
+  std::vector<T> x{0, -0.0, inf, -inf, std::numeric_limits<T>::quiet_NaN(), std::numeric_limits<T>::min(),
+                   limit, -limit, 1e30, -1e30, below, -below};
+  while (x.size() % width) {
+    x.push_back(0);
+  }
+  std::vector<T> s(x.size());
+  std::vector<T> c(x.size());
+  sin(x.data(), x.data(), s.data(), x.size());
+  cos(x.data(), x.data(), c.data(), x.size());
+  EXPECT_TRUE(s[0] == 0 && !std::signbit(s[0]));
+  EXPECT_TRUE(s[1] == 0 && std::signbit(s[1]));
+  EXPECT_EQ(c[0], 1);
+  EXPECT_EQ(c[1], 1);
+  for (size_t i = 2; i < 5; ++i) {
+    EXPECT_TRUE(std::isnan(s[i])) << "sin(" << x[i] << ") = " << s[i];
+    EXPECT_TRUE(std::isnan(c[i])) << "cos(" << x[i] << ") = " << c[i];
+  }
+  EXPECT_EQ(s[5], x[5]);
+  EXPECT_EQ(c[5], 1);
+  for (size_t i = 6; i < 10; ++i) {
+    EXPECT_TRUE(std::isnan(s[i])) << "sin(" << x[i] << ") = " << s[i];
+    EXPECT_TRUE(std::isnan(c[i])) << "cos(" << x[i] << ") = " << c[i];
+  }
+  for (size_t i = 10; i < 12; ++i) {
+    EXPECT_NEAR(s[i], std::sin(static_cast<double>(x[i])), 2e-7) << "sin(" << x[i] << ")";
+    EXPECT_NEAR(c[i], std::cos(static_cast<double>(x[i])), 2e-7) << "cos(" << x[i] << ")";
+  }
+}
+
+TEST(VecMath, SinCosSpecials) {
+  CheckSinCosSpecials<float>(8);
+  CheckSinCosSpecials<double>(4);
+}
+
+TEST(VecMath, FloatSinCosLargeArguments) {
+  // Single-precision arguments are reduced in double precision, so the
+  // absolute error stays small right up to 2^29.
+  Kernels kernels;
+  auto sin = kernels.Build<float>(vecmath::Function::SIN, 8);
+  auto cos = kernels.Build<float>(vecmath::Function::COS, 8);
+  std::vector<float> x(1 << 16);
+  std::mt19937_64 rng;
+  std::uniform_real_distribution<double> dist{std::log(8192.0), std::log(536870912.0)};
+  for (auto& val : x) {
+    val = static_cast<float>(std::exp(dist(rng)));
+  }
+  std::vector<float> s(x.size());
+  std::vector<float> c(x.size());
+  sin(x.data(), x.data(), s.data(), x.size());
+  cos(x.data(), x.data(), c.data(), x.size());
+  for (size_t i = 0; i < x.size(); ++i) {
+    EXPECT_NEAR(s[i], std::sin(static_cast<double>(x[i])), 2e-7) << "sin(" << x[i] << ")";
+    EXPECT_NEAR(c[i], std::cos(static_cast<double>(x[i])), 2e-7) << "cos(" << x[i] << ")";
+  }
+}
+
+TEST(VecMath, Double) {
+  for (unsigned width : {1u, 4u}) {
+    EXPECT_LE(MaxUlps<double>(vecmath::Function::EXP, Exp, -708., 709., false, width), 2);
+    EXPECT_LE(MaxUlps<double>(vecmath::Function::LOG, Log, 1e-300, 1e300, true, width), 1);
+    EXPECT_LE(MaxUlps<double>(vecmath::Function::TANH, Tanh, -20., 20., false, width), 2);
+    EXPECT_LE(MaxUlps<double>(vecmath::Function::SIN, Sin, -1e6, 1e6, false, width), 2);
+    EXPECT_LE(MaxUlps<double>(vecmath::Function::COS, Cos, -1e6, 1e6, false, width), 2);
+  }
+  CheckSpecials<double>(vecmath::Function::EXP, Exp, 4);
+  CheckSpecials<double>(vecmath::Function::LOG, Log, 4);
+  CheckSpecials<double>(vecmath::Function::TANH, Tanh, 4);
+}
+
+TEST(VecMath, Pow) {
+  const double inf = std::numeric_limits<double>::infinity();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<double> bases{0, 1, -1, 2, -2, 0.5, -0.5, inf, -inf, nan, 10, -8, 3, 1e-5, 7.5};
+  std::vector<double> exponents{0, 1, 2, 3, -1, -2, 0.5, -0.5, inf, -inf, nan, 2.5, 1e10, 1.0 / 3, 100, -3};
+  std::vector<float> fx;
+  std::vector<float> fy;
+  std::vector<double> dx;
+  std::vector<double> dy;
+  for (double x : bases) {
+    for (double y : exponents) {
+      fx.push_back(x);
+      fy.push_back(y);
+      dx.push_back(x);
+      dy.push_back(y);
+    }
+  }
+  while (fx.size() % 8) {
+    fx.push_back(1);
+    fy.push_back(1);
+    dx.push_back(1);
+    dy.push_back(1);
+  }
+  Kernels kernels;
+  std::vector<float> fout(fx.size());
+  kernels.Build<float>(vecmath::Function::POW, 8)(fx.data(), fy.data(), fout.data(), fx.size());
+  std::vector<double> dout(dx.size());
+  kernels.Build<double>(vecmath::Function::POW, 4)(dx.data(), dy.data(), dout.data(), dx.size());
+  for (size_t i = 0; i < fx.size(); ++i) {
+    EXPECT_LE(UlpDistance(fout[i], std::pow(fx[i], fy[i])), 1) << "pow(" << fx[i] << ", " << fy[i] << ")";
+    // The double-precision error grows with the magnitude of y ln x.
+    double bound = 2 + 2 * std::fabs(dy[i] * std::log(std::fabs(dx[i])));
+    EXPECT_LE(UlpDistance(dout[i], std::pow(dx[i], dy[i])), std::isfinite(bound) ? bound : 2)
+        << "pow(" << dx[i] << ", " << dy[i] << ")";
+  }
+}
+
+TEST(VecMath, PowLargeIntegralExponents) {
+  // The sign of a negative base's power depends on the exponent's parity,
+  // including for odd exponents too large for an int32.
+  std::vector<double> dx{-1, -1, -1, -1, -1, -1, -2, -1.5};
+  std::vector<double> dy{2147483649.0, 2147483648.0, -2147483649.0, 4294967297.0, 9007199254740991.0,
+                         9007199254740992.0, 2147483649.0, -4294967297.0};
+  Kernels kernels;
+  std::vector<double> dout(dx.size());
+  kernels.Build<double>(vecmath::Function::POW, 4)(dx.data(), dy.data(), dout.data(), dx.size());
+  for (size_t i = 0; i < dx.size(); ++i) {
+    EXPECT_EQ(dout[i], std::pow(dx[i], dy[i])) << "pow(" << dx[i] << ", " << dy[i] << ")";
+  }
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace cpu
+}  // namespace targets
+}  // namespace tile
+}  // namespace vertexai
@@ -0,0 +1,319 @@
+// Copyright 2019 Intel Corporation.
+
+#include "tile/targets/cpu/vecmath.h"
+
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/Module.h>
+
+#include <initializer_list>
+#include <stdexcept>
+
+namespace vertexai {
+namespace tile {
+namespace targets {
+namespace cpu {
+namespace vecmath {
+namespace {
+
+// Replaces the element type of a scalar or vector type.
+llvm::Type* WithElement(llvm::Type* type, llvm::Type* elem) {
+  if (type->isVectorTy()) {
+    return llvm::VectorType::get(elem, type->getVectorNumElements());
+  }
+  return elem;
+}
+
+// Emitter generates the approximations for one floating-point type, which is
+// either single or double precision, scalar or vector. Integer temporaries
+// use a same-width integer type for bit manipulation, and 32-bit integers for
+// the exponents and octants, which every x86 vector extension can convert.
+class Emitter {
+ public:
+  Emitter(llvm::IRBuilder<>* builder, llvm::Type* type)
+      : b_{*builder},
+        type_{type},
+        f64_{type->getScalarType()->isDoubleTy()},
+        bits_{f64_ ? 64u : 32u},
+        mant_{f64_ ? 52u : 23u},
+        bias_{f64_ ? 1023 : 127},
+        itype_{WithElement(type, b_.getIntNTy(bits_))},
+        i32type_{WithElement(type, b_.getInt32Ty())} {}
+
+  llvm::Value* Exp(llvm::Value* x) {
+    double hi = f64_ ? 709.782712893384 : 88.72283905206835;
+    double lo = f64_ ? -708.3964185322641 : -87.33654475;
+    // Clamp the argument, so that the scaling below cannot overflow the
+    // exponent field; the out-of-range lanes are patched up at the end.
+    llvm::Value* xc = Select(b_.CreateFCmpOGT(x, C(hi)), C(hi), x);
+    xc = Select(b_.CreateFCmpOLT(xc, C(lo)), C(lo), xc);
+    xc = Select(b_.CreateFCmpUNO(x, x), C(0), xc);
+    // Reduce to exp(r) * 2^n with |r| <= ln(2)/2, subtracting n*ln(2) in two
+    // parts so that the reduction is exact.
+    llvm::Value* n = Round(Mul(xc, C(1.4426950408889634073599)));
+    llvm::Value* y;
+    if (f64_) {
+      llvm::Value* r = Sub(xc, Mul(n, C(6.93145751953125E-1)));
+      r = Sub(r, Mul(n, C(1.42860682030941723212E-6)));
+      llvm::Value* z = Mul(r, r);
+      llvm::Value* px = Mul(r, Poly(z, {1.26177193074810590878E-4, 3.02994407707441961300E-2, 9.99999999999999999910E-1}));
+      llvm::Value* q = Poly(z, {3.00198505138664455042E-6, 2.52448340349684104192E-3, 2.27265548208155028766E-1,
+                                2.00000000000000000009E0});
+      y = Add(C(1), Mul(C(2), b_.CreateFDiv(px, Sub(q, px))));
+    } else {
+      llvm::Value* r = Sub(xc, Mul(n, C(0.693359375)));
+      r = Add(r, Mul(n, C(2.12194440e-4)));
+      llvm::Value* z = Mul(r, r);
+      llvm::Value* p = Poly(r, {1.9875691500E-4, 1.3981999507E-3, 8.3334519073E-3, 4.1665795894E-2, 1.6666665459E-1,
+                                5.0000001201E-1});
+      y = Add(Add(Mul(p, z), r), C(1));
+    }
+    llvm::Value* result = Scale(y, b_.CreateFPToSI(n, i32type_));
+    result = Select(b_.CreateFCmpOGT(x, C(hi)), llvm::ConstantFP::getInfinity(type_), result);
+    result = Select(b_.CreateFCmpOLT(x, C(lo)), C(0), result);
+    return Select(b_.CreateFCmpUNO(x, x), x, result);
+  }
+
+  llvm::Value* Log(llvm::Value* x) {
+    // Scale subnormal arguments up into the normal range.
+    double min_normal = f64_ ? 2.2250738585072014e-308 : 1.17549435e-38;
+    llvm::Value* tiny = b_.CreateFCmpOLT(x, C(min_normal));
+    llvm::Value* xs = Select(tiny, Mul(x, C(f64_ ? 4503599627370496.0 : 8388608.0)), x);
+    llvm::Value* e0 = Select(tiny, C(-static_cast<double>(mant_)), C(0));
+    // Split the argument into m * 2^e, with m in [sqrt(1/2), sqrt(2)).
+    llvm::Value* bits = b_.CreateBitCast(xs, itype_);
+    llvm::Value* field = b_.CreateAnd(b_.CreateLShr(bits, I(mant_)), I(f64_ ? 0x7ff : 0xff));
+    if (f64_) {
+      field = b_.CreateTrunc(field, i32type_);
+    }
+    llvm::Value* e = Add(b_.CreateSIToFP(b_.CreateSub(field, I32(bias_ - 1)), type_), e0);
+    uint64_t mant_mask = f64_ ? 0x000fffffffffffffULL : 0x007fffffULL;
+    uint64_t half_bits = f64_ ? 0x3fe0000000000000ULL : 0x3f000000ULL;
+    llvm::Value* m = b_.CreateBitCast(b_.CreateOr(b_.CreateAnd(bits, I(mant_mask)), I(half_bits)), type_);
+    llvm::Value* low = b_.CreateFCmpOLT(m, C(0.70710678118654752440));
+    e = Select(low, Sub(e, C(1)), e);
+    m = Select(low, Sub(Add(m, m), C(1)), Sub(m, C(1)));
+    // Approximate log(1 + m), adding e*ln(2) in two parts.
+    llvm::Value* z = Mul(m, m);
+    llvm::Value* y;
+    if (f64_) {
+      llvm::Value* p = Poly(m, {1.01875663804580931796E-4, 4.97494994976747001425E-1, 4.70579119878881725854E0,
+                                1.44989225341610930846E1, 1.79368678507819816313E1, 7.70838733755885391666E0});
+      llvm::Value* q = Poly(m, {1.0, 1.12873587189167450590E1, 4.52279145837532221105E1, 8.29875266912776603211E1,
+                                7.11544750618563894466E1, 2.31251620126765340583E1});
+      y = Mul(m, b_.CreateFDiv(Mul(z, p), q));
+      y = Sub(y, Mul(e, C(2.121944400546905827679e-4)));
+    } else {
+      llvm::Value* p = Poly(m, {7.0376836292E-2, -1.1514610310E-1, 1.1676998740E-1, -1.2420140846E-1, 1.4249322787E-1,
+                                -1.6668057665E-1, 2.0000714765E-1, -2.4999993993E-1, 3.3333331174E-1});
+      y = Mul(Mul(m, z), p);
+      y = Add(y, Mul(e, C(-2.12194440e-4)));
+    }
+    y = Sub(y, Mul(C(0.5), z));
+    llvm::Value* result = Add(Add(m, y), Mul(e, C(0.693359375)));
+    llvm::Value* inf = llvm::ConstantFP::getInfinity(type_);
+    result = Select(b_.CreateFCmpOEQ(x, inf), inf, result);
+    result = Select(b_.CreateFCmpOEQ(x, C(0)), llvm::ConstantFP::getInfinity(type_, true), result);
+    result = Select(b_.CreateFCmpOLT(x, C(0)), llvm::ConstantFP::getNaN(type_), result);
+    return Select(b_.CreateFCmpUNO(x, x), x, result);
+  }
+
+  llvm::Value* Pow(llvm::Value* x, llvm::Value* y) {
+    llvm::Value* result = Exp(Mul(y, Log(Fabs(x))));
+    // A negative base has a real power only for integral exponents, which
+    // determine its sign. Exponents of at least 2^53 (2^24 in single
+    // precision) are even integers; smaller ones convert exactly to an integer
+    // as wide as the float, whose low bit is their parity.
+    llvm::Value* small = b_.CreateFCmpOLT(Fabs(y), C(f64_ ? 9007199254740992.0 : 16777216.0));
+    llvm::Value* yi = b_.CreateFPToSI(Select(small, y, C(0)), itype_);
+    llvm::Value* integral = Select(small, b_.CreateFCmpOEQ(b_.CreateSIToFP(yi, type_), y), True());
+    llvm::Value* odd = b_.CreateAnd(small, b_.CreateICmpNE(b_.CreateAnd(yi, I(1)), I(0)));
+    llvm::Value* signed_result = Select(odd, b_.CreateFNeg(result), result);
+    llvm::Value* inf = llvm::ConstantFP::getInfinity(type_);
+    llvm::Value* real = b_.CreateOr(integral, b_.CreateFCmpOEQ(x, llvm::ConstantFP::getInfinity(type_, true)));
+    result = Select(b_.CreateFCmpOLT(x, C(0)), Select(real, signed_result, llvm::ConstantFP::getNaN(type_)), result);
+    // Powers of one are one, even when the exponent is infinite or NaN, as are
+    // zeroth powers of anything.
+    llvm::Value* one =
+        b_.CreateOr(b_.CreateFCmpOEQ(x, C(1)), b_.CreateAnd(b_.CreateFCmpOEQ(x, C(-1)), b_.CreateFCmpOEQ(Fabs(y), inf)));
+    result = Select(b_.CreateFCmpOEQ(y, C(0)), C(1), result);
+    return Select(one, C(1), result);
+  }
+
+  llvm::Value* Tanh(llvm::Value* x) {
+    llvm::Value* a = Fabs(x);
+    llvm::Value* z = Mul(x, x);
+    llvm::Value* small;
+    if (f64_) {
+      llvm::Value* p = Poly(z, {-9.64399179425052238628E-1, -9.92877231001918586564E1, -1.61468768441708447952E3});
+      llvm::Value* q =
+          Poly(z, {1.0, 1.12811678491632931402E2, 2.23548839060100448583E3, 4.84406305325125486048E3});
+      small = Add(x, Mul(Mul(x, z), b_.CreateFDiv(p, q)));
+    } else {
+      llvm::Value* p = Poly(z, {-5.70498872745E-3, 2.06390887954E-2, -5.37397155531E-2, 1.33314422036E-1,
+                                -3.33332819422E-1});
+      small = Add(x, Mul(Mul(x, z), p));
+    }
+    // Away from zero, tanh(|x|) = 1 - 2 / (exp(2|x|) + 1).
+    llvm::Value* big = Sub(C(1), b_.CreateFDiv(C(2), Add(Exp(Add(a, a)), C(1))));
+    big = CopySign(big, x);
+    return Select(b_.CreateFCmpOLT(a, C(0.625)), small, big);
+  }
+
+  llvm::Value* SinCos(llvm::Value* x, bool cosine) {
+    llvm::Value* a = Fabs(x);
+    llvm::Value* valid = b_.CreateFCmpOLT(a, C(536870912.0));
+    a = Select(valid, a, C(0));
+    // Reduce modulo pi/4: j is the (even) octant, and r the remainder, found
+    // by subtracting j*pi/4 in three parts. Single-precision products of the
+    // octant and those parts lose bits once the octant passes 2^13, so single
+    // precision is reduced in double precision too.
+    llvm::Type* rtype = WithElement(type_, b_.getDoubleTy());
+    auto rc = [rtype](double value) { return llvm::ConstantFP::get(rtype, value); };
+    llvm::Value* ra = f64_ ? a : b_.CreateFPExt(a, rtype);
+    llvm::Value* j = b_.CreateFPToSI(Mul(ra, rc(1.27323954473516268615)), i32type_);
+    j = b_.CreateAnd(b_.CreateAdd(j, I32(1)), I32(~1));
+    llvm::Value* fj = b_.CreateSIToFP(j, rtype);
+    llvm::Value* r = Sub(Sub(Sub(ra, Mul(fj, rc(7.85398125648498535156E-1))), Mul(fj, rc(3.77489470793079817668E-8))),
+                         Mul(fj, rc(2.69515142907905952645E-15)));
+    if (!f64_) {
+      r = b_.CreateFPTrunc(r, type_);
+    }
+    llvm::Value* z = Mul(r, r);
+    llvm::Value* ps;
+    llvm::Value* pc;
+    if (f64_) {
+      ps = Poly(z, {1.58962301576546568060E-10, -2.50507477628578072866E-8, 2.75573136213857245213E-6,
+                    -1.98412698295895385996E-4, 8.33333333332211858878E-3, -1.66666666666666307295E-1});
+      pc = Poly(z, {-1.13585365213876817300E-11, 2.08757008419747316778E-9, -2.75573141792967388112E-7,
+                    2.48015872888517045348E-5, -1.38888888888730564116E-3, 4.16666666666665929218E-2});
+    } else {
+      ps = Poly(z, {-1.9515295891E-4, 8.3321608736E-3, -1.6666654611E-1});
+      pc = Poly(z, {2.443315711809948E-005, -1.388731625493765E-003, 4.166664568298827E-002});
+    }
+    ps = Add(r, Mul(Mul(r, z), ps));
+    pc = Add(Sub(C(1), Mul(C(0.5), z)), Mul(Mul(z, z), pc));
+    // The octant selects between the two polynomials, and the sign.
+    llvm::Value* swap = b_.CreateICmpNE(b_.CreateAnd(j, I32(2)), I32(0));
+    llvm::Value* result;
+    llvm::Value* negate;
+    if (cosine) {
+      result = Select(swap, ps, pc);
+      negate = b_.CreateICmpNE(b_.CreateAnd(b_.CreateAdd(j, I32(2)), I32(4)), I32(0));
+    } else {
+      result = Select(swap, pc, ps);
+      // Test the sign bit rather than comparing with zero, so that sin(-0) is -0.
+      llvm::Value* sign = b_.CreateICmpSLT(b_.CreateBitCast(x, itype_), I(0));
+      negate = b_.CreateXor(b_.CreateICmpNE(b_.CreateAnd(j, I32(4)), I32(0)), sign);
+    }
+    result = Select(negate, b_.CreateFNeg(result), result);
+    return Select(valid, result, llvm::ConstantFP::getNaN(type_));
+  }
+
+ private:
+  llvm::Value* C(double value) { return llvm::ConstantFP::get(type_, value); }
+  llvm::Value* I(uint64_t value) { return llvm::ConstantInt::get(itype_, value); }
+  llvm::Value* I32(int32_t value) { return llvm::ConstantInt::get(i32type_, value, true); }
+  llvm::Value* True() { return llvm::ConstantInt::getTrue(WithElement(type_, b_.getInt1Ty())); }
+
+  llvm::Value* Add(llvm::Value* lhs, llvm::Value* rhs) { return b_.CreateFAdd(lhs, rhs); }
+  llvm::Value* Sub(llvm::Value* lhs, llvm::Value* rhs) { return b_.CreateFSub(lhs, rhs); }
+  llvm::Value* Mul(llvm::Value* lhs, llvm::Value* rhs) { return b_.CreateFMul(lhs, rhs); }
+  llvm::Value* Select(llvm::Value* cond, llvm::Value* lhs, llvm::Value* rhs) { return b_.CreateSelect(cond, lhs, rhs); }
+
+  llvm::Value* Intrinsic(llvm::Intrinsic::ID id, const std::vector<llvm::Value*>& args) {
+    llvm::Module* module = b_.GetInsertBlock()->getModule();
+    return b_.CreateCall(llvm::Intrinsic::getDeclaration(module, id, {type_}), args);
+  }
+  llvm::Value* Fabs(llvm::Value* x) { return Intrinsic(llvm::Intrinsic::fabs, {x}); }
+  llvm::Value* CopySign(llvm::Value* x, llvm::Value* sign) { return Intrinsic(llvm::Intrinsic::copysign, {x, sign}); }
+
+  // Evaluates a polynomial by Horner's rule, coefficients from the highest
+  // power down.
+  llvm::Value* Poly(llvm::Value* x, std::initializer_list<double> coeffs) {
+    llvm::Value* result = nullptr;
+    for (double coeff : coeffs) {
+      result = result ? Add(Mul(result, x), C(coeff)) : C(coeff);
+    }
+    return result;
+  }
+
+  // Rounds to the nearest integer by adding and subtracting a constant which
+  // pushes the fraction out of the mantissa. Unlike rint, this never becomes a
+  // library call on targets without a vector rounding instruction.
+  llvm::Value* Round(llvm::Value* x) {
+    llvm::Value* magic = C(f64_ ? 6755399441055744.0 : 12582912.0);
+    return Sub(Add(x, magic), magic);
+  }
+
+  // Multiplies y by 2^n, in two steps so that n may reach one past the
+  // largest exponent.
+  llvm::Value* Scale(llvm::Value* y, llvm::Value* n) {
+    llvm::Value* half = b_.CreateAShr(n, I32(1));
+    for (llvm::Value* part : {half, b_.CreateSub(n, half)}) {
+      llvm::Value* biased = b_.CreateAdd(part, I32(bias_));
+      if (f64_) {
+        biased = b_.CreateSExt(biased, itype_);
+      }
+      y = Mul(y, b_.CreateBitCast(b_.CreateShl(biased, I(mant_)), type_));
+    }
+    return y;
+  }
+
+  llvm::IRBuilder<>& b_;
+  llvm::Type* type_;
+  bool f64_;
+  unsigned bits_;
+  unsigned mant_;
+  int32_t bias_;
+  llvm::Type* itype_;
+  llvm::Type* i32type_;
+};
+
+}  // namespace
+
+llvm::Value* Emit(llvm::IRBuilder<>* builder, Function fn, const std::vector<llvm::Value*>& args) {
+  if (args.size() != (fn == Function::POW ? 2u : 1u)) {
+    throw std::runtime_error("Wrong number of arguments for a vecmath function");
+  }
+  llvm::Type* type = args[0]->getType();
+  llvm::Type* elem = type->getScalarType();
+  // Evaluate in a wider type where this one lacks the range or precision.
+  llvm::Type* wider = nullptr;
+  if (elem->isHalfTy()) {
+    wider = WithElement(type, builder->getFloatTy());
+  } else if (elem->isFloatTy() && fn == Function::POW) {
+    wider = WithElement(type, builder->getDoubleTy());
+  }
+  if (wider) {
+    std::vector<llvm::Value*> wide_args;
+    for (auto arg : args) {
+      wide_args.push_back(builder->CreateFPExt(arg, wider));
+    }
+    return builder->CreateFPTrunc(Emit(builder, fn, wide_args), type);
+  }
+  if (!elem->isFloatTy() && !elem->isDoubleTy()) {
+    throw std::runtime_error("vecmath functions require floating-point arguments");
+  }
+  Emitter emitter{builder, type};
+  switch (fn) {
+    case Function::EXP:
+      return emitter.Exp(args[0]);
+    case Function::LOG:
+      return emitter.Log(args[0]);
+    case Function::POW:
+      return emitter.Pow(args[0], args[1]);
+    case Function::TANH:
+      return emitter.Tanh(args[0]);
+    case Function::SIN:
+      return emitter.SinCos(args[0], false);
+    case Function::COS:
+      return emitter.SinCos(args[0], true);
+  }
+  throw std::runtime_error("Unknown vecmath function");
+}
+
+}  // namespace vecmath
+}  // namespace cpu
+}  // namespace targets
+}  // namespace tile
+}  // namespace vertexai
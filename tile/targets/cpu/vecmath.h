@@ -0,0 +1,55 @@
+// Copyright 2019 Intel Corporation.
+
+#pragma once
+
+#include <llvm/IR/IRBuilder.h>
+
+#include <vector>
+
+namespace vertexai {
+namespace tile {
+namespace targets {
+namespace cpu {
+namespace vecmath {
+
+// The transcendental functions for which vecmath generates inline code.
+enum class Function {
+  EXP,
+  LOG,
+  POW,
+  TANH,
+  SIN,
+  COS,
+};
+
+// Generates inline code evaluating a transcendental function, returning the
+// result. The arguments must share one floating-point type, which may be a
+// scalar or a vector of any width; the code operates on whole vectors, so it
+// runs at the full SIMD width of the target rather than calling the C library
+// once per lane. POW takes two arguments, the others one.
+//
+// The approximations are the Cephes polynomial and rational forms, evaluated
+// in the argument's own precision, except that half-precision arguments are
+// evaluated in single precision, and single-precision POW and the SIN/COS
+// range reduction in double precision.
+// Measured against glibc over the indicated domains, the maximum errors are:
+//
+//   function  f32                              f64
+//   EXP       1 ulp                            2 ulp
+//   LOG       1 ulp                            1 ulp
+//   TANH      2 ulp                            2 ulp
+//   POW       1 ulp                            2 + 2|y ln x| ulp
+//   SIN/COS   2 ulp for |x| <= 2pi;            2 ulp for |x| <= 1e6
+//             1e-7 absolute for |x| < 2^29
+//
+// Half-precision results are within 1 ulp over every input. Results which
+// would be subnormal are flushed to zero, infinities and NaNs follow C99
+// except that POW(-0, y) is +0 or +inf for odd integer y, and SIN/COS yield
+// NaN for |x| >= 2^29.
+llvm::Value* Emit(llvm::IRBuilder<>* builder, Function fn, const std::vector<llvm::Value*>& args);
+
+}  // namespace vecmath
+}  // namespace cpu
+}  // namespace targets
+}  // namespace tile
+}  // namespace vertexai